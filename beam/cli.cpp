@@ -304,6 +304,13 @@ int main_impl(int argc, char* argv[])
 
 			clean_old_logfiles(LOG_FILES_DIR, LOG_FILES_PREFIX, logCleanupPeriod);
 
+			if (uint32_t logAsync = vm[cli::LOG_ASYNC].as<uint32_t>())
+			{
+				Logger::AsyncParams pars;
+				pars.block = (logAsync > 1);
+				logger->start_async(pars);
+			}
+
 			Rules::get().UpdateChecksum();
 			LOG_INFO() << "Beam Node " << PROJECT_VERSION << " (" << BRANCH_NAME << ")";
 			LOG_INFO() << "Rules signature: " << Rules::get().get_SignatureStr();
@@ -372,6 +379,11 @@ int main_impl(int argc, char* argv[])
 					}
 
 					node.m_Cfg.m_VerificationThreads = vm[cli::VERIFICATION_THREADS].as<int>();
+					node.m_Cfg.m_VerificationWorkStealing = vm[cli::VERIFICATION_WORK_STEALING].as<bool>();
+					node.m_Cfg.m_TxValidation.m_Threads = vm[cli::TX_VALIDATION_THREADS].as<uint32_t>();
+					node.m_Cfg.m_TxValidation.m_BatchMax = vm[cli::TX_VALIDATION_BATCH].as<uint32_t>();
+					node.m_Cfg.m_BandwidthCtl.m_CompressedBodies = vm[cli::COMPRESSED_BODIES].as<bool>();
+					node.m_Cfg.m_SyncCtl.m_Window = vm[cli::SYNC_WINDOW].as<uint32_t>();
 
 					node.m_Cfg.m_LogEvents = vm[cli::LOG_UTXOS].as<bool>();
 
@@ -461,6 +473,15 @@ int main_impl(int argc, char* argv[])
 					if (vm.count(cli::VACUUM))
 						node.m_Cfg.m_ProcessorParams.m_Vacuum = vm[cli::VACUUM].as<bool>();
 
+					if (vm.count(cli::DB_WAL))
+						node.m_Cfg.m_ProcessorParams.m_Wal = vm[cli::DB_WAL].as<bool>();
+
+					if (vm.count(cli::STATES_HASHES))
+						node.m_Cfg.m_ProcessorParams.m_StatesHashes = vm[cli::STATES_HASHES].as<bool>();
+
+					if (vm.count(cli::BLOCK_STORE))
+						node.m_Cfg.m_ProcessorParams.m_BlockStore = vm[cli::BLOCK_STORE].as<bool>();
+
 					if (vm.count(cli::RESET_ID))
 						node.m_Cfg.m_ProcessorParams.m_ResetSelfID = vm[cli::RESET_ID].as<bool>();
 
@@ -470,6 +491,8 @@ int main_impl(int argc, char* argv[])
 					if (!vm[cli::BBS_ENABLE].as<bool>())
 						ZeroObject(node.m_Cfg.m_Bbs.m_Limit);
 
+					node.m_Cfg.m_Bbs.m_MaxIndexSize = uint64_t(vm[cli::BBS_MAX_INDEX].as<uint32_t>()) * 1024U * 1024U;
+
 					auto var = vm[cli::FAST_SYNC];
 					if (!var.empty())
 					{
@@ -530,6 +553,7 @@ int main_impl(int argc, char* argv[])
 					{
 						node.m_Cfg.m_Recovery.m_sPathOutput = vm[cli::RECOVERY_AUTO_PATH].as<string>();
 						node.m_Cfg.m_Recovery.m_Granularity = vm[cli::RECOVERY_AUTO_PERIOD].as<uint32_t>();
+						node.m_Cfg.m_Recovery.m_Deltas = vm[cli::RECOVERY_AUTO_DELTAS].as<uint32_t>();
 					}
 
 					io::Timer::Ptr pCrashTimer;
@@ -161,6 +161,7 @@ namespace bvm2 {
 		ZeroObject(m_Data);
 		ZeroObject(m_LinearMem);
 		m_Instruction.m_p0 = m_Instruction.m_p1 = nullptr;
+		ResetPreDecoded();
 
 		m_vStack.resize((nStackBytes + sizeof(Wasm::Word) - 1) / sizeof(Wasm::Word), 0);
 
@@ -295,6 +296,7 @@ namespace bvm2 {
 		m_Stack.m_PosMin = x.m_StackPosMin;
 		m_Stack.m_BytesMax = x.m_StackBytesMax;
 
+		ResetPreDecoded();
 		m_FarCalls.m_Stack.Delete(x);
 
 		if (!m_FarCalls.m_Stack.empty())
@@ -1356,6 +1358,8 @@ namespace bvm2 {
 
 		Blob blob(pVal, nVal);
 		AddRemoveShader(cid, &blob, true);
+
+		ResetPreDecoded(); // the code buffers may be modified or reused
 	}
 
 	BVM_METHOD(Halt)
@@ -26,6 +26,7 @@
 
 #include <sstream>
 #include <algorithm>
+#include <chrono>
 #include <iterator>
 #include <math.h>
 
@@ -92,6 +93,18 @@ namespace Shaders {
 	template <bool bToShader> void Convert(Dummy::Hash2&) {}
 	template <bool bToShader> void Convert(Dummy::Hash3&) {}
 
+	namespace Globals { // hand-written module, see TestPreDecoded()
+		struct Args {
+			static const uint32_t s_iMethod = 2;
+			uint32_t m_Count;
+			uint32_t m_Res;
+		};
+	}
+	template <bool bToShader> void Convert(Globals::Args& x) {
+		ConvertOrd<bToShader>(x.m_Count);
+		ConvertOrd<bToShader>(x.m_Res);
+	}
+
 	template <bool bToShader> void Convert(Dummy::VerifyBeamHeader& x) {
 		x.m_Hdr.template Convert<bToShader>();
 	}
@@ -700,6 +713,10 @@ namespace bvm2 {
 		void TestDaoCore();
 		void TestAphorize();
 		void TestLiquity();
+		void TestPreDecoded();
+
+		template <typename TArg>
+		void TestPreDecodedFor(const char* szName, const ContractID&, const TArg& args, bool bOk);
 
 		void TestAll();
 	};
@@ -1828,6 +1845,122 @@ namespace bvm2 {
 
 	}
 
+	template <typename TArg>
+	void MyProcessor::TestPreDecodedFor(const char* szName, const ContractID& cid, const TArg& args, bool bOk)
+	{
+		// run the same method by the plain interpreter, and with the pre-decoded code. Must be cycle-exact
+		TArg pArgs[2];
+		uint32_t pCycles[2], pCharge[2];
+
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			m_UsePreDecoded = !!i;
+			pArgs[i] = args;
+
+			auto t0 = std::chrono::steady_clock::now();
+			verify_test(RunGuarded_T(cid, TArg::s_iMethod, pArgs[i]) == bOk);
+			auto dt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+
+			pCycles[i] = m_Cycles;
+			pCharge[i] = m_Charge;
+
+			std::cout << szName << (i ? ", pre-decoded: " : ", interpreted: ") << m_Cycles << " cycles, " << dt << " us" << std::endl;
+		}
+
+		m_UsePreDecoded = true;
+
+		verify_test(pCycles[0] == pCycles[1]);
+		verify_test(pCharge[0] == pCharge[1]);
+		verify_test(!memcmp(pArgs, pArgs + 1, sizeof(TArg)));
+	}
+
+	void MyProcessor::TestPreDecoded()
+	{
+		{
+			Shaders::Dummy::InfCycle args;
+			args.m_Val = 12;
+			TestPreDecodedFor("InfCycle", m_cidDummy, args, false); // runs out of charge at the same cycle
+		}
+
+		{
+			Shaders::Dummy::MathTest2 args;
+			ZeroObject(args);
+			ECC::GenRandom(&args.m_Nom, sizeof(args.m_Nom));
+			ECC::GenRandom(&args.m_Denom, sizeof(args.m_Denom));
+			TestPreDecodedFor("MathTest2", m_cidDummy, args, true);
+		}
+
+		{
+			Shaders::Dummy::Hash3 args;
+			ZeroObject(args);
+			memset(args.m_pInp, 0x5a, sizeof(args.m_pInp));
+			args.m_Inp = sizeof(args.m_pInp);
+			args.m_NaggleBytes = 7;
+			args.m_Bits = 256;
+			TestPreDecodedFor("Keccak", m_cidDummy, args, true);
+		}
+
+		{
+			// The contract modifies its global variable (the data section follows the code), this must not invalidate the pre-decoded code.
+			// Hand-written module:
+			//	Method_2(Args* p) { g_Val = 0; for (uint32_t i = 0; ; ) { g_Val += i; if (++i >= p->m_Count) break; } p->m_Res = g_Val; }
+			//	g_Val is at va 1024, initially 7
+			static const uint8_t pWasm[] = {
+				0x00, 'a', 's', 'm', 0x01, 0x00, 0x00, 0x00,
+				0x01, 0x05, 0x01, 0x60, 0x01, 0x7f, 0x00, // types: (i32) -> ()
+				0x03, 0x04, 0x03, 0x00, 0x00, 0x00, // funcs
+				0x07, 0x22, 0x03, // exports
+					0x08, 'M', 'e', 't', 'h', 'o', 'd', '_', '0', 0x00, 0x00,
+					0x08, 'M', 'e', 't', 'h', 'o', 'd', '_', '1', 0x00, 0x01,
+					0x08, 'M', 'e', 't', 'h', 'o', 'd', '_', '2', 0x00, 0x02,
+				0x0a, 0x40, 0x03, // code
+					0x02, 0x00, 0x0b, // c'tor
+					0x02, 0x00, 0x0b, // d'tor
+					0x38, 0x01, 0x01, 0x7f,
+						0x41, 0x80, 0x08, 0x41, 0x00, 0x36, 0x02, 0x00, // g_Val = 0
+						0x03, 0x40, // loop
+							0x41, 0x80, 0x08, 0x41, 0x80, 0x08, 0x28, 0x02, 0x00, 0x20, 0x01, 0x6a, 0x36, 0x02, 0x00, // g_Val += i
+							0x20, 0x01, 0x41, 0x01, 0x6a, 0x22, 0x01, // ++i
+							0x20, 0x00, 0x28, 0x02, 0x00, 0x49, 0x0d, 0x00, // continue if i < p->m_Count
+						0x0b,
+						0x20, 0x00, 0x41, 0x80, 0x08, 0x28, 0x02, 0x00, 0x36, 0x02, 0x04, // p->m_Res = g_Val
+					0x0b,
+				0x0b, 0x0b, 0x01, 0x00, 0x41, 0x80, 0x08, 0x0b, 0x04, 0x07, 0x00, 0x00, 0x00, // data
+			};
+
+			ByteBuffer code;
+			Processor::Compile(code, Blob(pWasm, sizeof(pWasm)), Kind::Contract);
+
+			ContractID cid;
+			Zero_ zero;
+			verify_test(ContractCreate_T(cid, code, zero));
+
+			auto IsCached = [&code]() {
+				// the slot that matches the executable part of the code
+				for (const auto& s : PreDecoded::get_ThreadCache().m_pSlot)
+					if (!s.m_Code.empty() && (s.m_Code.size() < code.size()) && !memcmp(&s.m_Code.front(), &code.front(), s.m_Code.size()))
+						return true;
+				return false;
+			};
+
+			Shaders::Globals::Args args;
+			args.m_Count = 100000;
+			args.m_Res = 0;
+
+			TestPreDecodedFor("Globals", cid, args, true);
+			verify_test(IsCached());
+
+			uint32_t nRes = 0;
+			for (uint32_t i = 0; i < args.m_Count; i++)
+				nRes += i;
+
+			// re-run, the decoded code is reused
+			verify_test(RunGuarded_T(cid, args.s_iMethod, args));
+			verify_test(args.m_Res == nRes);
+			verify_test(IsCached());
+		}
+	}
+
 	void MyProcessor::TestDummy()
 	{
 		ContractID cid;
@@ -2152,6 +2285,8 @@ namespace bvm2 {
 			verify_test(RunGuarded(cid, args.s_iMethod, buf, nullptr));
 		}
 
+		TestPreDecoded();
+
 		verify_test(ContractDestroy_T(cid, zero));
 	}
 
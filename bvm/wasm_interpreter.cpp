@@ -1490,6 +1490,88 @@ namespace Wasm {
 		Test(n <= 4);
 	}
 
+	/////////////////////////////////////////////
+	// PreDecoded
+	inline uint32_t& Processor::PreDecoded::Slot::get_Idx(uint32_t ip)
+	{
+		const uint32_t nPageSize = 1U << s_PageBits;
+
+		uint32_t& nPage = m_vPages[ip >> s_PageBits];
+		if (!nPage)
+		{
+			nPage = static_cast<uint32_t>(m_vIdx.size() >> s_PageBits) + 1;
+			m_vIdx.resize(m_vIdx.size() + nPageSize, 0);
+		}
+
+		return m_vIdx[((nPage - 1) << s_PageBits) | (ip & (nPageSize - 1))];
+	}
+
+	void Processor::PreDecoded::Slot::Init(const Blob& code)
+	{
+		m_Code.assign(static_cast<const uint8_t*>(code.p), static_cast<const uint8_t*>(code.p) + code.n);
+		m_pCode = code.p;
+		m_vPages.assign((code.n >> s_PageBits) + 1, 0);
+		m_vIdx.clear();
+		m_vOps.clear();
+	}
+
+	void Processor::PreDecoded::Slot::Clear()
+	{
+		m_Code.clear();
+		m_pCode = nullptr;
+		m_vPages.clear();
+		m_vIdx.clear();
+		m_vOps.clear();
+	}
+
+	Processor::PreDecoded::Slot& Processor::PreDecoded::Select(const Blob& code)
+	{
+		Slot* pRes = nullptr;
+		Slot* pOldest = m_pSlot;
+
+		for (uint32_t i = 0; i < s_Slots; i++)
+		{
+			auto& s = m_pSlot[i];
+			if ((s.m_Code.size() == code.n) && code.n && !memcmp(&s.m_Code.front(), code.p, code.n))
+			{
+				pRes = &s;
+				pRes->m_pCode = code.p;
+				break;
+			}
+
+			if (s.m_Tick < pOldest->m_Tick)
+				pOldest = &s;
+		}
+
+		if (!pRes)
+		{
+			pRes = pOldest;
+			pRes->Init(code);
+		}
+
+		pRes->m_Tick = ++m_Tick;
+		return *pRes;
+	}
+
+	Processor::PreDecoded& Processor::PreDecoded::get_ThreadCache()
+	{
+		static thread_local PreDecoded s_Cache;
+		return s_Cache;
+	}
+
+	void Processor::OnWriteCode(const uint8_t* p, uint32_t nSize)
+	{
+		Blob code = get_CodeExec();
+		auto* pCode = static_cast<const uint8_t*>(code.p);
+		if ((p + nSize <= pCode) || (p >= pCode + code.n))
+			return; // not in the executable code (i.e. global variables)
+
+		// rare, not worth the partial invalidation. The slot no longer matches the code
+		if (m_pPreDecoded && (m_pPreDecoded->m_pCode == m_Code.p))
+			m_pPreDecoded->Clear();
+		ResetPreDecoded();
+	}
+
 	struct ProcessorPlus
 		:public Processor
 	{
@@ -1563,8 +1645,11 @@ namespace Wasm {
 
 		void OnLocal(bool bSet, bool bGet)
 		{
-			uint32_t nOffset = m_Instruction.Read<uint32_t>();
+			OnLocalEx(m_Instruction.Read<uint32_t>(), bSet, bGet);
+		}
 
+		void OnLocalEx(uint32_t nOffset, bool bSet, bool bGet)
+		{
 			uint8_t nType = Type::s_Base + static_cast<uint8_t>((sizeof(Word) - 1) & (nOffset - Type::s_Base));
 			uint8_t nWords = Type::Words(nType);
 
@@ -1609,9 +1694,12 @@ namespace Wasm {
 			auto nAlign = m_Instruction.Read<Word>();
 			Stack::TestAlignmentPower(nAlign);
 
-			auto nOffs = m_Instruction.Read<Word>();
-			nOffs += m_Stack.Pop<Word>();
+			return MemAddr(m_Instruction.Read<Word>(), nSize, bW);
+		}
 
+		uint8_t* MemAddr(Word nOffs, uint32_t nSize, bool bW)
+		{
+			nOffs += m_Stack.Pop<Word>();
 			return get_AddrEx(nOffs, nSize, bW);
 		}
 
@@ -1623,15 +1711,17 @@ namespace Wasm {
 			return MemArgEx(nSize, false);
 		}
 
+		struct RunCheckpoint :public Checkpoint {
+			Word m_Ip;
+			RunCheckpoint(Word ip) :m_Ip(ip) {}
+			virtual void Dump(std::ostream& os) override {
+				os << "wasm/Run, Ip=" << uintBigFrom(m_Ip);
+			}
+		};
+
 		void RunOncePlus()
 		{
-			struct MyCheckpoint :public Checkpoint {
-				Word m_Ip;
-				virtual void Dump(std::ostream& os) override {
-					os << "wasm/Run, Ip=" << uintBigFrom(m_Ip);
-				}
-			} cp;
-			cp.m_Ip = get_Ip();
+			RunCheckpoint cp(get_Ip());
 
 			typedef Instruction I;
 			I nInstruction = (I) m_Instruction.Read1();
@@ -1694,6 +1784,297 @@ namespace Wasm {
 			}
 
 		}
+
+		void DoDrop(uint32_t nWords);
+		void DoSelect(uint32_t nWords);
+		void DoCall(Word nAddr);
+		void DoCallExt(uint32_t iExt);
+		void DoRet(uint32_t nRets, uint32_t nLocals, uint32_t nArgs);
+
+		/////////////////////////////////////////////
+		// Pre-decoded execution
+		typedef PreDecoded::Op Op;
+
+		static ProcessorPlus& From(Processor& p) {
+			return Cast::Up<ProcessorPlus>(p);
+		}
+
+		template <void (ProcessorPlus::*pfn)()>
+		static void Exec(Processor& p, const Op&) {
+			(From(p).*pfn)();
+		}
+
+		template <bool bSet, bool bGet>
+		static void Exec_local(Processor& p, const Op& op) {
+			From(p).OnLocalEx(op.m_Arg0, bSet, bGet);
+		}
+
+		template <bool bGet>
+		static void Exec_global_imp(Processor& p, const Op& op) {
+			p.OnGlobalVar(op.m_Arg0, bGet);
+		}
+
+		static void Exec_drop(Processor& p, const Op& op) {
+			From(p).DoDrop(op.m_Arg0);
+		}
+
+		static void Exec_select(Processor& p, const Op& op) {
+			From(p).DoSelect(op.m_Arg0);
+		}
+
+		static void Exec_br(Processor& p, const Op& op) {
+			p.Jmp(op.m_Arg0);
+		}
+
+		static void Exec_br_if(Processor& p, const Op& op)
+		{
+			Word addr = op.m_Arg0;
+			if (p.m_Stack.Pop<Word>())
+				p.Jmp(addr);
+		}
+
+		static void Exec_br_table(Processor& p, const Op& op)
+		{
+			// the addresses are read from the code, only the number of labels is pre-decoded
+			Word nOperand = p.m_Stack.Pop<Word>();
+			std::setmin(nOperand, op.m_Arg0);
+
+			auto* pAddrs = reinterpret_cast<const Word*>(static_cast<const uint8_t*>(p.m_Code.p) + op.m_Arg1);
+			p.Jmp(from_wasm<Word>(pAddrs[nOperand]));
+		}
+
+		static void Exec_call(Processor& p, const Op& op) {
+			From(p).DoCall(op.m_Arg0);
+		}
+
+		static void Exec_call_ext(Processor& p, const Op& op) {
+			From(p).DoCallExt(op.m_Arg0);
+		}
+
+		static void Exec_i32_const(Processor& p, const Op& op) {
+			p.m_Stack.Push<uint32_t>(op.m_Arg0);
+		}
+
+		static void Exec_i64_const(Processor& p, const Op& op) {
+			p.m_Stack.Push<uint64_t>(op.m_Arg1);
+		}
+
+		static void Exec_prolog(Processor& p, const Op& op)
+		{
+			for (uint32_t nWords = op.m_Arg0; nWords--; )
+				p.m_Stack.Push1(0);
+		}
+
+		static void Exec_ret(Processor& p, const Op& op) {
+			From(p).DoRet(op.m_Arg0, static_cast<uint32_t>(op.m_Arg1), static_cast<uint32_t>(op.m_Arg1 >> 32));
+		}
+
+		template <typename T, typename TMem>
+		static void Exec_load(Processor& p, const Op& op)
+		{
+			TMem val1 = from_wasm<typename Type::ToFlexible<TMem, false>::T>(From(p).MemAddr(op.m_Arg0, sizeof(TMem), false));
+			auto valExt = Type::Extend<T, TMem>(val1);
+			p.m_Stack.Push(valExt);
+		}
+
+		template <typename T, typename TMem>
+		static void Exec_store(Processor& p, const Op& op)
+		{
+			auto val = p.m_Stack.Pop<T>();
+			to_wasm(From(p).MemAddr(op.m_Arg0, sizeof(TMem), true), static_cast<TMem>(val));
+		}
+
+		void DecodeOp(Reader& inp, Op& op)
+		{
+			typedef Instruction I;
+			I nInstruction = (I) inp.Read1();
+
+			switch (nInstruction)
+			{
+			case I::local_get: op.m_pfn = Exec_local<false, true>; op.m_Arg0 = inp.Read<uint32_t>(); break;
+			case I::local_set: op.m_pfn = Exec_local<true, false>; op.m_Arg0 = inp.Read<uint32_t>(); break;
+			case I::local_tee: op.m_pfn = Exec_local<true, true>; op.m_Arg0 = inp.Read<uint32_t>(); break;
+			case I::global_get_imp: op.m_pfn = Exec_global_imp<true>; op.m_Arg0 = inp.Read<uint32_t>(); break;
+			case I::global_set_imp: op.m_pfn = Exec_global_imp<false>; op.m_Arg0 = inp.Read<uint32_t>(); break;
+			case I::drop: op.m_pfn = Exec_drop; op.m_Arg0 = Type::Words(inp.Read1()); break;
+			case I::select: op.m_pfn = Exec_select; op.m_Arg0 = Type::Words(inp.Read1()); break;
+			case I::i32_wrap_i64: op.m_pfn = Exec<&ProcessorPlus::On_i32_wrap_i64>; break;
+			case I::i64_extend_i32_s: op.m_pfn = Exec<&ProcessorPlus::On_i64_extend_i32_s>; break;
+			case I::i64_extend_i32_u: op.m_pfn = Exec<&ProcessorPlus::On_i64_extend_i32_u>; break;
+			case I::call: op.m_pfn = Exec_call; op.m_Arg0 = from_wasm<Word>(inp.Consume(sizeof(Word))); break;
+			case I::call_ext: op.m_pfn = Exec_call_ext; op.m_Arg0 = inp.Read<uint32_t>(); break;
+			case I::call_indirect: op.m_pfn = Exec<&ProcessorPlus::On_call_indirect>; break;
+			case I::br: op.m_pfn = Exec_br; op.m_Arg0 = from_wasm<Word>(inp.Consume(sizeof(Word))); break;
+			case I::br_if: op.m_pfn = Exec_br_if; op.m_Arg0 = from_wasm<Word>(inp.Consume(sizeof(Word))); break;
+			case I::i32_const: op.m_pfn = Exec_i32_const; op.m_Arg0 = inp.Read<int32_t>(); break;
+			case I::i64_const: op.m_pfn = Exec_i64_const; op.m_Arg1 = inp.Read<int64_t>(); break;
+			case I::prolog: op.m_pfn = Exec_prolog; op.m_Arg0 = inp.Read<uint32_t>(); break;
+
+			case I::br_table:
+				{
+					uint32_t nLabels;
+					inp.Read(nLabels);
+
+					uint32_t nSize = sizeof(Word) * (nLabels + 1);
+					Test(nSize / sizeof(Word) == nLabels + 1); // overflow check
+
+					op.m_pfn = Exec_br_table;
+					op.m_Arg0 = nLabels;
+					op.m_Arg1 = static_cast<uint32_t>(inp.Consume(nSize) - static_cast<const uint8_t*>(m_Code.p));
+				}
+				break;
+
+			case I::ret:
+				{
+					op.m_pfn = Exec_ret;
+					op.m_Arg0 = inp.Read<uint32_t>();
+					auto nLocals = inp.Read<uint32_t>();
+					auto nArgs = inp.Read<uint32_t>();
+					op.m_Arg1 = nLocals | (static_cast<uint64_t>(nArgs) << 32);
+				}
+				break;
+
+#define THE_MACRO(name, id32, id64) \
+			case I::i32_##name: op.m_pfn = Exec<&ProcessorPlus::On_##name<uint32_t, uint32_t> >; break; \
+			case I::i64_##name: op.m_pfn = Exec<&ProcessorPlus::On_##name<uint32_t, uint64_t> >; break;
+
+			WasmInstructions_unop_Polymorphic_32(THE_MACRO)
+			WasmInstructions_binop_Polymorphic_32(THE_MACRO)
+#undef THE_MACRO
+
+#define THE_MACRO(name, id32, id64) \
+			case I::i32_##name: op.m_pfn = Exec<&ProcessorPlus::On_##name<uint32_t, uint32_t> >; break; \
+			case I::i64_##name: op.m_pfn = Exec<&ProcessorPlus::On_##name<uint64_t, uint64_t> >; break;
+
+			WasmInstructions_binop_Polymorphic_x(THE_MACRO)
+#undef THE_MACRO
+
+#define THE_MACRO(id, type, name, tmem) \
+			case I::type##_##name: \
+				Stack::TestAlignmentPower(inp.Read<Word>()); \
+				op.m_Arg0 = inp.Read<Word>(); \
+				op.m_pfn = Exec_load<Type::Code2Type<Type::type>::T, tmem>; \
+				break;
+
+			WasmInstructions_Load(THE_MACRO)
+#undef THE_MACRO
+
+#define THE_MACRO(id, type, name, tmem) \
+			case I::type##_##name: \
+				Stack::TestAlignmentPower(inp.Read<Word>()); \
+				op.m_Arg0 = inp.Read<Word>(); \
+				op.m_pfn = Exec_store<Type::Code2Type<Type::type>::T, tmem>; \
+				break;
+
+			WasmInstructions_Store(THE_MACRO)
+#undef THE_MACRO
+
+			default:
+				break; // not pre-decoded (global_get/set fail anyway)
+			}
+		}
+
+		Op& Decode(PreDecoded::Slot& s, Word ip)
+		{
+			auto& op = s.m_vOps.emplace_back();
+			ZeroObject(op);
+			op.m_Ip = ip;
+
+			Reader inp(m_Instruction.m_Mode);
+			inp.m_p0 = m_Instruction.m_p0;
+			inp.m_p1 = m_Instruction.m_p1;
+
+			try {
+				DecodeOp(inp, op);
+			}
+			catch (const Exc&) {
+				op.m_pfn = nullptr; // let the interpreter fail in the same way
+			}
+
+			// The decoded ops are shared by processors with different modes. If the mode is relevant for this instruction - leave it to the interpreter
+			if (inp.m_ModeTriggered)
+				op.m_pfn = nullptr;
+
+			if (op.m_pfn)
+			{
+				op.m_Size = static_cast<uint32_t>(inp.m_p0 - m_Instruction.m_p0);
+
+				// only the executable part is matched and tracked for writes
+				if (ip + op.m_Size > get_CodeExec().n)
+					op.m_pfn = nullptr;
+			}
+
+			s.get_Idx(ip) = static_cast<uint32_t>(s.m_vOps.size());
+			return op;
+		}
+
+		Op* FindOp(PreDecoded::Slot& s, Word ip)
+		{
+			if (ip >= s.m_Code.size())
+				return nullptr;
+
+			uint32_t iOp = s.get_Idx(ip);
+			return iOp ? &s.m_vOps[iOp - 1] : &Decode(s, ip);
+		}
+
+		void RunOnceDecoded()
+		{
+#ifdef WASM_INTERPRETER_DEBUG
+			if (m_Dbg.m_Instructions)
+			{
+				RunOncePlus();
+				return;
+			}
+#endif // WASM_INTERPRETER_DEBUG
+
+			auto* pSlot = m_pPreDecoded;
+			Blob code = get_CodeExec();
+			if (!pSlot || (pSlot->m_pCode != code.p) || (pSlot->m_Code.size() != code.n))
+			{
+				ResetPreDecoded();
+				m_pPreDecoded = pSlot = &PreDecoded::get_ThreadCache().Select(code);
+			}
+
+			Word ip = get_Ip();
+			Op* pOp = nullptr;
+
+			Op* pPrev = m_pPreDecodedPrev;
+			if (pPrev)
+			{
+				if (pPrev->m_Ip + pPrev->m_Size == ip)
+				{
+					pOp = pPrev->m_pNext;
+					if (!pOp)
+						pOp = pPrev->m_pNext = FindOp(*pSlot, ip);
+				}
+				else
+				{
+					if (pPrev->m_nJmp == ip)
+						pOp = pPrev->m_pJmp;
+
+					if (!pOp)
+					{
+						pOp = pPrev->m_pJmp = FindOp(*pSlot, ip);
+						pPrev->m_nJmp = ip;
+					}
+				}
+			}
+			else
+				pOp = FindOp(*pSlot, ip);
+
+			if (!pOp || !pOp->m_pfn)
+			{
+				m_pPreDecodedPrev = nullptr;
+				RunOncePlus();
+				return;
+			}
+
+			RunCheckpoint cp(ip);
+
+			m_pPreDecodedPrev = pOp;
+			m_Instruction.m_p0 += pOp->m_Size;
+			pOp->m_pfn(*this, *pOp); // the handlers don't access the op after calling out
+		}
 	};
 
 	Word Processor::get_Ip() const
@@ -1755,6 +2136,9 @@ namespace Wasm {
 		CheckpointTxt cp("mem/bounds");
 		Test(nSize <= nSizeOut);
 
+		if (bW)
+			Cast::NotConst(*this).OnWriteCode(pRet, nSize);
+
 		return pRet;
 	}
 
@@ -1762,7 +2146,12 @@ namespace Wasm {
 	{
 		auto& p = Cast::Up<ProcessorPlus>(*this);
 		static_assert(sizeof(p) == sizeof(*this));
-		p.RunOncePlus();
+
+		// In the AutoWorkAround mode the reader may modify the code, leave it to the interpreter
+		if (m_UsePreDecoded && (Reader::Mode::AutoWorkAround != m_Instruction.m_Mode))
+			p.RunOnceDecoded();
+		else
+			p.RunOncePlus();
 	}
 
 	void Processor::InvokeExt(uint32_t)
@@ -1836,14 +2225,22 @@ namespace Wasm {
 
 	void ProcessorPlus::On_drop()
 	{
-		uint32_t nWords = Type::Words(m_Instruction.Read1());
+		DoDrop(Type::Words(m_Instruction.Read1()));
+	}
+
+	void ProcessorPlus::DoDrop(uint32_t nWords)
+	{
 		Test(m_Stack.m_Pos - m_Stack.m_PosMin >= nWords);
 		m_Stack.m_Pos -= nWords;
 	}
 
 	void ProcessorPlus::On_select()
 	{
-		uint32_t nWords = Type::Words(m_Instruction.Read1());
+		DoSelect(Type::Words(m_Instruction.Read1()));
+	}
+
+	void ProcessorPlus::DoSelect(uint32_t nWords)
+	{
 		auto nSel = m_Stack.Pop<Word>();
 
 		Test(m_Stack.m_Pos - m_Stack.m_PosMin >= (nWords << 1)); // must be at least 2 such operands
@@ -1902,7 +2299,11 @@ namespace Wasm {
 
 	void ProcessorPlus::On_call()
 	{
-		Word nAddr = ReadAddr();
+		DoCall(ReadAddr());
+	}
+
+	void ProcessorPlus::DoCall(Word nAddr)
+	{
 		Word nRetAddr = get_Ip();
 		m_Stack.Push(nRetAddr);
 		OnCall(nAddr);
@@ -1910,8 +2311,11 @@ namespace Wasm {
 
 	void ProcessorPlus::On_call_ext()
 	{
-		uint32_t iExt = m_Instruction.Read<uint32_t>();
+		DoCallExt(m_Instruction.Read<uint32_t>());
+	}
 
+	void ProcessorPlus::DoCallExt(uint32_t iExt)
+	{
 		struct MyCheckpoint :public Checkpoint {
 			uint32_t m_iExt;
 			virtual void Dump(std::ostream& os) override {
@@ -1973,6 +2377,11 @@ namespace Wasm {
 		auto nLocals = m_Instruction.Read<uint32_t>();
 		auto nArgs = m_Instruction.Read<uint32_t>();
 
+		DoRet(nRets, nLocals, nArgs);
+	}
+
+	void ProcessorPlus::DoRet(uint32_t nRets, uint32_t nLocals, uint32_t nArgs)
+	{
 		// stack layout
 		// ...
 		// args
@@ -18,6 +18,7 @@
 #include "../utility/byteorder.h"
 
 #include <limits>
+#include <deque>
 
 namespace beam {
 namespace Wasm {
@@ -347,6 +348,70 @@ namespace Wasm {
 		} m_Dbg;
 #endif // WASM_INTERPRETER_DEBUG
 
+		// Pre-decoded form of the code: each instruction is parsed once, and translated into a handler with the resolved operands.
+		// Built lazily, per instruction address. The execution is still step-by-step (one instruction per RunOnce), the results,
+		// errors and cycle counts are exactly the same as of the plain interpreter.
+		// The decoded code is kept in a per-thread cache, shared by the processors (the node creates one per kernel). It's matched
+		// by the contents of the executable part of the code (up to m_prTable0), not by the buffer address. The data that follows
+		// (global variables) may be modified by the code, this doesn't affect the decoded ops.
+		struct PreDecoded
+		{
+			struct Op
+			{
+				typedef void (*Handler)(Processor&, const Op&);
+
+				Handler m_pfn; // if null - the instruction is executed by the plain interpreter
+				uint32_t m_Size; // encoded size
+				uint32_t m_Arg0;
+				uint64_t m_Arg1;
+				uint32_t m_Ip;
+
+				// the successors, linked once they're executed. Most of the time the next op is found without the lookup
+				uint32_t m_nJmp; // ip of the last non-sequential successor
+				Op* m_pNext;
+				Op* m_pJmp;
+			};
+
+			struct Slot
+			{
+				ByteBuffer m_Code; // copy of the decoded code
+				const void* m_pCode = nullptr; // buffer address it was last matched to
+				uint32_t m_Tick = 0;
+
+				// ip -> 1-based index in m_vOps, 0 if not decoded yet.
+				// Allocated in pages, only for the code that is actually executed, the setup cost doesn't depend on the code size.
+				static const uint32_t s_PageBits = 10;
+				std::vector<uint32_t> m_vPages; // 1-based page number in m_vIdx, 0 if not allocated
+				std::vector<uint32_t> m_vIdx;
+				std::deque<Op> m_vOps; // the ops are never moved, until the slot is reused
+
+				uint32_t& get_Idx(uint32_t ip); // allocates the page if necessary
+				void Init(const Blob& code);
+				void Clear();
+			};
+
+			static const uint32_t s_Slots = 16;
+
+			Slot m_pSlot[s_Slots];
+			uint32_t m_Tick = 0;
+
+			Slot& Select(const Blob& code);
+
+			static PreDecoded& get_ThreadCache();
+		};
+
+		PreDecoded::Slot* m_pPreDecoded = nullptr; // current code, in the thread cache
+		PreDecoded::Op* m_pPreDecodedPrev = nullptr; // last executed op of the current code
+		bool m_UsePreDecoded = true;
+
+		// must be called when the code buffer is modified or released
+		void ResetPreDecoded() {
+			m_pPreDecoded = nullptr;
+			m_pPreDecodedPrev = nullptr;
+		}
+		void OnWriteCode(const uint8_t* p, uint32_t nSize); // the code may modify itself
+		Blob get_CodeExec() const { return Blob(m_Code.p, std::min(m_prTable0, m_Code.n)); } // the pre-decoded part of the code
+
 		Processor()
 			:m_Instruction(Reader::Mode::Emulate_x86)
 		{
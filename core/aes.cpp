@@ -824,6 +824,32 @@ void AES::StreamCipher::PerfXor(uint8_t* pBuf, uint32_t nSize)
 
 void AES::StreamCipher::XCrypt(const Encoder& enc, uint8_t* pBuf, uint32_t nSize)
 {
+	if (nSize >= s_BlockSize * Accel::s_MinBlocks)
+	{
+		if (m_nBuf)
+		{
+			// use the remaining cipherstream first
+			uint8_t n = m_nBuf;
+			PerfXor(pBuf, n);
+
+			pBuf += n;
+			nSize -= n;
+		}
+
+		uint32_t nBlocks = nSize / s_BlockSize;
+		if ((nBlocks >= Accel::s_MinBlocks) && (Accel::None != Accel::get()))
+		{
+			XCryptAccel(enc, pBuf, nBlocks);
+
+			nBlocks *= s_BlockSize;
+			pBuf += nBlocks;
+			nSize -= nBlocks;
+
+			if (!nSize)
+				return;
+		}
+	}
+
 	while (true)
 	{
 		if (!m_nBuf)
@@ -846,3 +872,260 @@ void AES::StreamCipher::XCrypt(const Encoder& enc, uint8_t* pBuf, uint32_t nSize
 		nSize -= n;
 	}
 }
+
+/////////////////////////////////////
+// Hardware acceleration
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#	define AES_ACCEL_X86
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#		define AES_TARGET(x)
+#	else // _MSC_VER
+#		include <cpuid.h>
+#		define AES_TARGET(x) __attribute__((target(x)))
+#	endif // _MSC_VER
+#	include <immintrin.h>
+
+#	if (defined(_MSC_VER) && (_MSC_VER >= 1920)) || (defined(__clang__) && (__clang_major__ >= 6)) || (!defined(__clang__) && defined(__GNUC__) && (__GNUC__ >= 8))
+#		define AES_ACCEL_VAES
+#	endif
+#endif
+
+AES::Accel::Enum AES::Accel::s_Limit = AES::Accel::VAes;
+
+#ifdef AES_ACCEL_X86
+
+namespace {
+
+	void CpuId(uint32_t* pRes, uint32_t nLeaf)
+	{
+#ifdef _MSC_VER
+		__cpuidex((int*) pRes, (int) nLeaf, 0);
+#else // _MSC_VER
+		if (!__get_cpuid_count(nLeaf, 0, pRes, pRes + 1, pRes + 2, pRes + 3))
+			pRes[0] = pRes[1] = pRes[2] = pRes[3] = 0;
+#endif // _MSC_VER
+	}
+
+	uint64_t XGetBv()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else // _MSC_VER
+		uint32_t nLo, nHi;
+		__asm__ __volatile__("xgetbv" : "=a"(nLo), "=d"(nHi) : "c"(0));
+		return (uint64_t(nHi) << 32) | nLo;
+#endif // _MSC_VER
+	}
+
+	AES::Accel::Enum DetectAccel()
+	{
+		uint32_t pRes[4]; // eax, ebx, ecx, edx
+		CpuId(pRes, 0);
+		uint32_t nMaxLeaf = pRes[0];
+
+		if (nMaxLeaf < 1)
+			return AES::Accel::None;
+
+		CpuId(pRes, 1);
+		bool bSse2 = !!(pRes[3] & (1U << 26));
+		bool bSsse3 = !!(pRes[2] & (1U << 9));
+		bool bAesNi = !!(pRes[2] & (1U << 25));
+		bool bOsXSave = !!(pRes[2] & (1U << 27));
+		bool bAvx = !!(pRes[2] & (1U << 28));
+
+		if (!(bSse2 && bSsse3 && bAesNi))
+			return AES::Accel::None;
+
+#ifdef AES_ACCEL_VAES
+		if (bOsXSave && bAvx && (nMaxLeaf >= 7) && ((XGetBv() & 6) == 6)) // xmm and ymm state enabled by OS
+		{
+			CpuId(pRes, 7);
+			bool bAvx2 = !!(pRes[1] & (1U << 5));
+			bool bVAes = !!(pRes[2] & (1U << 9));
+
+			if (bAvx2 && bVAes)
+				return AES::Accel::VAes;
+		}
+#endif // AES_ACCEL_VAES
+
+		return AES::Accel::AesNi;
+	}
+
+	// The counter is a big-endian 128-bit number, kept as 2 native halves during the processing
+	struct Counter
+	{
+		uint64_t m_Hi;
+		uint64_t m_Lo;
+
+		void Import(const uint8_t* p)
+		{
+			m_Hi = m_Lo = 0;
+			for (uint32_t i = 0; i < 8; i++)
+			{
+				m_Hi = (m_Hi << 8) | p[i];
+				m_Lo = (m_Lo << 8) | p[i + 8];
+			}
+		}
+
+		void Export(uint8_t* p) const
+		{
+			for (uint32_t i = 0; i < 8; i++)
+			{
+				p[7 - i] = (uint8_t) (m_Hi >> (i << 3));
+				p[15 - i] = (uint8_t) (m_Lo >> (i << 3));
+			}
+		}
+
+		void Inc()
+		{
+			if (!++m_Lo)
+				m_Hi++;
+		}
+	};
+
+	AES_TARGET("aes,ssse3")
+	void XCryptAesNi(const uint8_t* pRkRaw, Counter& ctr, uint8_t* pBuf, uint32_t nBlocks)
+	{
+		__m128i pRk[AES::Nr + 1];
+		for (uint32_t i = 0; i <= AES::Nr; i++)
+			pRk[i] = _mm_loadu_si128((const __m128i*) (pRkRaw + i * AES::s_BlockSize));
+
+		const __m128i msk = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); // to big-endian
+
+		for (; nBlocks >= AES::Accel::s_MinBlocks; nBlocks -= AES::Accel::s_MinBlocks)
+		{
+			__m128i x[AES::Accel::s_MinBlocks];
+
+			for (uint32_t i = 0; i < _countof(x); i++)
+			{
+				x[i] = _mm_shuffle_epi8(_mm_set_epi64x((int64_t) ctr.m_Hi, (int64_t) ctr.m_Lo), msk);
+				x[i] = _mm_xor_si128(x[i], pRk[0]);
+				ctr.Inc();
+			}
+
+			for (uint32_t iRound = 1; iRound < AES::Nr; iRound++)
+				for (uint32_t i = 0; i < _countof(x); i++)
+					x[i] = _mm_aesenc_si128(x[i], pRk[iRound]);
+
+			for (uint32_t i = 0; i < _countof(x); i++)
+			{
+				x[i] = _mm_aesenclast_si128(x[i], pRk[AES::Nr]);
+
+				__m128i* pDst = (__m128i*) pBuf;
+				_mm_storeu_si128(pDst, _mm_xor_si128(x[i], _mm_loadu_si128(pDst)));
+				pBuf += AES::s_BlockSize;
+			}
+		}
+
+		for (; nBlocks; nBlocks--)
+		{
+			__m128i x = _mm_shuffle_epi8(_mm_set_epi64x((int64_t) ctr.m_Hi, (int64_t) ctr.m_Lo), msk);
+			ctr.Inc();
+
+			x = _mm_xor_si128(x, pRk[0]);
+			for (uint32_t iRound = 1; iRound < AES::Nr; iRound++)
+				x = _mm_aesenc_si128(x, pRk[iRound]);
+			x = _mm_aesenclast_si128(x, pRk[AES::Nr]);
+
+			__m128i* pDst = (__m128i*) pBuf;
+			_mm_storeu_si128(pDst, _mm_xor_si128(x, _mm_loadu_si128(pDst)));
+			pBuf += AES::s_BlockSize;
+		}
+	}
+
+#ifdef AES_ACCEL_VAES
+	AES_TARGET("aes,vaes,avx2")
+	void XCryptVAes(const uint8_t* pRkRaw, Counter& ctr, uint8_t* pBuf, uint32_t nBlocks)
+	{
+		__m256i pRk[AES::Nr + 1];
+		for (uint32_t i = 0; i <= AES::Nr; i++)
+			pRk[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (pRkRaw + i * AES::s_BlockSize)));
+
+		const __m256i msk = _mm256_set_epi8( // to big-endian, within each 128-bit lane
+			0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+			0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+		const uint32_t nPairs = AES::Accel::s_MinBlocks / 2;
+
+		for (; nBlocks >= AES::Accel::s_MinBlocks; nBlocks -= AES::Accel::s_MinBlocks)
+		{
+			__m256i x[nPairs];
+
+			for (uint32_t i = 0; i < nPairs; i++)
+			{
+				Counter ctr1 = ctr;
+				ctr1.Inc();
+
+				x[i] = _mm256_set_epi64x((int64_t) ctr1.m_Hi, (int64_t) ctr1.m_Lo, (int64_t) ctr.m_Hi, (int64_t) ctr.m_Lo);
+				x[i] = _mm256_xor_si256(_mm256_shuffle_epi8(x[i], msk), pRk[0]);
+
+				ctr = ctr1;
+				ctr.Inc();
+			}
+
+			for (uint32_t iRound = 1; iRound < AES::Nr; iRound++)
+				for (uint32_t i = 0; i < nPairs; i++)
+					x[i] = _mm256_aesenc_epi128(x[i], pRk[iRound]);
+
+			for (uint32_t i = 0; i < nPairs; i++)
+			{
+				x[i] = _mm256_aesenclast_epi128(x[i], pRk[AES::Nr]);
+
+				__m256i* pDst = (__m256i*) pBuf;
+				_mm256_storeu_si256(pDst, _mm256_xor_si256(x[i], _mm256_loadu_si256(pDst)));
+				pBuf += AES::s_BlockSize * 2;
+			}
+		}
+
+		if (nBlocks)
+			XCryptAesNi(pRkRaw, ctr, pBuf, nBlocks);
+	}
+#endif // AES_ACCEL_VAES
+
+} // namespace
+
+#endif // AES_ACCEL_X86
+
+AES::Accel::Enum AES::Accel::get_Supported()
+{
+#ifdef AES_ACCEL_X86
+	static const Enum s_Val = DetectAccel();
+	return s_Val;
+#else // AES_ACCEL_X86
+	return None;
+#endif // AES_ACCEL_X86
+}
+
+AES::Accel::Enum AES::Accel::get()
+{
+	Enum val = get_Supported();
+	return (val < s_Limit) ? val : s_Limit;
+}
+
+void AES::StreamCipher::XCryptAccel(const Encoder& enc, uint8_t* pBuf, uint32_t nBlocks)
+{
+	assert(!m_nBuf);
+
+#ifdef AES_ACCEL_X86
+	// round keys in the byte order expected by the AES instructions
+	uint8_t pRk[(Nr + 1) * s_BlockSize];
+	for (uint32_t i = 0; i < (Nr + 1) * 4; i++)
+		PUT_UINT32(enc.m_erk[i], pRk, i * 4);
+
+	Counter ctr;
+	ctr.Import(m_Counter.m_pData);
+
+#	ifdef AES_ACCEL_VAES
+	if (Accel::VAes == Accel::get())
+		XCryptVAes(pRk, ctr, pBuf, nBlocks);
+	else
+#	endif // AES_ACCEL_VAES
+		XCryptAesNi(pRk, ctr, pBuf, nBlocks);
+
+	ctr.Export(m_Counter.m_pData);
+#else // AES_ACCEL_X86
+	assert(false); // not supported
+#endif // AES_ACCEL_X86
+}
@@ -34,6 +34,27 @@ struct AES
 
 		void Reset();
 		void XCrypt(const Encoder&, uint8_t* pBuf, uint32_t nSize);
+
+	private:
+		void XCryptAccel(const Encoder&, uint8_t* pBuf, uint32_t nBlocks);
+	};
+
+	// Hardware-accelerated CTR mode (x86/x64 only), selected at runtime according to the CPU capabilities.
+	// Processes 8 blocks at once. Used for bulk data only, the rest goes via the portable implementation.
+	struct Accel
+	{
+		enum Enum {
+			None,
+			AesNi,
+			VAes, // AES-NI on 256-bit registers (2 blocks per instruction)
+		};
+
+		static const uint32_t s_MinBlocks = 8;
+
+		static Enum get_Supported();
+		static Enum get(); // min of supported and s_Limit
+
+		static Enum s_Limit; // can be lowered to force the slower path (tests, benchmarks)
 	};
 
 };
@@ -332,14 +332,62 @@ namespace beam
 		ser & cwp;
 	}
 
+	void RecoveryInfo::Writer::OpenDelta(const char* sz, const Block::ChainWorkProof& cwp, const Block::SystemState::ID& idPrev)
+	{
+		Open(sz, cwp);
+
+		yas::binary_oarchive<std::FStream, SERIALIZE_OPTIONS> ser(m_Stream);
+		ser & idPrev;
+	}
+
 	struct RecoveryInfo::IParser::Context
 	{
+		typedef yas::binary_iarchive<std::FStream, SERIALIZE_OPTIONS> Der;
+		typedef yas::binary_oarchive<std::FStream, SERIALIZE_OPTIONS> Ser;
+
+		struct File
+		{
+			std::FStream m_Stream;
+			Der m_Der;
+			Block::ChainWorkProof m_Cwp;
+			Block::SystemState::Full m_Tip;
+			uint64_t m_Size;
+
+			File()
+				:m_Der(m_Stream)
+			{
+			}
+
+			void Open(const char*);
+
+			bool HasShielded() const {
+				return m_Tip.m_Height >= Rules::get().pForks[2].m_Height;
+			}
+		};
+
+		struct UtxoAdded
+		{
+			Height m_Height;
+			Output::Ptr m_pOutput;
+		};
+
+		struct KeyCmp
+		{
+			bool operator()(const UtxoTree::Key& a, const UtxoTree::Key& b) const {
+				return a.V.cmp(b.V) < 0;
+			}
+		};
+
 		IParser& m_Parser;
-		std::FStream m_Stream;
-		yas::binary_iarchive<std::FStream, SERIALIZE_OPTIONS> m_Der;
-		Block::ChainWorkProof m_Cwp;
-		Block::SystemState::Full m_Tip;
-		uint64_t m_Total;
+		std::vector<std::unique_ptr<File> > m_vFiles; // the base, then the deltas
+		uint64_t m_Total = 0;
+		Ser* m_pSer = nullptr; // if set - the merged data is written
+
+		// UTXO changes of all the deltas
+		std::multimap<UtxoTree::Key, UtxoAdded, KeyCmp> m_UtxosAdded;
+		std::multiset<UtxoTree::Key, KeyCmp> m_UtxosSpent;
+
+		TxoID m_ShieldedOuts = 0;
 
 		UtxoTree::Compact m_UtxoTree;
 		Merkle::CompactMmr m_Shielded;
@@ -349,19 +397,26 @@ namespace beam
 
 		Context(IParser& p)
 			:m_Parser(p)
-			,m_Der(m_Stream)
 		{
 		}
 
-		void Open(const char*);
+		File& get_Last() { return *m_vFiles.back(); }
+
+		void Open(const char* szBase, const std::vector<std::string>& vDeltas);
+		void OpenDelta(const char*);
 		bool Proceed();
 		bool ProceedUtxos();
-		bool ProceedShielded();
-		bool ProceedAssets();
+		bool OnUtxo(const UtxoTree::Key&, Height, const Output&);
+		bool ProceedShielded(File&);
+		bool ProceedAssets(File&);
 		void Finalyze();
 
 		bool OnProgress() {
-			return m_Parser.OnProgress(m_Total - m_Stream.get_Remaining(), m_Total);
+			uint64_t nDone = 0;
+			for (const auto& pFile : m_vFiles)
+				nDone += pFile->m_Size - pFile->m_Stream.get_Remaining();
+
+			return m_Parser.OnProgress(nDone, m_Total);
 		}
 
 		static void ThrowRulesMismatch() {
@@ -373,10 +428,10 @@ namespace beam
 		}
 	};
 
-	void RecoveryInfo::RecoveryInfo::IParser::Context::Open(const char* sz)
+	void RecoveryInfo::IParser::Context::File::Open(const char* sz)
 	{
 		m_Stream.Open(sz, true, true);
-		m_Total = m_Stream.get_Remaining();
+		m_Size = m_Stream.get_Remaining();
 
 		uint32_t nForks = 0;
 		m_Der & nForks;
@@ -403,6 +458,77 @@ namespace beam
 			ThrowRulesMismatch();
 	}
 
+	void RecoveryInfo::IParser::Context::Open(const char* szBase, const std::vector<std::string>& vDeltas)
+	{
+		m_vFiles.emplace_back(new File)->Open(szBase);
+
+		for (const auto& sDelta : vDeltas)
+			OpenDelta(sDelta.c_str());
+
+		for (const auto& pFile : m_vFiles)
+			m_Total += pFile->m_Size;
+	}
+
+	void RecoveryInfo::IParser::Context::OpenDelta(const char* sz)
+	{
+		Block::SystemState::ID idTip;
+		get_Last().m_Tip.get_ID(idTip);
+
+		File& f = *m_vFiles.emplace_back(new File);
+		f.Open(sz);
+
+		Block::SystemState::ID idPrev;
+		f.m_Der & idPrev;
+
+		if ((idPrev != idTip) || (f.m_Tip.m_Height <= idTip.m_Height))
+			ThrowBadData();
+
+		// The UTXO changes are kept in memory, and merged with the base UTXOs (which are sorted) on the fly
+		while (true)
+		{
+			Height h;
+			f.m_Der & h;
+
+			if (MaxHeight == h)
+				break;
+
+			// Output copy doesn't include the proofs, load it in-place
+			auto pOutp = std::make_unique<Output>();
+			yas::detail::loadRecovery(f.m_Der, *pOutp, h);
+
+			UtxoTree::Key::Data d;
+			d.m_Commitment = pOutp->m_Commitment;
+			d.m_Maturity = pOutp->get_MinMaturity(h);
+
+			UtxoTree::Key key;
+			key = d;
+
+			UtxoAdded& x = m_UtxosAdded.emplace(key, UtxoAdded())->second;
+			x.m_Height = h;
+			x.m_pOutput = std::move(pOutp);
+		}
+
+		while (true)
+		{
+			UtxoTree::Key::Data d;
+			f.m_Der & d.m_Maturity;
+
+			if (MaxHeight == d.m_Maturity)
+				break;
+
+			f.m_Der & d.m_Commitment;
+
+			UtxoTree::Key key;
+			key = d;
+
+			auto it = m_UtxosAdded.find(key);
+			if (m_UtxosAdded.end() != it)
+				m_UtxosAdded.erase(it); // created by one of the previous deltas
+			else
+				m_UtxosSpent.insert(key);
+		}
+	}
+
 	void RecoveryInfo::RecoveryInfo::IParser::Context::Finalyze()
 	{
 		struct Verifier
@@ -442,34 +568,58 @@ namespace beam
 			}
 		};
 
+		const File& f = get_Last();
+
 		Verifier v(*this);
-		v.m_Height = m_Tip.m_Height;
+		v.m_Height = f.m_Tip.m_Height;
 
 		Merkle::Hash hv;
 		BEAM_VERIFY(v.get_Live(hv));
 
-		if (!(m_Cwp.m_hvRootLive == hv))
+		if (!(f.m_Cwp.m_hvRootLive == hv))
 			ThrowBadData();
 
-		if (m_Tip.m_Height >= Rules::get().pForks[3].m_Height)
+		if (f.m_Tip.m_Height >= Rules::get().pForks[3].m_Height)
 		{
 			BEAM_VERIFY(v.get_Utxos(hv));
-			if (m_Tip.m_Kernels != hv)
+			if (f.m_Tip.m_Kernels != hv)
 				ThrowBadData();
 		}
 	}
 
 	bool RecoveryInfo::IParser::Proceed(const char* sz)
+	{
+		return Proceed(sz, std::vector<std::string>());
+	}
+
+	bool RecoveryInfo::IParser::Proceed(const char* szBase, const std::vector<std::string>& vDeltas)
 	{
 		Context ctx(*this);
-		ctx.Open(sz);
+		ctx.Open(szBase, vDeltas);
 		return ctx.Proceed();
 	}
 
+	void RecoveryInfo::Merge(const char* szOut, const char* szBase, const std::vector<std::string>& vDeltas)
+	{
+		IParser p;
+		IParser::Context ctx(p);
+		ctx.Open(szBase, vDeltas);
+
+		Writer w;
+		w.Open(szOut, ctx.get_Last().m_Cwp);
+
+		IParser::Context::Ser ser(w.m_Stream);
+		ctx.m_pSer = &ser;
+
+		BEAM_VERIFY(ctx.Proceed()); // can't be aborted, the result is verified
+	}
+
 	bool RecoveryInfo::IParser::Context::Proceed()
 	{
+		File& fLast = get_Last();
+
 		std::vector<Block::SystemState::Full> vec;
-		m_Cwp.UnpackStates(vec);
+		fLast.m_Cwp.UnpackStates(vec);
 		if (!m_Parser.OnStates(vec))
 			return false;
 
@@ -477,41 +627,77 @@ namespace beam
 			return false;
 
 		const Rules& r = Rules::get();
-		if (m_Tip.m_Height >= r.pForks[2].m_Height)
+		if (fLast.HasShielded())
 		{
-			if (!ProceedShielded())
-				return false;
+			if (m_pSer)
+				*m_pSer & MaxHeight; // terminator
+
+			for (const auto& pFile : m_vFiles)
+				if (pFile->HasShielded() && !ProceedShielded(*pFile))
+					return false;
+
+			if (m_pSer)
+				*m_pSer & MaxHeight; // terminator
 
-			if (!ProceedAssets())
+			// only the most recent assets
+			if (!ProceedAssets(fLast))
 				return false;
 
-			if (m_Tip.m_Height >= r.pForks[3].m_Height)
+			if (m_pSer)
+				*m_pSer & (Asset::s_MaxCount + 1); // terminator
+
+			if (fLast.m_Tip.m_Height >= r.pForks[3].m_Height)
 			{
-				m_Der
+				fLast.m_Der
 					& m_hvContracts
 					& m_hvKL;
+
+				if (m_pSer)
+					*m_pSer
+						& m_hvContracts
+						& m_hvKL;
 			}
 		}
 
+		if (!m_Parser.OnDone())
+			return false;
+
 		Finalyze();
 		return true;
 	}
 
+	bool RecoveryInfo::IParser::Context::OnUtxo(const UtxoTree::Key& key, Height h, const Output& outp)
+	{
+		if (!m_UtxoTree.Add(key))
+			ThrowBadData();
+
+		if (m_pSer)
+		{
+			*m_pSer & h;
+			yas::detail::saveRecovery(*m_pSer, outp, h);
+		}
+
+		return m_Parser.OnUtxo(h, outp);
+	}
+
 	bool RecoveryInfo::IParser::Context::ProceedUtxos()
 	{
+		File& f = *m_vFiles.front();
+		auto itAdded = m_UtxosAdded.begin();
+
 		while (true)
 		{
-			if (!m_Stream.get_Remaining())
+			if (!f.m_Stream.get_Remaining())
 				break; // old-style terminator
 
 			Height h;
-			m_Der & h;
+			f.m_Der & h;
 
 			if (MaxHeight == h)
 				break;
 
 			Output outp;
-			yas::detail::loadRecovery(m_Der, outp, h);
+			yas::detail::loadRecovery(f.m_Der, outp, h);
 
 			UtxoTree::Key::Data d;
 			d.m_Commitment = outp.m_Commitment;
@@ -520,41 +706,64 @@ namespace beam
 			UtxoTree::Key key;
 			key = d;
 
-			if (!m_UtxoTree.Add(key))
-				ThrowBadData();
+			// the added ones that precede it
+			for (; (m_UtxosAdded.end() != itAdded) && (itAdded->first.V.cmp(key.V) < 0); itAdded++)
+				if (!OnUtxo(itAdded->first, itAdded->second.m_Height, *itAdded->second.m_pOutput))
+					return false;
 
-			if (!m_Parser.OnUtxo(h, outp))
-				return false;
+			auto itSpent = m_UtxosSpent.find(key);
+			if (m_UtxosSpent.end() != itSpent)
+				m_UtxosSpent.erase(itSpent);
+			else
+			{
+				if (!OnUtxo(key, h, outp))
+					return false;
+			}
 
 			if (!OnProgress())
 				return false;
 		}
 
+		for (; m_UtxosAdded.end() != itAdded; itAdded++)
+			if (!OnUtxo(itAdded->first, itAdded->second.m_Height, *itAdded->second.m_pOutput))
+				return false;
+
+		if (!m_UtxosSpent.empty())
+			ThrowBadData(); // spent UTXOs not found in the base
+
 		return true;
 	}
 
-	bool RecoveryInfo::IParser::Context::ProceedShielded()
+	bool RecoveryInfo::IParser::Context::ProceedShielded(File& f)
 	{
-		TxoID nOuts = 0;
-
 		while (true)
 		{
 			Height h;
-			m_Der & h;
+			f.m_Der & h;
 
 			if (MaxHeight == h)
 				break;
 
 			uint8_t nFlags = 0;
-			m_Der & nFlags;
+			f.m_Der & nFlags;
+
+			if (m_pSer)
+				*m_pSer
+					& h
+					& nFlags;
 
 			Merkle::Hash hv;
 
 			if (Flags::Output & nFlags)
 			{
 				ShieldedTxo txo;
-				m_Der & txo;
-				m_Der & hv;
+				f.m_Der & txo;
+				f.m_Der & hv;
+
+				if (m_pSer)
+					*m_pSer
+						& txo
+						& hv;
 
 				assert(!txo.m_pAsset); // the asset proof itself is omitted.
 				if (Flags::HadAsset & nFlags)
@@ -562,13 +771,18 @@ namespace beam
 					txo.m_pAsset.reset(new Asset::Proof);
 
 					if (h >= Rules::get().pForks[3].m_Height)
-						m_Der & txo.m_pAsset->m_hGen;
+					{
+						f.m_Der & txo.m_pAsset->m_hGen;
+
+						if (m_pSer)
+							*m_pSer & txo.m_pAsset->m_hGen;
+					}
 				}
 
 				ShieldedTxo::DescriptionOutp dOutp;
 				dOutp.m_Commitment = txo.m_Commitment;
 				dOutp.m_SerialPub = txo.m_Ticket.m_SerialPub;
-				dOutp.m_ID = nOuts++;
+				dOutp.m_ID = m_ShieldedOuts++;
 				dOutp.m_Height = h;
 
 				if (!m_Parser.OnShieldedOut(dOutp, txo, hv, h))
@@ -579,9 +793,12 @@ namespace beam
 			else
 			{
 				ShieldedTxo::DescriptionInp dInp;
-				m_Der & dInp.m_SpendPk;
+				f.m_Der & dInp.m_SpendPk;
 				dInp.m_Height = h;
 
+				if (m_pSer)
+					*m_pSer & dInp.m_SpendPk;
+
 				if (!m_Parser.OnShieldedIn(dInp))
 					return false;
 
@@ -597,17 +814,20 @@ namespace beam
 		return true;
 	}
 
-	bool RecoveryInfo::IParser::Context::ProceedAssets()
+	bool RecoveryInfo::IParser::Context::ProceedAssets(File& f)
 	{
 		while (true)
 		{
 			Asset::Full ai;
-			m_Der & ai.m_ID;
+			f.m_Der & ai.m_ID;
 
 			if (ai.m_ID > Asset::s_MaxCount)
 				break;
 
-			m_Der & Cast::Down<Asset::Info>(ai);
+			f.m_Der & Cast::Down<Asset::Info>(ai);
+
+			if (m_pSer)
+				*m_pSer & ai;
 
 			Merkle::Hash hv;
 			ai.get_Hash(hv);
@@ -635,44 +855,310 @@ namespace beam
 		}
 	}
 
+	bool RecoveryInfo::IRecognizer::RecognizeUtxo(Height h, const Output& outp, CoinID& cid, Output::User& user) const
+	{
+		return m_pOwner && outp.Recover(h, *m_pOwner, cid, &user);
+	}
+
+	bool RecoveryInfo::IRecognizer::RecognizeShieldedOut(const ShieldedTxo& txo, const ECC::Hash::Value& hvMsg, Height hScheme, ShieldedTxo::DataParams& pars, Key::Index& nIdx) const
+	{
+		for (nIdx = 0; nIdx < static_cast<Key::Index>(m_vSh.size()); nIdx++)
+		{
+			if (pars.m_Ticket.Recover(txo.m_Ticket, m_vSh[nIdx]))
+			{
+				ECC::Oracle oracle;
+				oracle << hvMsg;
+
+				if (pars.m_Output.Recover(txo, pars.m_Ticket.m_SharedSecret, hScheme, oracle))
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool RecoveryInfo::IRecognizer::OnShieldedOutRecognizedInternal(const ShieldedTxo::DescriptionOutp& dout, const ShieldedTxo::DataParams& pars, Key::Index nIdx)
+	{
+		ShieldedTxo::ID sid;
+		pars.ToID(sid);
+		sid.m_Key.m_nIdx = nIdx;
+		m_mapSpendKeys[pars.m_Ticket.m_SpendPk] = sid.m_Key;
+
+		return OnShieldedOutRecognized(dout, pars, nIdx);
+	}
+
+	bool RecoveryInfo::IRecognizer::OnShieldedInInternal(const ShieldedTxo::DescriptionInp& din)
+	{
+		auto it = m_mapSpendKeys.find(din.m_SpendPk);
+		if (m_mapSpendKeys.end() == it)
+			return true;
+
+		ShieldedTxo::BaseKey key = it->second;
+		m_mapSpendKeys.erase(it);
+
+		return OnShieldedInRecognized(din, key);
+	}
+
+	/////////////////////////////
+	// Parallel recognition
+	struct RecoveryInfo::IRecognizer::Batch
+	{
+		static const uint32_t s_Size = 1024;
+
+		struct Element
+		{
+			enum struct Type {
+				Utxo,
+				ShieldedOut,
+				ShieldedIn,
+				Asset
+			};
+
+			Type m_Type;
+			Height m_Height;
+			bool m_Recognized;
+
+			// Utxo
+			Output m_Output;
+			CoinID m_Cid;
+			Output::User m_User;
+
+			// ShieldedOut
+			ShieldedTxo::DescriptionOutp m_dOutp;
+			ShieldedTxo m_Txo;
+			ECC::Hash::Value m_hvMsg;
+			ShieldedTxo::DataParams m_Pars;
+			Key::Index m_nIdx;
+
+			// ShieldedIn
+			ShieldedTxo::DescriptionInp m_dInp;
+
+			// Asset
+			Asset::Full m_Asset;
+
+			void Recognize(const IRecognizer&);
+		};
+
+		std::deque<Element> m_vElements; // not shrunk, the elements are reused
+		uint32_t m_Count = 0;
+
+		Element& Add(Element::Type eType)
+		{
+			if (m_vElements.size() == m_Count)
+				m_vElements.emplace_back();
+
+			Element& x = m_vElements[m_Count++];
+			x.m_Type = eType;
+			x.m_Recognized = false;
+			return x;
+		}
+
+		struct Task
+			:public Executor::TaskAsync
+		{
+			const IRecognizer* m_pThis;
+			Batch* m_pBatch;
+			uint32_t m_i0;
+			uint32_t m_i1;
+
+			virtual void Exec(Executor::Context&) override
+			{
+				for (uint32_t i = m_i0; i < m_i1; i++)
+					m_pBatch->m_vElements[i].Recognize(*m_pThis);
+			}
+		};
+	};
+
+	void RecoveryInfo::IRecognizer::Batch::Element::Recognize(const IRecognizer& r)
+	{
+		switch (m_Type)
+		{
+		case Type::Utxo:
+			m_Recognized = r.RecognizeUtxo(m_Height, m_Output, m_Cid, m_User);
+			break;
+
+		case Type::ShieldedOut:
+			m_Recognized = r.RecognizeShieldedOut(m_Txo, m_hvMsg, m_Height, m_Pars, m_nIdx);
+			break;
+
+		case Type::Asset:
+			m_Recognized = r.m_pOwner && m_Asset.Recognize(*r.m_pOwner);
+			break;
+
+		default: // ShieldedIn is resolved on delivery
+			break;
+		}
+	}
+
+	RecoveryInfo::IRecognizer::IRecognizer()
+	{
+	}
+
+	RecoveryInfo::IRecognizer::~IRecognizer()
+	{
+		WaitPending(); // in case the parsing was interrupted by an exception
+	}
+
+	RecoveryInfo::IRecognizer::Batch& RecoveryInfo::IRecognizer::get_Batch()
+	{
+		if (!m_pBatch)
+			m_pBatch = std::make_unique<Batch>();
+		return *m_pBatch;
+	}
+
+	void RecoveryInfo::IRecognizer::WaitPending()
+	{
+		if (m_pBatchPending && m_pBatchPending->m_Count)
+			m_pExecutor->Flush(0);
+	}
+
+	bool RecoveryInfo::IRecognizer::DeliverPending()
+	{
+		if (!m_pBatchPending)
+			return true;
+
+		WaitPending();
+
+		Batch& b = *m_pBatchPending;
+		uint32_t nCount = b.m_Count;
+		b.m_Count = 0;
+
+		for (uint32_t i = 0; i < nCount; i++)
+		{
+			Batch::Element& x = b.m_vElements[i];
+			bool bRes = true;
+
+			switch (x.m_Type)
+			{
+			case Batch::Element::Type::Utxo:
+				if (x.m_Recognized)
+					bRes = OnUtxoRecognized(x.m_Height, x.m_Output, x.m_Cid, x.m_User);
+				break;
+
+			case Batch::Element::Type::ShieldedOut:
+				if (x.m_Recognized)
+					bRes = OnShieldedOutRecognizedInternal(x.m_dOutp, x.m_Pars, x.m_nIdx);
+				break;
+
+			case Batch::Element::Type::ShieldedIn:
+				bRes = OnShieldedInInternal(x.m_dInp);
+				break;
+
+			case Batch::Element::Type::Asset:
+				if (x.m_Recognized)
+					bRes = OnAssetRecognized(x.m_Asset);
+			}
+
+			if (!bRes)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool RecoveryInfo::IRecognizer::OnBatchAdded()
+	{
+		return (m_pBatch->m_Count < Batch::s_Size) || Submit();
+	}
+
+	bool RecoveryInfo::IRecognizer::Submit()
+	{
+		// deliver the previous batch, then start the recognition of this one
+		if (!DeliverPending())
+		{
+			m_pBatch->m_Count = 0; // aborted
+			return false;
+		}
+
+		m_pBatch.swap(m_pBatchPending);
+
+		Batch& b = *m_pBatchPending;
+		uint32_t nTasks = std::max(m_pExecutor->get_Threads(), 1U);
+
+		for (uint32_t iTask = 0, i0 = 0; iTask < nTasks; iTask++)
+		{
+			uint32_t i1 = static_cast<uint32_t>(static_cast<uint64_t>(b.m_Count) * (iTask + 1) / nTasks);
+			if (i1 == i0)
+				continue;
+
+			auto pTask = std::make_unique<Batch::Task>();
+			pTask->m_pThis = this;
+			pTask->m_pBatch = &b;
+			pTask->m_i0 = i0;
+			pTask->m_i1 = i1;
+			m_pExecutor->Push(std::move(pTask));
+
+			i0 = i1;
+		}
+
+		return true;
+	}
+
 	bool RecoveryInfo::IRecognizer::OnUtxo(Height h, const Output& outp)
 	{
-		if (m_pOwner)
+		if (!m_pExecutor)
 		{
 			CoinID cid;
 			Output::User user;
-			if (outp.Recover(h, *m_pOwner, cid, &user))
-				return OnUtxoRecognized(h, outp, cid, user);
+			return !RecognizeUtxo(h, outp, cid, user) || OnUtxoRecognized(h, outp, cid, user);
 		}
 
-		return true;
+		if (!m_pOwner)
+			return true; // nothing to recognize
+
+		Batch::Element& x = get_Batch().Add(Batch::Element::Type::Utxo);
+		x.m_Height = h;
+		x.m_Output = outp;
+
+		return OnBatchAdded();
 	}
 
 	bool RecoveryInfo::IRecognizer::OnShieldedOut(const ShieldedTxo::DescriptionOutp& dout, const ShieldedTxo& txo, const ECC::Hash::Value& hvMsg, Height hScheme)
 	{
-		for (Key::Index nIdx = 0; nIdx < static_cast<Key::Index>(m_vSh.size()); nIdx++)
+		if (!m_pExecutor)
 		{
 			ShieldedTxo::DataParams pars;
+			Key::Index nIdx;
+			return !RecognizeShieldedOut(txo, hvMsg, hScheme, pars, nIdx) || OnShieldedOutRecognizedInternal(dout, pars, nIdx);
+		}
 
-			if (pars.m_Ticket.Recover(txo.m_Ticket, m_vSh[nIdx]))
-			{
-				ECC::Oracle oracle;
-				oracle << hvMsg;
+		Batch::Element& x = get_Batch().Add(Batch::Element::Type::ShieldedOut);
+		x.m_Height = hScheme;
+		x.m_dOutp = dout;
+		x.m_Txo = txo;
+		x.m_hvMsg = hvMsg;
 
-				if (pars.m_Output.Recover(txo, pars.m_Ticket.m_SharedSecret, hScheme, oracle))
-					return OnShieldedOutRecognized(dout, pars, nIdx);
-			}
-		}
+		return OnBatchAdded();
+	}
 
-		return true;
+	bool RecoveryInfo::IRecognizer::OnShieldedIn(const ShieldedTxo::DescriptionInp& din)
+	{
+		if (!m_pExecutor)
+			return OnShieldedInInternal(din);
+
+		Batch::Element& x = get_Batch().Add(Batch::Element::Type::ShieldedIn);
+		x.m_dInp = din;
+
+		return OnBatchAdded();
 	}
 
 	bool RecoveryInfo::IRecognizer::OnAsset(Asset::Full& ai)
 	{
-		if (m_pOwner && ai.Recognize(*m_pOwner))
-			return OnAssetRecognized(ai);
+		if (!m_pExecutor)
+			return !(m_pOwner && ai.Recognize(*m_pOwner)) || OnAssetRecognized(ai);
 
-		return true;
+		Batch::Element& x = get_Batch().Add(Batch::Element::Type::Asset);
+		x.m_Asset = ai;
+
+		return OnBatchAdded();
+	}
+
+	bool RecoveryInfo::IRecognizer::OnDone()
+	{
+		if (m_pBatch && m_pBatch->m_Count && !Submit())
+			return false;
+
+		return DeliverPending();
 	}
 
 } // namespace beam
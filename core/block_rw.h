@@ -40,6 +40,11 @@ namespace beam
 	};
 
 	// Full recovery info. Includes ChainWorkProof, and all the UTXO set which hash should correspond to the tip commitment
+	//
+	// Delta: the changes since the previous tip (of the base or the previous delta). Same layout as the full one, except:
+	//	- ChainWorkProof is followed by the ID of the previous tip
+	//	- the created UTXOs are followed by the spent ones (maturity + commitment), terminated by MaxHeight
+	//	- only the new shielded ins/outs. The assets and the rest are the full ones
 	struct RecoveryInfo
 	{
 		struct Flags {
@@ -52,6 +57,7 @@ namespace beam
 			std::FStream m_Stream;
 
 			void Open(const char*, const Block::ChainWorkProof&);
+			void OpenDelta(const char*, const Block::ChainWorkProof&, const Block::SystemState::ID& idPrev); // the body should follow
 		};
 
 		struct IParser
@@ -63,27 +69,61 @@ namespace beam
 			virtual bool OnShieldedOut(const ShieldedTxo::DescriptionOutp& , const ShieldedTxo&, const ECC::Hash::Value& hvMsg, Height) { return true; }
 			virtual bool OnShieldedIn(const ShieldedTxo::DescriptionInp&) { return true; }
 			virtual bool OnAsset(Asset::Full&) { return true; }
+			virtual bool OnDone() { return true; } // all the elements are parsed, before the final verification
 
 			bool Proceed(const char*);
+			bool Proceed(const char* szBase, const std::vector<std::string>& vDeltas); // the deltas are replayed over the base
 
 			struct Context;
 		};
 
+		// writes the full recovery info, equivalent to the base with the deltas
+		static void Merge(const char* szOut, const char* szBase, const std::vector<std::string>& vDeltas);
+
 		struct IRecognizer
 			:public IParser
 		{
 			Key::IPKdf::Ptr m_pOwner;
 			std::vector<ShieldedTxo::Viewer> m_vSh;
 
+			// If set - the recognition is done by the executor threads, in batches. The parser proceeds with the next batch while the previous one is recognized.
+			// The results are delivered in the file order, on the caller thread
+			Executor* m_pExecutor = nullptr;
+
+			IRecognizer();
+			~IRecognizer();
+
 			void Init(const Key::IPKdf::Ptr&, Key::Index nMaxShieldedIdx = 1);
 
 			virtual bool OnUtxo(Height, const Output&) override;
 			virtual bool OnShieldedOut(const ShieldedTxo::DescriptionOutp&, const ShieldedTxo&, const ECC::Hash::Value& hvMsg, Height) override;
+			virtual bool OnShieldedIn(const ShieldedTxo::DescriptionInp&) override;
 			virtual bool OnAsset(Asset::Full&) override;
+			virtual bool OnDone() override;
 
 			virtual bool OnUtxoRecognized(Height, const Output&, CoinID&, const Output::User&) { return true; }
 			virtual bool OnShieldedOutRecognized(const ShieldedTxo::DescriptionOutp&, const ShieldedTxo::DataParams&, Key::Index) { return true; }
+			virtual bool OnShieldedInRecognized(const ShieldedTxo::DescriptionInp&, const ShieldedTxo::BaseKey&) { return true; } // spends the recognized out
 			virtual bool OnAssetRecognized(Asset::Full&) { return true; }
+
+		private:
+			struct Batch;
+			std::unique_ptr<Batch> m_pBatch; // being filled
+			std::unique_ptr<Batch> m_pBatchPending; // being recognized
+
+			typedef std::map<ECC::Point, ShieldedTxo::BaseKey> SpendKeyMap;
+			SpendKeyMap m_mapSpendKeys; // recognized shielded outs, that are not spent yet
+
+			bool RecognizeUtxo(Height, const Output&, CoinID&, Output::User&) const;
+			bool RecognizeShieldedOut(const ShieldedTxo&, const ECC::Hash::Value& hvMsg, Height, ShieldedTxo::DataParams&, Key::Index&) const;
+			bool OnShieldedOutRecognizedInternal(const ShieldedTxo::DescriptionOutp&, const ShieldedTxo::DataParams&, Key::Index);
+			bool OnShieldedInInternal(const ShieldedTxo::DescriptionInp&);
+
+			Batch& get_Batch();
+			bool OnBatchAdded();
+			bool Submit();
+			bool DeliverPending();
+			void WaitPending();
 		};
 	};
 
@@ -156,6 +156,22 @@ namespace beam
 #endif // WIN32
 	}
 
+	void MappedFileRaw::Flush(Offset n0, Offset n1) const
+	{
+		assert((n0 <= n1) && (n1 <= m_nMapping));
+		if (n0 == n1)
+			return;
+
+		n0 &= ~Offset(s_PageSize - 1); // must be page-aligned
+
+#ifdef WIN32
+		test_SysRet(!FlushViewOfFile(m_pMapping + n0, (size_t) (n1 - n0)), "FlushViewOfFile");
+		test_SysRet(!FlushFileBuffers(m_hFile), "FlushFileBuffers");
+#else // WIN32
+		test_SysRet(msync(m_pMapping + n0, (size_t) (n1 - n0), MS_SYNC) != 0, "msync");
+#endif // WIN32
+	}
+
 	void MappedFileRaw::Open(const char* sz)
 	{
 		Close();
@@ -286,11 +302,12 @@ namespace beam
 	{
 		while (get_Bank(iBank).m_Free < nMinFree)
 		{
-			// grow
+			// grow. At least by a page, but at once for all the missing elements (remapping is expensive for bulk reservations)
+			nSize = AlignUp(nSize, sizeof(Offset));
+
 			Offset n0 = m_Raw.m_nMapping;
 			Offset n1 = AlignUp(n0, m_Raw.s_PageSize) + m_Raw.s_PageSize;
-
-			nSize = AlignUp(nSize, sizeof(Offset));
+			std::setmax(n1, AlignUp<Offset>(n0 + static_cast<Offset>(nMinFree - get_Bank(iBank).m_Free) * nSize, m_Raw.s_PageSize));
 
 			m_Raw.CloseMapping();
 			m_Raw.Resize(n1);
@@ -38,6 +38,7 @@ namespace beam
 		void CloseMapping();
 		void OpenMapping();
 		void Resize(Offset);
+		void Flush(Offset n0, Offset n1) const; // writes the modified range of the mapping to disk
 
 		MappedFileRaw();
 		~MappedFileRaw();
@@ -55,6 +55,7 @@ namespace beam {
 			static const uint32_t Initial = 1024;
 
 			static const uint32_t PenaltyNetworkErr = 128;
+			static const uint32_t PenaltyInvalidTx = 64; // relayed tx failed the context-free validation (on the tx validator threads only)
 
 			static const uint32_t Starvation_s_ToRatio = 1; // increase per second
 
@@ -520,19 +520,25 @@ bool NodeConnection::IsLive() const
     return m_Connection && !m_pAsyncFail;
 }
 
+template <typename TMsg>
+void NodeConnection::SendAs(uint8_t code, const TMsg& v)
+{
+    if (!IsLive())
+        return;
+    m_SerializeCache.clear();
+    MsgSerializer& ser = m_Protocol.serializeNoFinalize(m_SerializeCache, code, v);
+    m_Protocol.Encrypt(m_SerializeCache, ser);
+    io::Result res = m_Connection->write_msg(m_SerializeCache);
+    m_SerializeCache.clear();
+
+    TestIoResultAsync(res);
+    TestNotDrown();
+}
+
 #define THE_MACRO(code, msg) \
 void NodeConnection::SendRaw(const msg& v) \
 { \
-    if (!IsLive()) \
-        return; \
-    m_SerializeCache.clear(); \
-    MsgSerializer& ser = m_Protocol.serializeNoFinalize(m_SerializeCache, uint8_t(code), v); \
-    m_Protocol.Encrypt(m_SerializeCache, ser); \
-    io::Result res = m_Connection->write_msg(m_SerializeCache); \
-    m_SerializeCache.clear(); \
-\
-    TestIoResultAsync(res); \
-    TestNotDrown(); \
+    SendAs(uint8_t(code), v); \
 } \
 \
 bool NodeConnection::OnMsgInternal(uint64_t, msg##_NoInit&& v) \
@@ -975,6 +981,16 @@ void NodeConnection::Send(const NewTransaction& msg)
     }
 }
 
+void NodeConnection::Send(const BodyRef& msg)
+{
+    SendAs(BodyRef::s_Code, msg);
+}
+
+void NodeConnection::Send(const BodyPackRef& msg)
+{
+    SendAs(BodyPackRef::s_Code, msg);
+}
+
 /////////////////////////
 // NodeConnection::Server
 void NodeConnection::Server::Listen(const io::Address& addr)
@@ -71,6 +71,11 @@ namespace proto {
 #define BeamNodeMsg_BodyPack(macro) \
     macro(std::vector<BodyBuffers>, Bodies)
 
+// BodyPack, serialized and compressed by LzStream (shares the dictionary with the previous BodyPackZ on this connection)
+#define BeamNodeMsg_BodyPackZ(macro) \
+    macro(uint32_t, SizeRaw) \
+    macro(ByteBuffer, Data)
+
 #define BeamNodeMsg_GetProofState(macro) \
     macro(Height, Height)
 
@@ -329,6 +334,7 @@ namespace proto {
     macro(0x25, ProofKernel2) \
     macro(0x26, GetBodyPack) \
     macro(0x27, BodyPack) \
+    macro(0x4c, BodyPackZ) \
     macro(0x28, GetProofShieldedOutp) \
     macro(0x20, GetProofShieldedInp) \
     macro(0x35, GetProofAsset) \
@@ -406,6 +412,9 @@ namespace proto {
 
         static const uint32_t WantDependentState     = 0x10000; // Please send me dependent state updates
         static_assert(!(WantDependentState  & Extension::Msk));
+
+        static const uint32_t CompressedBodies       = 0x20000; // Send me BodyPackZ instead of BodyPack
+        static_assert(!(CompressedBodies  & Extension::Msk));
 	};
 
     struct IDType
@@ -416,6 +425,7 @@ namespace proto {
     };
 
 	static const uint32_t g_HdrPackMaxSize = 2048; // about 400K
+	static const uint32_t g_BodyPackZMaxSizeRaw = 1024 * 1024 * 10; // same as max msg size
 
     struct Event
     {
@@ -539,6 +549,29 @@ namespace proto {
 
 	};
 
+	// Serialized exactly as BodyBuffers, but references the data instead of holding it (i.e. the block store mapping). For sending only
+	struct BodyBuffersRef
+	{
+		io::SharedBuffer m_Perishable;
+		io::SharedBuffer m_Eternal;
+
+		template <typename Archive>
+		void serialize(Archive& ar) const
+		{
+			SaveAsByteBuffer(ar, m_Perishable);
+			SaveAsByteBuffer(ar, m_Eternal);
+		}
+
+	private:
+		template <typename Archive>
+		static void SaveAsByteBuffer(Archive& ar, const io::SharedBuffer& buf)
+		{
+			ar.write_seq_size(buf.size);
+			if (buf.size)
+				ar.write(buf.data, buf.size);
+		}
+	};
+
     enum Unused_ { Unused };
     enum Uninitialized_ { Uninitialized };
 
@@ -651,6 +684,21 @@ namespace proto {
 #undef THE_MACRO5
 #undef THE_MACRO6
 
+	// Body and BodyPack that reference the bodies (see BodyBuffersRef). Sent instead of them, the peer receives the original messages
+	struct BodyRef
+	{
+		static const uint8_t s_Code = Body::s_Code;
+		BodyBuffersRef m_Body;
+		template <typename Archive> void serialize(Archive& ar) const { ar & m_Body; }
+	};
+
+	struct BodyPackRef
+	{
+		static const uint8_t s_Code = BodyPack::s_Code;
+		std::vector<BodyBuffersRef> m_Bodies;
+		template <typename Archive> void serialize(Archive& ar) const { ar & m_Bodies; }
+	};
+
 
 	namespace Bbs
 	{
@@ -742,6 +790,9 @@ namespace proto {
 
         SerializedMsg m_SerializeCache;
 
+        template <typename TMsg>
+        void SendAs(uint8_t code, const TMsg&);
+
         void TestIoResultAsync(const io::Result& res);
         void TestInputMsgContext(uint8_t);
 
@@ -869,6 +920,8 @@ namespace proto {
         }
 
         void Send(const NewTransaction&);
+        void Send(const BodyRef&);
+        void Send(const BodyPackRef&);
 
         struct Server
         {
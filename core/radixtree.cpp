@@ -862,4 +862,185 @@ void UtxoTree::Compact::FlushInternal(uint16_t nBitsCommonNext)
 	}
 }
 
+/////////////////////////////
+// UtxoTree::BulkLoader
+bool UtxoTree::BulkLoader::Init(const BulkEntry* pE, size_t n)
+{
+	m_pE = pE;
+	m_vGroups.clear();
+	m_nQueues = 0;
+
+	if (n > std::numeric_limits<uint32_t>::max())
+		return false;
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if (i)
+		{
+			int nCmp = pE[i - 1].m_Key.V.cmp(pE[i].m_Key.V);
+			if (nCmp > 0)
+				return false;
+
+			if (!nCmp)
+			{
+				if (pE[i - 1].m_ID >= pE[i].m_ID)
+					return false;
+
+				if (m_vGroups.back() == i - 1)
+					m_nQueues++;
+
+				continue; // Input::Count can't overflow, since the total is limited as well
+			}
+		}
+
+		m_vGroups.push_back(i);
+	}
+
+	m_vGroups.push_back(static_cast<uint32_t>(n));
+	return true;
+}
+
+void UtxoTree::BulkLoader::Allocate(uint32_t nTasksDesired)
+{
+	assert(!m_Tree.m_RootOffset);
+
+	uint32_t nLeafs = get_Leafs();
+	m_vLeafs.resize(nLeafs);
+	m_vJoints.resize(get_Joints());
+
+	for (uint32_t iGroup = 0; iGroup < nLeafs; iGroup++)
+	{
+		MyLeaf& x = *Cast::Up<MyLeaf>(m_Tree.CreateLeaf());
+		m_vLeafs[iGroup] = &x;
+
+		uint32_t i = m_vGroups[iGroup];
+		x.m_Bits = 0;
+		x.m_Key = m_pE[i].m_Key;
+		x.m_ID = m_pE[i].m_ID;
+
+		for (i++; i < m_vGroups[iGroup + 1]; i++)
+			m_Tree.PushID(m_pE[i].m_ID, x);
+	}
+
+	for (uint32_t i = 0; i < m_vJoints.size(); i++)
+		m_vJoints[i] = Cast::Up<MyJoint>(m_Tree.CreateJoint());
+
+	m_nTaskMax = std::max(nLeafs / std::max(nTasksDesired, 1U), 1U);
+	m_vTasks.clear();
+
+	if (nLeafs)
+		Plan(0, nLeafs, 0);
+}
+
+uint32_t UtxoTree::BulkLoader::get_Split(uint32_t i0, uint32_t i1, uint16_t& nBitsCommon) const
+{
+	assert(i1 - i0 > 1);
+
+	// all the keys in the range share the prefix of the first and the last ones
+	Key k = get_Key(i0);
+	k.V ^= get_Key(i1 - 1).V;
+
+	nBitsCommon = static_cast<uint16_t>(k.V.nBits - k.V.get_Order());
+	assert(nBitsCommon < Key::s_Bits);
+
+	// find the 1st key with the differing bit set
+	uint32_t iByte = nBitsCommon >> 3;
+	uint8_t nMsk = 1 << (7 ^ (7 & nBitsCommon));
+
+	uint32_t iMin = i0 + 1, iMax = i1 - 1;
+	while (iMin < iMax)
+	{
+		uint32_t iMid = (iMin + iMax) >> 1;
+		if (nMsk & get_Key(iMid).V.m_pData[iByte])
+			iMax = iMid;
+		else
+			iMin = iMid + 1;
+	}
+
+	return iMin;
+}
+
+void UtxoTree::BulkLoader::Plan(uint32_t i0, uint32_t i1, uint16_t nBits)
+{
+	if (i1 - i0 <= m_nTaskMax)
+	{
+		Task& t = m_vTasks.emplace_back();
+		t.m_i0 = i0;
+		t.m_i1 = i1;
+		t.m_nBits = nBits;
+		t.m_pNode = nullptr;
+		return;
+	}
+
+	uint16_t nBitsCommon;
+	uint32_t iMid = get_Split(i0, i1, nBitsCommon);
+
+	Plan(i0, iMid, nBitsCommon + 1);
+	Plan(iMid, i1, nBitsCommon + 1);
+}
+
+RadixTree::Node* UtxoTree::BulkLoader::Build(uint32_t i0, uint32_t i1, uint16_t nBits, Merkle::Hash& hv, bool bTop)
+{
+	if (bTop && (i1 - i0 <= m_nTaskMax))
+	{
+		// built already
+		const Task& t = m_vTasks[m_iTask++];
+		assert((t.m_i0 == i0) && (t.m_i1 == i1) && t.m_pNode);
+
+		hv = t.m_Hash;
+		return t.m_pNode;
+	}
+
+	if (i1 - i0 == 1)
+	{
+		MyLeaf& x = *m_vLeafs[i0];
+		x.m_Bits = (Key::s_Bits - nBits) | (MyLeaf::s_User & x.m_Bits) | MyLeaf::s_Leaf | MyLeaf::s_Clean;
+		x.get_Hash(hv);
+		return &x;
+	}
+
+	uint16_t nBitsCommon;
+	uint32_t iMid = get_Split(i0, i1, nBitsCommon);
+
+	// Joints in the range [i0, i1 - 1) belong to this subtree. The children use [i0, iMid - 1) and [iMid, i1 - 1)
+	MyJoint& x = *m_vJoints[iMid - 1];
+	x.m_Bits = (nBitsCommon - nBits) | MyJoint::s_Clean;
+
+	// key of the leftmost leaf, so that all the joints that refer to it form a chain up from its parent, as Delete() assumes
+	x.m_pKeyPtr.set_Strict(m_vLeafs[i0]->m_Key.V.m_pData);
+
+	Merkle::Hash hv1;
+	x.m_ppC[0].set_Strict(Build(i0, iMid, nBitsCommon + 1, hv, bTop));
+	x.m_ppC[1].set_Strict(Build(iMid, i1, nBitsCommon + 1, hv1, bTop));
+
+	ECC::Hash::Processor()
+		<< hv
+		<< hv1
+		>> x.m_Hash;
+
+	hv = x.m_Hash;
+	return &x;
+}
+
+void UtxoTree::BulkLoader::ExecTask(uint32_t iTask)
+{
+	Task& t = m_vTasks[iTask];
+	t.m_pNode = Build(t.m_i0, t.m_i1, t.m_nBits, t.m_Hash, false);
+}
+
+void UtxoTree::BulkLoader::Finalize()
+{
+	if (!get_Leafs())
+		return;
+
+	m_iTask = 0;
+
+	Merkle::Hash hv;
+	Node* pRoot = Build(0, get_Leafs(), 0, hv, true);
+	assert(m_vTasks.size() == m_iTask);
+
+	m_Tree.OnDirty();
+	m_Tree.set_Root(pRoot);
+}
+
 } // namespace beam
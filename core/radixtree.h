@@ -166,9 +166,10 @@ public:
 protected:
 	int64_t m_RootOffset;
 
-private:
 	void set_Root(Node*);
 
+private:
+
 	void DeleteNode(Node*);
 	void ReplaceTip(CursorBase& cu, Node* pNew);
 	bool Traverse(const Node&, ITraveler&) const;
@@ -331,6 +332,64 @@ public:
 		void Flush(Merkle::Hash&);
 	};
 
+	struct BulkEntry
+	{
+		Key m_Key;
+		TxoID m_ID;
+
+		bool operator < (const BulkEntry& x) const
+		{
+			int n = m_Key.V.cmp(x.m_Key.V);
+			return n ? (n < 0) : (m_ID < x.m_ID);
+		}
+	};
+
+	class BulkLoader
+	{
+		// Builds the (empty) tree bottom-up from the sorted entries, all the hashes are evaluated as well.
+		// The nodes are allocated in advance (allocation isn't thread-safe), then the tree is split into independent subtrees,
+		// which may be built in parallel. The resulting tree is identical to the one built by consequent Find() + PushID()
+		struct Task
+		{
+			uint32_t m_i0;
+			uint32_t m_i1;
+			uint16_t m_nBits;
+			RadixTree::Node* m_pNode;
+			Merkle::Hash m_Hash;
+		};
+
+		UtxoTree& m_Tree;
+		const BulkEntry* m_pE;
+		std::vector<uint32_t> m_vGroups; // 1st entry of each group of equal keys, plus the terminator
+		std::vector<MyLeaf*> m_vLeafs;
+		std::vector<MyJoint*> m_vJoints;
+		std::vector<Task> m_vTasks;
+		uint32_t m_nTaskMax;
+		uint32_t m_iTask;
+		uint32_t m_nQueues;
+
+		const Key& get_Key(uint32_t iGroup) const { return m_pE[m_vGroups[iGroup]].m_Key; }
+		uint32_t get_Split(uint32_t i0, uint32_t i1, uint16_t& nBitsCommon) const;
+		void Plan(uint32_t i0, uint32_t i1, uint16_t nBits);
+		RadixTree::Node* Build(uint32_t i0, uint32_t i1, uint16_t nBits, Merkle::Hash&, bool bTop);
+
+	public:
+		BulkLoader(UtxoTree& t) :m_Tree(t) {}
+
+		bool Init(const BulkEntry*, size_t); // false if the entries aren't sorted, or count overflow
+
+		// number of elements that'll be allocated
+		uint32_t get_Leafs() const { return static_cast<uint32_t>(m_vGroups.size() - 1); }
+		uint32_t get_Joints() const { return get_Leafs() ? (get_Leafs() - 1) : 0; }
+		uint32_t get_Queues() const { return m_nQueues; }
+		uint32_t get_QueueNodes() const { return static_cast<uint32_t>(m_vGroups.back()) - get_Leafs() + m_nQueues; }
+
+		void Allocate(uint32_t nTasksDesired);
+		uint32_t get_Tasks() const { return static_cast<uint32_t>(m_vTasks.size()); }
+		void ExecTask(uint32_t); // different tasks may be executed concurrently
+		void Finalize();
+	};
+
 protected:
 	virtual Leaf* CreateLeaf() override { return new MyLeaf; }
 	virtual uint8_t* GetLeafKey(const Leaf& x) const override { return Cast::Up<MyLeaf>(Cast::NotConst(x)).m_Key.V.m_pData; }
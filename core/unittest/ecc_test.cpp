@@ -1491,6 +1491,51 @@ void TestAES()
 
 	sd.dec.Proceed(pBuf, pBuf); // inplace decode
 	verify_test(!memcmp(pBuf, pPlaintext, sizeof(pPlaintext)));
+
+	// CTR mode. Accelerated versions must produce the same cipherstream, regardless to the fragmentation
+	std::vector<uint8_t> vPlain(0x1000 + 27), vRef, v;
+	for (size_t i = 0; i < vPlain.size(); i++)
+		vPlain[i] = static_cast<uint8_t>(i * 7 + 3);
+
+	const uint32_t pFragment[] = { 1, 15, 16, 17, 130, 1000, 333, 128, 5 };
+	AES::Accel::Enum eLimit = AES::Accel::s_Limit;
+
+	for (uint32_t iLevel = AES::Accel::None; iLevel <= AES::Accel::get_Supported(); iLevel++)
+	{
+		AES::Accel::s_Limit = static_cast<AES::Accel::Enum>(iLevel);
+
+		for (uint32_t iPass = 0; iPass < 2; iPass++)
+		{
+			AES::StreamCipher sc;
+			sc.Reset();
+			memset(sc.m_Counter.m_pData + 8, 0xff, 8);
+			sc.m_Counter.m_pData[15] = 0xf0; // low half overflows in the middle
+
+			v = vPlain;
+
+			if (iPass)
+			{
+				for (uint32_t nPos = 0, i = 0; nPos < v.size(); i++)
+				{
+					uint32_t n = std::min(pFragment[i % _countof(pFragment)], static_cast<uint32_t>(v.size()) - nPos);
+					sc.XCrypt(se.enc, &v.front() + nPos, n);
+					nPos += n;
+				}
+			}
+			else
+				sc.XCrypt(se.enc, &v.front(), static_cast<uint32_t>(v.size()));
+
+			if (vRef.empty())
+				vRef = v;
+			else
+				verify_test(v == vRef);
+		}
+	}
+
+	AES::Accel::s_Limit = eLimit;
+	verify_test(vRef != vPlain);
+
+	printf("AES acceleration: %u\n", AES::Accel::get());
 }
 
 void TestKdfPair(Key::IKdf& skdf, Key::IPKdf& pkdf)
@@ -2706,18 +2751,45 @@ void RunBenchmark()
 		asc.Reset();
 
 		uint8_t pBuf[0x400];
+		std::vector<uint8_t> vBig(0x500000); // max body pack
 
-		BenchmarkMeter bm("AES.XCrypt-1MB");
-		bm.N = 10;
-		do
+		static const char* s_szAccel[] = { "Portable", "AesNi", "VAes" };
+		AES::Accel::Enum eLimit = AES::Accel::s_Limit;
+
+		for (uint32_t iLevel = AES::Accel::None; iLevel <= AES::Accel::get_Supported(); iLevel++)
 		{
-			for (uint32_t i = 0; i < bm.N; i++)
+			AES::Accel::s_Limit = static_cast<AES::Accel::Enum>(iLevel);
+			char sz[64];
+
 			{
-				for (size_t nSize = 0; nSize < 0x100000; nSize += sizeof(pBuf))
-					asc.XCrypt(enc, pBuf, sizeof(pBuf));
+				snprintf(sz, sizeof(sz), "AES.XCrypt-1MB-%s", s_szAccel[iLevel]);
+				BenchmarkMeter bm(sz);
+				bm.N = 10;
+				do
+				{
+					for (uint32_t i = 0; i < bm.N; i++)
+					{
+						for (size_t nSize = 0; nSize < 0x100000; nSize += sizeof(pBuf))
+							asc.XCrypt(enc, pBuf, sizeof(pBuf));
+					}
+
+				} while (bm.ShouldContinue());
 			}
 
-		} while (bm.ShouldContinue());
+			{
+				snprintf(sz, sizeof(sz), "AES.XCrypt-5MB-%s", s_szAccel[iLevel]);
+				BenchmarkMeter bm(sz);
+				bm.N = 1;
+				do
+				{
+					for (uint32_t i = 0; i < bm.N; i++)
+						asc.XCrypt(enc, &vBig.front(), static_cast<uint32_t>(vBig.size()));
+
+				} while (bm.ShouldContinue());
+			}
+		}
+
+		AES::Accel::s_Limit = eLimit;
 	}
 
 	{
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <iostream>
+#include <thread>
 #include "../radixtree.h"
 #include "../navigator.h"
 #include "../../utility/serialize.h"
@@ -412,6 +413,148 @@ namespace beam
 		verify_test(hv1 == hv2);
 	}
 
+	void CollectLeafs(const UtxoTree& t, std::vector<std::pair<UtxoTree::Key, TxoID> >& v)
+	{
+		struct Traveler
+			:public RadixTree::ITraveler
+		{
+			std::vector<std::pair<UtxoTree::Key, TxoID> >* m_pV;
+
+			virtual bool OnLeaf(const RadixTree::Leaf& x) override
+			{
+				const UtxoTree::MyLeaf& v = Cast::Up<UtxoTree::MyLeaf>(x);
+				if (v.IsExt())
+				{
+					for (auto p = v.m_pIDs.get_Strict()->m_pTop.get_Strict(); p; p = p->m_pNext.get())
+						m_pV->emplace_back(v.m_Key, p->m_ID);
+				}
+				else
+					m_pV->emplace_back(v.m_Key, v.m_ID);
+				return true;
+			}
+		} t2;
+
+		t2.m_pV = &v;
+		t.Traverse(t2);
+	}
+
+	void TestUtxoTreeBulk()
+	{
+		// bulk load vs consequent insertion. The resulting trees must be identical
+		std::vector<UtxoTree::BulkEntry> vEntries;
+		vEntries.resize(300000);
+
+		for (uint32_t i = 0; i < vEntries.size(); i++)
+		{
+			UtxoTree::BulkEntry& e = vEntries[i];
+			e.m_ID = i;
+
+			if (i && !(i % 19))
+				e.m_Key = vEntries[rand() % i].m_Key; // duplicate
+			else
+			{
+				UtxoTree::Key::Data d;
+				SetRandomUtxoKey(d);
+				e.m_Key = d;
+			}
+		}
+
+		UtxoTree t1;
+		Merkle::Hash hv1, hv2;
+
+		uint32_t t_ms = GetTime_ms();
+
+		for (uint32_t i = 0; i < vEntries.size(); i++)
+		{
+			UtxoTree::Cursor cu;
+			bool bCreate = true;
+			UtxoTree::MyLeaf* p = t1.Find(cu, vEntries[i].m_Key, bCreate);
+
+			if (bCreate)
+				p->m_ID = vEntries[i].m_ID;
+			else
+				t1.PushID(vEntries[i].m_ID, *p);
+		}
+
+		t1.get_Hash(hv1);
+
+		uint32_t dtSeq_ms = GetTime_ms() - t_ms;
+
+		std::vector<std::pair<UtxoTree::Key, TxoID> > vLeafs1, vLeafs2;
+		CollectLeafs(t1, vLeafs1);
+
+		for (uint32_t nThreads = 1; nThreads <= 4; nThreads *= 2)
+		{
+			t_ms = GetTime_ms();
+
+			std::vector<UtxoTree::BulkEntry> vSorted = vEntries;
+			std::sort(vSorted.begin(), vSorted.end());
+
+			UtxoTree t2;
+			UtxoTree::BulkLoader bl(t2);
+			verify_test(bl.Init(&vSorted.front(), vSorted.size()));
+			bl.Allocate(nThreads * 8);
+
+			std::vector<std::thread> vThreads;
+			for (uint32_t iThread = 0; iThread < nThreads; iThread++)
+			{
+				vThreads.emplace_back([&bl, iThread, nThreads]() {
+					for (uint32_t i = iThread; i < bl.get_Tasks(); i += nThreads)
+						bl.ExecTask(i);
+				});
+			}
+
+			for (auto& th : vThreads)
+				th.join();
+
+			bl.Finalize();
+			t2.get_Hash(hv2);
+
+			uint32_t dt_ms = GetTime_ms() - t_ms;
+			verify_test(hv1 == hv2);
+
+			printf("Utxo tree, %u elements. Consequent=%u ms, Bulk(threads=%u)=%u ms\n", static_cast<uint32_t>(vEntries.size()), dtSeq_ms, nThreads, dt_ms);
+
+			vLeafs2.clear();
+			CollectLeafs(t2, vLeafs2);
+			verify_test(vLeafs1.size() == vLeafs2.size());
+			for (size_t i = 0; i < vLeafs1.size(); i++)
+			{
+				verify_test(vLeafs1[i].first.V == vLeafs2[i].first.V);
+				verify_test(vLeafs1[i].second == vLeafs2[i].second);
+			}
+
+			// proofs, and modifications
+			for (uint32_t i = 0; i < vEntries.size(); i++)
+			{
+				UtxoTree::Cursor cu;
+				bool bCreate = false;
+				UtxoTree::MyLeaf* p = t2.Find(cu, vEntries[i].m_Key, bCreate);
+				if (!p)
+					continue; // duplicate, deleted already
+
+				if (!(i % 97))
+				{
+					t2.get_Hash(hv2);
+
+					Merkle::Proof proof;
+					t2.get_Proof(proof, cu);
+
+					Merkle::Hash hvElement;
+					p->get_Hash(hvElement);
+
+					Merkle::Interpret(hvElement, proof);
+					verify_test(hvElement == hv2);
+				}
+
+				t2.Delete(cu);
+			}
+
+			t2.get_Hash(hv2);
+			verify_test(hv2 == Zero);
+		}
+	}
+
 	struct MyMmr
 		:public Merkle::Mmr
 	{
@@ -675,6 +818,7 @@ int main()
 {
 	beam::TestNavigator();
 	beam::TestUtxoTree();
+	beam::TestUtxoTreeBulk();
 	beam::TestMmr();
 
 	return g_TestsFailed ? -1 : 0;
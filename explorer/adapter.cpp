@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "adapter.h"
+#include "index.h"
 #include "node/node.h"
 #include "core/serialization_adapters.h"
 #include "bvm/bvm2.h"
@@ -42,11 +43,14 @@ namespace beam { namespace explorer {
 namespace {
 
 static const size_t PACKER_FRAGMENTS_SIZE = 4096;
-static const size_t CACHE_DEPTH = 100000;
+static const size_t CACHE_DEPTH = 1000; // older blocks are served from the index
+static const Height INDEX_BATCH = 100; // blocks per reactor cycle during the index catch-up
+static const uint64_t MAX_BLOCKS_PER_REQUEST = 1500;
 
 const unsigned int FAKE_SEED = 10283UL;
 const char WALLET_DB_PATH[] = "explorer-wallet.db";
 const char WALLET_DB_PASS[] = "1";
+const char INDEX_DB_PATH[] = "explorer-index.db";
 
 #ifdef BEAM_ATOMIC_SWAP_SUPPORT
 std::string SwapAmountToString(Amount swapAmount, wallet::AtomicSwapCoin swapCoin)
@@ -127,8 +131,305 @@ private:
     size_t _depth;
 };
 
+/// Constant json fragments, to compose the responses
+struct HelperFragments {
+    io::SharedBuffer _leftBrace, _comma, _rightBrace, _quote;
+
+    HelperFragments() {
+        static const char* s = "[,]\"";
+        io::SharedBuffer buf(s, 4);
+        _leftBrace = buf;
+        _leftBrace.size = 1;
+        _comma = buf;
+        _comma.size = 1;
+        _comma.data ++;
+        _rightBrace = buf;
+        _rightBrace.size = 1;
+        _rightBrace.data += 2;
+        _quote = buf;
+        _quote.size = 1;
+        _quote.data += 3;
+    }
+};
+
 using nlohmann::json;
 
+json history_to_json(const json& id, const std::vector<Height>& heights) {
+    return json{ {"id", id}, {"heights", heights} };
+}
+
+/// Contract list/state from the node DB as of the specified height, the descriptions are produced by the rich contract parser shader
+void get_ContractList(json& out, NodeDB& db, Height h)
+{
+#pragma pack (push, 1)
+    struct KeyEntry
+    {
+        bvm2::ContractID m_Zero;
+        uint8_t m_Tag;
+
+        struct SidCid
+        {
+            bvm2::ShaderID m_Sid;
+            bvm2::ContractID m_Cid;
+        } m_SidCid;
+    };
+#pragma pack (pop)
+
+    KeyEntry k0, k1;
+    ZeroObject(k0);
+    k0.m_Tag = Shaders::KeyTag::SidCid;
+
+    k1.m_Zero = Zero;
+    k1.m_Tag = Shaders::KeyTag::SidCid;
+    memset(reinterpret_cast<void*>(&k1.m_SidCid), 0xff, sizeof(k1.m_SidCid));
+
+    std::vector<std::pair<KeyEntry::SidCid, Height> > vIDs;
+
+    {
+        NodeDB::WalkerContractData wlk;
+        for (db.ContractDataEnum(wlk, Blob(&k0, sizeof(k0)), Blob(&k1, sizeof(k1))); wlk.MoveNext(); )
+        {
+            if ((sizeof(KeyEntry) != wlk.m_Key.n) || (sizeof(Height) != wlk.m_Val.n))
+                continue;
+
+            auto& x = vIDs.emplace_back();
+            x.first = reinterpret_cast<const KeyEntry*>(wlk.m_Key.p)->m_SidCid;
+            (reinterpret_cast<const uintBigFor<Height>::Type*>(wlk.m_Val.p))->Export(x.second);
+        }
+    }
+
+    out = json::array();
+    char buf[80];
+
+    for (size_t i = 0; i < vIDs.size(); i++)
+    {
+        const auto& x = vIDs[i];
+
+        std::string sExtra;
+        NodeProcessor::get_ContractDescr(db, h, x.first.m_Sid, x.first.m_Cid, sExtra, false);
+
+        out.push_back(
+            json{
+                {"sid", uint256_to_hex(buf, x.first.m_Sid)},
+                {"cid", uint256_to_hex(buf, x.first.m_Cid)},
+                {"extra", sExtra },
+                {"height",   x.second}
+            }
+        );
+
+    }
+
+}
+
+bool get_ContractState(json& out, NodeDB& db, Height h, const bvm2::ContractID& cid)
+{
+    bvm2::ShaderID sid;
+
+    {
+        Blob blob;
+        NodeDB::Recordset rs;
+        if (!db.ContractDataFind(cid, blob, rs))
+            return false;
+
+        bvm2::get_ShaderID(sid, blob);
+    }
+
+    json jFunds, jAssets;
+
+    {
+
+#pragma pack (push, 1)
+        struct KeyFund
+        {
+            bvm2::ContractID m_Cid;
+            uint8_t m_Tag = Shaders::KeyTag::LockedAmount;
+            uintBigFor<Asset::ID>::Type m_Aid;
+        };
+#pragma pack (pop)
+
+        KeyFund k0, k1;
+        k0.m_Cid = cid;
+        k0.m_Aid = Zero;
+        k1.m_Cid = cid;
+        k1.m_Aid = static_cast<Asset::ID>(-1);
+
+        NodeDB::WalkerContractData wlk;
+        for (db.ContractDataEnum(wlk, Blob(&k0, sizeof(k0)), Blob(&k1, sizeof(k1))); wlk.MoveNext(); )
+        {
+            if ((sizeof(KeyFund) != wlk.m_Key.n) || (sizeof(AmountBig::Type) != wlk.m_Val.n))
+                continue;
+
+            Asset::ID aid;
+            reinterpret_cast<const KeyFund*>(wlk.m_Key.p)->m_Aid.Export(aid);
+
+            const auto& val = *reinterpret_cast<const AmountBig::Type*>(wlk.m_Val.p);
+
+
+            jFunds.push_back(
+                json{
+                    {"aid", aid},
+                    {"value", AmountBig::get_Lo(val)}
+                }
+            );
+        }
+    }
+
+
+    {
+
+#pragma pack (push, 1)
+        struct KeyAsset
+        {
+            bvm2::ContractID m_Cid;
+            uint8_t m_Tag = Shaders::KeyTag::OwnedAsset;
+            uintBigFor<Asset::ID>::Type m_Aid;
+        };
+#pragma pack (pop)
+
+        KeyAsset k0, k1;
+        k0.m_Cid = cid;
+        k0.m_Aid = Zero;
+        k1.m_Cid = cid;
+        k1.m_Aid = static_cast<Asset::ID>(-1);
+
+        NodeDB::WalkerContractData wlk;
+        for (db.ContractDataEnum(wlk, Blob(&k0, sizeof(k0)), Blob(&k1, sizeof(k1))); wlk.MoveNext(); )
+        {
+            if (sizeof(KeyAsset) != wlk.m_Key.n)
+                continue;
+
+            Asset::Full ai;
+            reinterpret_cast<const KeyAsset*>(wlk.m_Key.p)->m_Aid.Export(ai.m_ID);
+
+            if (!db.AssetGetSafe(ai))
+                ai.m_Value = Zero;
+
+            std::string sMeta;
+            ai.m_Metadata.get_String(sMeta);
+
+            jAssets.push_back(
+                json{
+                    {"aid", ai.m_ID },
+                    {"value", AmountBig::get_Lo(ai.m_Value)},
+                    {"metadata", sMeta }
+                }
+            );
+        }
+    }
+
+    std::string sExtra;
+    NodeProcessor::get_ContractDescr(db, h, sid, cid, sExtra, true);
+
+    out = json{
+        {"funds", jFunds},
+        {"assets", jAssets},
+        {"extra", sExtra }
+    };
+
+    return true;
+}
+
+/// Serves requests from the explorer index via a read-only connection, doesn't touch the node.
+/// The node DB is only accessed via the snapshots of its read pool (if it's open)
+class IndexReader : public IAdapter::IReader, private HelperFragments {
+public:
+    IndexReader(const char* path, NodeDB::ReadPool* dbReaders) : _dbReaders(dbReaders), _packer(PACKER_FRAGMENTS_SIZE) {
+        _index.open(path, true);
+    }
+
+private:
+    bool get_block(io::SerializedMsg& out, uint64_t height) override {
+        io::SharedBuffer body;
+        if (!_index.get_block(height, body)) return false;
+
+        out.push_back(body);
+        return true;
+    }
+
+    bool get_block_by_hash(io::SerializedMsg& out, const ByteBuffer& hash) override {
+        if (!_dbReaders) return false;
+
+        Height height;
+        {
+            NodeDB::ReadPool::Snapshot snapshot(*_dbReaders); // released before the index lookup
+            height = snapshot.get_DB().FindBlock(hash);
+        }
+
+        return (height >= Rules::HeightGenesis) && get_block(out, height);
+    }
+
+    bool get_block_by_kernel(io::SerializedMsg& out, const ByteBuffer& key) override {
+        BlockIndex::Transaction t(_index); // both lookups from the same snapshot
+
+        Height height = _index.find_kernel(key);
+        return height && get_block(out, height);
+    }
+
+    bool get_blocks(io::SerializedMsg& out, uint64_t startHeight, uint64_t n) override {
+        if (n > MAX_BLOCKS_PER_REQUEST) n = MAX_BLOCKS_PER_REQUEST;
+        else if (n == 0) n = 1;
+
+        io::SerializedMsg bodies;
+        bodies.reserve(n);
+        _index.get_blocks(startHeight, startHeight + n - 1, [&bodies](Height, io::SharedBuffer&& body) {
+            bodies.push_back(std::move(body));
+        });
+
+        if (bodies.size() != n) return false; // some blocks are not indexed (yet)
+
+        out.push_back(_leftBrace);
+        for (size_t i = 0; i < bodies.size(); i++) {
+            if (i) out.push_back(_comma);
+            out.push_back(bodies[i]);
+        }
+        out.push_back(_rightBrace);
+        return true;
+    }
+
+    bool get_asset_history(io::SerializedMsg& out, uint64_t aid) override {
+        std::vector<Height> vHeights;
+        _index.get_asset_heights(static_cast<Asset::ID>(aid), vHeights);
+        return serialize_json_msg(out, _packer, history_to_json(aid, vHeights));
+    }
+
+    bool get_contract_history(io::SerializedMsg& out, const ByteBuffer& id) override {
+        if (id.size() != bvm2::ContractID::nBytes) return false;
+
+        std::vector<Height> vHeights;
+        _index.get_contract_heights(id, vHeights);
+
+        char buf[80];
+        return serialize_json_msg(out, _packer, history_to_json(hash_to_hex(buf, reinterpret_cast<const bvm2::ContractID&>(id.front())), vHeights));
+    }
+
+    bool get_contracts(io::SerializedMsg& out) override {
+        if (!_dbReaders) return false;
+
+        json j;
+        {
+            NodeDB::ReadPool::Snapshot snapshot(*_dbReaders);
+            get_ContractList(j, snapshot.get_DB(), snapshot.m_Cursor.m_Height);
+        }
+        return serialize_json_msg(out, _packer, j);
+    }
+
+    bool get_contract_details(io::SerializedMsg& out, const ByteBuffer& id) override {
+        if (!_dbReaders || (id.size() != bvm2::ContractID::nBytes)) return false;
+
+        json j;
+        {
+            NodeDB::ReadPool::Snapshot snapshot(*_dbReaders);
+            if (!get_ContractState(j, snapshot.get_DB(), snapshot.m_Cursor.m_Height, reinterpret_cast<const bvm2::ContractID&>(id.front())))
+                return false;
+        }
+        return serialize_json_msg(out, _packer, j);
+    }
+
+    NodeDB::ReadPool* _dbReaders;
+    BlockIndex _index;
+    HttpMsgCreator _packer;
+};
+
 } //namespace
 
 class ExchangeRateProvider
@@ -231,7 +532,7 @@ private:
 };
 
 /// Explorer server backend, gets callback on status update and returns json messages for server
-class Adapter : public Node::IObserver, public IAdapter {
+class Adapter : public Node::IObserver, public IAdapter, private HelperFragments {
 public:
     Adapter(Node& node) :
         _packer(PACKER_FRAGMENTS_SIZE),
@@ -241,7 +542,14 @@ public:
         _nodeIsSyncing(true),
         _cache(CACHE_DEPTH)
     {
-         init_helper_fragments();
+         try {
+             _index.open(INDEX_DB_PATH);
+         } catch (const std::exception& e) {
+             LOG_ERROR() << "Explorer index disabled: " << e.what();
+             _index.close();
+         }
+         _indexTimer = io::Timer::create(io::Reactor::get_Current());
+         _indexTimer->start(0, false, [this]() { update_index(); }); // the node isn't initialized yet
          _hook = &node.m_Cfg.m_Observer;
          _nextHook = *_hook;
          *_hook = this;
@@ -285,22 +593,6 @@ public:
     }
 
 private:
-    void init_helper_fragments() {
-        static const char* s = "[,]\"";
-        io::SharedBuffer buf(s, 4);
-        _leftBrace = buf;
-        _leftBrace.size = 1;
-        _comma = buf;
-        _comma.size = 1;
-        _comma.data ++;
-        _rightBrace = buf;
-        _rightBrace.size = 1;
-        _rightBrace.data += 2;
-        _quote = buf;
-        _quote.size = 1;
-        _quote.data += 3;
-    }
-
     /// Returns body for /status request
     void OnSyncProgress() override {
 		const Node::SyncStatus& s = _node.m_SyncStatus;
@@ -316,6 +608,7 @@ private:
         const auto& cursor = _nodeBackend.m_Cursor;
         _cache.currentHeight = cursor.m_Sid.m_Height;
         _statusDirty = true;
+        if (_indexVerified) update_index();
         if (_nextHook) _nextHook->OnStateChanged();
     }
 
@@ -325,9 +618,136 @@ private:
 
         blocks.erase(blocks.lower_bound(id.m_Height), blocks.end());
 
+        if (_index.is_open() && (_indexHeight > id.m_Height)) {
+            try {
+                BlockIndex::Transaction t(_index);
+                _index.rollback_to(id.m_Height);
+                t.commit();
+                _indexHeight = id.m_Height;
+            } catch (const std::exception& e) {
+                on_index_error(e);
+            }
+        }
+
         if (_nextHook) _nextHook->OnRolledBack(id);
     }
 
+    void on_index_error(const std::exception& e) {
+        LOG_ERROR() << "Explorer index disabled: " << e.what();
+        _index.close();
+        _indexHeight = 0;
+    }
+
+    /// After restart the node may be at a different branch (or even a different DB). Roll the index back to the common part
+    void verify_index() {
+        NodeDB& db = _nodeBackend.get_DB();
+
+        Height h = std::min(_index.get_height(), _nodeBackend.m_Cursor.m_Sid.m_Height);
+        for (; h; h--) {
+            Merkle::Hash hvIndex, hvNode;
+            uint64_t row;
+            if (_index.get_hash(h, hvIndex) && extract_row(h, row, nullptr)) {
+                db.get_StateHash(row, hvNode);
+                if (hvIndex == hvNode) break;
+            }
+        }
+
+        BlockIndex::Transaction t(_index);
+        _index.rollback_to(h);
+        t.commit();
+
+        _indexHeight = h;
+        _indexVerified = true;
+        LOG_INFO() << "Explorer index height " << h;
+    }
+
+    /// Renders and indexes the new blocks, at most INDEX_BATCH per call. The rest is deferred, to not block the reactor for long
+    void update_index() {
+        if (!_index.is_open()) return;
+
+        try {
+            if (!_indexVerified) verify_index();
+
+            Height hTip = _nodeBackend.m_Cursor.m_Sid.m_Height;
+            if (_indexHeight >= hTip) return;
+
+            Height hEnd = std::min(hTip, _indexHeight + INDEX_BATCH);
+            _exchangeRateProvider->preloadRates(_indexHeight + 1, hEnd);
+
+            BlockIndex::Transaction t(_index);
+
+            Height h = _indexHeight + 1;
+            for (; h <= hEnd; h++) {
+                if (!index_block(h)) break;
+            }
+
+            t.commit();
+            _indexHeight = h - 1;
+
+            if ((_indexHeight < hTip) && (h > hEnd)) {
+                _indexTimer->start(0, false, [this]() { update_index(); });
+            }
+        } catch (const std::exception& e) {
+            on_index_error(e);
+        }
+    }
+
+    bool index_block(Height h) {
+        NodeDB& db = _nodeBackend.get_DB();
+
+        uint64_t row;
+        if (!extract_row(h, row, nullptr)) return false;
+
+        NodeDB::StateID sid;
+        sid.m_Row = row;
+        sid.m_Height = h;
+        Block::SystemState::ID id;
+        db.get_StateID(sid, id);
+
+        json j;
+        ExtraInfo::Refs refs;
+        io::SharedBuffer body;
+
+        // may fail if the block is below the horizon, the index still gets its hash
+        if (extract_block_from_row(j, row, h, &refs)) {
+            _sm.clear();
+            if (!serialize_json_msg(_sm, _packer, j)) return false;
+            body = io::normalize(_sm, false);
+            _sm.clear();
+
+            for (const auto& hv : refs.m_Kernels) {
+                _index.add_kernel(hv, h);
+            }
+            for (auto aid : refs.m_Assets) {
+                _index.add_asset(aid, h);
+            }
+            for (const auto& cid : refs.m_Contracts) {
+                _index.add_contract(cid, h);
+            }
+
+            _cache.put_block(h, body);
+        }
+
+        _index.add_block(id, Blob(body.data, static_cast<uint32_t>(body.size)));
+        return true;
+    }
+
+    bool get_indexed_block(io::SerializedMsg& out, Height h) {
+        if (!_index.is_open() || (h > _indexHeight)) return false;
+
+        io::SharedBuffer body;
+        try {
+            if (!_index.get_block(h, body)) return false;
+        } catch (const std::exception& e) {
+            on_index_error(e);
+            return false;
+        }
+
+        _cache.put_block(h, body);
+        out.push_back(body);
+        return true;
+    }
+
     bool get_status(io::SerializedMsg& out) override {
         if (_statusDirty) {
             const auto& cursor = _nodeBackend.m_Cursor;
@@ -403,6 +823,26 @@ private:
 
     struct ExtraInfo
     {
+        // lookup keys collected while rendering a block, for the index
+        struct Refs {
+            std::vector<Merkle::Hash> m_Kernels;
+            std::set<Asset::ID> m_Assets;
+            std::set<bvm2::ContractID> m_Contracts;
+            std::vector<PeerID> m_AssetOwners; // of the created assets, their IDs are resolved from the asset list
+
+            void OnContract(const NodeProcessor::ContractInvokeExtraInfo& info)
+            {
+                m_Contracts.insert(info.m_Cid);
+
+                for (auto it = info.m_FundsIO.m_Map.begin(); info.m_FundsIO.m_Map.end() != it; it++)
+                    if (it->first)
+                        m_Assets.insert(it->first);
+
+                for (size_t i = 0; i < info.m_vNested.size(); i++)
+                    OnContract(info.m_vNested[i]);
+            }
+        };
+
         struct ContractRichInfo {
             std::vector<NodeProcessor::ContractInvokeExtraInfo> m_vInfo;
             size_t m_iPos = 0;
@@ -420,6 +860,7 @@ private:
         {
             std::ostringstream m_os;
             bool m_Empty = true;
+            Refs* m_pRefs = nullptr;
 
             void Next()
             {
@@ -439,6 +880,13 @@ private:
                 }
             }
 
+            void OnContractTop(const NodeProcessor::ContractInvokeExtraInfo& info)
+            {
+                if (m_pRefs)
+                    m_pRefs->OnContract(info);
+                OnContract(info);
+            }
+
             void OnContract(const NodeProcessor::ContractInvokeExtraInfo& info)
             {
                 m_os << "Contract " << info.m_Cid << ", " << info.m_sParsed;
@@ -532,7 +980,7 @@ private:
             return w.m_os.str();
         }
 
-        static std::string get(const TxKernel& krn, Amount& fee, ContractRichInfo& cri)
+        static std::string get(const TxKernel& krn, Amount& fee, ContractRichInfo& cri, Refs* pRefs)
         {
             struct MyWalker
                 :public TxKernel::IWalker
@@ -574,18 +1022,27 @@ private:
                 {
                     m_Wr.Next();
                     m_Wr.m_os << "Asset.Create MD.Hash=" << krn.m_MetaData.m_Hash;
+
+                    if (m_Wr.m_pRefs)
+                        m_Wr.m_pRefs->m_AssetOwners.push_back(krn.m_Owner);
                 }
 
                 void OnKrnEx(const TxKernelAssetDestroy& krn)
                 {
                     m_Wr.Next();
                     m_Wr.m_os << "Asset.Destroy ID=" << krn.m_AssetID;
+
+                    if (m_Wr.m_pRefs)
+                        m_Wr.m_pRefs->m_Assets.insert(krn.m_AssetID);
                 }
 
                 void OnKrnEx(const TxKernelAssetEmit& krn)
                 {
                     m_Wr.Next();
                     m_Wr.m_os << "Asset.Emit ID=" << krn.m_AssetID << " Value=" << krn.m_Value;
+
+                    if (m_Wr.m_pRefs)
+                        m_Wr.m_pRefs->m_Assets.insert(krn.m_AssetID);
                 }
 
                 void OnKrnEx(const TxKernelShieldedOutput& krn)
@@ -616,7 +1073,7 @@ private:
 
                     auto pInfo = m_pCri->get_Next();
                     if (pInfo)
-                        m_Wr.OnContract(*pInfo);
+                        m_Wr.OnContractTop(*pInfo);
                     else
                     {
                         NodeProcessor::ContractInvokeExtraInfo info;
@@ -627,7 +1084,7 @@ private:
 
                         info.SetUnk(0, krn.m_Args, &sid);
 
-                        m_Wr.OnContract(info);
+                        m_Wr.OnContractTop(info);
                     }
                 }
 
@@ -637,18 +1094,19 @@ private:
 
                     auto pInfo = m_pCri->get_Next();
                     if (pInfo)
-                        m_Wr.OnContract(*pInfo);
+                        m_Wr.OnContractTop(*pInfo);
                     else
                     {
                         NodeProcessor::ContractInvokeExtraInfo info;
                         info.m_Cid = krn.m_Cid;
                         info.SetUnk(krn.m_iMethod, krn.m_Args, nullptr);
-                        m_Wr.OnContract(info);
+                        m_Wr.OnContractTop(info);
                     }
                 }
 
             } wlk;
             wlk.m_pCri = &cri;
+            wlk.m_Wr.m_pRefs = pRefs;
 
             if (!krn.m_vNested.empty())
             {
@@ -663,197 +1121,78 @@ private:
         }
     };
 
-    void get_ContractList(json& out)
+    bool get_contracts(io::SerializedMsg& out) override
     {
-#pragma pack (push, 1)
-        struct KeyEntry
-        {
-            bvm2::ContractID m_Zero;
-            uint8_t m_Tag;
-
-            struct SidCid
-            {
-                bvm2::ShaderID m_Sid;
-                bvm2::ContractID m_Cid;
-            } m_SidCid;
-        };
-#pragma pack (pop)
-
-        KeyEntry k0, k1;
-        ZeroObject(k0);
-        k0.m_Tag = Shaders::KeyTag::SidCid;
+        json j;
+        get_ContractList(j, _nodeBackend.get_DB(), _nodeBackend.m_Cursor.m_Full.m_Height);
 
-        k1.m_Zero = Zero;
-        k1.m_Tag = Shaders::KeyTag::SidCid;
-        memset(reinterpret_cast<void*>(&k1.m_SidCid), 0xff, sizeof(k1.m_SidCid));
+        return json2Msg(j, out);
+    }
+    
+    bool get_asset_history(io::SerializedMsg& out, uint64_t aid) override
+    {
+        std::vector<Height> vHeights;
+        if (!get_index_heights(vHeights, [this, aid](std::vector<Height>& v) { _index.get_asset_heights(static_cast<Asset::ID>(aid), v); }))
+            return false;
 
-        std::vector<std::pair<KeyEntry::SidCid, Height> > vIDs;
+        return json2Msg(history_to_json(aid, vHeights), out);
+    }
 
-        {
-            NodeDB::WalkerContractData wlk;
-            for (_nodeBackend.get_DB().ContractDataEnum(wlk, Blob(&k0, sizeof(k0)), Blob(&k1, sizeof(k1))); wlk.MoveNext(); )
-            {
-                if ((sizeof(KeyEntry) != wlk.m_Key.n) || (sizeof(Height) != wlk.m_Val.n))
-                    continue;
+    bool get_contract_history(io::SerializedMsg& out, const ByteBuffer& id) override
+    {
+        if (id.size() != bvm2::ContractID::nBytes)
+            return false;
 
-                auto& x = vIDs.emplace_back();
-                x.first = reinterpret_cast<const KeyEntry*>(wlk.m_Key.p)->m_SidCid;
-                (reinterpret_cast<const uintBigFor<Height>::Type*>(wlk.m_Val.p))->Export(x.second);
-            }
-        }
+        std::vector<Height> vHeights;
+        if (!get_index_heights(vHeights, [this, &id](std::vector<Height>& v) { _index.get_contract_heights(id, v); }))
+            return false;
 
-        out = json::array();
         char buf[80];
-
-        for (size_t i = 0; i < vIDs.size(); i++)
-        {
-            const auto& x = vIDs[i];
-
-            std::string sExtra;
-            _nodeBackend.get_ContractDescr(x.first.m_Sid, x.first.m_Cid, sExtra, false);
-
-            out.push_back(
-                json{
-                    {"sid", uint256_to_hex(buf, x.first.m_Sid)},
-                    {"cid", uint256_to_hex(buf, x.first.m_Cid)},
-                    {"extra", sExtra },
-                    {"height",   x.second}
-                }
-            );
-
-        }
-
+        return json2Msg(history_to_json(hash_to_hex(buf, reinterpret_cast<const bvm2::ContractID&>(id.front())), vHeights), out);
     }
 
-    bool get_ContractState(json& out, const bvm2::ContractID& cid)
+    IReader::Ptr create_reader() override
     {
-        bvm2::ShaderID sid;
-
-        {
-            Blob blob;
-            NodeDB::Recordset rs;
-            if (!_nodeBackend.get_DB().ContractDataFind(cid, blob, rs))
-                return false;
-
-            bvm2::get_ShaderID(sid, blob);
-        }
-
-        json jFunds, jAssets;
-
-        {
-
-#pragma pack (push, 1)
-            struct KeyFund
-            {
-                bvm2::ContractID m_Cid;
-                uint8_t m_Tag = Shaders::KeyTag::LockedAmount;
-                uintBigFor<Asset::ID>::Type m_Aid;
-            };
-#pragma pack (pop)
-
-            KeyFund k0, k1;
-            k0.m_Cid = cid;
-            k0.m_Aid = Zero;
-            k1.m_Cid = cid;
-            k1.m_Aid = static_cast<Asset::ID>(-1);
+        if (!_index.is_open())
+            return {};
 
-            NodeDB::WalkerContractData wlk;
-            for (_nodeBackend.get_DB().ContractDataEnum(wlk, Blob(&k0, sizeof(k0)), Blob(&k1, sizeof(k1))); wlk.MoveNext(); )
-            {
-                if ((sizeof(KeyFund) != wlk.m_Key.n) || (sizeof(AmountBig::Type) != wlk.m_Val.n))
-                    continue;
-
-                Asset::ID aid;
-                reinterpret_cast<const KeyFund*>(wlk.m_Key.p)->m_Aid.Export(aid);
-
-                const auto& val = *reinterpret_cast<const AmountBig::Type*>(wlk.m_Val.p);
-
-
-                jFunds.push_back(
-                    json{
-                        {"aid", aid},
-                        {"value", AmountBig::get_Lo(val)}
-                    }
-                );
-            }
+        try {
+            NodeDB::ReadPool& dbReaders = _nodeBackend.m_DbReaders;
+            return std::make_unique<IndexReader>(INDEX_DB_PATH, dbReaders.IsOpen() ? &dbReaders : nullptr);
+        } catch (const std::exception& e) {
+            LOG_ERROR() << "Explorer index reader: " << e.what();
         }
+        return {};
+    }
 
+    template <typename TFunc>
+    bool get_index_heights(std::vector<Height>& v, const TFunc& func)
+    {
+        if (!_index.is_open())
+            return false;
 
-        {
-
-#pragma pack (push, 1)
-            struct KeyAsset
-            {
-                bvm2::ContractID m_Cid;
-                uint8_t m_Tag = Shaders::KeyTag::OwnedAsset;
-                uintBigFor<Asset::ID>::Type m_Aid;
-            };
-#pragma pack (pop)
-
-            KeyAsset k0, k1;
-            k0.m_Cid = cid;
-            k0.m_Aid = Zero;
-            k1.m_Cid = cid;
-            k1.m_Aid = static_cast<Asset::ID>(-1);
-
-            NodeDB::WalkerContractData wlk;
-            for (_nodeBackend.get_DB().ContractDataEnum(wlk, Blob(&k0, sizeof(k0)), Blob(&k1, sizeof(k1))); wlk.MoveNext(); )
-            {
-                if (sizeof(KeyAsset) != wlk.m_Key.n)
-                    continue;
-
-                Asset::Full ai;
-                reinterpret_cast<const KeyAsset*>(wlk.m_Key.p)->m_Aid.Export(ai.m_ID);
-
-                if (!_nodeBackend.get_DB().AssetGetSafe(ai))
-                    ai.m_Value = Zero;
-
-                std::string sMeta;
-                ai.m_Metadata.get_String(sMeta);
-
-                jAssets.push_back(
-                    json{
-                        {"aid", ai.m_ID },
-                        {"value", AmountBig::get_Lo(ai.m_Value)},
-                        {"metadata", sMeta }
-                    }
-                );
-            }
+        try {
+            func(v);
+        } catch (const std::exception& e) {
+            on_index_error(e);
+            return false;
         }
-
-        std::string sExtra;
-        _nodeBackend.get_ContractDescr(sid, cid, sExtra, true);
-
-        out = json{
-            {"funds", jFunds},
-            {"assets", jAssets},
-            {"extra", sExtra }
-        };
-
         return true;
     }
 
-    bool get_contracts(io::SerializedMsg& out) override
-    {
-        json j;
-        get_ContractList(j);
-
-        return json2Msg(j, out);
-    }
-    
     bool get_contract_details(io::SerializedMsg& out, const ByteBuffer& id) override
     {
         if (id.size() != bvm2::ContractID::nBytes)
             return false;
 
         json j;
-        if (!get_ContractState(j, reinterpret_cast<const bvm2::ContractID&>(id.front())))
+        if (!get_ContractState(j, _nodeBackend.get_DB(), _nodeBackend.m_Cursor.m_Full.m_Height, reinterpret_cast<const bvm2::ContractID&>(id.front())))
             return false;
 
         return json2Msg(j, out);
     }
 
-    bool extract_block_from_row(json& out, uint64_t row, Height height) {
+    bool extract_block_from_row(json& out, uint64_t row, Height height, ExtraInfo::Refs* pRefs = nullptr) {
         NodeDB& db = _nodeBackend.get_DB();
 
         Block::SystemState::Full blockState;
@@ -915,7 +1254,10 @@ private:
             for (const auto &v : block.m_vKernels) {
 
                 Amount fee = 0;
-                std::string sExtra = ExtraInfo::get(*v, fee, cri);
+                std::string sExtra = ExtraInfo::get(*v, fee, cri, pRefs);
+
+                if (pRefs)
+                    pRefs->m_Kernels.push_back(v->m_Internal.m_ID);
 
                 kernels.push_back(
                     json{
@@ -938,6 +1280,9 @@ private:
 
                 if (ret > 0)
                 {
+                    if (pRefs && (pRefs->m_AssetOwners.end() != std::find(pRefs->m_AssetOwners.begin(), pRefs->m_AssetOwners.end(), ai.m_Owner)))
+                        pRefs->m_Assets.insert(ai.m_ID);
+
                     assets.push_back(
                         json{
                             {"id", ai.m_ID},
@@ -991,7 +1336,7 @@ private:
     }
 
     bool get_block_impl(io::SerializedMsg& out, uint64_t height, uint64_t& row, uint64_t* prevRow) {
-        if (_cache.get_block(out, height)) {
+        if (_cache.get_block(out, height) || get_indexed_block(out, height)) {
             if (prevRow && row > 0) {
                 extract_row(height, row, prevRow);
             }
@@ -1063,24 +1408,56 @@ private:
     bool get_block_by_kernel(io::SerializedMsg& out, const ByteBuffer& key) override {
         NodeDB& db = _nodeBackend.get_DB();
 
-        Height height = db.FindKernel(key);
+        Height height = 0;
+        if (_index.is_open()) {
+            try {
+                height = _index.find_kernel(key);
+            } catch (const std::exception& e) {
+                on_index_error(e);
+            }
+        }
+        if (!height) {
+            height = db.FindKernel(key);
+        }
         uint64_t row = 0;
 
         return get_block_impl(out, height, row, 0);
     }
 
     bool get_blocks(io::SerializedMsg& out, uint64_t startHeight, uint64_t n) override {
-        static const uint64_t maxElements = 1500;
-        if (n > maxElements) n = maxElements;
+        if (n > MAX_BLOCKS_PER_REQUEST) n = MAX_BLOCKS_PER_REQUEST;
         else if (n==0) n=1;
         Height endHeight = startHeight + n - 1;
-        _exchangeRateProvider->preloadRates(startHeight, endHeight);
+
+        // fetch the indexed part of the range in a single query
+        std::map<Height, io::SharedBuffer> indexed;
+        if (_index.is_open() && (startHeight <= _indexHeight)) {
+            try {
+                _index.get_blocks(startHeight, std::min(endHeight, _indexHeight), [&indexed](Height h, io::SharedBuffer&& body) {
+                    indexed.emplace(h, std::move(body));
+                });
+            } catch (const std::exception& e) {
+                on_index_error(e);
+                indexed.clear();
+            }
+        }
+
+        if (indexed.size() < n) {
+            _exchangeRateProvider->preloadRates(startHeight, endHeight);
+        }
+
         out.push_back(_leftBrace);
         uint64_t row = 0;
         uint64_t prevRow = 0;
         for (;;) {
-            bool ok = get_block_impl(out, endHeight, row, &prevRow);
-            if (!ok) return false;
+            auto it = indexed.find(endHeight);
+            if (indexed.end() != it) {
+                out.push_back(it->second);
+                prevRow = 0; // not known, will be looked-up by height if necessary
+            } else {
+                bool ok = get_block_impl(out, endHeight, row, &prevRow);
+                if (!ok) return false;
+            }
             if (endHeight == startHeight) {
                 break;
             }
@@ -1227,9 +1604,6 @@ private:
 	Node& _node;
     NodeProcessor& _nodeBackend;
 
-    // helper fragments
-    io::SharedBuffer _leftBrace, _comma, _rightBrace, _quote;
-
     // If true then status boby needs to be refreshed
     bool _statusDirty;
 
@@ -1242,6 +1616,12 @@ private:
 
     ResponseCache _cache;
 
+    // persistent index, contains all the blocks up to _indexHeight
+    BlockIndex _index;
+    Height _indexHeight = 0;
+    bool _indexVerified = false;
+    io::Timer::Ptr _indexTimer;
+
     io::SerializedMsg _sm;
 
     wallet::IWalletDB::Ptr _walletDB;
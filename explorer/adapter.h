@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#pragma once
+
 #include "utility/io/buffer.h"
 #include "utility/common.h"
 
@@ -27,6 +29,30 @@ struct IAdapter {
 
     virtual ~IAdapter() = default;
 
+    /// Read-only access to the explorer index (and to the node DB snapshots, if the node DB is in WAL mode), independent of the node.
+    /// Each instance may be used by a single (arbitrary) thread.
+    /// Methods return false if the request can't be answered from the index, then it should be passed to the adapter (on the reactor thread)
+    struct IReader {
+        using Ptr = std::unique_ptr<IReader>;
+
+        virtual ~IReader() = default;
+
+        virtual bool get_block(io::SerializedMsg& out, uint64_t height) = 0;
+        virtual bool get_block_by_hash(io::SerializedMsg& out, const ByteBuffer& hash) = 0;
+        virtual bool get_block_by_kernel(io::SerializedMsg& out, const ByteBuffer& key) = 0;
+        virtual bool get_blocks(io::SerializedMsg& out, uint64_t startHeight, uint64_t n) = 0;
+        virtual bool get_asset_history(io::SerializedMsg& out, uint64_t aid) = 0;
+        virtual bool get_contract_history(io::SerializedMsg& out, const ByteBuffer& id) = 0;
+
+        /// Run the contract parser shader on a node DB snapshot. The failure is final: these are not passed to the adapter,
+        /// the shader calls must not run on the reactor thread
+        virtual bool get_contracts(io::SerializedMsg& out) = 0;
+        virtual bool get_contract_details(io::SerializedMsg& out, const ByteBuffer& id) = 0;
+    };
+
+    /// Returns nullptr if the index isn't available
+    virtual IReader::Ptr create_reader() = 0;
+
     /// Returns body for /status request
     virtual bool get_status(io::SerializedMsg& out) = 0;
 
@@ -48,6 +74,10 @@ struct IAdapter {
 
     virtual bool get_contracts(io::SerializedMsg& out) = 0;
     virtual bool get_contract_details(io::SerializedMsg& out, const ByteBuffer& id) = 0;
+
+    /// Heights of the blocks that affected the asset/contract, from the explorer index
+    virtual bool get_asset_history(io::SerializedMsg& out, uint64_t aid) = 0;
+    virtual bool get_contract_history(io::SerializedMsg& out, const ByteBuffer& id) = 0;
 };
 
 IAdapter::Ptr create_adapter(Node& node);
@@ -23,6 +23,7 @@ using namespace std;
 #define LOG_FILES_DIR "logs"
 #define FILES_PREFIX "explorer-node"
 #define API_PORT_PARAMETER "api_port"
+#define WORKER_THREADS_PARAMETER "worker_threads"
 
 struct Options {
     std::string nodeDbFilename;
@@ -35,6 +36,7 @@ struct Options {
     static const unsigned logRotationPeriod = 3*60*60*1000; // 3 hours
     std::vector<uint32_t> whitelist;
     uint32_t logCleanupPeriod;
+    uint32_t workerThreads;
     ByteBuffer m_RichParser;
     bool m_RichParserChanged = false;
 };
@@ -66,7 +68,7 @@ int main(int argc, char* argv[]) {
         setup_node(node, options);
         explorer::IAdapter::Ptr adapter = explorer::create_adapter(node);
         node.Initialize();
-        explorer::Server server(*adapter, *reactor, options.explorerListenTo, options.accessControlFile, options.whitelist);
+        explorer::Server server(*adapter, *reactor, options.explorerListenTo, options.accessControlFile, options.whitelist, options.workerThreads);
         LOG_INFO() << "Node listens to " << options.nodeListenTo << ", explorer listens to " << options.explorerListenTo;
         reactor->run();
         LOG_INFO() << "Done";
@@ -92,6 +94,7 @@ bool parse_cmdline(int argc, char* argv[], Options& o) {
         (cli::NODE_PEER, po::value<string>()->default_value("eu-node03.masternet.beam.mw:8100"), "peer address")
         (cli::PORT_FULL, po::value<uint16_t>()->default_value(10000), "port to start the local node on")
         (API_PORT_PARAMETER, po::value<uint16_t>()->default_value(8888), "port to start the local api server on")
+        (WORKER_THREADS_PARAMETER, po::value<uint32_t>()->default_value(0), "number of threads serving the indexed data (blocks, lookups), 0 - everything on the node thread")
         (cli::KEY_OWNER, po::value<string>()->default_value(""), "owner viewer key")
         (cli::PASS, po::value<string>()->default_value(""), "password for owner key")
         (cli::IP_WHITELIST, po::value<std::string>()->default_value(""), "IP whitelist")
@@ -135,6 +138,7 @@ bool parse_cmdline(int argc, char* argv[], Options& o) {
         o.nodeConnectTo = vm[cli::NODE_PEER].as<string>();
         o.nodeListenTo.port(vm[cli::PORT].as<uint16_t>());
         o.explorerListenTo.port(vm[API_PORT_PARAMETER].as<uint16_t>());
+        o.workerThreads = vm[WORKER_THREADS_PARAMETER].as<uint32_t>();
 
         std::string keyOwner = vm[cli::KEY_OWNER].as<string>();
         if (!keyOwner.empty())
@@ -233,6 +237,9 @@ void setup_node(Node& node, const Options& o) {
     auto& address = node.m_Cfg.m_Connect.emplace_back();
     address.resolve(o.nodeConnectTo.c_str());
 
+    // the worker threads resolve block hashes via the node DB snapshots
+    node.m_Cfg.m_ProcessorParams.m_Wal = (o.workerThreads > 0);
+
     node.m_Cfg.m_ProcessorParams.m_RichInfoFlags = NodeProcessor::StartParams::RichInfo::On;
     if (o.m_RichParserChanged)
     {
@@ -0,0 +1,303 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "index.h"
+#include "sqlite/sqlite3.h"
+#include "utility/logger.h"
+#include <sstream>
+
+namespace beam { namespace explorer {
+
+namespace {
+
+const int INDEX_VERSION = 1;
+
+/// Resets the statement after use
+struct StatementGuard {
+    sqlite3_stmt* s;
+
+    explicit StatementGuard(sqlite3_stmt* s_) : s(s_) {}
+
+    ~StatementGuard() {
+        sqlite3_reset(s);
+        sqlite3_clear_bindings(s);
+    }
+};
+
+} //namespace
+
+BlockIndex::~BlockIndex() {
+    close();
+}
+
+void BlockIndex::open(const char* path, bool readOnly) {
+    close();
+
+    try {
+        int flags = SQLITE_OPEN_NOMUTEX | (readOnly ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE));
+        test_ret(sqlite3_open_v2(path, &_db, flags, nullptr));
+        sqlite3_busy_timeout(_db, 5000);
+
+        if (!readOnly) {
+            exec("PRAGMA journal_mode = WAL");
+            exec("PRAGMA synchronous = NORMAL");
+            exec("PRAGMA journal_size_limit=1048576");
+        }
+
+        int version = 0;
+        {
+            sqlite3_stmt* s = nullptr;
+            test_ret(sqlite3_prepare_v2(_db, "PRAGMA user_version", -1, &s, nullptr));
+            if (SQLITE_ROW == sqlite3_step(s)) {
+                version = sqlite3_column_int(s, 0);
+            }
+            sqlite3_finalize(s);
+        }
+
+        if (version != INDEX_VERSION) {
+            if (readOnly) {
+                throw std::runtime_error("explorer index not initialized");
+            }
+
+            // the index is derived from the node data, no migration, just rebuild it
+            if (version) {
+                LOG_INFO() << "Explorer index version " << version << " is outdated, rebuilding";
+            }
+            create();
+        }
+    } catch (...) {
+        close();
+        throw;
+    }
+}
+
+void BlockIndex::close() {
+    for (auto& s : _statements) {
+        if (s) {
+            sqlite3_finalize(s);
+            s = nullptr;
+        }
+    }
+
+    if (_db) {
+        sqlite3_close(_db);
+        _db = nullptr;
+    }
+}
+
+void BlockIndex::create() {
+    exec("DROP TABLE IF EXISTS Blocks");
+    exec("DROP TABLE IF EXISTS Kernels");
+    exec("DROP TABLE IF EXISTS Assets");
+    exec("DROP TABLE IF EXISTS Contracts");
+
+    exec("CREATE TABLE Blocks (Height INTEGER PRIMARY KEY, Hash BLOB NOT NULL, Body BLOB)");
+    exec("CREATE TABLE Kernels (ID BLOB NOT NULL, Height INTEGER NOT NULL)");
+    exec("CREATE INDEX IdxKernelsID ON Kernels(ID)");
+    exec("CREATE INDEX IdxKernelsHeight ON Kernels(Height)");
+    exec("CREATE TABLE Assets (Aid INTEGER NOT NULL, Height INTEGER NOT NULL, PRIMARY KEY(Aid, Height)) WITHOUT ROWID");
+    exec("CREATE INDEX IdxAssetsHeight ON Assets(Height)");
+    exec("CREATE TABLE Contracts (Cid BLOB NOT NULL, Height INTEGER NOT NULL, PRIMARY KEY(Cid, Height)) WITHOUT ROWID");
+    exec("CREATE INDEX IdxContractsHeight ON Contracts(Height)");
+
+    std::ostringstream os;
+    os << "PRAGMA user_version = " << INDEX_VERSION;
+    exec(os.str().c_str());
+}
+
+void BlockIndex::exec(const char* sql) {
+    test_ret(sqlite3_exec(_db, sql, nullptr, nullptr, nullptr));
+}
+
+void BlockIndex::test_ret(int ret) {
+    if (SQLITE_OK == ret) return;
+
+    std::ostringstream os;
+    os << "explorer index sqlite err " << ret << ", " << (_db ? sqlite3_errmsg(_db) : "");
+    throw std::runtime_error(os.str());
+}
+
+sqlite3_stmt* BlockIndex::get_statement(Query q, const char* sql) {
+    sqlite3_stmt*& s = _statements[static_cast<size_t>(q)];
+    if (!s) {
+        test_ret(sqlite3_prepare_v2(_db, sql, -1, &s, nullptr));
+    }
+    return s;
+}
+
+bool BlockIndex::step(sqlite3_stmt* s) {
+    int ret = sqlite3_step(s);
+    switch (ret) {
+    case SQLITE_ROW:
+        return true;
+    case SQLITE_DONE:
+        return false;
+    default:
+        test_ret(ret);
+        return false; // unreachable
+    }
+}
+
+void BlockIndex::exec_statement(Query q, const char* sql) {
+    sqlite3_stmt* s = get_statement(q, sql);
+    StatementGuard g(s);
+    step(s);
+}
+
+void BlockIndex::bind_blob(sqlite3_stmt* s, int col, const void* p, size_t n) {
+    test_ret(sqlite3_bind_blob(s, col, p, static_cast<int>(n), SQLITE_STATIC));
+}
+
+BlockIndex::Transaction::Transaction(BlockIndex& index) : _index(&index) {
+    _index->exec_statement(Query::Begin, "BEGIN");
+}
+
+BlockIndex::Transaction::~Transaction() {
+    if (_index) {
+        try {
+            _index->exec_statement(Query::Rollback, "ROLLBACK");
+        } catch (const std::exception& e) {
+            LOG_ERROR() << e.what();
+        }
+    }
+}
+
+void BlockIndex::Transaction::commit() {
+    _index->exec_statement(Query::Commit, "COMMIT");
+    _index = nullptr;
+}
+
+Height BlockIndex::get_height() {
+    sqlite3_stmt* s = get_statement(Query::Height, "SELECT MAX(Height) FROM Blocks");
+    StatementGuard g(s);
+    if (!step(s) || (SQLITE_NULL == sqlite3_column_type(s, 0))) return 0;
+    return static_cast<Height>(sqlite3_column_int64(s, 0));
+}
+
+bool BlockIndex::get_hash(Height h, Merkle::Hash& hash) {
+    sqlite3_stmt* s = get_statement(Query::Hash, "SELECT Hash FROM Blocks WHERE Height=?");
+    StatementGuard g(s);
+    sqlite3_bind_int64(s, 1, static_cast<sqlite3_int64>(h));
+    if (!step(s) || (sqlite3_column_bytes(s, 0) != static_cast<int>(hash.nBytes))) return false;
+
+    memcpy(hash.m_pData, sqlite3_column_blob(s, 0), hash.nBytes);
+    return true;
+}
+
+void BlockIndex::add_block(const Block::SystemState::ID& id, const Blob& body) {
+    sqlite3_stmt* s = get_statement(Query::BlockIns, "INSERT OR REPLACE INTO Blocks (Height, Hash, Body) VALUES(?,?,?)");
+    StatementGuard g(s);
+    sqlite3_bind_int64(s, 1, static_cast<sqlite3_int64>(id.m_Height));
+    bind_blob(s, 2, id.m_Hash.m_pData, id.m_Hash.nBytes);
+    if (body.n) {
+        bind_blob(s, 3, body.p, body.n);
+    }
+    step(s);
+}
+
+void BlockIndex::add_kernel(const Merkle::Hash& id, Height h) {
+    sqlite3_stmt* s = get_statement(Query::KernelIns, "INSERT INTO Kernels (ID, Height) VALUES(?,?)");
+    StatementGuard g(s);
+    bind_blob(s, 1, id.m_pData, id.nBytes);
+    sqlite3_bind_int64(s, 2, static_cast<sqlite3_int64>(h));
+    step(s);
+}
+
+void BlockIndex::add_asset(Asset::ID aid, Height h) {
+    sqlite3_stmt* s = get_statement(Query::AssetIns, "INSERT OR IGNORE INTO Assets (Aid, Height) VALUES(?,?)");
+    StatementGuard g(s);
+    sqlite3_bind_int64(s, 1, aid);
+    sqlite3_bind_int64(s, 2, static_cast<sqlite3_int64>(h));
+    step(s);
+}
+
+void BlockIndex::add_contract(const ECC::uintBig& cid, Height h) {
+    sqlite3_stmt* s = get_statement(Query::ContractIns, "INSERT OR IGNORE INTO Contracts (Cid, Height) VALUES(?,?)");
+    StatementGuard g(s);
+    bind_blob(s, 1, cid.m_pData, cid.nBytes);
+    sqlite3_bind_int64(s, 2, static_cast<sqlite3_int64>(h));
+    step(s);
+}
+
+void BlockIndex::rollback_to(Height h) {
+    struct {
+        Query q;
+        const char* sql;
+    } const pDel[] = {
+        { Query::BlockDel, "DELETE FROM Blocks WHERE Height>?" },
+        { Query::KernelDel, "DELETE FROM Kernels WHERE Height>?" },
+        { Query::AssetDel, "DELETE FROM Assets WHERE Height>?" },
+        { Query::ContractDel, "DELETE FROM Contracts WHERE Height>?" },
+    };
+
+    for (const auto& x : pDel) {
+        sqlite3_stmt* s = get_statement(x.q, x.sql);
+        StatementGuard g(s);
+        sqlite3_bind_int64(s, 1, static_cast<sqlite3_int64>(h));
+        step(s);
+    }
+}
+
+bool BlockIndex::get_block(Height h, io::SharedBuffer& body) {
+    sqlite3_stmt* s = get_statement(Query::BlockGet, "SELECT Body FROM Blocks WHERE Height=?");
+    StatementGuard g(s);
+    sqlite3_bind_int64(s, 1, static_cast<sqlite3_int64>(h));
+    if (!step(s)) return false;
+
+    int n = sqlite3_column_bytes(s, 0);
+    if (n <= 0) return false;
+
+    body.assign(sqlite3_column_blob(s, 0), n);
+    return true;
+}
+
+void BlockIndex::get_blocks(Height hMin, Height hMax, const std::function<void(Height, io::SharedBuffer&&)>& func) {
+    sqlite3_stmt* s = get_statement(Query::BlockRange, "SELECT Height, Body FROM Blocks WHERE Height>=? AND Height<=? AND Body IS NOT NULL ORDER BY Height DESC");
+    StatementGuard g(s);
+    sqlite3_bind_int64(s, 1, static_cast<sqlite3_int64>(hMin));
+    sqlite3_bind_int64(s, 2, static_cast<sqlite3_int64>(hMax));
+
+    while (step(s)) {
+        io::SharedBuffer body(sqlite3_column_blob(s, 1), sqlite3_column_bytes(s, 1));
+        func(static_cast<Height>(sqlite3_column_int64(s, 0)), std::move(body));
+    }
+}
+
+Height BlockIndex::find_kernel(const Blob& id) {
+    sqlite3_stmt* s = get_statement(Query::KernelFind, "SELECT Height FROM Kernels WHERE ID=? ORDER BY Height DESC LIMIT 1");
+    StatementGuard g(s);
+    bind_blob(s, 1, id.p, id.n);
+    if (!step(s)) return 0;
+    return static_cast<Height>(sqlite3_column_int64(s, 0));
+}
+
+void BlockIndex::get_asset_heights(Asset::ID aid, std::vector<Height>& res) {
+    sqlite3_stmt* s = get_statement(Query::AssetFind, "SELECT Height FROM Assets WHERE Aid=? ORDER BY Height");
+    StatementGuard g(s);
+    sqlite3_bind_int64(s, 1, aid);
+    while (step(s)) {
+        res.push_back(static_cast<Height>(sqlite3_column_int64(s, 0)));
+    }
+}
+
+void BlockIndex::get_contract_heights(const Blob& cid, std::vector<Height>& res) {
+    sqlite3_stmt* s = get_statement(Query::ContractFind, "SELECT Height FROM Contracts WHERE Cid=? ORDER BY Height");
+    StatementGuard g(s);
+    bind_blob(s, 1, cid.p, cid.n);
+    while (step(s)) {
+        res.push_back(static_cast<Height>(sqlite3_column_int64(s, 0)));
+    }
+}
+
+}} //namespaces
@@ -0,0 +1,117 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "core/block_crypt.h"
+#include "utility/io/buffer.h"
+#include <functional>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace beam { namespace explorer {
+
+/// Persistent explorer index, maintained incrementally along with the node.
+/// Keeps the pre-rendered block bodies (json) keyed by height, and the lookups by kernel, asset and contract.
+/// Every processed height has a row with the block hash, so that the index can be verified against the node after restart.
+/// The body may be missing (i.e. the block is below the node horizon).
+class BlockIndex {
+public:
+    BlockIndex() = default;
+    ~BlockIndex();
+
+    BlockIndex(const BlockIndex&) = delete;
+    BlockIndex& operator=(const BlockIndex&) = delete;
+
+    /// Opens or creates the index. If the format version doesn't match - the index is rebuilt from scratch.
+    /// The index is in WAL mode, so that read-only connections (from other threads) see consistent snapshots while it's being updated.
+    /// Read-only connection requires an existing index of the current version
+    void open(const char* path, bool readOnly = false);
+    void close();
+    bool is_open() const { return _db != nullptr; }
+
+    /// Highest processed height, 0 if empty
+    Height get_height();
+
+    /// Hash of the processed block at the given height
+    bool get_hash(Height h, Merkle::Hash& hash);
+
+    /// Groups the modifications in a single transaction. For a read-only connection - pins the snapshot for several queries
+    struct Transaction {
+        explicit Transaction(BlockIndex& index);
+        ~Transaction(); // rolls back unless committed
+        void commit();
+    private:
+        BlockIndex* _index;
+    };
+
+    /// Must be called for consecutive heights
+    void add_block(const Block::SystemState::ID& id, const Blob& body);
+    void add_kernel(const Merkle::Hash& id, Height h);
+    void add_asset(Asset::ID aid, Height h);
+    void add_contract(const ECC::uintBig& cid, Height h);
+
+    /// Removes everything above the given height
+    void rollback_to(Height h);
+
+    /// Returns false if the block isn't indexed or has no body. The body is copied once into the shared buffer.
+    bool get_block(Height h, io::SharedBuffer& body);
+
+    /// Enumerates the rendered bodies in the range, in descending order
+    void get_blocks(Height hMin, Height hMax, const std::function<void(Height, io::SharedBuffer&&)>& func);
+
+    /// Returns 0 if not found
+    Height find_kernel(const Blob& id);
+
+    void get_asset_heights(Asset::ID aid, std::vector<Height>& res);
+    void get_contract_heights(const Blob& cid, std::vector<Height>& res);
+
+private:
+    enum struct Query {
+        Begin,
+        Commit,
+        Rollback,
+        Height,
+        Hash,
+        BlockIns,
+        BlockGet,
+        BlockRange,
+        KernelIns,
+        KernelFind,
+        AssetIns,
+        AssetFind,
+        ContractIns,
+        ContractFind,
+        BlockDel,
+        KernelDel,
+        AssetDel,
+        ContractDel,
+
+        count
+    };
+
+    sqlite3* _db = nullptr;
+    sqlite3_stmt* _statements[static_cast<size_t>(Query::count)] = { };
+
+    void create();
+    void exec(const char* sql);
+    void test_ret(int ret);
+    sqlite3_stmt* get_statement(Query q, const char* sql);
+    bool step(sqlite3_stmt* s);
+    void exec_statement(Query q, const char* sql);
+    void bind_blob(sqlite3_stmt* s, int col, const void* p, size_t n);
+};
+
+}} //namespaces
@@ -29,6 +29,7 @@ static const uint64_t SERVER_RESTART_TIMER = 1;
 static const uint64_t ACL_REFRESH_TIMER = 2;
 static const unsigned SERVER_RESTART_INTERVAL = 1000;
 static const unsigned ACL_REFRESH_INTERVAL = 5555;
+static const size_t MAX_QUEUED_REQUESTS = 32; // per connection, while waiting for a worker
 
 enum Dirs {
       DIR_STATUS
@@ -41,12 +42,14 @@ enum Dirs {
 #endif  // BEAM_ATOMIC_SWAP_SUPPORT
     , DIR_CONTRACTS
     , DIR_CONTRACT_DETAILS
+    , DIR_ASSET_HISTORY
+    , DIR_CONTRACT_HISTORY
     // etc
 };
 
 } //namespace
 
-Server::Server(IAdapter& adapter, io::Reactor& reactor, io::Address bindAddress, const std::string& keysFileName, const std::vector<uint32_t>& whitelist) :
+Server::Server(IAdapter& adapter, io::Reactor& reactor, io::Address bindAddress, const std::string& keysFileName, const std::vector<uint32_t>& whitelist, uint32_t workerThreads) :
     _msgCreator(2000),
     _backend(adapter),
     _reactor(reactor),
@@ -57,6 +60,11 @@ Server::Server(IAdapter& adapter, io::Reactor& reactor, io::Address bindAddress,
 {
     _timers.set_timer(SERVER_RESTART_TIMER, 0, BIND_THIS_MEMFN(start_server));
     _timers.set_timer(ACL_REFRESH_TIMER, ACL_REFRESH_INTERVAL, BIND_THIS_MEMFN(refresh_acl));
+    start_workers(workerThreads);
+}
+
+Server::~Server() {
+    stop_workers();
 }
 
 void Server::start_server() {
@@ -118,8 +126,32 @@ bool Server::on_request(uint64_t id, const HttpMsgReader::Message& msg) {
         return false;
     }
 
-    const std::string& path = msg.msg->get_path();
+    const HttpConnection::Ptr& conn = it->second;
+
+    auto itP = _workers.pending.find(id);
+    if (itP != _workers.pending.end()) {
+        // the previous request is being processed, this one is answered after it
+        if (itP->second.size() < MAX_QUEUED_REQUESTS) {
+            itP->second.push_back(msg.msg->get_path());
+            return true;
+        }
+
+        LOG_DEBUG() << STS << "-peer " << io::Address::from_u64(id) << " : too many requests while busy";
+        conn->shutdown();
+        _connections.erase(it);
+        return false;
+    }
+
+    bool keepalive = handle_request(id, conn, msg.msg->get_path(), true);
 
+    if (!keepalive) {
+        conn->shutdown();
+        _connections.erase(it);
+    }
+    return keepalive;
+}
+
+bool Server::handle_request(uint64_t id, const HttpConnection::Ptr& conn, const std::string& path, bool allowOffload) {
     static const std::map<std::string_view, int> dirs {
           { "status", DIR_STATUS }
         , { "block", DIR_BLOCK }
@@ -131,10 +163,10 @@ bool Server::on_request(uint64_t id, const HttpMsgReader::Message& msg) {
 #endif  // BEAM_ATOMIC_SWAP_SUPPORT
         , { "contracts", DIR_CONTRACTS }
         , { "contract", DIR_CONTRACT_DETAILS }
+        , { "asset_history", DIR_ASSET_HISTORY }
+        , { "contract_history", DIR_CONTRACT_HISTORY }
     };
 
-    const HttpConnection::Ptr& conn = it->second;
-
     bool (Server::*func)(const HttpConnection::Ptr&) = 0;
 
     if (_currentUrl.parse(path, dirs)) {
@@ -165,6 +197,12 @@ bool Server::on_request(uint64_t id, const HttpMsgReader::Message& msg) {
             case DIR_CONTRACT_DETAILS:
                 func = &Server::send_contract_details;
                 break;
+            case DIR_ASSET_HISTORY:
+                func = &Server::send_asset_history;
+                break;
+            case DIR_CONTRACT_HISTORY:
+                func = &Server::send_contract_history;
+                break;
             default:
                 break;
         }
@@ -177,6 +215,8 @@ bool Server::on_request(uint64_t id, const HttpMsgReader::Message& msg) {
         bool validKey = _acl.check(conn->peer_address());
         if (!validKey) {
             send(conn, 403, "Forbidden");
+        } else if (allowOffload && offload_request(id, path)) {
+            keepalive = true; // the response is sent when the job is done
         } else {
             keepalive = (this->*func)(conn);
         }
@@ -184,13 +224,226 @@ bool Server::on_request(uint64_t id, const HttpMsgReader::Message& msg) {
         send(conn, 404, "Not Found");
     }
 
-    if (!keepalive) {
-        conn->shutdown();
-        _connections.erase(it);
-    }
     return keepalive;
 }
 
+void Server::start_workers(uint32_t nThreads) {
+    for (uint32_t i = 0; i < nThreads; i++) {
+        auto pReader = _backend.create_reader();
+        if (!pReader) {
+            LOG_WARNING() << STS << "explorer index unavailable, requests are handled on the node thread";
+            _workers.readers.clear();
+            return;
+        }
+        _workers.readers.push_back(std::move(pReader));
+    }
+
+    if (_workers.readers.empty()) return;
+
+    _workers.run = true;
+    _workers.evtDone = io::AsyncEvent::create(_reactor, BIND_THIS_MEMFN(on_jobs_done));
+
+    _workers.threads.resize(nThreads);
+    for (uint32_t i = 0; i < nThreads; i++) {
+        _workers.threads[i] = MyThread(&Server::run_worker, this, i);
+    }
+
+    LOG_INFO() << STS << nThreads << " worker threads";
+}
+
+void Server::stop_workers() {
+    if (_workers.threads.empty()) return;
+
+    {
+        std::unique_lock<std::mutex> scope(_workers.mutex);
+        _workers.run = false;
+        _workers.newJob.notify_all();
+    }
+
+    for (auto& t : _workers.threads) {
+        if (t.joinable()) t.join();
+    }
+
+    _workers.threads.clear();
+    _workers.readers.clear();
+    _workers.queIn.clear();
+    _workers.queOut.clear();
+    _workers.pending.clear();
+    _workers.evtDone.reset();
+}
+
+void Server::run_worker(uint32_t iThread) {
+    IAdapter::IReader& reader = *_workers.readers[iThread];
+
+    std::unique_lock<std::mutex> scope(_workers.mutex);
+    while (true) {
+        if (!_workers.run) break;
+
+        if (_workers.queIn.empty()) {
+            _workers.newJob.wait(scope);
+            continue;
+        }
+
+        Job::Ptr pJob = std::move(_workers.queIn.front());
+        _workers.queIn.pop_front();
+
+        scope.unlock();
+
+        try {
+            pJob->served = execute_job(reader, *pJob);
+        } catch (const std::exception& e) {
+            LOG_WARNING() << STS << e.what();
+            pJob->served = false;
+        }
+
+        if (!pJob->served) pJob->body.clear();
+
+        scope.lock();
+
+        _workers.queOut.push_back(std::move(pJob));
+        _workers.evtDone->post();
+    }
+}
+
+bool Server::execute_job(IAdapter::IReader& reader, Job& job) {
+    switch (job.dir) {
+        case DIR_BLOCK:
+            if (job.byHash) return reader.get_block_by_hash(job.body, job.id);
+            return job.byKernel ?
+                reader.get_block_by_kernel(job.body, job.id) :
+                reader.get_block(job.body, job.height);
+        case DIR_BLOCKS:
+            return reader.get_blocks(job.body, job.height, job.n);
+        case DIR_ASSET_HISTORY:
+            return reader.get_asset_history(job.body, job.height);
+        case DIR_CONTRACT_HISTORY:
+            return reader.get_contract_history(job.body, job.id);
+        case DIR_CONTRACTS:
+            return reader.get_contracts(job.body);
+        case DIR_CONTRACT_DETAILS:
+            return reader.get_contract_details(job.body, job.id);
+        default:
+            return false;
+    }
+}
+
+bool Server::offload_request(uint64_t id, const std::string& path) {
+    if (_workers.threads.empty()) return false;
+
+    auto pJob = std::make_unique<Job>();
+
+    // only what the index can answer. Malformed requests are rejected in place
+    switch (_currentUrl.dir) {
+        case DIR_BLOCK:
+            if (_currentUrl.has_arg("hash")) {
+                if (!_currentUrl.get_hex_arg("hash", pJob->id)) return false;
+                pJob->byHash = true;
+            } else if (_currentUrl.has_arg("kernel")) {
+                if (!_currentUrl.get_hex_arg("kernel", pJob->id)) return false;
+                pJob->byKernel = true;
+            } else {
+                pJob->height = _currentUrl.get_int_arg("height", 0);
+                if (pJob->height <= 0) return false;
+            }
+            break;
+        case DIR_BLOCKS:
+            pJob->height = _currentUrl.get_int_arg("height", 0);
+            pJob->n = _currentUrl.get_int_arg("n", 0);
+            if (pJob->height <= 0 || pJob->n < 0) return false;
+            break;
+        case DIR_ASSET_HISTORY:
+            pJob->height = _currentUrl.get_int_arg("id", 0);
+            if (pJob->height <= 0) return false;
+            break;
+        case DIR_CONTRACT_HISTORY:
+            if (!_currentUrl.has_arg("id") || !_currentUrl.get_hex_arg("id", pJob->id)) return false;
+            break;
+        case DIR_CONTRACTS:
+            pJob->final = true; // the shader calls stay off the reactor thread
+            break;
+        case DIR_CONTRACT_DETAILS:
+            if (!_currentUrl.has_arg("id") || !_currentUrl.get_hex_arg("id", pJob->id)) return false;
+            pJob->final = true;
+            break;
+        default:
+            return false;
+    }
+
+    pJob->connId = id;
+    pJob->path = path;
+    pJob->dir = _currentUrl.dir;
+
+    _workers.pending[id]; // the requests received meanwhile are queued here
+
+    std::unique_lock<std::mutex> scope(_workers.mutex);
+    _workers.queIn.push_back(std::move(pJob));
+    _workers.newJob.notify_one();
+
+    return true;
+}
+
+void Server::on_jobs_done() {
+    while (true) {
+        Job::Ptr pJob;
+        {
+            std::unique_lock<std::mutex> scope(_workers.mutex);
+            if (_workers.queOut.empty()) break;
+
+            pJob = std::move(_workers.queOut.front());
+            _workers.queOut.pop_front();
+        }
+
+        std::deque<std::string> queued;
+        auto itP = _workers.pending.find(pJob->connId);
+        if (itP != _workers.pending.end()) {
+            queued.swap(itP->second);
+            _workers.pending.erase(itP);
+        }
+
+        auto it = _connections.find(pJob->connId);
+        if (it == _connections.end()) continue; // disconnected meanwhile
+
+        const HttpConnection::Ptr& conn = it->second;
+        bool keepalive;
+
+        if (pJob->served) {
+            _body = std::move(pJob->body);
+            keepalive = send(conn, 200, "OK");
+        } else if (pJob->final) {
+            keepalive = send(conn, 500, "Internal error #2");
+        } else {
+            // not in the index (yet), handle it the usual way
+            keepalive = handle_request(pJob->connId, conn, pJob->path, false);
+        }
+
+        if (keepalive) {
+            keepalive = handle_queued(pJob->connId, conn, queued);
+        }
+
+        if (!keepalive) {
+            conn->shutdown();
+            _connections.erase(it);
+        }
+    }
+}
+
+bool Server::handle_queued(uint64_t id, const HttpConnection::Ptr& conn, std::deque<std::string>& queued) {
+    while (!queued.empty()) {
+        auto itP = _workers.pending.find(id);
+        if (itP != _workers.pending.end()) {
+            // offloaded again, the rest waits for it
+            itP->second = std::move(queued);
+            return true;
+        }
+
+        std::string path = std::move(queued.front());
+        queued.pop_front();
+
+        if (!handle_request(id, conn, path, true)) return false;
+    }
+    return true;
+}
+
 bool Server::send_status(const HttpConnection::Ptr& conn) {
     _body.clear();
     if (!_backend.get_status(_body)) {
@@ -281,6 +534,28 @@ bool Server::send_contract_details(const HttpConnection::Ptr& conn) {
     return send(conn, 200, "OK");
 }
 
+bool Server::send_asset_history(const HttpConnection::Ptr& conn) {
+    auto aid = _currentUrl.get_int_arg("id", 0);
+    if (aid <= 0) {
+        return send(conn, 400, "Bad request");
+    }
+    if (!_backend.get_asset_history(_body, aid)) {
+        return send(conn, 500, "Internal error #2");
+    }
+    return send(conn, 200, "OK");
+}
+
+bool Server::send_contract_history(const HttpConnection::Ptr& conn) {
+    ByteBuffer id;
+    if (!_currentUrl.has_arg("id") || !_currentUrl.get_hex_arg("id", id)) {
+        return send(conn, 400, "Bad request");
+    }
+    if (!_backend.get_contract_history(_body, id)) {
+        return send(conn, 500, "Internal error #2");
+    }
+    return send(conn, 200, "OK");
+}
+
 bool Server::send(const HttpConnection::Ptr& conn, int code, const char* message) {
     assert(conn);
 
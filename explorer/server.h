@@ -12,21 +12,28 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "adapter.h"
 #include "http/http_connection.h"
 #include "http/http_msg_creator.h"
 #include "utility/io/tcpserver.h"
 #include "utility/io/coarsetimer.h"
+#include "utility/io/asyncevent.h"
 #include "utility/helpers.h"
+#include "utility/thread.h"
 #include <string_view>
 #include <set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 namespace beam { namespace explorer {
 
-struct IAdapter;
-
 class Server {
 public:
-    Server(IAdapter& adapter, io::Reactor& reactor, io::Address bindAddress, const std::string& keysFileName, const std::vector<uint32_t>& whitelist);
+    /// If workerThreads is non-zero - the requests that can be answered from the explorer index are handled in worker threads,
+    /// and only the responses are written on the reactor thread. The contract requests (shader calls) are then handled by the workers only
+    Server(IAdapter& adapter, io::Reactor& reactor, io::Address bindAddress, const std::string& keysFileName, const std::vector<uint32_t>& whitelist, uint32_t workerThreads = 0);
+    ~Server();
 
 private:
     class IPAccessControl {
@@ -49,18 +56,62 @@ private:
     void on_stream_accepted(io::TcpStream::Ptr&& newStream, io::ErrorCode errorCode);
 
     bool on_request(uint64_t id, const HttpMsgReader::Message& msg);
+    bool handle_request(uint64_t id, const HttpConnection::Ptr& conn, const std::string& path, bool allowOffload);
     bool send_status(const HttpConnection::Ptr& conn);
     bool send_block(const HttpConnection::Ptr& conn);
     bool send_blocks(const HttpConnection::Ptr& conn);
     bool send_peers(const HttpConnection::Ptr& conn);
     bool send_contracts(const HttpConnection::Ptr& conn);
     bool send_contract_details(const HttpConnection::Ptr& conn);
+    bool send_asset_history(const HttpConnection::Ptr& conn);
+    bool send_contract_history(const HttpConnection::Ptr& conn);
 #ifdef BEAM_ATOMIC_SWAP_SUPPORT
     bool send_swap_offers(const HttpConnection::Ptr& conn);
     bool send_swap_totals(const HttpConnection::Ptr& conn);
 #endif  // BEAM_ATOMIC_SWAP_SUPPORT
     bool send(const HttpConnection::Ptr& conn, int code, const char* message);
 
+    /// Request handled by a worker thread
+    struct Job {
+        using Ptr = std::unique_ptr<Job>;
+
+        uint64_t connId = 0;
+        std::string path; // to handle it on the reactor thread if the worker can't
+        int dir = -1;
+        bool byHash = false;
+        bool byKernel = false;
+        int64_t height = 0;
+        int64_t n = 0;
+        ByteBuffer id;
+        bool final = false; // if not served - fails, not retried on the reactor thread
+
+        bool served = false;
+        io::SerializedMsg body;
+    };
+
+    struct Workers {
+        std::mutex mutex;
+        std::condition_variable newJob;
+        std::deque<Job::Ptr> queIn;
+        std::deque<Job::Ptr> queOut;
+        bool run = false;
+
+        std::vector<IAdapter::IReader::Ptr> readers; // per thread
+        std::vector<MyThread> threads;
+        io::AsyncEvent::Ptr evtDone;
+
+        // connections waiting for the response, with the requests received meanwhile (answered in order). Reactor thread only
+        std::map<uint64_t, std::deque<std::string>> pending;
+    };
+
+    void start_workers(uint32_t nThreads);
+    void stop_workers();
+    void run_worker(uint32_t iThread);
+    static bool execute_job(IAdapter::IReader& reader, Job& job);
+    bool offload_request(uint64_t id, const std::string& path);
+    void on_jobs_done();
+    bool handle_queued(uint64_t id, const HttpConnection::Ptr& conn, std::deque<std::string>& queued);
+
     HttpMsgCreator _msgCreator;
     IAdapter& _backend;
     io::Reactor& _reactor;
@@ -74,6 +125,7 @@ private:
     //AccessControl _acl;
     IPAccessControl _acl;
     std::vector<uint32_t> _whitelist;
+    Workers _workers;
 };
 
 }} //namespaces
@@ -0,0 +1,231 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "explorer/index.h"
+#include "utility/logger.h"
+#include <boost/filesystem.hpp>
+#include <stdio.h>
+
+using namespace beam;
+using namespace beam::explorer;
+
+static int g_TestsFailed = 0;
+
+#define verify_test(x) \
+do { \
+    if (!(x)) { \
+        printf("Test failed! Line=%u, Expression: %s\n", __LINE__, #x); \
+        g_TestsFailed++; \
+    } \
+} while (false)
+
+#define FILENAME "_explorer_index.db"
+
+namespace {
+
+Block::SystemState::ID make_id(Height h) {
+    Block::SystemState::ID id;
+    id.m_Height = h;
+    ECC::Hash::Processor() << "block" << h >> id.m_Hash;
+    return id;
+}
+
+Merkle::Hash make_kernel(Height h, uint32_t i) {
+    Merkle::Hash hv;
+    ECC::Hash::Processor() << "kernel" << h << i >> hv;
+    return hv;
+}
+
+std::string make_body(Height h) {
+    return "{\"height\":" + std::to_string(h) + "}";
+}
+
+bool has_body(Height h) {
+    return (h % 7) != 0; // simulate the blocks below the horizon
+}
+
+bool check_body(BlockIndex& index, Height h) {
+    io::SharedBuffer body;
+    if (!index.get_block(h, body)) return false;
+    std::string s = make_body(h);
+    return (body.size == s.size()) && !memcmp(body.data, s.data(), s.size());
+}
+
+void fill(BlockIndex& index, Height h0, Height h1) {
+    BlockIndex::Transaction t(index);
+
+    for (Height h = h0; h <= h1; h++) {
+        std::string s = make_body(h);
+        Blob body;
+        if (has_body(h)) {
+            body = Blob(s.data(), static_cast<uint32_t>(s.size()));
+        }
+        index.add_block(make_id(h), body);
+
+        for (uint32_t i = 0; i < 3; i++) {
+            index.add_kernel(make_kernel(h, i), h);
+        }
+
+        if (!(h % 10)) {
+            index.add_asset(1, h);
+        }
+        index.add_asset(static_cast<Asset::ID>(h), h);
+
+        ECC::uintBig cid;
+        cid = static_cast<uint32_t>(h % 3);
+        index.add_contract(cid, h);
+        index.add_contract(cid, h); // duplicates are ignored
+    }
+
+    t.commit();
+}
+
+void TestIndex() {
+    boost::filesystem::remove(FILENAME);
+
+    {
+        BlockIndex index;
+        index.open(FILENAME);
+        verify_test(index.is_open());
+        verify_test(!index.get_height());
+
+        fill(index, 1, 100);
+        verify_test(index.get_height() == 100);
+
+        for (Height h = 1; h <= 100; h++) {
+            verify_test(check_body(index, h) == has_body(h));
+
+            Merkle::Hash hv;
+            verify_test(index.get_hash(h, hv) && (hv == make_id(h).m_Hash));
+            verify_test(index.find_kernel(make_kernel(h, 2)) == h);
+        }
+        verify_test(!index.find_kernel(make_kernel(101, 0)));
+
+        std::vector<Height> v;
+        index.get_asset_heights(1, v);
+        verify_test(v.size() == 11);
+        verify_test(v.front() == 1 && v.back() == 100);
+
+        ECC::uintBig cid;
+        cid = 2U;
+        v.clear();
+        index.get_contract_heights(cid, v);
+        verify_test(v.size() == 33);
+        verify_test(v.front() == 2 && v.back() == 98);
+
+        // range, descending, without the missing bodies
+        Height hPrev = 61;
+        uint32_t nCount = 0;
+        index.get_blocks(40, 60, [&](Height h, io::SharedBuffer&& body) {
+            verify_test(h < hPrev && h >= 40);
+            verify_test(has_body(h));
+            verify_test(body.size == make_body(h).size());
+            hPrev = h;
+            nCount++;
+        });
+        verify_test(nCount == 18); // 42, 49, 56 are missing
+
+        // uncommitted transaction must have no effect
+        {
+            BlockIndex::Transaction t(index);
+            index.rollback_to(10);
+            verify_test(index.get_height() == 10);
+        }
+        verify_test(index.get_height() == 100);
+
+        {
+            BlockIndex::Transaction t(index);
+            index.rollback_to(50);
+            t.commit();
+        }
+        verify_test(index.get_height() == 50);
+        verify_test(!check_body(index, 51));
+        verify_test(!index.find_kernel(make_kernel(51, 0)));
+        verify_test(index.find_kernel(make_kernel(50, 0)) == 50);
+
+        v.clear();
+        index.get_asset_heights(1, v);
+        verify_test(v.size() == 6);
+        v.clear();
+        index.get_asset_heights(70, v);
+        verify_test(v.empty());
+    }
+
+    // persistence
+    {
+        BlockIndex index;
+        index.open(FILENAME);
+        verify_test(index.get_height() == 50);
+        verify_test(check_body(index, 50));
+
+        fill(index, 51, 60);
+        verify_test(index.get_height() == 60);
+        verify_test(index.find_kernel(make_kernel(55, 1)) == 55);
+
+        // read-only connection, as used by the explorer worker threads
+        BlockIndex reader;
+        reader.open(FILENAME, true);
+        verify_test(reader.get_height() == 60);
+
+        {
+            BlockIndex::Transaction tRead(reader); // snapshot
+            verify_test(reader.get_height() == 60);
+
+            fill(index, 61, 70);
+            verify_test(index.get_height() == 70);
+
+            verify_test(reader.get_height() == 60);
+            verify_test(!check_body(reader, 65));
+        }
+
+        verify_test(reader.get_height() == 70);
+        verify_test(check_body(reader, 65));
+        verify_test(reader.find_kernel(make_kernel(65, 0)) == 65);
+
+        // modifications are not allowed
+        bool bThrown = false;
+        try {
+            reader.rollback_to(0);
+        } catch (const std::exception&) {
+            bThrown = true;
+        }
+        verify_test(bThrown);
+        verify_test(index.get_height() == 70);
+    }
+
+    // read-only connection requires an existing index
+    {
+        BlockIndex reader;
+        bool bThrown = false;
+        try {
+            reader.open(FILENAME "_missing", true);
+        } catch (const std::exception&) {
+            bThrown = true;
+        }
+        verify_test(bThrown);
+        verify_test(!reader.is_open());
+    }
+
+    boost::filesystem::remove(FILENAME);
+}
+
+} // namespace
+
+int main() {
+    auto logger = Logger::create(LOG_LEVEL_WARNING, LOG_LEVEL_WARNING);
+
+    TestIndex();
+
+    return g_TestsFailed ? -1 : 0;
+}
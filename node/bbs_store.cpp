@@ -0,0 +1,444 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbs_store.h"
+#include "../utility/logger.h"
+#include <boost/filesystem.hpp>
+
+namespace beam {
+
+#pragma pack (push, 1)
+
+struct BbsStore::SegmentHdr
+{
+	uint64_t m_Stamp;
+	uint64_t m_Bucket;
+	uint32_t m_BucketWidth_s;
+	uint32_t m_Reserved;
+	uint64_t m_Used; // including this header
+};
+
+struct BbsStore::RecordHdr
+{
+	Key m_Key;
+	BbsChannel m_Channel;
+	Timestamp m_TimePosted;
+	uint32_t m_Nonce;
+	uint32_t m_Size;
+};
+
+#pragma pack (pop)
+
+namespace
+{
+	const uint32_t s_RecordAlign = 8;
+	const uint64_t s_SegmentMin = 0x10000;
+
+	uint64_t get_RecordSize(uint32_t nMsg, uint32_t nHdr)
+	{
+		uint64_t n = uint64_t(nHdr) + nMsg;
+		return (n + s_RecordAlign - 1) & ~uint64_t(s_RecordAlign - 1);
+	}
+
+#ifdef WIN32
+	boost::filesystem::path MakeFsPath(const std::string& s) { return boost::filesystem::path(Utf8toUtf16(s.c_str())); }
+#else // WIN32
+	boost::filesystem::path MakeFsPath(const std::string& s) { return boost::filesystem::path(s); }
+#endif // WIN32
+}
+
+bool BbsStore::Msg::Channel::operator < (const Channel& x) const
+{
+	if (m_Value < x.m_Value)
+		return true;
+	if (m_Value > x.m_Value)
+		return false;
+	return get_ParentObj().m_ID < x.get_ParentObj().m_ID;
+}
+
+BbsStore::BbsStore()
+{
+	ZeroObject(m_Totals);
+}
+
+void BbsStore::get_Path(std::string& sPath, uint64_t iBucket) const
+{
+	sPath = m_sDir;
+	sPath += '/';
+	sPath += std::to_string(iBucket);
+	sPath += ".bbs";
+}
+
+void BbsStore::Open(const char* szDir, uint64_t nStamp, uint32_t nBucketWidth_s)
+{
+	Close();
+
+	if (!nBucketWidth_s)
+		throw std::runtime_error("BBS bucket width not set");
+
+	m_sDir = szDir;
+	m_Stamp = nStamp;
+	m_BucketWidth_s = nBucketWidth_s;
+
+	try
+	{
+		boost::filesystem::path pathDir = MakeFsPath(m_sDir);
+		boost::filesystem::create_directories(pathDir);
+
+		std::vector<uint64_t> vBuckets;
+		for (boost::filesystem::directory_iterator itEnd, it{ pathDir }; itEnd != it; ++it)
+		{
+			const boost::filesystem::path& path = it->path();
+			if (path.extension() != ".bbs")
+				continue;
+
+			std::string sName = path.stem().string();
+			char* szEnd = nullptr;
+			uint64_t iBucket = strtoull(sName.c_str(), &szEnd, 10);
+
+			if (sName.empty() || *szEnd)
+				continue; // not ours
+
+			vBuckets.push_back(iBucket);
+		}
+
+		std::sort(vBuckets.begin(), vBuckets.end()); // IDs are assigned in order of buckets
+
+		for (uint64_t iBucket : vBuckets)
+		{
+			Bucket* pB = new Bucket;
+			pB->m_Index.m_Value = iBucket;
+			ZeroObject(pB->m_Totals);
+			m_Buckets.insert(pB->m_Index);
+
+			std::string sPath;
+			get_Path(sPath, iBucket);
+			pB->m_File.Open(sPath.c_str());
+
+			if (!LoadBucket(*pB))
+			{
+				LOG_INFO() << "BBS segment " << iBucket << " discarded";
+				DeleteBucket(*pB, true);
+			}
+		}
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+
+	LOG_INFO() << "BBS store: " << m_Totals.m_Count << " messages, " << m_Buckets.size() << " segments";
+}
+
+void BbsStore::Close()
+{
+	while (!m_Buckets.empty())
+		DeleteBucket(m_Buckets.begin()->get_ParentObj(), false);
+
+	assert(m_IDs.empty() && m_Keys.empty() && m_Channels.empty());
+
+	m_sDir.clear();
+	m_LastID = 0;
+	m_MaxTime = 0;
+	ZeroObject(m_Totals);
+}
+
+bool BbsStore::LoadBucket(Bucket& b)
+{
+	MappedFileRaw& f = b.m_File;
+	if (f.m_nMapping < sizeof(SegmentHdr))
+		return false;
+
+	const SegmentHdr& hdr = f.get_At<SegmentHdr>(0);
+	if ((hdr.m_Stamp != m_Stamp) ||
+		(hdr.m_Bucket != b.m_Index.m_Value) ||
+		(hdr.m_BucketWidth_s != m_BucketWidth_s) ||
+		(hdr.m_Used < sizeof(SegmentHdr)) ||
+		(hdr.m_Used > f.m_nMapping))
+		return false;
+
+	for (MappedFileRaw::Offset pos = sizeof(SegmentHdr); pos < hdr.m_Used; )
+	{
+		if (hdr.m_Used - pos < sizeof(RecordHdr))
+			return false;
+
+		const RecordHdr& rec = f.get_At<RecordHdr>(pos);
+		uint64_t nRecord = get_RecordSize(rec.m_Size, sizeof(RecordHdr));
+		if (hdr.m_Used - pos < nRecord)
+			return false;
+
+		if (Find(rec.m_Key))
+		{
+			LOG_WARNING() << "BBS duplicate msg skipped";
+		}
+		else
+		{
+			Msg* pMsg = new Msg;
+			pMsg->m_Key.m_Value = rec.m_Key;
+			pMsg->m_Channel.m_Value = rec.m_Channel;
+			pMsg->m_Time = rec.m_TimePosted;
+			pMsg->m_Size = rec.m_Size;
+			pMsg->m_Offset = pos;
+
+			InsertMsg(*pMsg, b);
+		}
+
+		pos += nRecord;
+	}
+
+	return true;
+}
+
+void BbsStore::InsertMsg(Msg& msg, Bucket& b)
+{
+	msg.m_ID.m_Value = ++m_LastID;
+	msg.m_pBucket = &b;
+
+	m_IDs.insert(msg.m_ID);
+	m_Keys.insert(msg.m_Key);
+	m_Channels.insert(msg.m_Channel);
+	b.m_lstMsgs.push_back(msg.m_Bucket);
+
+	b.m_Totals.m_Count++;
+	b.m_Totals.m_Size += msg.m_Size;
+	m_Totals.m_Count++;
+	m_Totals.m_Size += msg.m_Size;
+
+	std::setmax(m_MaxTime, msg.m_Time);
+}
+
+void BbsStore::DeleteBucket(Bucket& b, bool bEraseFile)
+{
+	while (!b.m_lstMsgs.empty())
+	{
+		Msg& msg = b.m_lstMsgs.front().get_ParentObj();
+		b.m_lstMsgs.pop_front();
+
+		m_IDs.erase(Msg::IDSet::s_iterator_to(msg.m_ID));
+		m_Keys.erase(Msg::KeySet::s_iterator_to(msg.m_Key));
+		m_Channels.erase(Msg::ChannelSet::s_iterator_to(msg.m_Channel));
+
+		delete &msg;
+	}
+
+	m_Totals.m_Count -= b.m_Totals.m_Count;
+	m_Totals.m_Size -= b.m_Totals.m_Size;
+
+	b.m_File.Close();
+
+	if (bEraseFile)
+	{
+		std::string sPath;
+		get_Path(sPath, b.m_Index.m_Value);
+		DeleteFile(sPath.c_str());
+	}
+
+	m_Buckets.erase(Bucket::Set::s_iterator_to(b.m_Index));
+	delete &b;
+}
+
+BbsStore::Bucket* BbsStore::CreateBucket(uint64_t iBucket)
+{
+	std::string sPath;
+	get_Path(sPath, iBucket);
+
+	std::unique_ptr<Bucket> pB(new Bucket);
+	pB->m_Index.m_Value = iBucket;
+	ZeroObject(pB->m_Totals);
+
+	MappedFileRaw& f = pB->m_File;
+	f.Open(sPath.c_str());
+	f.CloseMapping();
+	f.Resize(0); // if there was a file - it was discarded
+	f.Resize(s_SegmentMin);
+	f.OpenMapping();
+
+	SegmentHdr& hdr = f.get_At<SegmentHdr>(0);
+	hdr.m_Stamp = m_Stamp;
+	hdr.m_Bucket = iBucket;
+	hdr.m_BucketWidth_s = m_BucketWidth_s;
+	hdr.m_Reserved = 0;
+	hdr.m_Used = sizeof(SegmentHdr);
+
+	m_Buckets.insert(pB->m_Index);
+	return pB.release();
+}
+
+uint64_t BbsStore::Insert(const Data& d)
+{
+	if (!IsOpen())
+		throw std::runtime_error("BBS store not open");
+
+	assert(!Find(d.m_Key));
+
+	uint64_t iBucket = d.m_TimePosted / m_BucketWidth_s;
+
+	Bucket::Index key;
+	key.m_Value = iBucket;
+	Bucket::Set::iterator it = m_Buckets.find(key);
+
+	Bucket& b = (m_Buckets.end() == it) ? *CreateBucket(iBucket) : it->get_ParentObj();
+	MappedFileRaw& f = b.m_File;
+
+	uint64_t nUsed = f.get_At<SegmentHdr>(0).m_Used;
+	uint64_t nRecord = get_RecordSize(d.m_Message.n, sizeof(RecordHdr));
+
+	if (nUsed + nRecord > f.m_nMapping)
+	{
+		// grow exponentially
+		uint64_t nSize = std::max(nUsed + nRecord, f.m_nMapping * 2);
+
+		f.CloseMapping();
+		f.Resize(nSize);
+		f.OpenMapping();
+	}
+
+	RecordHdr& rec = f.get_At<RecordHdr>(nUsed);
+	rec.m_Key = d.m_Key;
+	rec.m_Channel = d.m_Channel;
+	rec.m_TimePosted = d.m_TimePosted;
+	rec.m_Nonce = d.m_Nonce;
+	rec.m_Size = d.m_Message.n;
+
+	if (d.m_Message.n)
+		memcpy(&rec + 1, d.m_Message.p, d.m_Message.n);
+
+	f.get_At<SegmentHdr>(0).m_Used = nUsed + nRecord; // commit
+
+	Msg* pMsg = new Msg;
+	pMsg->m_Key.m_Value = d.m_Key;
+	pMsg->m_Channel.m_Value = d.m_Channel;
+	pMsg->m_Time = d.m_TimePosted;
+	pMsg->m_Size = d.m_Message.n;
+	pMsg->m_Offset = nUsed;
+
+	InsertMsg(*pMsg, b);
+	return m_LastID;
+}
+
+const BbsStore::Msg* BbsStore::Find(const Key& key) const
+{
+	Msg::InKey k;
+	k.m_Value = key;
+
+	Msg::KeySet::const_iterator it = m_Keys.find(k);
+	return (m_Keys.end() == it) ? nullptr : &it->get_ParentObj();
+}
+
+void BbsStore::get_Data(const Msg& msg, Data& d) const
+{
+	const RecordHdr& rec = msg.m_pBucket->m_File.get_At<RecordHdr>(msg.m_Offset);
+
+	d.m_Key = rec.m_Key;
+	d.m_Channel = rec.m_Channel;
+	d.m_TimePosted = rec.m_TimePosted;
+	d.m_Nonce = rec.m_Nonce;
+	d.m_Message.p = &rec + 1;
+	d.m_Message.n = rec.m_Size;
+}
+
+const BbsStore::Msg* BbsStore::FindNext(uint64_t id) const
+{
+	Msg::ID key;
+	key.m_Value = id;
+
+	Msg::IDSet::const_iterator it = m_IDs.upper_bound(key);
+	return (m_IDs.end() == it) ? nullptr : &it->get_ParentObj();
+}
+
+const BbsStore::Msg* BbsStore::FindNext(BbsChannel ch, uint64_t id) const
+{
+	Msg key;
+	key.m_Channel.m_Value = ch;
+	key.m_ID.m_Value = id;
+
+	Msg::ChannelSet::const_iterator it = m_Channels.upper_bound(key.m_Channel);
+	if ((m_Channels.end() == it) || (it->m_Value != ch))
+		return nullptr;
+
+	return &it->get_ParentObj();
+}
+
+const BbsStore::Msg* BbsStore::get_Next(const Msg& msg, bool bChannel) const
+{
+	if (bChannel)
+	{
+		Msg::ChannelSet::const_iterator it = m_Channels.iterator_to(msg.m_Channel);
+		if ((m_Channels.end() == ++it) || (it->m_Value != msg.m_Channel.m_Value))
+			return nullptr;
+
+		return &it->get_ParentObj();
+	}
+
+	Msg::IDSet::const_iterator it = m_IDs.iterator_to(msg.m_ID);
+	return (m_IDs.end() == ++it) ? nullptr : &it->get_ParentObj();
+}
+
+uint64_t BbsStore::FindCursor(Timestamp t) const
+{
+	uint64_t idRes = m_LastID + 1;
+
+	for (Bucket::Set::const_iterator it = m_Buckets.begin(); m_Buckets.end() != it; ++it)
+	{
+		const Bucket& b = it->get_ParentObj();
+
+		uint64_t t0 = b.m_Index.m_Value * m_BucketWidth_s;
+		if (t0 + m_BucketWidth_s <= t)
+			continue; // all the messages are older
+
+		if (t0 >= t)
+		{
+			// all the messages are newer, the 1st one has the lowest ID
+			if (!b.m_lstMsgs.empty())
+				std::setmin(idRes, b.m_lstMsgs.front().get_ParentObj().m_ID.m_Value);
+			continue;
+		}
+
+		for (Msg::BucketList::const_iterator itMsg = b.m_lstMsgs.begin(); b.m_lstMsgs.end() != itMsg; ++itMsg)
+		{
+			const Msg& msg = itMsg->get_ParentObj();
+			if (msg.m_Time >= t)
+			{
+				std::setmin(idRes, msg.m_ID.m_Value);
+				break; // the rest have higher IDs
+			}
+		}
+	}
+
+	return idRes;
+}
+
+bool BbsStore::IsInLimits(const Totals& x, const Totals& lims)
+{
+	return
+		(x.m_Count <= lims.m_Count) &&
+		(x.m_Size <= lims.m_Size);
+}
+
+void BbsStore::Cleanup(Timestamp tsMin, const Totals& lims)
+{
+	while (!m_Buckets.empty())
+	{
+		Bucket& b = m_Buckets.begin()->get_ParentObj();
+
+		// erase if the newest message in the bucket is expired, or out of limits
+		if (IsInLimits(m_Totals, lims) && ((b.m_Index.m_Value + 1) * m_BucketWidth_s > tsMin))
+			break;
+
+		DeleteBucket(b, true);
+	}
+}
+
+} // namespace beam
@@ -0,0 +1,140 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "db.h"
+#include "../core/mapped_file.h"
+#include "../utility/containers.h"
+
+namespace beam {
+
+// BBS messages storage, independent of the node DB.
+// Messages are appended to segment files, each segment holds the messages posted within a fixed time interval (bucket).
+// Expired buckets are erased as a whole (the file is deleted). The indexes (by key, ID and channel) are kept in memory, the message bodies
+// are not: they are read directly from the mapped segments.
+// IDs are assigned sequentially, they are valid within the session only (reassigned when the store is re-opened).
+class BbsStore
+{
+public:
+	typedef NodeDB::WalkerBbs::Key Key;
+	typedef NodeDB::WalkerBbs::Data Data;
+	typedef NodeDB::BbsTotals Totals;
+
+	struct Bucket;
+
+	struct Msg
+	{
+		struct ID :public boost::intrusive::set_base_hook<> {
+			uint64_t m_Value;
+			bool operator < (const ID& x) const { return (m_Value < x.m_Value); }
+			IMPLEMENT_GET_PARENT_OBJ(Msg, m_ID)
+		} m_ID;
+
+		struct InKey :public boost::intrusive::set_base_hook<> {
+			Key m_Value;
+			bool operator < (const InKey& x) const { return (m_Value < x.m_Value); }
+			IMPLEMENT_GET_PARENT_OBJ(Msg, m_Key)
+		} m_Key;
+
+		struct Channel :public boost::intrusive::set_base_hook<> {
+			BbsChannel m_Value;
+			bool operator < (const Channel& x) const; // by channel, then by ID
+			IMPLEMENT_GET_PARENT_OBJ(Msg, m_Channel)
+		} m_Channel;
+
+		struct InBucket :public boost::intrusive::list_base_hook<> {
+			IMPLEMENT_GET_PARENT_OBJ(Msg, m_Bucket)
+		} m_Bucket; // in order of appearance (i.e. sorted by ID)
+
+		Bucket* m_pBucket;
+		MappedFileRaw::Offset m_Offset; // record position within the segment
+		Timestamp m_Time;
+		uint32_t m_Size;
+
+		typedef boost::intrusive::set<ID> IDSet;
+		typedef boost::intrusive::set<InKey> KeySet;
+		typedef boost::intrusive::set<Channel> ChannelSet;
+		typedef boost::intrusive::list<InBucket> BucketList;
+	};
+
+	struct Bucket
+	{
+		struct Index :public boost::intrusive::set_base_hook<> {
+			uint64_t m_Value; // time / width
+			bool operator < (const Index& x) const { return (m_Value < x.m_Value); }
+			IMPLEMENT_GET_PARENT_OBJ(Bucket, m_Index)
+		} m_Index;
+
+		MappedFileRaw m_File;
+		Msg::BucketList m_lstMsgs;
+		Totals m_Totals;
+
+		typedef boost::intrusive::set<Index> Set;
+	};
+
+	static const uint32_t s_IndexPerMsg = sizeof(Msg) + sizeof(void*) * 2; // RAM taken by the indexes per message, incl. the heap block overhead
+
+	BbsStore();
+	~BbsStore() { Close(); }
+
+	// segments with different stamp or bucket width (left from another DB, or different settings) are deleted
+	void Open(const char* szDir, uint64_t nStamp, uint32_t nBucketWidth_s);
+	void Close();
+	bool IsOpen() const { return !m_sDir.empty(); }
+
+	uint64_t Insert(const Data&); // must be unique (if not sure - first try to find it). Returns the ID
+	const Msg* Find(const Key&) const;
+	void get_Data(const Msg&, Data&) const; // the message body points into the mapped segment, valid until the next Insert/Cleanup
+
+	const Msg* FindNext(uint64_t id) const; // lowest ID above the specified
+	const Msg* FindNext(BbsChannel, uint64_t id) const; // same, within the channel
+	const Msg* get_Next(const Msg&, bool bChannel) const; // bChannel: stay within the same channel
+
+	uint64_t FindCursor(Timestamp) const; // lowest ID of the msg posted no earlier than the specified time. If none - returns the next ID to be assigned
+	uint64_t get_LastID() const { return m_LastID; }
+	Timestamp get_MaxTime() const { return m_MaxTime; }
+	const Totals& get_Totals() const { return m_Totals; }
+	uint32_t get_Buckets() const { return static_cast<uint32_t>(m_Buckets.size()); }
+
+	// Drops the buckets that expired completely, then the oldest ones until the totals are within the limits
+	void Cleanup(Timestamp tsMin, const Totals& lims);
+
+private:
+
+	std::string m_sDir;
+	uint64_t m_Stamp = 0;
+	uint32_t m_BucketWidth_s = 0;
+
+	uint64_t m_LastID = 0;
+	Timestamp m_MaxTime = 0;
+	Totals m_Totals;
+
+	Bucket::Set m_Buckets;
+	Msg::IDSet m_IDs;
+	Msg::KeySet m_Keys;
+	Msg::ChannelSet m_Channels;
+
+	struct SegmentHdr;
+	struct RecordHdr;
+
+	void get_Path(std::string&, uint64_t iBucket) const;
+	Bucket* CreateBucket(uint64_t iBucket);
+	bool LoadBucket(Bucket&);
+	void DeleteBucket(Bucket&, bool bEraseFile);
+	void InsertMsg(Msg&, Bucket&);
+	static bool IsInLimits(const Totals&, const Totals& lims);
+};
+
+} // namespace beam
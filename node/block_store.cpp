@@ -0,0 +1,499 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "block_store.h"
+#include "../utility/logger.h"
+#include <boost/filesystem.hpp>
+
+namespace beam {
+
+#pragma pack (push, 1)
+
+struct BlockStore::SegmentHdr
+{
+	uint64_t m_Stamp;
+	uint64_t m_Index;
+	uint64_t m_Used; // including this header
+};
+
+struct BlockStore::RecordHdr
+{
+	uint64_t m_Row;
+	Merkle::Hash m_Hash; // of the state
+	uint32_t m_SizeP;
+	uint32_t m_SizeE;
+	uint32_t m_Flags;
+	uint32_t m_Reserved;
+
+	static const uint32_t ErasedP = 1;
+	static const uint32_t ErasedE = 2;
+	static const uint32_t ErasedAll = ErasedP | ErasedE;
+
+	uint64_t get_Live(uint32_t nFlags) const
+	{
+		return
+			((ErasedP & nFlags) ? 0 : m_SizeP) +
+			((ErasedE & nFlags) ? 0 : m_SizeE);
+	}
+
+	static uint32_t get_FlagsEmpty(uint32_t nSizeP, uint32_t nSizeE)
+	{
+		// missing parts are considered erased
+		return
+			(nSizeP ? 0 : ErasedP) |
+			(nSizeE ? 0 : ErasedE);
+	}
+
+	static uint64_t get_RecordSize(uint64_t nData)
+	{
+		const uint32_t nAlign = 8;
+		uint64_t n = sizeof(RecordHdr) + nData;
+		return (n + nAlign - 1) & ~uint64_t(nAlign - 1);
+	}
+};
+
+#pragma pack (pop)
+
+namespace
+{
+#ifdef WIN32
+	boost::filesystem::path MakeFsPath(const std::string& s) { return boost::filesystem::path(Utf8toUtf16(s.c_str())); }
+#else // WIN32
+	boost::filesystem::path MakeFsPath(const std::string& s) { return boost::filesystem::path(s); }
+#endif // WIN32
+}
+
+BlockStore::Segment::~Segment()
+{
+	m_File.Close();
+
+	if (!m_sPathErase.empty())
+		DeleteFile(m_sPathErase.c_str());
+}
+
+void BlockStore::get_Path(std::string& sPath, uint64_t iSegment) const
+{
+	sPath = m_sDir;
+	sPath += '/';
+	sPath += std::to_string(iSegment);
+	sPath += ".blk";
+}
+
+void BlockStore::Open(const char* szDir, uint64_t nStamp)
+{
+	Close();
+
+	m_sDir = szDir;
+	m_Stamp = nStamp;
+
+	try
+	{
+		boost::filesystem::path pathDir = MakeFsPath(m_sDir);
+		boost::filesystem::create_directories(pathDir);
+
+		std::vector<uint64_t> vSegments;
+		for (boost::filesystem::directory_iterator itEnd, it{ pathDir }; itEnd != it; ++it)
+		{
+			const boost::filesystem::path& path = it->path();
+			if (path.extension() != ".blk")
+				continue;
+
+			std::string sName = path.stem().string();
+			char* szEnd = nullptr;
+			uint64_t iSegment = strtoull(sName.c_str(), &szEnd, 10);
+
+			if (sName.empty() || *szEnd || !iSegment)
+				continue; // not ours
+
+			vSegments.push_back(iSegment);
+		}
+
+		std::sort(vSegments.begin(), vSegments.end()); // the later record of the same row supersedes the earlier
+
+		for (uint64_t iSegment : vSegments)
+		{
+			Segment::Ptr pS = std::make_shared<Segment>();
+			pS->m_Index = iSegment;
+			m_Segments[iSegment] = pS;
+
+			std::string sPath;
+			get_Path(sPath, iSegment);
+			pS->m_File.Open(sPath.c_str());
+
+			if (!LoadSegment(*pS))
+			{
+				LOG_INFO() << "Block store segment " << iSegment << " discarded";
+				DeleteSegment(*pS, true);
+			}
+		}
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+
+	LOG_INFO() << "Block store: " << m_Totals.m_Records << " bodies, " << m_Segments.size() << " segments";
+}
+
+void BlockStore::Close()
+{
+	m_vErasures.clear(); // not committed
+
+	while (!m_Segments.empty())
+		DeleteSegment(*m_Segments.begin()->second, false);
+
+	assert(m_Rows.empty());
+
+	m_sDir.clear();
+	m_Totals = Totals();
+}
+
+bool BlockStore::LoadSegment(Segment& s)
+{
+	MappedFileRaw& f = s.m_File;
+	if (f.m_nMapping < sizeof(SegmentHdr))
+		return false;
+
+	const SegmentHdr& hdr = f.get_At<SegmentHdr>(0);
+	if ((hdr.m_Stamp != m_Stamp) ||
+		(hdr.m_Index != s.m_Index) ||
+		(hdr.m_Used < sizeof(SegmentHdr)) ||
+		(hdr.m_Used > f.m_nMapping))
+		return false;
+
+	// validate first, the records of a broken segment must not supersede anything
+	for (MappedFileRaw::Offset pos = sizeof(SegmentHdr); pos < hdr.m_Used; )
+	{
+		if (hdr.m_Used - pos < sizeof(RecordHdr))
+			return false;
+
+		const RecordHdr& rec = f.get_At<RecordHdr>(pos);
+		uint64_t nRecord = RecordHdr::get_RecordSize(uint64_t(rec.m_SizeP) + rec.m_SizeE);
+		if (hdr.m_Used - pos < nRecord)
+			return false;
+
+		pos += nRecord;
+	}
+
+	for (MappedFileRaw::Offset pos = sizeof(SegmentHdr); pos < hdr.m_Used; )
+	{
+		const RecordHdr& rec = f.get_At<RecordHdr>(pos);
+		uint64_t nRecord = RecordHdr::get_RecordSize(uint64_t(rec.m_SizeP) + rec.m_SizeE);
+
+		uint32_t nFlags = rec.m_Flags | RecordHdr::get_FlagsEmpty(rec.m_SizeP, rec.m_SizeE);
+		if ((RecordHdr::ErasedAll & nFlags) != RecordHdr::ErasedAll)
+		{
+			Record* pPrev = FindRecord(rec.m_Row);
+			if (pPrev)
+				DeleteRecord(*pPrev); // superseded
+
+			Record* pRec = new Record;
+			pRec->m_Offset = pos;
+			pRec->m_Flags = nFlags;
+			InsertRecord(*pRec, s, rec.m_Row);
+		}
+
+		pos += nRecord;
+	}
+
+	s.m_Flushed = hdr.m_Used;
+	return true;
+}
+
+void BlockStore::InsertRecord(Record& r, Segment& s, uint64_t row)
+{
+	r.m_Row.m_Value = row;
+	r.m_pSegment = &s;
+
+	m_Rows.insert(r.m_Row);
+	s.m_lstRecords.push_back(r.m_Segment);
+
+	uint64_t nLive = s.m_File.get_At<RecordHdr>(r.m_Offset).get_Live(r.m_Flags);
+	s.m_Live += nLive;
+	m_Totals.m_Live += nLive;
+	m_Totals.m_Records++;
+}
+
+void BlockStore::DeleteRecord(Record& r)
+{
+	Segment& s = *r.m_pSegment;
+
+	uint64_t nLive = s.m_File.get_At<RecordHdr>(r.m_Offset).get_Live(r.m_Flags);
+	assert(s.m_Live >= nLive);
+	s.m_Live -= nLive;
+	m_Totals.m_Live -= nLive;
+	m_Totals.m_Records--;
+
+	m_Rows.erase(Record::RowSet::s_iterator_to(r.m_Row));
+	s.m_lstRecords.erase(Record::SegmentList::s_iterator_to(r.m_Segment));
+
+	delete &r;
+}
+
+void BlockStore::DeleteSegment(Segment& s, bool bEraseFile)
+{
+	while (!s.m_lstRecords.empty())
+		DeleteRecord(s.m_lstRecords.front().get_ParentObj());
+
+	if (bEraseFile)
+		get_Path(s.m_sPathErase, s.m_Index); // deleted once the segment is released (there may be body references still)
+
+	m_Segments.erase(s.m_Index); // may be destroyed
+}
+
+BlockStore::Segment& BlockStore::CreateSegment(uint64_t nSize)
+{
+	uint64_t iSegment = m_Segments.empty() ? 1 : (m_Segments.rbegin()->first + 1);
+
+	std::string sPath;
+	get_Path(sPath, iSegment);
+
+	Segment::Ptr pS = std::make_shared<Segment>();
+	pS->m_Index = iSegment;
+
+	MappedFileRaw& f = pS->m_File;
+	f.Open(sPath.c_str());
+	f.CloseMapping();
+	f.Resize(0); // if there was a file - it was discarded
+	f.Resize(nSize); // preallocated, the mapping is never moved
+	f.OpenMapping();
+
+	SegmentHdr& hdr = f.get_At<SegmentHdr>(0);
+	hdr.m_Stamp = m_Stamp;
+	hdr.m_Index = iSegment;
+	hdr.m_Used = sizeof(SegmentHdr);
+
+	m_Segments[iSegment] = pS;
+	return *pS;
+}
+
+uint64_t BlockStore::get_Used() const
+{
+	uint64_t nUsed = 0;
+	for (auto it = m_Segments.begin(); m_Segments.end() != it; ++it)
+		nUsed += it->second->m_File.get_At<SegmentHdr>(0).m_Used;
+
+	return nUsed;
+}
+
+BlockStore::Record* BlockStore::FindRecord(uint64_t row) const
+{
+	Record::Row key;
+	key.m_Value = row;
+
+	Record::RowSet::const_iterator it = m_Rows.find(key);
+	return (m_Rows.end() == it) ? nullptr : &it->get_ParentObj();
+}
+
+BlockStore::Record& BlockStore::Append(uint64_t row, const Merkle::Hash& hv, const Blob& bodyP, const Blob& bodyE)
+{
+	uint64_t nRecord = RecordHdr::get_RecordSize(uint64_t(bodyP.n) + bodyE.n);
+
+	Segment* pS = m_Segments.empty() ? nullptr : m_Segments.rbegin()->second.get();
+	if (!pS || (pS->m_File.get_At<SegmentHdr>(0).m_Used + nRecord > pS->m_File.m_nMapping))
+		pS = &CreateSegment(std::max(m_SegmentSize, sizeof(SegmentHdr) + nRecord));
+
+	MappedFileRaw& f = pS->m_File;
+	uint64_t nUsed = f.get_At<SegmentHdr>(0).m_Used;
+
+	RecordHdr& rec = f.get_At<RecordHdr>(nUsed);
+	rec.m_Row = row;
+	rec.m_Hash = hv;
+	rec.m_SizeP = bodyP.n;
+	rec.m_SizeE = bodyE.n;
+	rec.m_Flags = 0;
+	rec.m_Reserved = 0;
+
+	uint8_t* pDst = reinterpret_cast<uint8_t*>(&rec + 1);
+	if (bodyP.n)
+		memcpy(pDst, bodyP.p, bodyP.n);
+	if (bodyE.n)
+		memcpy(pDst + bodyP.n, bodyE.p, bodyE.n);
+
+	f.get_At<SegmentHdr>(0).m_Used = nUsed + nRecord; // commit
+
+	Record* pRec = new Record;
+	pRec->m_Offset = nUsed;
+	pRec->m_Flags = RecordHdr::get_FlagsEmpty(bodyP.n, bodyE.n);
+	InsertRecord(*pRec, *pS, row);
+
+	return *pRec;
+}
+
+void BlockStore::Insert(uint64_t row, const Merkle::Hash& hv, const Blob& bodyP, const Blob& bodyE)
+{
+	if (!IsOpen())
+		throw std::runtime_error("block store not open");
+
+	std::unique_lock<std::mutex> scope(m_Mutex);
+
+	Record* pRec = FindRecord(row);
+	if (pRec)
+		Erase(*pRec, RecordHdr::ErasedAll);
+
+	if (bodyP.n || bodyE.n)
+		Append(row, hv, bodyP, bodyE);
+}
+
+bool BlockStore::Find(uint64_t row, const Merkle::Hash& hv, Body& body) const
+{
+	std::unique_lock<std::mutex> scope(m_Mutex); // the data is immutable once appended, only the index and flags need it
+
+	const Record* pRec = FindRecord(row);
+	if (!pRec)
+		return false;
+
+	const Segment& s = *pRec->m_pSegment;
+	const RecordHdr& rec = s.m_File.get_At<RecordHdr>(pRec->m_Offset);
+	if (rec.m_Hash != hv)
+		return false;
+
+	// the buffers only hold the segment, there's no allocated memory to point to
+	io::SharedMem guard(m_Segments.find(s.m_Index)->second, nullptr);
+	const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(&rec + 1);
+
+	if (RecordHdr::ErasedP & pRec->m_Flags)
+		body.m_Perishable.clear();
+	else
+		body.m_Perishable.assign(pSrc, rec.m_SizeP, guard);
+
+	if (RecordHdr::ErasedE & pRec->m_Flags)
+		body.m_Eternal.clear();
+	else
+		body.m_Eternal.assign(pSrc + rec.m_SizeP, rec.m_SizeE, std::move(guard));
+
+	return true;
+}
+
+void BlockStore::Erase(Record& r, uint32_t nFlags)
+{
+	nFlags &= ~r.m_Flags;
+	if (!nFlags)
+		return;
+
+	Segment& s = *r.m_pSegment;
+
+	Erasure& e = m_vErasures.emplace_back();
+	e.m_pSegment = m_Segments.find(s.m_Index)->second;
+	e.m_Offset = r.m_Offset;
+	e.m_Flags = nFlags;
+
+	const RecordHdr& rec = s.m_File.get_At<RecordHdr>(r.m_Offset);
+	uint64_t nLive0 = rec.get_Live(r.m_Flags);
+	r.m_Flags |= nFlags;
+	uint64_t nDelta = nLive0 - rec.get_Live(r.m_Flags);
+
+	s.m_Live -= nDelta;
+	m_Totals.m_Live -= nDelta;
+
+	if ((RecordHdr::ErasedAll & r.m_Flags) == RecordHdr::ErasedAll)
+		DeleteRecord(r);
+}
+
+void BlockStore::DelPerishable(uint64_t row)
+{
+	std::unique_lock<std::mutex> scope(m_Mutex);
+
+	Record* pRec = FindRecord(row);
+	if (pRec)
+		Erase(*pRec, RecordHdr::ErasedP);
+}
+
+void BlockStore::Delete(uint64_t row)
+{
+	std::unique_lock<std::mutex> scope(m_Mutex);
+
+	Record* pRec = FindRecord(row);
+	if (pRec)
+		Erase(*pRec, RecordHdr::ErasedAll);
+}
+
+void BlockStore::Flush()
+{
+	for (auto it = m_Segments.begin(); m_Segments.end() != it; ++it)
+	{
+		Segment& s = *it->second;
+		uint64_t nUsed = s.m_File.get_At<SegmentHdr>(0).m_Used;
+
+		if (s.m_Flushed < nUsed)
+		{
+			s.m_File.Flush(s.m_Flushed, nUsed);
+			// the header goes after the data it exposes. Once the segment grows past the 1st page it's not covered by the above range
+			s.m_File.Flush(0, sizeof(SegmentHdr));
+			s.m_Flushed = nUsed;
+		}
+	}
+}
+
+void BlockStore::OnCommitted()
+{
+	std::unique_lock<std::mutex> scope(m_Mutex); // segments are deleted, records are moved
+
+	// the flags must be on disk before the segments are deleted or compacted, otherwise the erased records may come back live
+	for (const Erasure& e : m_vErasures)
+	{
+		MappedFileRaw& f = e.m_pSegment->m_File;
+		f.get_At<RecordHdr>(e.m_Offset).m_Flags |= e.m_Flags;
+		f.Flush(e.m_Offset, e.m_Offset + sizeof(RecordHdr));
+	}
+
+	m_vErasures.clear();
+
+	if (m_Segments.empty())
+		return;
+
+	// reclaim the space. The tail segment is left as-is, it's still appended
+	uint64_t iTail = m_Segments.rbegin()->first;
+
+	for (auto it = m_Segments.begin(); it->first != iTail; )
+	{
+		Segment& s = *(it++)->second;
+
+		if (!s.m_Live)
+			DeleteSegment(s, true);
+		else
+		{
+			uint64_t nData = s.m_File.get_At<SegmentHdr>(0).m_Used - sizeof(SegmentHdr);
+			if (s.m_Live * 2 < nData)
+				Compact(s);
+		}
+	}
+}
+
+void BlockStore::Compact(Segment& s)
+{
+	// move the live records to the tail. They're read directly from the segment mapping, which is stable
+	while (!s.m_lstRecords.empty())
+	{
+		Record& r = s.m_lstRecords.front().get_ParentObj();
+		const RecordHdr& rec = s.m_File.get_At<RecordHdr>(r.m_Offset);
+		const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(&rec + 1);
+
+		Blob bodyP(nullptr, 0), bodyE(nullptr, 0);
+		if (!(RecordHdr::ErasedP & r.m_Flags))
+			bodyP = Blob(pSrc, rec.m_SizeP);
+		if (!(RecordHdr::ErasedE & r.m_Flags))
+			bodyE = Blob(pSrc + rec.m_SizeP, rec.m_SizeE);
+
+		uint64_t row = r.m_Row.m_Value;
+		DeleteRecord(r);
+		Append(row, rec.m_Hash, bodyP, bodyE);
+	}
+
+	Flush(); // the moved records (and the tail header that exposes them) must be on disk before the segment is erased
+	DeleteSegment(s, true);
+}
+
+} // namespace beam
@@ -0,0 +1,140 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../core/block_crypt.h"
+#include "../core/mapped_file.h"
+#include "../utility/io/buffer.h"
+#include <boost/intrusive/set.hpp>
+#include <boost/intrusive/list.hpp>
+#include <mutex>
+
+namespace beam {
+
+// Block bodies storage, aside of the node DB.
+// Bodies are appended to segment files of a fixed capacity. Segments are preallocated, hence the mapping never moves, and the bodies
+// are returned as shared buffers that reference the mapping directly (they keep the segment alive, even if it's erased meanwhile).
+// The index (by the state row) is kept in memory, it's rebuilt on open. The DB is the authority on which bodies exist, it only keeps
+// the marks for the bodies stored here.
+// The appended data must be flushed before the DB commit. Erasures are persisted only after it (so that a rollback of the DB transaction
+// won't reference the erased data). Segments without live data are deleted, the sparse ones are compacted (live records are moved to the tail).
+// Find may be called from other threads (DB read snapshots), the rest is for the owner thread only. Open/Close must not race with Find.
+class BlockStore
+{
+public:
+
+	struct Segment;
+
+	struct Record
+	{
+		struct Row :public boost::intrusive::set_base_hook<> {
+			uint64_t m_Value;
+			bool operator < (const Row& x) const { return (m_Value < x.m_Value); }
+			IMPLEMENT_GET_PARENT_OBJ(Record, m_Row)
+		} m_Row;
+
+		struct InSegment :public boost::intrusive::list_base_hook<> {
+			IMPLEMENT_GET_PARENT_OBJ(Record, m_Segment)
+		} m_Segment;
+
+		Segment* m_pSegment;
+		MappedFileRaw::Offset m_Offset; // record position within the segment
+		uint32_t m_Flags; // erased parts. Persisted on commit
+
+		typedef boost::intrusive::set<Row> RowSet;
+		typedef boost::intrusive::list<InSegment> SegmentList;
+	};
+
+	struct Segment
+	{
+		typedef std::shared_ptr<Segment> Ptr;
+
+		uint64_t m_Index;
+		MappedFileRaw m_File;
+		Record::SegmentList m_lstRecords;
+		uint64_t m_Live = 0;
+		uint64_t m_Flushed = 0; // the data up to this offset is written to disk
+		std::string m_sPathErase; // if set - the file is deleted when the segment is released
+
+		~Segment();
+	};
+
+	struct Body
+	{
+		io::SharedBuffer m_Perishable;
+		io::SharedBuffer m_Eternal;
+	};
+
+	struct Totals
+	{
+		uint64_t m_Records = 0;
+		uint64_t m_Live = 0; // size of the live body parts
+	};
+
+	uint64_t m_SegmentSize = 0x4000000; // 64MB. Bodies that don't fit get a dedicated segment
+
+	BlockStore() = default;
+	~BlockStore() { Close(); }
+
+	// segments with a different stamp (left from another DB) are deleted
+	void Open(const char* szDir, uint64_t nStamp);
+	void Close();
+	bool IsOpen() const { return !m_sDir.empty(); }
+
+	void Insert(uint64_t row, const Merkle::Hash&, const Blob& bodyP, const Blob& bodyE); // replaces the previous record of this row, if any
+	bool Find(uint64_t row, const Merkle::Hash&, Body&) const; // fails if there's no record, or it belongs to a different state
+	void DelPerishable(uint64_t row);
+	void Delete(uint64_t row);
+
+	void Flush(); // writes the appended data and the segment headers to disk. Call before the DB commit
+	void OnCommitted(); // persists (and flushes) the erasures, reclaims the space
+
+	const Totals& get_Totals() const { return m_Totals; }
+	uint32_t get_Segments() const { return static_cast<uint32_t>(m_Segments.size()); }
+	uint64_t get_Used() const; // total size of the segments data, including the erased records
+
+private:
+
+	std::string m_sDir;
+	uint64_t m_Stamp = 0;
+	Totals m_Totals;
+	mutable std::mutex m_Mutex; // index modifications vs Find. The owner thread reads w/o locking
+
+	std::map<uint64_t, Segment::Ptr> m_Segments;
+	Record::RowSet m_Rows;
+
+	struct Erasure {
+		Segment::Ptr m_pSegment;
+		MappedFileRaw::Offset m_Offset;
+		uint32_t m_Flags;
+	};
+	std::vector<Erasure> m_vErasures; // not persisted yet
+
+	struct SegmentHdr;
+	struct RecordHdr;
+
+	void get_Path(std::string&, uint64_t iSegment) const;
+	Segment& CreateSegment(uint64_t nSize);
+	bool LoadSegment(Segment&);
+	void DeleteSegment(Segment&, bool bEraseFile);
+	Record* FindRecord(uint64_t row) const;
+	Record& Append(uint64_t row, const Merkle::Hash&, const Blob& bodyP, const Blob& bodyE);
+	void InsertRecord(Record&, Segment&, uint64_t row);
+	void DeleteRecord(Record&);
+	void Erase(Record&, uint32_t nFlags);
+	void Compact(Segment&);
+};
+
+} // namespace beam
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "db.h"
+#include "block_store.h"
 #include <algorithm> // sort
 #include "../core/peer_manager.h"
 #include "../utility/logger.h"
@@ -151,6 +152,10 @@ void NodeDB::ThrowSqliteError(int ret)
 {
 	char sz[0x1000];
 	snprintf(sz, _countof(sz), "sqlite err %d, %s", ret, sqlite3_errmsg(m_pDb));
+
+	if (m_ReadOnly)
+		throw std::runtime_error(sz); // not a corruption, the main connection is not affected
+
 	ThrowError(sz);
 }
 
@@ -186,6 +191,8 @@ void NodeDB::Close()
         BEAM_VERIFY(SQLITE_OK == sqlite3_close(m_pDb));
 		m_pDb = NULL;
 	}
+
+	m_ReadOnly = false;
 }
 
 NodeDB::Recordset::Recordset()
@@ -349,13 +356,23 @@ const void* NodeDB::Recordset::get_BlobStrict(int col, uint32_t n)
 	return x.p;
 }
 
-void NodeDB::Open(const char* szPath)
+const uint64_t NodeDB::s_VersionTop = 30;
+
+void NodeDB::Open(const char* szPath, bool bWal /* = false */)
 {
 	TestRet(sqlite3_open_v2(szPath, &m_pDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_CREATE, NULL));
 	// Attempt to fix the "busy" error when PC goes to sleep and then awakes. Try the busy handler with non-zero timeout (maybe a single retry would be enough)
 	sqlite3_busy_timeout(m_pDb, 5000);
 
-	ExecTextOut("PRAGMA locking_mode = EXCLUSIVE");
+	if (bWal)
+		// readers don't block the writer and vice versa. Exclusive locking mode is incompatible with other connections
+		ExecTextOut("PRAGMA journal_mode = WAL");
+	else
+	{
+		ExecTextOut("PRAGMA locking_mode = EXCLUSIVE");
+		ExecTextOut("PRAGMA journal_mode = DELETE"); // in case it was previously opened in WAL mode
+	}
+
 	ExecTextOut("PRAGMA journal_size_limit=1048576"); // limit journal file, otherwise it may remain huge even after tx commit, until the app is closed
 
 	bool bCreate;
@@ -365,7 +382,7 @@ void NodeDB::Open(const char* szPath)
 		bCreate = !rs.Step();
 	}
 
-	const uint64_t nVersionTop = 30;
+	const uint64_t nVersionTop = s_VersionTop;
 
 
 	Transaction t(*this);
@@ -453,6 +470,96 @@ void NodeDB::Open(const char* szPath)
 	t.Commit();
 }
 
+void NodeDB::OpenReadOnly(const char* szPath)
+{
+	m_ReadOnly = true;
+
+	TestRet(sqlite3_open_v2(szPath, &m_pDb, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL));
+	sqlite3_busy_timeout(m_pDb, 5000);
+
+	if (ParamIntGetDef(ParamID::DbVer) != s_VersionTop)
+		throw std::runtime_error("NodeDB version mismatch");
+}
+
+NodeDB::ReadPool::Snapshot::Snapshot(ReadPool& pool)
+	:m_Pool(pool)
+	,m_pDB(pool.Acquire())
+{
+	m_pDB->ExecStep(Query::Begin, "BEGIN");
+
+	try {
+		m_pDB->get_Cursor(m_Cursor); // the 1st read fixes the snapshot
+	}
+	catch (...) {
+		m_pDB.reset(); // closing the connection ends the transaction
+		throw;
+	}
+}
+
+NodeDB::ReadPool::Snapshot::~Snapshot()
+{
+	try {
+		m_pDB->ExecStep(Query::Rollback, "ROLLBACK");
+	}
+	catch (const std::exception& e) {
+		LOG_WARNING() << "snapshot release: " << e.what();
+		m_pDB.reset(); // don't reuse
+	}
+
+	if (m_pDB)
+		m_Pool.Release(std::move(m_pDB));
+}
+
+void NodeDB::ReadPool::Open(const char* szPath, BlockStore* pBlocks)
+{
+	Close();
+
+	std::unique_lock<std::mutex> scope(m_Mutex);
+	m_sPath = szPath;
+	m_pBlocks = pBlocks;
+}
+
+void NodeDB::ReadPool::Close()
+{
+	std::unique_lock<std::mutex> scope(m_Mutex);
+	m_vIdle.clear();
+	m_sPath.clear();
+	m_pBlocks = nullptr;
+}
+
+std::unique_ptr<NodeDB> NodeDB::ReadPool::Acquire()
+{
+	std::unique_lock<std::mutex> scope(m_Mutex);
+	if (!m_vIdle.empty())
+	{
+		std::unique_ptr<NodeDB> pRes = std::move(m_vIdle.back());
+		m_vIdle.pop_back();
+		return pRes;
+	}
+
+	if (m_sPath.empty())
+		throw std::runtime_error("NodeDB read pool not open");
+
+	std::string sPath = m_sPath;
+	BlockStore* pBlocks = m_pBlocks;
+	scope.unlock(); // open w/o holding the lock
+
+	std::unique_ptr<NodeDB> pRes = std::make_unique<NodeDB>();
+	pRes->OpenReadOnly(sPath.c_str());
+	pRes->set_BlockStore(pBlocks, false);
+
+	scope.lock();
+	m_Created++;
+	return pRes;
+}
+
+void NodeDB::ReadPool::Release(std::unique_ptr<NodeDB>&& pDB)
+{
+	std::unique_lock<std::mutex> scope(m_Mutex);
+	if (!m_sPath.empty() && (m_vIdle.size() < m_MaxIdle))
+		m_vIdle.push_back(std::move(pDB));
+}
+
 void NodeDB::CheckIntegrity()
 {
 	std::string s = ExecTextOut("PRAGMA integrity_check");
@@ -1492,13 +1599,39 @@ TxoID NodeDB::FindStateByTxoID(StateID& sid, TxoID id0)
 	return id0;
 }
 
+void NodeDB::set_BlockStore(BlockStore* p, bool bAppend)
+{
+	m_pBlocks = p;
+	m_BlocksAppend = p && bAppend;
+}
+
 void NodeDB::SetStateBlock(uint64_t rowid, const Blob& bodyP, const Blob& bodyE, const PeerID& peer)
 {
 	Recordset rs(*this, Query::StateSetBlock, "UPDATE " TblStates " SET " TblStates_BodyP "=?," TblStates_BodyE "=?," TblStates_Peer "=? WHERE rowid=?");
-	if (bodyP.n)
-		rs.put(0, bodyP);
-	if (bodyE.n)
-		rs.put(1, bodyE);
+
+	if (m_BlocksAppend)
+	{
+		Merkle::Hash hv;
+		get_StateHash(rowid, hv);
+		m_pBlocks->Insert(rowid, hv, bodyP, bodyE);
+
+		// empty blob is the mark of the body part moved to the store
+		if (bodyP.n)
+			rs.put(0, Blob(nullptr, 0));
+		if (bodyE.n)
+			rs.put(1, Blob(nullptr, 0));
+	}
+	else
+	{
+		if (m_pBlocks)
+			m_pBlocks->Delete(rowid); // in case it was moved there previously
+
+		if (bodyP.n)
+			rs.put(0, bodyP);
+		if (bodyE.n)
+			rs.put(1, bodyE);
+	}
+
 	rs.put(2, peer);
 	rs.put(3, rowid);
 
@@ -1508,20 +1641,106 @@ void NodeDB::SetStateBlock(uint64_t rowid, const Blob& bodyP, const Blob& bodyE,
 
 void NodeDB::GetStateBlock(uint64_t rowid, ByteBuffer* pP, ByteBuffer* pE, ByteBuffer* pRB)
 {
-	Recordset rs(*this, Query::StateGetBlock, "SELECT " TblStates_BodyP "," TblStates_BodyE "," TblStates_Rollback " FROM " TblStates " WHERE rowid=?");
+	Recordset rs(*this, Query::StateGetBlock, "SELECT " TblStates_BodyP "," TblStates_BodyE "," TblStates_Rollback "," TblStates_Hash " FROM " TblStates " WHERE rowid=?");
 	rs.put(0, rowid);
 	rs.StepStrict();
 
-	if (pP && !rs.IsNull(0))
-		rs.get(0, *pP);
-	if (pE && !rs.IsNull(1))
-		rs.get(1, *pE);
+	ByteBuffer* ppOut[] = { pP, pE };
+	bool pStored[] = { false, false };
+	bool bStored = false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!ppOut[i] || rs.IsNull(i))
+			continue;
+
+		Blob body;
+		rs.get(i, body);
+		if (body.n)
+			body.Export(*ppOut[i]);
+		else
+			bStored = pStored[i] = true;
+	}
+
 	if (pRB && !rs.IsNull(2))
 		rs.get(2, *pRB);
+
+	if (bStored)
+	{
+		io::SharedBuffer pBuf[2];
+		FindStoredBlock(rowid, rs.get_As<Merkle::Hash>(3), pStored[0] ? pBuf : nullptr, pStored[1] ? pBuf + 1 : nullptr);
+
+		for (int i = 0; i < 2; i++)
+			if (pStored[i])
+				ppOut[i]->assign(pBuf[i].data, pBuf[i].data + pBuf[i].size);
+	}
+}
+
+void NodeDB::GetStateBlock(uint64_t rowid, io::SharedBuffer* pP, io::SharedBuffer* pE)
+{
+	Recordset rs(*this, Query::StateGetBlock, "SELECT " TblStates_BodyP "," TblStates_BodyE "," TblStates_Rollback "," TblStates_Hash " FROM " TblStates " WHERE rowid=?");
+	rs.put(0, rowid);
+	rs.StepStrict();
+
+	io::SharedBuffer* ppOut[] = { pP, pE };
+	bool bStored = false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!ppOut[i])
+			continue;
+
+		Blob body(nullptr, 0);
+		if (!rs.IsNull(i))
+		{
+			rs.get(i, body);
+			if (!body.n)
+			{
+				bStored = true;
+				continue;
+			}
+		}
+
+		ppOut[i]->assign(body.p, body.n); // the blob is valid only until the next step
+		ppOut[i] = nullptr;
+	}
+
+	if (bStored)
+		FindStoredBlock(rowid, rs.get_As<Merkle::Hash>(3), ppOut[0], ppOut[1]);
+}
+
+void NodeDB::FindStoredBlock(uint64_t rowid, const Merkle::Hash& hv, io::SharedBuffer* pP, io::SharedBuffer* pE)
+{
+	// read directly from the mapping
+	BlockStore::Body body;
+	if (!m_pBlocks || !m_pBlocks->Find(rowid, hv, body))
+	{
+		if (m_ReadOnly)
+		{
+			// A snapshot may outlive the record: the store is modified in-place, ahead of the DB commit. Report as not available
+			if (pP)
+				pP->clear();
+			if (pE)
+				pE->clear();
+			return;
+		}
+
+		if (!m_pBlocks)
+			ThrowError("block store not attached");
+		ThrowInconsistent();
+	}
+
+	if (pP)
+		*pP = std::move(body.m_Perishable);
+	if (pE)
+		*pE = std::move(body.m_Eternal);
 }
 
 void NodeDB::DelStateBlockPP(uint64_t rowid)
 {
+	if (m_pBlocks)
+		m_pBlocks->DelPerishable(rowid);
+
 	Recordset rs(*this, Query::StateDelBlockPP, "UPDATE " TblStates " SET " TblStates_BodyP "=NULL," TblStates_Peer "=NULL WHERE rowid=?");
 	rs.put(0, rowid);
 	rs.Step();
@@ -1530,6 +1749,9 @@ void NodeDB::DelStateBlockPP(uint64_t rowid)
 
 void NodeDB::DelStateBlockPPR(uint64_t rowid)
 {
+	if (m_pBlocks)
+		m_pBlocks->DelPerishable(rowid);
+
 	Recordset rs(*this, Query::StateDelBlockPPR, "UPDATE " TblStates " SET " TblStates_BodyP "=NULL," TblStates_Rollback "=NULL," TblStates_Peer "=NULL WHERE rowid=?");
 	rs.put(0, rowid);
 	rs.Step();
@@ -1538,6 +1760,9 @@ void NodeDB::DelStateBlockPPR(uint64_t rowid)
 
 void NodeDB::DelStateBlockAll(uint64_t rowid)
 {
+	if (m_pBlocks)
+		m_pBlocks->Delete(rowid);
+
 	Recordset rs(*this, Query::StateDelBlockAll, "UPDATE " TblStates
 		" SET " TblStates_BodyP "=NULL," TblStates_BodyE "=NULL," TblStates_Rollback "=NULL," TblStates_Peer "=NULL," TblStates_Extra "=NULL," TblStates_Txos "=NULL WHERE rowid=?");
 	rs.put(0, rowid);
@@ -1994,6 +2219,11 @@ void NodeDB::EnumBbsCSeq(WalkerBbs& x)
 	x.m_Rs.put(1, x.m_ID);
 }
 
+void NodeDB::EnumAllBbs(WalkerBbs& x)
+{
+	x.m_Rs.Reset(*this, Query::BbsEnumAllData, "SELECT " TblBbs_AllFieldsListed " FROM " TblBbs " ORDER BY " TblBbs_ID);
+}
+
 uint64_t NodeDB::get_AutoincrementID(const char* szTable)
 {
 	Recordset rs(*this, Query::AutoincrementID, "SELECT seq FROM sqlite_sequence WHERE name=?");
@@ -2056,6 +2286,12 @@ void NodeDB::BbsDel(uint64_t id)
 	TestChanged1Row();
 }
 
+void NodeDB::BbsDelAll()
+{
+	Recordset rs(*this, Query::BbsDelAll, "DELETE FROM " TblBbs);
+	rs.Step();
+}
+
 uint64_t NodeDB::BbsIns(const WalkerBbs::Data& d)
 {
 	Recordset rs(*this, Query::BbsIns, "INSERT INTO " TblBbs "(" TblBbs_InsFieldsListed ") VALUES(?,?,?,?,?)");
@@ -2325,6 +2561,10 @@ void NodeDB::StreamMmr::ShrinkTo(uint64_t nCount)
 void NodeDB::StreamMmr::ResizeTo(uint64_t nCount)
 {
 	m_DB.StreamResize(m_eType, get_TotalHashes(nCount, m_hStoreFrom) * sizeof(Merkle::Hash), get_TotalHashes(m_Count, m_hStoreFrom) * sizeof(Merkle::Hash));
+
+	if (nCount < m_Count)
+		m_Lru.DeleteFrom(nCount);
+
 	m_Count = nCount;
 }
 
@@ -2334,6 +2574,7 @@ void NodeDB::StreamMmr::LoadElement(Merkle::Hash& hv, const Merkle::Position& po
 		return;
 
 	m_DB.StreamIO(m_eType, Pos2Idx(pos, m_hStoreFrom) * sizeof(Merkle::Hash), hv.m_pData, hv.nBytes, false);
+	Cast::NotConst(this)->m_DbReads++;
 	Cast::NotConst(this)->CacheAdd(hv, pos);
 }
 
@@ -2362,7 +2603,7 @@ bool NodeDB::StreamMmr::CacheFind(Merkle::Hash& hv, const Merkle::Position& pos)
 		return true;
 	}
 
-	return false;
+	return Cast::NotConst(m_Lru).Find(hv, pos);
 }
 
 void NodeDB::StreamMmr::CacheAdd(const Merkle::Hash& hv, const Merkle::Position& pos)
@@ -2381,6 +2622,93 @@ void NodeDB::StreamMmr::CacheAdd(const Merkle::Hash& hv, const Merkle::Position&
 		ce.m_Value = hv;
 		ce.m_X = pos.X;
 	}
+
+	m_Lru.Set(hv, pos);
+}
+
+void NodeDB::StreamMmr::Lru::Delete(Entry& e)
+{
+	m_Keys.erase(KeySet::s_iterator_to(e.m_Key));
+	m_Mru.erase(MruList::s_iterator_to(e.m_Mru));
+	delete &e;
+}
+
+void NodeDB::StreamMmr::Lru::ShrinkTo(uint32_t n)
+{
+	while (m_Keys.size() > n)
+		Delete(m_Mru.back().get_ParentObj());
+}
+
+void NodeDB::StreamMmr::Lru::SetMax(uint32_t n)
+{
+	m_Max = n;
+	ShrinkTo(n);
+}
+
+bool NodeDB::StreamMmr::Lru::Find(Merkle::Hash& hv, const Merkle::Position& pos)
+{
+	if (m_Keys.empty())
+		return false;
+
+	Entry::Key key;
+	key.m_Pos = pos;
+
+	KeySet::iterator it = m_Keys.find(key);
+	if (m_Keys.end() == it)
+		return false;
+
+	Entry& e = it->get_ParentObj();
+	hv = e.m_Value;
+
+	m_Mru.erase(MruList::s_iterator_to(e.m_Mru));
+	m_Mru.push_front(e.m_Mru);
+	return true;
+}
+
+void NodeDB::StreamMmr::Lru::Set(const Merkle::Hash& hv, const Merkle::Position& pos)
+{
+	if (!m_Max)
+		return;
+
+	Entry::Key key;
+	key.m_Pos = pos;
+
+	KeySet::iterator it = m_Keys.find(key);
+	if (m_Keys.end() != it)
+	{
+		Entry& e = it->get_ParentObj();
+		e.m_Value = hv;
+
+		m_Mru.erase(MruList::s_iterator_to(e.m_Mru));
+		m_Mru.push_front(e.m_Mru);
+		return;
+	}
+
+	ShrinkTo(m_Max - 1);
+
+	Entry* pE = new Entry;
+	pE->m_Key.m_Pos = pos;
+	pE->m_Value = hv;
+
+	m_Keys.insert(pE->m_Key);
+	m_Mru.push_front(pE->m_Mru);
+}
+
+void NodeDB::StreamMmr::Lru::DeleteFrom(uint64_t nCount)
+{
+	// element (H, X) is present in the MMR iff it covers a complete range: (X+1) << H <= nCount
+	for (uint8_t h = 0; !m_Keys.empty() && (h < Merkle::Position::HMax); h++)
+	{
+		Entry::Key key0, key1;
+		key0.m_Pos.H = h;
+		key0.m_Pos.X = nCount >> h;
+		key1.m_Pos.H = h + 1;
+		key1.m_Pos.X = 0;
+
+		KeySet::iterator it1 = m_Keys.lower_bound(key1);
+		for (KeySet::iterator it = m_Keys.lower_bound(key0); it1 != it; )
+			Delete((it++)->get_ParentObj());
+	}
 }
 
 NodeDB::StatesMmr::StatesMmr(NodeDB& db)
@@ -2402,10 +2730,42 @@ void NodeDB::StatesMmr::LoadElement(Merkle::Hash& hv, const Merkle::Position& po
 		if (CacheFind(hv, pos))
 			return;
 
-		LoadStateHash(hv, pos.X + Rules::HeightGenesis);
+		if (m_StoreHashes)
+			m_DB.StreamIO(StreamType::StatesHashes, pos.X * sizeof(Merkle::Hash), hv.m_pData, hv.nBytes, false);
+		else
+			LoadStateHash(hv, pos.X + Rules::HeightGenesis);
+
+		Cast::NotConst(this)->m_DbReads++;
 		Cast::NotConst(this)->CacheAdd(hv, pos);
 	}
 }
+
+void NodeDB::StatesMmr::ResizeTo(uint64_t nCount)
+{
+	if (m_StoreHashes)
+		m_DB.StreamResize(StreamType::StatesHashes, nCount * sizeof(Merkle::Hash), m_Count * sizeof(Merkle::Hash));
+
+	StreamMmr::ResizeTo(nCount);
+}
+
+void NodeDB::StatesMmr::BuildHashes()
+{
+	m_DB.StreamsDelAll(StreamType::StatesHashes, StreamType::StatesHashes);
+	m_DB.StreamResize(StreamType::StatesHashes, m_Count * sizeof(Merkle::Hash), 0);
+
+	Merkle::Hash pBuf[0x400];
+	for (uint64_t i0 = 0; i0 < m_Count; )
+	{
+		uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(_countof(pBuf), m_Count - i0));
+		for (uint32_t i = 0; i < n; i++)
+			LoadStateHash(pBuf[i], i0 + i + Rules::HeightGenesis);
+
+		m_DB.StreamIO(StreamType::StatesHashes, i0 * sizeof(Merkle::Hash), pBuf[0].m_pData, sizeof(Merkle::Hash) * n, true);
+		i0 += n;
+	}
+
+	m_StoreHashes = true;
+}
 
 void NodeDB::StatesMmr::LoadStateHash(Merkle::Hash& hv, Height h) const
 {
@@ -2418,7 +2778,12 @@ void NodeDB::StatesMmr::SaveElement(const Merkle::Hash& hv, const Merkle::Positi
 	if (pos.H)
 		StreamMmr::SaveElement(hv, pos);
 	else
+	{
+		if (m_StoreHashes)
+			m_DB.StreamIO(StreamType::StatesHashes, pos.X * sizeof(Merkle::Hash), Cast::NotConst(hv.m_pData), hv.nBytes, true);
+
 		CacheAdd(hv, pos);
+	}
 }
 
 const uint32_t NodeDB::s_StreamBlob = 1024*1024; // arbitrary, but should not be changed after DB is created
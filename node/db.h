@@ -16,7 +16,11 @@
 
 #include "core/common.h"
 #include "core/block_crypt.h"
+#include "utility/io/buffer.h"
 #include "sqlite/sqlite3.h"
+#include <mutex>
+#include <boost/intrusive/set.hpp>
+#include <boost/intrusive/list.hpp>
 
 namespace beam {
 
@@ -28,6 +32,8 @@ public:
     {}
 };
 
+class BlockStore;
+
 class NodeDB
 {
 public:
@@ -63,6 +69,9 @@ public:
 			ForbiddenState,
 			Flags1, // used for 2-stage migration, where the 2nd stage is performed by the Processor
 			CacheState,
+			BbsStamp, // ties the BBS segments (stored separately) to this DB
+			StatesHashes, // set if the StatesHashes stream is maintained
+			BlocksStamp, // ties the block store segments (stored separately) to this DB
 		};
 	};
 
@@ -137,6 +146,7 @@ public:
 			BbsHistogram,
 			BbsEnumAllSeq,
 			BbsEnumAll,
+			BbsEnumAllData,
 			BbsFindRaw,
 			BbsFind,
 			BbsFindCursor,
@@ -144,6 +154,7 @@ public:
 			BbsIns,
 			BbsMaxTime,
 			BbsTotals,
+			BbsDelAll,
 			DummyIns,
 			DummyFindLowest,
 			DummyFind,
@@ -229,6 +240,7 @@ public:
 			ShieldedMmr,
 			AssetsMmr,
 			ShieldedState,
+			StatesHashes, // optional, hashes of the active states, by height
 
 			count
 		};
@@ -240,11 +252,13 @@ public:
 	virtual ~NodeDB();
 
 	void Close();
-	void Open(const char* szPath);
+	void Open(const char* szPath, bool bWal = false); // WAL mode: the DB is not locked exclusively, and can be read concurrently via ReadPool
+	void OpenReadOnly(const char* szPath); // the DB must already exist, no migration
 	bool IsOpen() const
 	{
 		return nullptr != m_pDb;
 	}
+	bool IsReadOnly() const { return m_ReadOnly; }
 
 	void Vacuum();
 	void CheckIntegrity();
@@ -353,10 +367,15 @@ public:
 
 	void SetStateBlock(uint64_t rowid, const Blob& bodyP, const Blob& bodyE, const PeerID&);
 	void GetStateBlock(uint64_t rowid, ByteBuffer* pP, ByteBuffer* pE, ByteBuffer* pRB);
+	void GetStateBlock(uint64_t rowid, io::SharedBuffer* pP, io::SharedBuffer* pE); // the parts in the BlockStore reference its mapping, no copy
 	void DelStateBlockPP(uint64_t rowid); // delete perishable, peer. Keep eternal, extra, txos, rollback
 	void DelStateBlockPPR(uint64_t rowid); // delete perishable, rollback, peer. Keep eternal, extra, txos
 	void DelStateBlockAll(uint64_t rowid); // delete perishable, peer, eternal, extra, txos, rollback
 
+	// The block bodies can be kept in the BlockStore, the DB keeps only the empty marks for them. Once attached, the bodies already moved
+	// there are read from it. New bodies are appended to it if bAppend is set
+	void set_BlockStore(BlockStore*, bool bAppend);
+
 	struct StateID {
 		uint64_t m_Row;
 		Height m_Height;
@@ -406,6 +425,45 @@ public:
 
 	bool get_Cursor(StateID& sid);
 
+	// Pool of read-only connections, for DB opened in WAL mode. Each connection has its own prepared statements.
+	// Connections are created on demand, and reused by consequent snapshots (up to m_MaxIdle are kept).
+	class ReadPool
+	{
+		std::string m_sPath;
+		BlockStore* m_pBlocks = nullptr;
+		std::mutex m_Mutex;
+		std::vector<std::unique_ptr<NodeDB> > m_vIdle;
+		uint32_t m_Created = 0;
+
+		std::unique_ptr<NodeDB> Acquire();
+		void Release(std::unique_ptr<NodeDB>&&);
+
+	public:
+		uint32_t m_MaxIdle = 4;
+
+		~ReadPool() { Close(); }
+
+		void Open(const char* szPath, BlockStore* pBlocks = nullptr); // the block store (if used) is attached to the connections, read-only
+		void Close(); // all the snapshots must be released
+		bool IsOpen() const { return !m_sPath.empty(); }
+
+		uint32_t get_Created() const { return m_Created; } // for tests
+
+		// Consistent read-only view of the DB, as of the last commit. Not affected by the consequent commits and rollbacks.
+		// Should be used by one thread at a time, and released asap: the WAL can't be checkpointed past the oldest live snapshot.
+		class Snapshot
+		{
+			ReadPool& m_Pool;
+			std::unique_ptr<NodeDB> m_pDB;
+		public:
+			Snapshot(ReadPool&);
+			~Snapshot();
+
+			StateID m_Cursor; // committed cursor, m_Row is 0 if there's none
+			NodeDB& get_DB() { return *m_pDB; }
+		};
+	};
+
 	void get_ChainWork(uint64_t, Difficulty::Raw&);
 
 	// the following functions move the curos, and mark the states with 'Active' flag
@@ -468,10 +526,12 @@ public:
 	};
 
 	void EnumBbsCSeq(WalkerBbs&); // set channel and ID before invocation
+	void EnumAllBbs(WalkerBbs&); // ordered by m_ID
 	uint64_t BbsIns(const WalkerBbs::Data&); // must be unique (if not sure - first try to find it). Returns the ID
 	bool BbsFind(WalkerBbs&); // set Key
 	uint64_t BbsFind(const WalkerBbs::Key&);
 	void BbsDel(uint64_t id);
+	void BbsDelAll();
 	uint64_t BbsFindCursor(Timestamp);
 	Timestamp get_BbsMaxTime();
 	uint64_t get_BbsLastID();
@@ -596,10 +656,58 @@ public:
 		NodeDB& m_DB;
 
 		StreamMmr(NodeDB&, StreamType::Enum, bool bStoreH0);
+		virtual ~StreamMmr() {}
 
 		void Append(const Merkle::Hash&);
 		void ShrinkTo(uint64_t nCount);
-		void ResizeTo(uint64_t nCount);
+		virtual void ResizeTo(uint64_t nCount);
+
+		// Bounded cache of the recently used elements (LRU), in addition to the small built-in one. Off by default.
+		class Lru
+		{
+			struct Entry
+			{
+				struct Key
+					:public boost::intrusive::set_base_hook<>
+				{
+					Merkle::Position m_Pos;
+					bool operator < (const Key& x) const {
+						return (m_Pos.H != x.m_Pos.H) ? (m_Pos.H < x.m_Pos.H) : (m_Pos.X < x.m_Pos.X);
+					}
+					IMPLEMENT_GET_PARENT_OBJ(Entry, m_Key)
+				} m_Key;
+
+				struct Mru
+					:public boost::intrusive::list_base_hook<>
+				{
+					IMPLEMENT_GET_PARENT_OBJ(Entry, m_Mru)
+				} m_Mru;
+
+				Merkle::Hash m_Value;
+			};
+
+			typedef boost::intrusive::set<Entry::Key> KeySet;
+			typedef boost::intrusive::list<Entry::Mru> MruList;
+
+			KeySet m_Keys;
+			MruList m_Mru;
+			uint32_t m_Max = 0;
+
+			void Delete(Entry&);
+			void ShrinkTo(uint32_t);
+
+		public:
+			~Lru() { ShrinkTo(0); }
+
+			void SetMax(uint32_t);
+			uint32_t get_Count() const { return static_cast<uint32_t>(m_Keys.size()); }
+
+			bool Find(Merkle::Hash&, const Merkle::Position&); // modifies MRU if found
+			void Set(const Merkle::Hash&, const Merkle::Position&);
+			void DeleteFrom(uint64_t nCount); // elements not present in the MMR of this size
+		} m_Lru;
+
+		uint64_t m_DbReads = 0; // elements that weren't cached
 
 	protected:
 		// Mmr
@@ -636,6 +744,12 @@ public:
 
 		void LoadStateHash(Merkle::Hash& hv, Height) const;
 
+		// The state hashes (MMR leaves) are also kept in the StatesHashes stream, instead of looking for the active state for each one
+		bool m_StoreHashes = false;
+		void BuildHashes(); // fill the stream for the current count
+
+		virtual void ResizeTo(uint64_t nCount) override;
+
 	protected:
 		// Mmr
 		virtual void LoadElement(Merkle::Hash& hv, const Merkle::Position& pos) const override;
@@ -753,6 +867,9 @@ public:
 private:
 
 	sqlite3* m_pDb;
+	bool m_ReadOnly = false;
+	BlockStore* m_pBlocks = nullptr;
+	bool m_BlocksAppend = false;
 
 	struct Statement
 	{
@@ -772,6 +889,8 @@ private:
 	static void ThrowError(const char*);
 	static void ThrowInconsistent();
 
+	void FindStoredBlock(uint64_t rowid, const Merkle::Hash&, io::SharedBuffer* pP, io::SharedBuffer* pE);
+
 	void Create();
 	void CreateTables20();
 	void CreateTables21();
@@ -802,6 +921,7 @@ private:
 	void MigrateFrom20();
 
 	static const uint32_t s_StreamBlob;
+	static const uint64_t s_VersionTop;
 
 	void StreamIO(StreamType::Enum, uint64_t pos, uint8_t*, uint64_t nCount, bool bWrite);
 	void StreamResize(StreamType::Enum, uint64_t n, uint64_t n0);
@@ -113,10 +113,11 @@ void Node::UpdateSyncStatusRaw()
 		if (bBlock)
 		{
 			assert(t.m_Key.first.m_Height);
-			// all the blocks up to this had been dloaded
 			std::setmax(hTotal, t.m_sidTrg.m_Height);
 			std::setmax(hDoneHdrs, t.m_sidTrg.m_Height);
-			std::setmax(hDoneBlocks, t.m_Key.first.m_Height - 1);
+
+			if (!t.m_bFollowUp) // all the blocks up to this had been dloaded
+				std::setmax(hDoneBlocks, t.m_Key.first.m_Height - 1);
 		}
 		else
 		{
@@ -170,6 +171,23 @@ void Node::UpdateSyncStatusRaw()
 	m_SyncStatus.m_Done = hDoneHdrs * SyncStatus::s_WeightHdr + hDoneBlocks * SyncStatus::s_WeightBlock;
 }
 
+Node::Task& Node::CreateTask(const Task::Key& key, const NodeDB::StateID& sidTrg)
+{
+	Task* pTask = new Task;
+	pTask->m_Key = key;
+	pTask->m_sidTrg = sidTrg;
+	pTask->m_bNeeded = true;
+	pTask->m_bFollowUp = false;
+	pTask->m_bHedged = false;
+	pTask->m_nCount = 0;
+	pTask->m_pOwner = NULL;
+
+	m_setTasks.insert(*pTask);
+	m_lstTasksUnassigned.push_back(*pTask);
+
+	return *pTask;
+}
+
 void Node::DeleteUnassignedTask(Task& t)
 {
     assert(!t.m_pOwner && !t.m_nCount);
@@ -371,23 +389,53 @@ bool Node::TryAssignTask(Task& t, Peer& p)
 	// assign
 	if (t.m_Key.second)
 	{
-		if (m_nTasksPackBody >= m_Cfg.m_MaxConcurrentBlocksRequest)
-			return false; // too many blocks requested
+		bool bPipelined = IsPipelined(t);
+		if (bPipelined)
+		{
+			if (nBlocks >= m_Cfg.m_SyncCtl.m_PacksPerPeer)
+				return false;
+		}
+		else
+		{
+			if (m_nTasksPackBody >= m_Cfg.m_MaxConcurrentBlocksRequest)
+				return false; // too many blocks requested
+		}
+
+		bool bFastSync = (t.m_Key.first.m_Height <= m_Processor.m_SyncData.m_Target.m_Height);
 
-		Height hCountExtra = t.m_sidTrg.m_Height - t.m_Key.first.m_Height;
+		NodeDB::StateID sidTop = bFastSync ? m_Processor.m_SyncData.m_Target : t.m_sidTrg;
+
+		if (bPipelined)
+		{
+			if (t.m_sidTrg.m_Height < sidTop.m_Height)
+				sidTop = t.m_sidTrg; // the segment was already trimmed
+
+			// request only the segment, sized wrt the peer throughput
+			Height hTop = t.m_Key.first.m_Height + p.m_Throughput.get_PackSize(m_Cfg.m_SyncCtl, m_Cfg.m_BandwidthCtl.m_MaxBodyPackCount) - 1;
+			if (hTop < sidTop.m_Height)
+			{
+				const uint64_t* pRows = m_Processor.FindCachedRows(t.m_sidTrg, t.m_sidTrg.m_Height - t.m_Key.first.m_Height);
+				if (pRows)
+				{
+					sidTop.m_Row = pRows[t.m_sidTrg.m_Height - hTop];
+					sidTop.m_Height = hTop;
+					t.m_sidTrg = sidTop;
+				}
+			}
+		}
 
 		proto::GetBodyPack msg;
+		msg.m_Top.m_Height = sidTop.m_Height;
+		msg.m_CountExtra = sidTop.m_Height - t.m_Key.first.m_Height;
 
-		if (t.m_Key.first.m_Height <= m_Processor.m_SyncData.m_Target.m_Height)
+		if (bFastSync)
 		{
 			// fast-sync mode, diluted blocks request.
-			msg.m_Top.m_Height = m_Processor.m_SyncData.m_Target.m_Height;
 			if (m_Processor.IsFastSync())
-				m_Processor.get_DB().get_StateHash(m_Processor.m_SyncData.m_Target.m_Row, msg.m_Top.m_Hash);
+				m_Processor.get_DB().get_StateHash(sidTop.m_Row, msg.m_Top.m_Hash);
 			else
 				msg.m_Top.m_Hash = Zero; // treasury
 
-			msg.m_CountExtra = m_Processor.m_SyncData.m_Target.m_Height - t.m_Key.first.m_Height;
 			msg.m_Height0 = m_Processor.m_SyncData.m_h0;
 			msg.m_HorizonLo1 = m_Processor.m_SyncData.m_TxoLo;
 			msg.m_HorizonHi1 = m_Processor.m_SyncData.m_Target.m_Height;
@@ -395,9 +443,7 @@ bool Node::TryAssignTask(Task& t, Peer& p)
 		else
 		{
 			// std blocks request
-			msg.m_Top.m_Height = t.m_sidTrg.m_Height;
-			m_Processor.get_DB().get_StateHash(t.m_sidTrg.m_Row, msg.m_Top.m_Hash);
-			msg.m_CountExtra = hCountExtra;
+			m_Processor.get_DB().get_StateHash(sidTop.m_Row, msg.m_Top.m_Hash);
 		}
 
 		p.Send(msg);
@@ -458,6 +504,122 @@ bool Node::TryAssignTask(Task& t, Peer& p)
     return true;
 }
 
+bool Node::IsPipelined(const Task& t) const
+{
+	return
+		t.m_Key.second &&
+		t.m_Key.first.m_Height && // not treasury
+		m_Cfg.m_SyncCtl.m_Window;
+}
+
+void Node::SchedulePipeline(Task& t0, const NodeDB::StateID& sidTrg)
+{
+	// While the segments are being downloaded, request the following ones from other peers (or pipeline to the same peer)
+	if (!IsPipelined(t0))
+		return;
+
+	Height hMax = m_Processor.m_Cursor.m_ID.m_Height + m_SyncStats.m_Window;
+	std::setmin(hMax, sidTrg.m_Height);
+
+	if (t0.m_Key.first.m_Height >= hMax)
+		return;
+
+	const uint64_t* pRows = m_Processor.FindCachedRows(sidTrg, sidTrg.m_Height - t0.m_Key.first.m_Height);
+	if (!pRows)
+		return;
+
+	NodeDB& db = m_Processor.get_DB();
+
+	for (Task* pT = &t0; pT->m_pOwner; )
+	{
+		Height h = pT->m_Key.first.m_Height + pT->m_nCount;
+
+		// skip the segments that were received out-of-order
+		for (; h <= hMax; h++)
+			if (!(NodeDB::StateFlags::Functional & db.GetStateFlags(pRows[sidTrg.m_Height - h])))
+				break;
+
+		if (h > hMax)
+			break;
+
+		Task tKey;
+		tKey.m_Key.second = true;
+
+		NodeDB::StateID sid;
+		sid.m_Height = h;
+		sid.m_Row = pRows[sidTrg.m_Height - h];
+		db.get_StateID(sid, tKey.m_Key.first);
+
+		TaskSet::iterator it = m_setTasks.find(tKey);
+		if (m_setTasks.end() == it)
+			pT = &CreateTask(tKey.m_Key, sidTrg);
+		else
+		{
+			pT = &(*it);
+			if (!pT->m_pOwner && (pT->m_sidTrg.m_Height < sidTrg.m_Height))
+				pT->m_sidTrg = sidTrg;
+		}
+
+		pT->m_bNeeded = true;
+		pT->m_bFollowUp = true;
+
+		if (!pT->m_pOwner)
+			TryAssignTask(*pT);
+	}
+}
+
+void Node::MaybeHedge(Peer& p)
+{
+	// The peer is idle. If some segment is late at a slower peer - request it from this one too, whoever is first.
+	if (!m_Cfg.m_SyncCtl.m_HedgeFactor || !p.m_Throughput.m_BlocksPerSec || !p.ShouldAssignTasks())
+		return;
+
+	for (TaskList::iterator it = p.m_lstTasks.begin(); p.m_lstTasks.end() != it; ++it)
+		if (it->m_Key.second)
+			return; // busy
+
+	PeerManager::TimePoint tp;
+
+	for (TaskSet::iterator it = m_setTasks.begin(); m_setTasks.end() != it; ++it)
+	{
+		Task& t = *it;
+		if (!IsPipelined(t) || !t.m_pOwner || t.m_bHedged || (&p == t.m_pOwner))
+			continue;
+
+		Peer& pOwner = *t.m_pOwner;
+		if (&t != &pOwner.m_lstTasks.front())
+			continue; // not served yet
+
+		const Peer::Throughput& tpOwner = pOwner.m_Throughput;
+		if (!tpOwner.m_BlocksPerSec || (tpOwner.m_BlocksPerSec >= p.m_Throughput.m_BlocksPerSec))
+			continue; // unknown peers are handled by the request timeout
+
+		uint32_t t0_ms = t.m_TimeAssigned_ms;
+		if (static_cast<int32_t>(tpOwner.m_LastDone_ms - t0_ms) > 0)
+			t0_ms = tpOwner.m_LastDone_ms; // was queued behind the previous one
+
+		uint32_t dt_ms = tp.get() - t0_ms;
+		if (dt_ms / m_Cfg.m_SyncCtl.m_HedgeFactor < tpOwner.get_Expected_ms(t.m_nCount))
+			continue;
+
+		// the tasks are sorted by height, this is the most urgent one
+		Task& t2 = CreateTask(t.m_Key, t.m_sidTrg);
+		t2.m_bFollowUp = t.m_bFollowUp;
+		t2.m_bHedged = true;
+
+		if (TryAssignTask(t2, p))
+		{
+			t.m_bHedged = true;
+			m_SyncStats.m_PacksHedged++;
+			LOG_INFO() << "Segment " << t.m_Key.first << " re-requested from " << p.m_RemoteAddr;
+		}
+		else
+			DeleteUnassignedTask(t2);
+
+		break;
+	}
+}
+
 void Node::Peer::SetTimerWrtFirstTask()
 {
 	if (m_lstTasks.empty())
@@ -486,28 +648,23 @@ void Node::Processor::RequestData(const Block::SystemState::ID& id, bool bBlock,
     tKey.m_Key.first = id;
     tKey.m_Key.second = bBlock;
 
+    Node::Task* pTask;
+
     TaskSet::iterator it = get_ParentObj().m_setTasks.find(tKey);
     if (get_ParentObj().m_setTasks.end() == it)
     {
         LOG_INFO() << "Requesting " << (bBlock ? "block" : "header") << " " << id;
 
-		Node::Task* pTask = new Node::Task;
-        pTask->m_Key = tKey.m_Key;
-        pTask->m_sidTrg = sidTrg;
-		pTask->m_bNeeded = true;
-        pTask->m_nCount = 0;
-        pTask->m_pOwner = NULL;
-
-        get_ParentObj().m_setTasks.insert(*pTask);
-        get_ParentObj().m_lstTasksUnassigned.push_back(*pTask);
-
+        pTask = &get_ParentObj().CreateTask(tKey.m_Key, sidTrg);
         get_ParentObj().TryAssignTask(*pTask);
 
 	}
 	else
 	{
-		Node::Task& t = *it;
+		pTask = &(*it);
+		Node::Task& t = *pTask;
 		t.m_bNeeded = true;
+		t.m_bFollowUp = false;
 
 		if (!t.m_pOwner)
 		{
@@ -517,6 +674,8 @@ void Node::Processor::RequestData(const Block::SystemState::ID& id, bool bBlock,
 			get_ParentObj().TryAssignTask(t);
 		}
 	}
+
+	get_ParentObj().SchedulePipeline(*pTask, sidTrg);
 }
 
 void Node::Processor::OnPeerInsane(const PeerID& peerID)
@@ -681,6 +840,19 @@ void Node::Processor::OnFastSyncSucceeded()
     }
 }
 
+static bool RenameFile(const std::string& sFrom, const std::string& sTo)
+{
+#ifdef WIN32
+	return
+		MoveFileExW(Utf8toUtf16(sFrom.c_str()).c_str(), Utf8toUtf16(sTo.c_str()).c_str(), MOVEFILE_REPLACE_EXISTING) ||
+		(GetLastError() == ERROR_FILE_NOT_FOUND);
+#else // WIN32
+	return
+		!rename(sFrom.c_str(), sTo.c_str()) ||
+		(ENOENT == errno);
+#endif // WIN32
+}
+
 void Node::MaybeGenerateRecovery()
 {
 	if (!m_PostStartSynced || m_Cfg.m_Recovery.m_sPathOutput.empty() || !m_Cfg.m_Recovery.m_Granularity)
@@ -691,8 +863,6 @@ void Node::MaybeGenerateRecovery()
 	if (h1 < h0 + m_Cfg.m_Recovery.m_Granularity)
 		return;
 
-	LOG_INFO() << "Generating recovery...";
-
 	std::ostringstream os;
 	os
 		<< m_Cfg.m_Recovery.m_sPathOutput
@@ -700,26 +870,23 @@ void Node::MaybeGenerateRecovery()
 
 	std::string sPath = os.str();
 
+	if (MaybeGenerateRecoveryDelta(sPath))
+		return;
+
+	LOG_INFO() << "Generating recovery...";
+
 	std::string sTmp = sPath;
 	sTmp += ".tmp";
 
-	bool bOk = GenerateRecoveryInfo(sTmp.c_str());
-	if (bOk)
-	{
-#ifdef WIN32
-		bOk =
-			MoveFileExW(Utf8toUtf16(sTmp.c_str()).c_str(), Utf8toUtf16(sPath.c_str()).c_str(), MOVEFILE_REPLACE_EXISTING) ||
-			(GetLastError() == ERROR_FILE_NOT_FOUND);
-#else // WIN32
-		bOk =
-			!rename(sTmp.c_str(), sPath.c_str()) ||
-			(ENOENT == errno);
-#endif // WIN32
-	}
+	bool bOk = GenerateRecoveryInfo(sTmp.c_str()) && RenameFile(sTmp, sPath);
 
 	if (bOk) {
 		LOG_INFO() << "Recovery generation done";
 		m_Processor.get_DB().ParamIntSet(NodeDB::ParamID::LastRecoveryHeight, h1);
+
+		m_RecoveryWriter.Reset();
+		m_RecoveryWriter.m_sBase = sPath;
+		m_RecoveryWriter.m_Tip = m_Processor.m_Cursor.m_ID;
 	} else
 	{
 		LOG_INFO() << "Recovery generation failed";
@@ -727,6 +894,214 @@ void Node::MaybeGenerateRecovery()
 	}
 }
 
+bool Node::MaybeGenerateRecoveryDelta(const std::string& sPath)
+{
+	RecoveryWriter& rw = m_RecoveryWriter;
+	if (!m_Cfg.m_Recovery.m_Deltas || rw.m_sBase.empty())
+		return false;
+
+	// the last one must be in the current chain
+	if ((rw.m_Tip.m_Height > m_Processor.m_Cursor.m_ID.m_Height) ||
+		(rw.m_Tip.m_Height != m_Processor.get_DB().ParamIntGetDef(NodeDB::ParamID::LastRecoveryHeight)))
+		return false;
+
+	Merkle::Hash hv;
+	m_Processor.get_DB().get_StateHash(m_Processor.FindActiveAtStrict(rw.m_Tip.m_Height), hv);
+	if (hv != rw.m_Tip.m_Hash)
+		return false;
+
+	auto pTask = std::make_unique<RecoveryWriter::Task>();
+	RecoveryWriter::Task& t = *pTask;
+
+	if (!PrepareRecoveryDelta(t, rw.m_Tip))
+		return false;
+
+	t.m_sPath = sPath + ".delta";
+
+	rw.m_vDeltas.push_back(t.m_sPath);
+	rw.m_Tip = m_Processor.m_Cursor.m_ID;
+
+	if (rw.m_vDeltas.size() >= m_Cfg.m_Recovery.m_Deltas)
+	{
+		t.m_sPathFull = sPath;
+		t.m_sBase.swap(rw.m_sBase);
+		t.m_vDeltas.swap(rw.m_vDeltas);
+
+		rw.m_sBase = sPath;
+	}
+
+	LOG_INFO() << "Recovery delta " << t.m_Prev << " -> " << rw.m_Tip << (t.m_sPathFull.empty() ? "" : ", full recovery is scheduled");
+
+	m_Processor.get_DB().ParamIntSet(NodeDB::ParamID::LastRecoveryHeight, rw.m_Tip.m_Height);
+	rw.Push(std::move(pTask));
+
+	return true;
+}
+
+bool Node::PrepareRecoveryDelta(RecoveryWriter::Task& t, const Block::SystemState::ID& idPrev)
+{
+	if (!GenerateRecoveryDelta(t.m_Body, idPrev.m_Height))
+		return false;
+
+	t.m_Cwp = m_Processor.m_Cwp;
+	t.m_Prev = idPrev;
+	return true;
+}
+
+bool Node::GenerateRecoveryDelta(const char* szPath, const Block::SystemState::ID& idPrev)
+{
+	RecoveryWriter::Task t;
+	if (!PrepareRecoveryDelta(t, idPrev))
+		return false;
+
+	t.m_sPath = szPath;
+	RecoveryWriter::Execute(t);
+	return t.m_Ok;
+}
+
+void Node::RecoveryWriter::Push(Task::Ptr&& pTask)
+{
+	if (!m_Thread.joinable())
+	{
+		m_Run = true;
+		m_pEvtDone = io::AsyncEvent::create(io::Reactor::get_Current(), [this]() { OnDone(); });
+		m_Thread = MyThread(&RecoveryWriter::RunThread, this, Rules::get());
+	}
+
+	std::unique_lock<std::mutex> scope(m_Mutex);
+	m_queIn.push_back(std::move(pTask));
+	m_NewTask.notify_one();
+}
+
+void Node::RecoveryWriter::Stop()
+{
+	if (!m_Thread.joinable())
+		return;
+
+	{
+		std::unique_lock<std::mutex> scope(m_Mutex);
+		m_Run = false;
+		m_NewTask.notify_one();
+	}
+
+	m_Thread.join();
+
+	OnDone();
+	m_pEvtDone.reset();
+}
+
+void Node::RecoveryWriter::RunThread(const Rules& r)
+{
+	Rules::Scope scopeRules(r);
+
+	std::unique_lock<std::mutex> scope(m_Mutex);
+	while (true)
+	{
+		if (m_queIn.empty())
+		{
+			if (!m_Run)
+				break; // all the pending files are written
+
+			m_NewTask.wait(scope);
+			continue;
+		}
+
+		Task::Ptr pTask = std::move(m_queIn.front());
+		m_queIn.pop_front();
+
+		scope.unlock();
+
+		Execute(*pTask);
+
+		scope.lock();
+
+		m_queOut.push_back(std::move(pTask));
+		m_pEvtDone->post();
+	}
+}
+
+void Node::RecoveryWriter::Execute(Task& t)
+{
+	std::string sTmp = t.m_sPath + ".tmp";
+
+	try
+	{
+		RecoveryInfo::Writer w;
+		w.OpenDelta(sTmp.c_str(), t.m_Cwp, t.m_Prev);
+		w.m_Stream.write(&t.m_Body.front(), t.m_Body.size());
+		w.m_Stream.Flush();
+	}
+	catch (const std::exception& ex)
+	{
+		LOG_ERROR() << ex.what();
+		beam::DeleteFile(sTmp.c_str());
+		return;
+	}
+
+	if (!RenameFile(sTmp, t.m_sPath))
+	{
+		beam::DeleteFile(sTmp.c_str());
+		return;
+	}
+
+	if (!t.m_sPathFull.empty())
+	{
+		sTmp = t.m_sPathFull + ".tmp";
+
+		try
+		{
+			RecoveryInfo::Merge(sTmp.c_str(), t.m_sBase.c_str(), t.m_vDeltas);
+		}
+		catch (const std::exception& ex)
+		{
+			LOG_ERROR() << ex.what();
+			beam::DeleteFile(sTmp.c_str());
+			return;
+		}
+
+		if (!RenameFile(sTmp, t.m_sPathFull))
+		{
+			beam::DeleteFile(sTmp.c_str());
+			return;
+		}
+
+		// superseded by the new full recovery (this delta is the last one of them). Note: without deltas the full files are never deleted
+		beam::DeleteFile(t.m_sBase.c_str());
+		for (const auto& sDelta : t.m_vDeltas)
+			beam::DeleteFile(sDelta.c_str());
+	}
+
+	t.m_Ok = true;
+}
+
+void Node::RecoveryWriter::OnDone()
+{
+	while (true)
+	{
+		Task::Ptr pTask;
+		{
+			std::unique_lock<std::mutex> scope(m_Mutex);
+			if (m_queOut.empty())
+				break;
+
+			pTask = std::move(m_queOut.front());
+			m_queOut.pop_front();
+		}
+
+		if (pTask->m_Ok)
+		{
+			if (!pTask->m_sPathFull.empty())
+				LOG_INFO() << "Recovery generation done";
+		}
+		else
+		{
+			// the chain is broken, the next one will be full
+			LOG_INFO() << "Recovery generation failed";
+			Reset();
+		}
+	}
+}
+
 void Node::Processor::OnRolledBack()
 {
     LOG_INFO() << "Rolled back to: " << m_Cursor.m_ID;
@@ -939,6 +1314,7 @@ void Node::Initialize(IExternalPOW* externalPOW)
         m_Cfg.m_VerificationThreads = m_Processor.m_ExecutorMT.get_Threads();
 
     m_Processor.m_ExecutorMT.set_Threads(std::max<uint32_t>(m_Cfg.m_VerificationThreads, 1U));
+    m_Processor.m_ExecutorMT.set_WorkStealing(m_Cfg.m_VerificationWorkStealing);
 
     m_Processor.m_Horizon = m_Cfg.m_Horizon;
     m_Processor.Initialize(m_Cfg.m_sPathLocal.c_str(), m_Cfg.m_ProcessorParams);
@@ -978,9 +1354,10 @@ void Node::Initialize(IExternalPOW* externalPOW)
 
     m_PeerMan.Initialize();
     m_Miner.Initialize(externalPOW);
-	m_Processor.get_DB().get_BbsTotals(m_Bbs.m_Totals);
-    m_Bbs.Cleanup();
-	m_Bbs.m_HighestPosted_s = m_Processor.get_DB().get_BbsMaxTime();
+    m_TxValidator.Initialize();
+	m_Bbs.Open();
+	m_SyncStats.Start();
+	m_BodyCompressionStats.Start();
 }
 
 uint32_t Node::get_AcessiblePeerCount() const
@@ -1097,31 +1474,95 @@ void Node::RefreshOwnedUtxos()
     }
 }
 
+void Node::Bbs::Open()
+{
+	const Config::Bbs& cfg = get_ParentObj().m_Cfg.m_Bbs;
+	if (!cfg.IsEnabled())
+		return;
+
+	NodeDB& db = get_ParentObj().m_Processor.get_DB();
+
+	uint64_t nStamp = db.ParamIntGetDef(NodeDB::ParamID::BbsStamp);
+	bool bMigrate = !nStamp; // new DB, or the messages were kept in it
+
+	if (bMigrate)
+	{
+		const ECC::uintBig& hv = get_ParentObj().NextNonce();
+		static_assert(sizeof(nStamp) <= sizeof(hv), "");
+		memcpy(&nStamp, hv.m_pData, sizeof(nStamp));
+		std::setmax(nStamp, 1U);
+	}
+
+	std::string sPath = cfg.m_sPath;
+	if (sPath.empty())
+		NodeProcessor::get_MappingPath(sPath, get_ParentObj().m_Cfg.m_sPathLocal.c_str(), "-bbs");
+
+	m_Store.Open(sPath.c_str(), nStamp, cfg.m_BucketWidth_s);
+
+	if (bMigrate)
+	{
+		// Move the messages to the store. The stamp is saved in the same DB transaction the table is emptied, if interrupted - the segments
+		// would be discarded on the next start (stamp mismatch), and the migration repeated.
+		Timestamp tsMin = getTimestamp() - cfg.m_MessageTimeout_s;
+		uint32_t nMigrated = 0;
+
+		NodeDB::WalkerBbs wlk;
+		for (db.EnumAllBbs(wlk); wlk.MoveNext(); )
+		{
+			if ((wlk.m_Data.m_TimePosted < tsMin) || m_Store.Find(wlk.m_Data.m_Key))
+				continue;
+
+			m_Store.Insert(wlk.m_Data);
+			nMigrated++;
+		}
+
+		if (nMigrated)
+			LOG_INFO() << "Bbs msgs moved from the DB: " << nMigrated;
+
+		db.BbsDelAll();
+		db.ParamIntSet(NodeDB::ParamID::BbsStamp, nStamp);
+	}
+
+	NodeDB::BbsTotals lims;
+	get_Limits(lims);
+	if (lims.m_Count < cfg.m_Limit.m_Count)
+		LOG_INFO() << "Bbs msgs count limited by the index size: " << lims.m_Count;
+
+	Cleanup();
+	m_HighestPosted_s = m_Store.get_MaxTime();
+}
+
+void Node::Bbs::get_Limits(NodeDB::BbsTotals& lims) const
+{
+	const Config::Bbs& cfg = get_ParentObj().m_Cfg.m_Bbs;
+	lims = cfg.m_Limit;
+
+	if (cfg.m_MaxIndexSize)
+	{
+		uint64_t nCount = cfg.m_MaxIndexSize / BbsStore::s_IndexPerMsg;
+		if (lims.m_Count > nCount)
+			lims.m_Count = static_cast<uint32_t>(nCount);
+	}
+}
+
 bool Node::Bbs::IsInLimits() const
 {
-	const NodeDB::BbsTotals& lims = get_ParentObj().m_Cfg.m_Bbs.m_Limit;
+	NodeDB::BbsTotals lims;
+	get_Limits(lims);
+	const NodeDB::BbsTotals& x = m_Store.get_Totals();
 
 	return
-		(m_Totals.m_Count <= lims.m_Count) &&
-		(m_Totals.m_Size <= lims.m_Size);
+		(x.m_Count <= lims.m_Count) &&
+		(x.m_Size <= lims.m_Size);
 }
 
 void Node::Bbs::Cleanup()
 {
-	NodeDB& db = get_ParentObj().m_Processor.get_DB();
-	NodeDB::WalkerBbsTimeLen wlk;
-
-	Timestamp ts = getTimestamp() - get_ParentObj().m_Cfg.m_Bbs.m_MessageTimeout_s;
-
-	for (db.EnumAllBbs(wlk); wlk.MoveNext(); )
-	{
-		if (IsInLimits() && (wlk.m_Time >= ts))
-			break;
+	NodeDB::BbsTotals lims;
+	get_Limits(lims);
 
-		db.BbsDel(wlk.m_ID);
-		m_Totals.m_Count--;
-		m_Totals.m_Size -= wlk.m_Size;
-	}
+	const Config::Bbs& cfg = get_ParentObj().m_Cfg.m_Bbs;
+	m_Store.Cleanup(getTimestamp() - cfg.m_MessageTimeout_s, lims);
 
 	m_LastCleanup_ms = GetTime_ms();
 }
@@ -1156,6 +1597,9 @@ Node::~Node()
     }
     m_Miner.m_vThreads.clear();
 
+    m_TxValidator.Stop();
+    m_RecoveryWriter.Stop();
+
     for (PeerList::iterator it = m_lstPeers.begin(); m_lstPeers.end() != it; ++it)
         it->m_LoginFlags = 0; // prevent re-assigning of tasks in the next loop
 
@@ -1261,6 +1705,9 @@ void Node::Peer::SetupLogin(proto::Login& msg)
 
 	if (m_This.m_Cfg.m_Bbs.IsEnabled())
 		msg.m_Flags |= proto::LoginFlags::Bbs; // indicate ability to receive and broadcast BBS messages
+
+	if (m_This.m_Cfg.m_BandwidthCtl.m_CompressedBodies)
+		msg.m_Flags |= proto::LoginFlags::CompressedBodies;
 }
 
 Height Node::Peer::get_MinPeerFork()
@@ -1704,6 +2151,7 @@ void Node::Peer::OnFirstTaskDone()
 
 	// Refrain from using TakeTasks(), it will only try to assign tasks to this peer
 	m_This.RefreshCongestions();
+	m_This.MaybeHedge(*this);
 	m_This.m_Processor.TryGoUpAsync();
 }
 
@@ -1734,6 +2182,145 @@ void Node::Peer::ModifyRatingWrtData(size_t nSize)
 	m_This.m_PeerMan.m_LiveSet.insert(Cast::Up<PeerMan::PeerInfoPlus>(m_pInfo)->m_Live);
 }
 
+void Node::Peer::ModifyThroughput(uint32_t nBlocks, size_t nSize)
+{
+	PeerManager::TimePoint tp;
+	uint32_t t_ms = tp.get();
+
+	// with pipelined requests the peer starts serving the task only after the previous one is done
+	uint32_t t0_ms = get_FirstTask().m_TimeAssigned_ms;
+	if (static_cast<int32_t>(m_Throughput.m_LastDone_ms - t0_ms) > 0)
+		t0_ms = m_Throughput.m_LastDone_ms;
+
+	uint32_t dt_ms = t_ms - t0_ms;
+	m_Throughput.m_LastDone_ms = t_ms;
+
+	uint32_t bw = PeerManager::Rating::ToBps(m_pInfo->m_RawRating.m_Value);
+	uint64_t dtTransfer_ms = bw ? (nSize * 1000ULL / bw) : dt_ms;
+
+	m_Throughput.OnPack(nBlocks, dt_ms, static_cast<uint32_t>(std::min<uint64_t>(dtTransfer_ms, dt_ms)));
+}
+
+void Node::Peer::Throughput::OnPack(uint32_t nBlocks, uint32_t dt_ms, uint32_t dtTransfer_ms)
+{
+	std::setmax(dt_ms, 1U);
+
+	uint32_t nBps = static_cast<uint32_t>(std::min<uint64_t>(nBlocks * 1000ULL / dt_ms, static_cast<uint32_t>(-1)));
+	std::setmax(nBps, 1U);
+
+	uint32_t nRtt_ms = dt_ms - dtTransfer_ms;
+
+	if (m_BlocksPerSec)
+	{
+		// moving average, the weight of the new measurement is 1/4
+		m_BlocksPerSec = static_cast<uint32_t>((m_BlocksPerSec * 3ULL + nBps) / 4);
+		m_Rtt_ms = static_cast<uint32_t>((m_Rtt_ms * 3ULL + nRtt_ms) / 4);
+		std::setmax(m_BlocksPerSec, 1U);
+	}
+	else
+	{
+		m_BlocksPerSec = nBps;
+		m_Rtt_ms = nRtt_ms;
+	}
+
+	m_LastPack = nBlocks;
+}
+
+uint32_t Node::Peer::Throughput::get_PackSize(const Config::SyncCtl& cfg, uint32_t nMax) const
+{
+	uint64_t n = cfg.m_PackMin;
+
+	if (m_BlocksPerSec)
+	{
+		n = static_cast<uint64_t>(m_BlocksPerSec) * cfg.m_PackTime_ms / 1000;
+		std::setmin(n, static_cast<uint64_t>(m_LastPack) * 2); // grow gradually, the estimate is less accurate for small packs
+		std::setmax(n, static_cast<uint64_t>(cfg.m_PackMin));
+	}
+
+	std::setmin(n, static_cast<uint64_t>(nMax));
+	return static_cast<uint32_t>(std::max<uint64_t>(n, 1));
+}
+
+uint32_t Node::Peer::Throughput::get_Expected_ms(uint32_t nBlocks) const
+{
+	assert(m_BlocksPerSec);
+	return m_Rtt_ms + static_cast<uint32_t>(std::min<uint64_t>(nBlocks * 1000ULL / m_BlocksPerSec, static_cast<uint32_t>(-1) - m_Rtt_ms));
+}
+
+void Node::SyncStats::Start()
+{
+	m_Window = get_ParentObj().m_Cfg.m_SyncCtl.m_Window;
+
+	uint32_t period_ms = get_ParentObj().m_Cfg.m_SyncCtl.m_StatsPeriod_ms;
+	if (!period_ms)
+		return;
+
+	m_Time_ms = GetTime_ms();
+	m_hCursor0 = get_ParentObj().m_Processor.m_Cursor.m_ID.m_Height;
+
+	m_pTimer = io::Timer::create(io::Reactor::get_Current());
+	m_pTimer->start(period_ms, true, [this]() { OnTimer(); });
+}
+
+void Node::SyncStats::OnTimer()
+{
+	Node& n = get_ParentObj();
+
+	uint32_t t_ms = GetTime_ms();
+	uint32_t dt_ms = std::max(t_ms - m_Time_ms, 1U);
+
+	Height hCursor = n.m_Processor.m_Cursor.m_ID.m_Height;
+	uint64_t nValidated = (hCursor > m_hCursor0) ? (hCursor - m_hCursor0) : 0;
+	uint64_t nDownloaded = m_BlocksDownloaded - m_BlocksDownloaded0;
+
+	m_Time_ms = t_ms;
+	m_hCursor0 = hCursor;
+	m_BlocksDownloaded0 = m_BlocksDownloaded;
+
+	n.m_Processor.m_ProofKernelStats.Log();
+
+	if (!nDownloaded && !n.m_nTasksPackBody)
+	{
+		// not syncing
+		m_DownloadedPerSec = 0;
+		m_ValidatedPerSec = 0;
+		return;
+	}
+
+	m_BlocksValidated += nValidated;
+	m_DownloadedPerSec = static_cast<uint32_t>(nDownloaded * 1000 / dt_ms);
+	m_ValidatedPerSec = static_cast<uint32_t>(nValidated * 1000 / dt_ms);
+
+	Height hAhead = (m_hDownloaded > hCursor) ? (m_hDownloaded - hCursor) : 0;
+	AdjustWindow(hAhead);
+
+	LOG_INFO()
+		<< "Sync blocks/sec: downloaded " << m_DownloadedPerSec
+		<< ", validated " << m_ValidatedPerSec
+		<< ", ahead " << hAhead
+		<< ", window " << m_Window
+		<< ", requested " << n.m_nTasksPackBody
+		<< ", re-requested " << m_PacksHedged;
+}
+
+void Node::SyncStats::AdjustWindow(Height hBacklog)
+{
+	const Config& cfg = get_ParentObj().m_Cfg;
+	if (!cfg.m_SyncCtl.m_Window || !cfg.m_SyncCtl.m_BacklogTime_s || !m_ValidatedPerSec)
+		return; // fixed, or the validation waits for a missing segment
+
+	Height hMin = std::min<Height>(cfg.m_BandwidthCtl.m_MaxBodyPackCount, cfg.m_SyncCtl.m_Window);
+	Height hBacklogMax = static_cast<Height>(m_ValidatedPerSec) * cfg.m_SyncCtl.m_BacklogTime_s;
+
+	if (hBacklog > hBacklogMax)
+		m_Window = std::max(m_Window / 2, hMin); // the validation lags behind
+	else
+	{
+		if (hBacklog >= m_Window - m_Window / 4)
+			m_Window = std::min(m_Window * 2, cfg.m_SyncCtl.m_Window); // the download is limited by the window, while the validation keeps up
+	}
+}
+
 void Node::Peer::OnMsg(proto::DataMissing&&)
 {
     Task& t = get_FirstTask();
@@ -1906,7 +2493,7 @@ void Node::Peer::OnMsg(proto::GetBodyPack&& msg)
 				if (NodeDB::StateFlags::Active & p.get_DB().GetStateFlags(sid.m_Row))
 				{
 					// functionality only supported for active states
-					proto::BodyPack msgBody;
+					proto::BodyPackRef msgBody; // the bodies are serialized directly from the block store mapping
 					size_t nSize = 0;
 
 					sid.m_Height -= msg.m_CountExtra;
@@ -1916,11 +2503,11 @@ void Node::Peer::OnMsg(proto::GetBodyPack&& msg)
 					{
 						sid.m_Row = p.FindActiveAtStrict(sid.m_Height);
 
-						proto::BodyBuffers bb;
+						proto::BodyBuffersRef bb;
 						if (!GetBlock(bb, sid, msg, true))
 							break;
 
-						nSize += bb.m_Eternal.size() + bb.m_Perishable.size();
+						nSize += bb.m_Eternal.size + bb.m_Perishable.size;
 						msgBody.m_Bodies.push_back(std::move(bb));
 
 						if (nSize >= m_This.m_Cfg.m_BandwidthCtl.m_MaxBodyPackSize)
@@ -1929,14 +2516,14 @@ void Node::Peer::OnMsg(proto::GetBodyPack&& msg)
 
 					if (msgBody.m_Bodies.size())
 					{
-						Send(msgBody);
+						SendBodyPack(msgBody);
 						return;
 					}
 				}
 			}
 			else
 			{
-				proto::Body msgBody;
+				proto::BodyRef msgBody;
 				if (GetBlock(msgBody.m_Body, sid, msg, false))
 				{
 					Send(msgBody);
@@ -1961,10 +2548,67 @@ void Node::Peer::OnMsg(proto::GetBodyPack&& msg)
     Send(proto::DataMissing());
 }
 
-bool Node::Peer::GetBlock(proto::BodyBuffers& out, const NodeDB::StateID& sid, const proto::GetBodyPack& msg, bool bActive)
+void Node::Peer::SendBodyPack(const proto::BodyPackRef& msg)
+{
+	if (proto::LoginFlags::CompressedBodies & m_LoginFlags)
+	{
+		Serializer ser;
+		ser & msg.m_Bodies;
+
+		SerializeBuffer sb = ser.buffer();
+		if (sb.second <= proto::g_BodyPackZMaxSizeRaw)
+		{
+			if (!m_pBodyEncoder)
+				m_pBodyEncoder = std::make_unique<LzStream::Encoder>();
+
+			proto::BodyPackZ msgZ;
+			msgZ.m_SizeRaw = static_cast<uint32_t>(sb.second);
+			m_pBodyEncoder->Write(msgZ.m_Data, sb.first, msgZ.m_SizeRaw);
+
+			m_This.m_BodyCompressionStats.m_Sent.Add(sb.second, msgZ.m_Data.size());
+
+			Send(msgZ);
+			return;
+		}
+	}
+
+	Send(msg);
+}
+
+void Node::BodyCompressionStats::Direction::Add(size_t nRaw, size_t nCompressed)
+{
+	m_Packs++;
+	m_BytesRaw += nRaw;
+	m_BytesCompressed += nCompressed;
+}
+
+void Node::BodyCompressionStats::Start()
+{
+	uint32_t period_ms = get_ParentObj().m_Cfg.m_BandwidthCtl.m_CompressionStatsPeriod_ms;
+	if (!period_ms)
+		return;
+
+	m_pTimer = io::Timer::create(io::Reactor::get_Current());
+	m_pTimer->start(period_ms, true, [this]() { OnTimer(); });
+}
+
+void Node::BodyCompressionStats::OnTimer()
+{
+	uint64_t nPacks = m_Sent.m_Packs + m_Received.m_Packs;
+	if (nPacks == m_PacksLogged)
+		return;
+
+	m_PacksLogged = nPacks;
+
+	LOG_INFO()
+		<< "Compressed body packs: sent " << m_Sent.m_Packs << ", saved " << m_Sent.get_Saved() << " bytes of " << m_Sent.m_BytesRaw
+		<< "; received " << m_Received.m_Packs << ", saved " << m_Received.get_Saved() << " bytes of " << m_Received.m_BytesRaw;
+}
+
+bool Node::Peer::GetBlock(proto::BodyBuffersRef& out, const NodeDB::StateID& sid, const proto::GetBodyPack& msg, bool bActive)
 {
-	ByteBuffer* pP = nullptr;
-	ByteBuffer* pE = nullptr;
+	io::SharedBuffer* pP = nullptr;
+	io::SharedBuffer* pE = nullptr;
 
 	switch (msg.m_FlagE)
 	{
@@ -1997,7 +2641,7 @@ bool Node::Peer::GetBlock(proto::BodyBuffers& out, const NodeDB::StateID& sid, c
 		Block::Body block;
 
 		Deserializer der;
-		der.reset(out.m_Perishable);
+		der.reset(out.m_Perishable.data, out.m_Perishable.size);
 		der & Cast::Down<Block::BodyBase>(block);
 		der & Cast::Down<TxVectors::Perishable>(block);
 
@@ -2014,7 +2658,9 @@ bool Node::Peer::GetBlock(proto::BodyBuffers& out, const NodeDB::StateID& sid, c
 		ser & Cast::Down<Block::BodyBase>(block);
 		ser & Cast::Down<TxVectors::Perishable>(block);
 
-		ser.swap_buf(out.m_Perishable);
+		ByteBuffer bb;
+		ser.swap_buf(bb);
+		out.m_Perishable.assign(std::move(bb));
 	}
 
 	return true;
@@ -2051,6 +2697,30 @@ void Node::Peer::OnMsg(proto::Body&& msg)
 	OnFirstTaskDone(eStatus);
 }
 
+void Node::Peer::OnMsg(proto::BodyPackZ&& msg)
+{
+	// decode unconditionally, the dictionary must stay in sync with the sender
+	if (msg.m_SizeRaw > proto::g_BodyPackZMaxSizeRaw)
+		ThrowUnexpected();
+
+	if (!m_pBodyDecoder)
+		m_pBodyDecoder = std::make_unique<LzStream::Decoder>();
+
+	ByteBuffer buf;
+	if (!m_pBodyDecoder->Read(buf, msg.m_Data.empty() ? nullptr : &msg.m_Data.front(), static_cast<uint32_t>(msg.m_Data.size()), msg.m_SizeRaw))
+		ThrowUnexpected("corrupted BodyPackZ");
+
+	m_This.m_BodyCompressionStats.m_Received.Add(buf.size(), msg.m_Data.size());
+
+	proto::BodyPack msgBody;
+
+	Deserializer der;
+	der.reset(buf);
+	der & msgBody.m_Bodies;
+
+	OnMsg(std::move(msgBody));
+}
+
 void Node::Peer::OnMsg(proto::BodyPack&& msg)
 {
 	Task& t = get_FirstTask();
@@ -2075,6 +2745,7 @@ void Node::Peer::OnMsg(proto::BodyPack&& msg)
 			msg.m_Bodies[i].m_Perishable.size();
 	}
 	ModifyRatingWrtData(nSize);
+	ModifyThroughput(static_cast<uint32_t>(msg.m_Bodies.size()), nSize);
 
 	NodeProcessor::DataStatus::Enum eStatus = NodeProcessor::DataStatus::Rejected;
 	if (!msg.m_Bodies.empty() && ShouldAcceptBodyPack())
@@ -2101,6 +2772,9 @@ void Node::Peer::OnMsg(proto::BodyPack&& msg)
 					break;
 				}
 			}
+
+			m_This.m_SyncStats.m_BlocksDownloaded += msg.m_Bodies.size();
+			std::setmax(m_This.m_SyncStats.m_hDownloaded, id.m_Height + msg.m_Bodies.size() - 1);
 		}
 	}
 
@@ -2145,10 +2819,31 @@ void Node::Peer::OnMsg(proto::NewTransaction&& msg)
     {
         m_This.OnTransactionDeferred(std::move(msg.m_Transaction), std::move(msg.m_Context), pSender, msg.m_Fluff);
     }
-}
+}
+
+void Node::OnTransactionDeferred(Transaction::Ptr&& pTx, std::unique_ptr<Merkle::Hash>&& pCtx, const PeerID* pSender, bool bFluff)
+{
+    m_TxValidationStats.m_Received++;
+
+    if (m_TxValidator.IsEnabled())
+    {
+        auto pElem = std::make_unique<TxValidator::Element>();
+        pElem->m_pTx = std::move(pTx);
+        pElem->m_pCtx = std::move(pCtx);
+        pElem->m_Fluff = bFluff;
+        pElem->m_Time_ms = GetTime_ms();
+
+        if (pSender)
+            pElem->m_Sender = *pSender;
+        else
+            pElem->m_Sender = Zero;
+
+        if (!m_TxValidator.Push(std::move(pElem)))
+            m_TxValidationStats.m_Dropped++;
+
+        return;
+    }
 
-void Node::OnTransactionDeferred(Transaction::Ptr&& pTx, std::unique_ptr<Merkle::Hash>&& pCtx, const PeerID* pSender, bool bFluff)
-{
     TxDeferred::Element txd;
     txd.m_pTx = std::move(pTx);
     txd.m_pCtx = std::move(pCtx);
@@ -2185,6 +2880,8 @@ void Node::TxDeferred::OnSchedule()
         TxDeferred::Element& x = m_lst.front();
         get_ParentObj().OnTransaction(std::move(x.m_pTx), std::move(x.m_pCtx), &x.m_Sender, x.m_Fluff, nullptr);
         m_lst.pop_front();
+
+        get_ParentObj().m_TxValidationStats.m_Done++;
     }
 
     if (m_lst.empty())
@@ -2192,6 +2889,328 @@ void Node::TxDeferred::OnSchedule()
 
 }
 
+void Node::TxValidator::Initialize()
+{
+    const Config& cfg = get_ParentObj().m_Cfg;
+    if (!cfg.m_TxValidation.m_Threads)
+        return;
+
+    m_Run = true;
+    m_BatchMax = std::max(cfg.m_TxValidation.m_BatchMax, 1U);
+    m_BatchDelay_ms = cfg.m_TxValidation.m_BatchDelay_ms;
+    m_pidNext = Zero;
+    m_pEvtDone = io::AsyncEvent::create(io::Reactor::get_Current(), [this]() { OnDone(); });
+
+    m_vThreads.resize(cfg.m_TxValidation.m_Threads);
+    for (size_t i = 0; i < m_vThreads.size(); i++)
+        m_vThreads[i] = MyThread(&TxValidator::RunThread, this, Rules::get());
+}
+
+void Node::TxValidator::Stop()
+{
+    if (m_vThreads.empty())
+        return;
+
+    {
+        std::unique_lock<std::mutex> scope(m_Mutex);
+        m_Run = false;
+        m_NewTask.notify_all();
+    }
+
+    for (size_t i = 0; i < m_vThreads.size(); i++)
+        if (m_vThreads[i].joinable())
+            m_vThreads[i].join();
+
+    m_vThreads.clear();
+    m_mapIn.clear();
+    m_nIn = 0;
+    m_queOut.clear();
+    m_Pending = 0;
+    m_pEvtDone.reset();
+}
+
+bool Node::TxValidator::IsSaturated() const
+{
+    return IsEnabled() && (m_Pending >= get_ParentObj().m_Cfg.m_TxValidation.m_MaxPending);
+}
+
+bool Node::TxValidator::Push(Element::Ptr&& pElem)
+{
+    assert(IsEnabled());
+    if (IsSaturated())
+        return false;
+
+    const Config& cfg = get_ParentObj().m_Cfg;
+
+    std::unique_lock<std::mutex> scope(m_Mutex);
+
+    std::deque<Element::Ptr>& que = m_mapIn[pElem->m_Sender];
+    if (que.size() >= cfg.m_TxValidation.m_MaxPendingPerPeer)
+        return false;
+
+    pElem->m_Height.m_Min = get_ParentObj().m_Processor.m_Cursor.m_ID.m_Height + 1;
+    pElem->m_Height.m_Max = MaxHeight;
+    m_Pending++;
+
+    que.push_back(std::move(pElem));
+    m_nIn++;
+    m_NewTask.notify_one();
+
+    return true;
+}
+
+void Node::TxValidator::SelectBatch(std::vector<Element::Ptr>& vBatch)
+{
+    // round-robin wrt senders, starting from the one that follows the last served
+    while ((vBatch.size() < m_BatchMax) && m_nIn)
+    {
+        auto it = m_mapIn.lower_bound(m_pidNext);
+        if (m_mapIn.end() == it)
+            it = m_mapIn.begin();
+
+        std::deque<Element::Ptr>& que = it->second;
+        assert(!que.empty());
+
+        vBatch.push_back(std::move(que.front()));
+        que.pop_front();
+        m_nIn--;
+
+        m_pidNext = it->first;
+        m_pidNext.Inc(); // may wrap-around to zero, that's ok
+
+        if (que.empty())
+            m_mapIn.erase(it);
+    }
+}
+
+void Node::TxValidator::RunThread(const Rules& r)
+{
+    Rules::Scope scopeRules(r);
+
+    std::vector<Element::Ptr> vBatch;
+    std::vector<Element*> vPtrs;
+
+    std::unique_lock<std::mutex> scope(m_Mutex);
+    while (true)
+    {
+        if (!m_Run)
+            break;
+
+        if (!m_nIn)
+        {
+            m_NewTask.wait(scope);
+            continue;
+        }
+
+        if ((m_nIn < m_BatchMax) && m_BatchDelay_ms)
+        {
+            // let the batch collect
+            auto tDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_BatchDelay_ms);
+            while (m_Run && (m_nIn < m_BatchMax) && (std::cv_status::timeout != m_NewTask.wait_until(scope, tDeadline)))
+                ;
+
+            if (!m_Run)
+                break;
+            if (!m_nIn)
+                continue; // taken by another thread
+        }
+
+        SelectBatch(vBatch);
+
+        scope.unlock();
+
+        vPtrs.resize(vBatch.size());
+        for (size_t i = 0; i < vBatch.size(); i++)
+            vPtrs[i] = vBatch[i].get();
+
+        ValidateBatch(&vPtrs.front(), vPtrs.size());
+
+        scope.lock();
+
+        for (size_t i = 0; i < vBatch.size(); i++)
+            m_queOut.push_back(std::move(vBatch[i]));
+        vBatch.clear();
+
+        m_pEvtDone->post();
+    }
+}
+
+void Node::TxValidator::Validate(Element& x)
+{
+    // the rangeproofs are accumulated in the current batch context, the caller is responsible to flush it
+    Transaction::Context::Params pars;
+    Transaction::Context ctx(pars);
+    ctx.m_Height = x.m_Height;
+
+    x.m_bValid =
+        ctx.ValidateAndSummarize(*x.m_pTx, x.m_pTx->get_Reader()) &&
+        ctx.IsValidTransaction();
+
+    x.m_Height = ctx.m_Height;
+    x.m_Stats = ctx.m_Stats;
+}
+
+void Node::TxValidator::ValidateBatch(Element** pp, size_t n)
+{
+    assert(n);
+
+    // Each tx is validated once, its contribution to the batch equation is kept: the casual part as a point, and the scalars
+    // of the prepared generators. The batch is verified by the sum of the contributions. If it fails - the culprits are
+    // found by bisection over the kept contributions, without re-validating the txs.
+    typedef ECC::InnerProduct::BatchContext BatchContext;
+
+    struct Part
+    {
+        ECC::Point::Native m_Casual;
+        ECC::Scalar::Native m_pKPrep[BatchContext::s_CountPrepared];
+    };
+
+    struct Verifier
+    {
+        BatchContext& m_Bc;
+        Element** m_pp;
+        const std::vector<Part>& m_vParts;
+
+        bool IsValid(const size_t* pIdx, size_t n)
+        {
+            m_Bc.m_Sum = Zero;
+            for (uint32_t j = 0; j < BatchContext::s_CountPrepared; j++)
+                m_Bc.m_Bufs.m_pKPrep[j] = Zero;
+
+            for (size_t i = 0; i < n; i++)
+            {
+                const Part& part = m_vParts[pIdx[i]];
+                m_Bc.m_Sum += part.m_Casual;
+                for (uint32_t j = 0; j < BatchContext::s_CountPrepared; j++)
+                    m_Bc.m_Bufs.m_pKPrep[j] += part.m_pKPrep[j];
+            }
+
+            m_Bc.m_Casual = 0;
+            m_Bc.Calculate(); // adds the prepared part
+            return (m_Bc.m_Sum == Zero);
+        }
+
+        void Bisect(const size_t* pIdx, size_t n, bool bKnownInvalid)
+        {
+            if (!bKnownInvalid && IsValid(pIdx, n))
+                return;
+
+            if (1 == n)
+            {
+                m_pp[*pIdx]->m_bValid = false; // the culprit
+                return;
+            }
+
+            size_t n0 = n / 2;
+            bool bValid0 = IsValid(pIdx, n0);
+            if (!bValid0)
+                Bisect(pIdx, n0, true);
+
+            Bisect(pIdx + n0, n - n0, bValid0); // if the 1st half is valid - the 2nd isn't
+        }
+    };
+
+    ECC::InnerProduct::BatchContextEx<4> bc;
+    BatchContext::Scope scopeBc(bc);
+
+    std::vector<Part> vParts(n);
+    std::vector<size_t> vIdx; // txs that passed on their own
+    vIdx.reserve(n);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        Validate(*pp[i]);
+
+        Part& part = vParts[i];
+        if (bc.m_bDirty)
+        {
+            bc.m_Prepared = 0;
+            bc.Calculate(); // flush the pending casuals to m_Sum
+            bc.m_Prepared = BatchContext::s_CountPrepared;
+
+            part.m_Casual = bc.m_Sum;
+            for (uint32_t j = 0; j < BatchContext::s_CountPrepared; j++)
+                part.m_pKPrep[j] = bc.m_Bufs.m_pKPrep[j];
+
+            bc.Reset(); // the next tx starts from scratch
+        }
+        else
+        {
+            part.m_Casual = Zero;
+            for (uint32_t j = 0; j < BatchContext::s_CountPrepared; j++)
+                part.m_pKPrep[j] = Zero;
+        }
+
+        if (pp[i]->m_bValid)
+            vIdx.push_back(i);
+    }
+
+    if (!vIdx.empty())
+    {
+        Verifier v{ bc, pp, vParts };
+        v.Bisect(&vIdx.front(), vIdx.size(), false);
+    }
+}
+
+void Node::TxValidator::OnInvalid(const PeerID& pid)
+{
+    if (pid == Zero)
+        return;
+
+    Node& n = get_ParentObj();
+
+    bool bCreate = false;
+    PeerManager::PeerInfo* pInfo = n.m_PeerMan.Find(pid, bCreate);
+    if (!pInfo)
+        return;
+
+    uint32_t val =
+        (pInfo->m_RawRating.m_Value > PeerManager::Rating::PenaltyInvalidTx) ?
+        (pInfo->m_RawRating.m_Value - PeerManager::Rating::PenaltyInvalidTx) :
+        1;
+    n.m_PeerMan.SetRating(*pInfo, val);
+
+    n.m_TxValidationStats.m_Penalized++;
+}
+
+void Node::TxValidator::OnDone()
+{
+    Node& n = get_ParentObj();
+
+    while (true)
+    {
+        Element::Ptr pElem;
+        {
+            std::unique_lock<std::mutex> scope(m_Mutex);
+            if (m_queOut.empty())
+                break;
+
+            pElem = std::move(m_queOut.front());
+            m_queOut.pop_front();
+        }
+
+        assert(m_Pending);
+        m_Pending--;
+
+        Element& x = *pElem;
+        if (!x.m_bValid)
+        {
+            n.m_TxValidationStats.m_Invalid++;
+            OnInvalid(x.m_Sender);
+        }
+
+        {
+            x.m_pValidated = x.m_pTx.get();
+            const Element* pCurrent = pElem.get();
+            TemporarySwap<const Element*> scopeCurrent(m_pCurrent, pCurrent);
+            n.OnTransaction(std::move(x.m_pTx), std::move(x.m_pCtx), &x.m_Sender, x.m_Fluff, nullptr);
+        }
+
+        n.m_TxValidationStats.m_Done++;
+        std::setmax(n.m_TxValidationStats.m_LatencyMax_ms, GetTime_ms() - x.m_Time_ms);
+    }
+}
+
 uint8_t Node::OnTransaction(Transaction::Ptr&& pTx, std::unique_ptr<Merkle::Hash>&& pCtx, const PeerID* pSender, bool bFluff, std::ostream* pExtraInfo)
 {
     return 
@@ -2217,11 +3236,38 @@ uint8_t Node::ValidateTx2(Transaction::Context& ctx, const Transaction& tx, uint
 {
     ctx.m_Height.m_Min = m_Processor.m_Cursor.m_ID.m_Height + 1;
 
-    if (!(m_Processor.ValidateAndSummarize(ctx, tx, tx.get_Reader()) && ctx.IsValidTransaction()))
+    const TxValidator::Element* pPre = m_TxValidator.m_pCurrent;
+    if (pPre && (pPre->m_pValidated == &tx))
     {
-        if (pExtraInfo)
-            *pExtraInfo << "Context-free validation failed";
-        return proto::TxStatus::Invalid;
+        // context-free validation was already performed asynchronously
+        if (!pPre->m_bValid)
+        {
+            if (pExtraInfo)
+                *pExtraInfo << "Context-free validation failed";
+            return proto::TxStatus::Invalid;
+        }
+
+        ctx.m_Stats = pPre->m_Stats;
+        ctx.m_Height.m_Max = pPre->m_Height.m_Max;
+        std::setmax(ctx.m_Height.m_Min, pPre->m_Height.m_Min);
+
+        if (ctx.m_Height.IsEmpty())
+        {
+            if (pExtraInfo)
+                *pExtraInfo << "Height range fail";
+            return proto::TxStatus::InvalidContext; // the tip has moved meanwhile
+        }
+    }
+    else
+    {
+        m_TxValidationStats.m_ValidatedSync++;
+
+        if (!(m_Processor.ValidateAndSummarize(ctx, tx, tx.get_Reader()) && ctx.IsValidTransaction()))
+        {
+            if (pExtraInfo)
+                *pExtraInfo << "Context-free validation failed";
+            return proto::TxStatus::Invalid;
+        }
     }
 
     uint8_t nCode = m_Processor.ValidateTxContextEx(tx, ctx.m_Height, false, nBvmCharge, pParent, pExtraInfo, pNewCtx);
@@ -3097,22 +4143,20 @@ void Node::Peer::BroadcastBbs()
 
 	size_t nExtra = 0;
 
-	NodeDB& db = m_This.m_Processor.get_DB();
-	NodeDB::WalkerBbsLite wlk;
+	const BbsStore& bbs = m_This.m_Bbs.m_Store;
 
-	wlk.m_ID = m_CursorBbs;
-	for (db.EnumAllBbsSeq(wlk); wlk.MoveNext(); )
+	for (const BbsStore::Msg* pMsg = bbs.FindNext(m_CursorBbs); pMsg; pMsg = bbs.get_Next(*pMsg, false))
 	{
 		proto::BbsHaveMsg msgOut;
-		msgOut.m_Key = wlk.m_Key;
+		msgOut.m_Key = pMsg->m_Key.m_Value;
 		Send(msgOut);
 
-		nExtra += wlk.m_Size;
+		m_CursorBbs = pMsg->m_ID.m_Value;
+
+		nExtra += pMsg->m_Size;
 		if (IsChocking(nExtra))
 			break;
 	}
-
-	m_CursorBbs = wlk.m_ID;
 }
 
 void Node::Peer::MaybeSendSerif()
@@ -3184,6 +4228,9 @@ void Node::Peer::OnMsg(proto::HaveTransaction&& msg)
     if (m_This.m_TxPool.m_setTxs.end() != it)
         return; // already have it
 
+    if (m_This.m_TxValidator.IsSaturated())
+        return; // don't request more, until the pending ones are handled. Other peers will advertise it again
+
     if (!m_This.m_Wtx.Add(key.m_Key))
         return; // already waiting for it
 
@@ -3603,7 +4650,7 @@ void Node::Peer::OnMsg(proto::BbsMsg&& msg)
     if (msg.m_TimePosted + Rules::get().DA.MaxAhead_s < m_This.m_Bbs.m_HighestPosted_s)
         return; // don't allow too much out-of-order messages
 
-    NodeDB& db = m_This.m_Processor.get_DB();
+    BbsStore& bbs = m_This.m_Bbs.m_Store;
     NodeDB::WalkerBbs wlk;
 
     wlk.m_Data.m_Channel = msg.m_Channel;
@@ -3613,17 +4660,15 @@ void Node::Peer::OnMsg(proto::BbsMsg&& msg)
 
     Bbs::CalcMsgKey(wlk.m_Data);
 
-    if (db.BbsFind(wlk.m_Data.m_Key))
+    if (bbs.Find(wlk.m_Data.m_Key))
         return; // already have it
 
     m_This.m_Bbs.MaybeCleanup();
 
-    uint64_t id = db.BbsIns(wlk.m_Data);
+    uint64_t id = bbs.Insert(wlk.m_Data);
     m_This.m_Bbs.m_W.Delete(wlk.m_Data.m_Key);
 
 	std::setmax(m_This.m_Bbs.m_HighestPosted_s, msg.m_TimePosted);
-	m_This.m_Bbs.m_Totals.m_Count++;
-	m_This.m_Bbs.m_Totals.m_Size += wlk.m_Data.m_Message.n;
 
     // 1. Send to other BBS-es
 
@@ -3668,8 +4713,7 @@ void Node::Peer::OnMsg(proto::BbsHaveMsg&& msg)
     if (!m_This.m_Cfg.m_Bbs.IsEnabled())
 		ThrowUnexpected();
 
-    NodeDB& db = m_This.m_Processor.get_DB();
-	if (db.BbsFind(msg.m_Key)) {
+	if (m_This.m_Bbs.m_Store.Find(msg.m_Key)) {
 		// stupid compiler insists on parentheses here!
 		return; // already have it
 	}
@@ -3689,14 +4733,14 @@ void Node::Peer::OnMsg(proto::BbsGetMsg&& msg)
 	if (!m_This.m_Cfg.m_Bbs.IsEnabled())
 		ThrowUnexpected();
 
-	NodeDB& db = m_This.m_Processor.get_DB();
-    NodeDB::WalkerBbs wlk;
-
-    wlk.m_Data.m_Key = msg.m_Key;
-    if (!db.BbsFind(wlk))
-        return; // don't have it
+	const BbsStore& bbs = m_This.m_Bbs.m_Store;
+	const BbsStore::Msg* pMsg = bbs.Find(msg.m_Key);
+	if (!pMsg)
+		return; // don't have it
 
-    SendBbsMsg(wlk.m_Data);
+	NodeDB::WalkerBbs::Data d;
+	bbs.get_Data(*pMsg, d);
+	SendBbsMsg(d);
 }
 
 void Node::Peer::SendBbsMsg(const NodeDB::WalkerBbs::Data& d)
@@ -3731,7 +4775,7 @@ void Node::Peer::OnMsg(proto::BbsSubscribe&& msg)
         m_This.m_Bbs.m_Subscribed.insert(pS->m_Bbs);
         m_Subscriptions.insert(pS->m_Peer);
 
-		pS->m_Cursor = m_This.m_Processor.get_DB().BbsFindCursor(msg.m_TimeFrom) - 1;
+		pS->m_Cursor = m_This.m_Bbs.m_Store.FindCursor(msg.m_TimeFrom) - 1;
 
 		BroadcastBbs(*pS);
     }
@@ -3744,20 +4788,19 @@ void Node::Peer::BroadcastBbs(Bbs::Subscription& s)
 	if (IsChocking())
 		return;
 
-	NodeDB& db = m_This.m_Processor.get_DB();
-	NodeDB::WalkerBbs wlk;
-
-	wlk.m_Data.m_Channel = s.m_Peer.m_Channel;
-	wlk.m_ID = s.m_Cursor;
+	const BbsStore& bbs = m_This.m_Bbs.m_Store;
 
-	for (db.EnumBbsCSeq(wlk); wlk.MoveNext(); )
+	for (const BbsStore::Msg* pMsg = bbs.FindNext(s.m_Peer.m_Channel, s.m_Cursor); pMsg; pMsg = bbs.get_Next(*pMsg, true))
 	{
-		SendBbsMsg(wlk.m_Data);
+		// the body is sent directly from the mapped segment
+		NodeDB::WalkerBbs::Data d;
+		bbs.get_Data(*pMsg, d);
+		SendBbsMsg(d);
+
+		s.m_Cursor = pMsg->m_ID.m_Value;
 		if (IsChocking())
 			break;
 	}
-
-	s.m_Cursor = wlk.m_ID;
 }
 
 void Node::Peer::OnMsg(proto::BbsResetSync&& msg)
@@ -3765,7 +4808,7 @@ void Node::Peer::OnMsg(proto::BbsResetSync&& msg)
 	if (!m_This.m_Cfg.m_Bbs.IsEnabled())
 		ThrowUnexpected();
 
-	m_CursorBbs = m_This.m_Processor.get_DB().BbsFindCursor(msg.m_TimeFrom) - 1;
+	m_CursorBbs = m_This.m_Bbs.m_Store.FindCursor(msg.m_TimeFrom) - 1;
 	BroadcastBbs();
 }
 
@@ -4358,11 +5401,14 @@ bool Node::Miner::Restart()
         keys.m_pOwner ? *keys.m_pOwner : *keys.m_pGeneric);
 
     bc.m_pParent = get_ParentObj().m_TxDependent.m_pBest;
+    bc.m_pTemplate = &m_Template;
 
     if (m_pFinalizer)
         bc.m_Mode = NodeProcessor::BlockContext::Mode::Assemble;
 
+    uint32_t t0_ms = GetTime_ms();
     bool bRes = get_ParentObj().m_Processor.GenerateNewBlock(bc);
+    m_TemplateStats.OnBuilt(m_Template.m_Build, GetTime_ms() - t0_ms);
 
     if (!bRes)
     {
@@ -4394,6 +5440,29 @@ bool Node::Miner::Restart()
     return true;
 }
 
+void Node::Miner::TemplateStats::OnBuilt(NodeProcessor::BlockTemplate::Build b, uint32_t dt_ms)
+{
+    const char* szBuild;
+
+    switch (b)
+    {
+    case NodeProcessor::BlockTemplate::Build::Full:
+        m_Full++;
+        szBuild = "rebuilt";
+        break;
+
+    default:
+        m_Reused++;
+        szBuild = "reused";
+    }
+
+    m_Last_ms = dt_ms;
+    std::setmax(m_Max_ms, dt_ms);
+    m_Total_ms += dt_ms;
+
+    LOG_INFO() << "Block template " << szBuild << " in " << dt_ms << " ms. Full/Reused=" << m_Full << "/" << m_Reused << ", Max=" << m_Max_ms << " ms";
+}
+
 void Node::Miner::StartMining(Task::Ptr&& pTask)
 {
     assert(pTask && !m_pTaskToFinalize);
@@ -4843,6 +5912,81 @@ void Node::PeerMan::PeerInfoPlus::DetachStrict()
 	m_Live.m_p = nullptr;
 }
 
+template <typename TArchive>
+void Node::SaveRecoveryNonStd(TArchive& ser, Height hMin)
+{
+    const Rules& r = Rules::get();
+
+    // shielded in/outs
+    struct MyKrnWalker
+        :public NodeProcessor::KrnWalkerShielded
+    {
+        TArchive& m_Ser;
+        MyKrnWalker(TArchive& ser) :m_Ser(ser) {}
+
+        virtual bool OnKrnEx(const TxKernelShieldedInput& krn) override
+        {
+            uint8_t nFlags = 0;
+
+            m_Ser & m_Height;
+            m_Ser & nFlags;
+            m_Ser & krn.m_SpendProof.m_SpendPk;
+            return true;
+        }
+
+        virtual bool OnKrnEx(const TxKernelShieldedOutput& krn) override
+        {
+            Asset::Proof::Ptr pAsset;
+
+            uint8_t nFlags = RecoveryInfo::Flags::Output;
+            if (krn.m_Txo.m_pAsset)
+            {
+                pAsset.swap(Cast::NotConst(krn).m_Txo.m_pAsset);
+                nFlags |= RecoveryInfo::Flags::HadAsset;
+            }
+
+            m_Ser & m_Height;
+            m_Ser & nFlags;
+            m_Ser & krn.m_Txo;
+            m_Ser & krn.m_Msg;
+
+            if (pAsset && (m_Height >= Rules::get().pForks[3].m_Height))
+                m_Ser & pAsset->m_hGen;
+
+            return true;
+        }
+
+    } wlk(ser);
+
+    if (hMin <= m_Processor.m_Cursor.m_ID.m_Height)
+        m_Processor.EnumKernels(wlk, HeightRange(hMin, m_Processor.m_Cursor.m_ID.m_Height));
+
+    ser & MaxHeight; // terminator
+
+    // assets
+    Asset::Full ai;
+    ai.m_ID = 0;
+
+    while (m_Processor.get_DB().AssetGetNext(ai))
+        ser & ai;
+
+    ser & (Asset::s_MaxCount + 1); // terminator
+
+    if (m_Processor.m_Cursor.m_ID.m_Height >= r.pForks[3].m_Height)
+    {
+        m_Processor.EnsureCursorKernels();
+
+        Merkle::Hash hv;
+        NodeProcessor::Evaluator ev(m_Processor);
+
+        BEAM_VERIFY(ev.get_Contracts(hv));
+        ser & hv;
+
+        BEAM_VERIFY(ev.get_KL(hv));
+        ser & hv;
+    }
+}
+
 bool Node::GenerateRecoveryInfo(const char* szPath)
 {
 	if (!m_Processor.BuildCwp())
@@ -4916,75 +6060,89 @@ bool Node::GenerateRecoveryInfo(const char* szPath)
             MySerializer ser(ctx.m_Writer.m_Stream);
             ser & MaxHeight; // terminator
 
-            // shielded in/outs
-            struct MyKrnWalker
-                :public NodeProcessor::KrnWalkerShielded
-            {
-                MySerializer& m_Ser;
-                MyKrnWalker(MySerializer& ser) :m_Ser(ser) {}
+            SaveRecoveryNonStd(ser, r.pForks[2].m_Height);
+        }
 
-                virtual bool OnKrnEx(const TxKernelShieldedInput& krn) override
-                {
-                    uint8_t nFlags = 0;
+	}
+	catch (const std::exception& ex)
+	{
+		LOG_ERROR() << ex.what();
+		return false;
+	}
 
-                    m_Ser & m_Height;
-                    m_Ser & nFlags;
-                    m_Ser & krn.m_SpendProof.m_SpendPk;
-                    return true;
-                }
+	return true;
+}
 
-                virtual bool OnKrnEx(const TxKernelShieldedOutput& krn) override
-                {
-                    Asset::Proof::Ptr pAsset;
+bool Node::GenerateRecoveryDelta(ByteBuffer& buf, Height hPrev)
+{
+	if (!m_Processor.BuildCwp())
+		return false; // no info yet
 
-                    uint8_t nFlags = RecoveryInfo::Flags::Output;
-                    if (krn.m_Txo.m_pAsset)
-                    {
-                        pAsset.swap(Cast::NotConst(krn).m_Txo.m_pAsset);
-                        nFlags |= RecoveryInfo::Flags::HadAsset;
-                    }
+	const Height& h1 = m_Processor.m_Cursor.m_ID.m_Height; // alias
+	assert(hPrev < h1);
 
-                    m_Ser & m_Height;
-                    m_Ser & nFlags;
-                    m_Ser & krn.m_Txo;
-                    m_Ser & krn.m_Msg;
+	Serializer ser;
 
-                    if (pAsset && (m_Height >= Rules::get().pForks[3].m_Height))
-                        m_Ser & pAsset->m_hGen;
+	try
+	{
+		NodeDB& db = m_Processor.get_DB();
+		TxoID id0 = m_Processor.get_TxosBefore(hPrev + 1);
 
-                    return true;
-                }
+		// created UTXOs. Those that are already spent are omitted
+		Height h = hPrev + 1;
+		TxoID idNext = m_Processor.get_TxosBefore(h + 1);
+
+		NodeDB::WalkerTxo wlk;
+		for (db.EnumTxos(wlk, id0); wlk.MoveNext(); )
+		{
+			while (wlk.m_ID >= idNext)
+				idNext = m_Processor.get_TxosBefore(++h + 1);
+
+			if (MaxHeight != wlk.m_SpendHeight)
+				continue;
 
-            } wlk(ser);
+			Deserializer der;
+			der.reset(wlk.m_Value.p, wlk.m_Value.n);
 
-            m_Processor.EnumKernels(wlk, HeightRange(r.pForks[2].m_Height, m_Processor.m_Cursor.m_ID.m_Height));
+			Output outp;
+			der & outp;
 
-            ser & MaxHeight; // terminator
+			ser & h;
+			yas::detail::saveRecovery(ser, outp, h);
+		}
 
-            // assets
-            Asset::Full ai;
-            ai.m_ID = 0;
+		ser & MaxHeight; // terminator
 
-            while (m_Processor.get_DB().AssetGetNext(ai))
-                ser & ai;
+		// spent UTXOs, those that were created before
+		for (NodeDB::StateID sid = m_Processor.m_Cursor.m_Sid; sid.m_Height > hPrev; )
+		{
+			std::vector<NodeDB::StateInput> v;
+			db.get_StateInputs(sid.m_Row, v);
 
-            ser & (Asset::s_MaxCount + 1); // terminator
+			for (size_t i = 0; i < v.size(); i++)
+			{
+				TxoID id = v[i].get_ID();
+				if (id >= id0)
+					continue;
 
-            if (m_Processor.m_Cursor.m_ID.m_Height >= r.pForks[3].m_Height)
-            {
-                m_Processor.EnsureCursorKernels();
+				Input inp;
+				inp.m_Internal.m_ID = id;
+				Output outp;
+				m_Processor.ToInputWithMaturity(inp, outp, true);
 
-                Merkle::Hash hv;
-                NodeProcessor::Evaluator ev(m_Processor);
+				ser & inp.m_Internal.m_Maturity;
+				ser & inp.m_Commitment;
+			}
 
-                BEAM_VERIFY(ev.get_Contracts(hv));
-                ser & hv;
+			if (!db.get_Prev(sid))
+				break;
+		}
 
-                BEAM_VERIFY(ev.get_KL(hv));
-                ser & hv;
-            }
-        }
+		ser & MaxHeight; // terminator
 
+		const Rules& r = Rules::get();
+		if (h1 >= r.pForks[2].m_Height)
+			SaveRecoveryNonStd(ser, std::max(hPrev + 1, r.pForks[2].m_Height));
 	}
 	catch (const std::exception& ex)
 	{
@@ -4992,6 +6150,7 @@ bool Node::GenerateRecoveryInfo(const char* szPath)
 		return false;
 	}
 
+	ser.swap_buf(buf);
 	return true;
 }
 
@@ -15,11 +15,13 @@
 #pragma once
 
 #include "processor.h"
+#include "bbs_store.h"
 #include "utility/io/timer.h"
 #include "core/proto.h"
 #include "core/block_crypt.h"
 #include "core/shielded.h"
 #include "core/peer_manager.h"
+#include "utility/compression.h"
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/set.hpp>
 #include <condition_variable>
@@ -84,6 +86,26 @@ struct Node
 		// negative: number of cores minus number of mining threads.
 		int m_VerificationThreads = 0;
 
+		// Use the work-stealing scheduler for verification threads (per-thread lock-free queues) instead of the shared locked queue.
+		bool m_VerificationWorkStealing = false;
+
+		struct TxValidation
+		{
+			// Context-free verification of txs received from other nodes (signatures, rangeproofs and etc.) can be done in dedicated threads,
+			// so that the node thread isn't stalled during tx floods. Then the context-dependent checks are performed on the node thread.
+			// 0: validate on the node thread (when idle)
+			uint32_t m_Threads = 0;
+			uint32_t m_MaxPending = 2000; // beyond this the node stops requesting new txs from peers, and drops the unsolicited ones
+			uint32_t m_MaxPendingPerPeer = 500; // unsolicited txs from a single peer beyond this are dropped
+
+			// Txs are verified in batches (the rangeproofs of all the txs are verified at once). A validation thread waits up to BatchDelay
+			// for the batch to collect, the txs are picked round-robin wrt senders. If the batch fails - it's bisected to find the culprit(s).
+			// 1: no batching
+			uint32_t m_BatchMax = 32;
+			uint32_t m_BatchDelay_ms = 5;
+
+		} m_TxValidation;
+
 		struct RollbackLimit
 		{
 			Height m_Max = 60; // artificial restriction on how much the node will rollback automatically
@@ -97,8 +119,16 @@ struct Node
 			uint32_t m_MessageTimeout_s = 3600 * 12; // 1/2 day
 			uint32_t m_CleanupPeriod_ms = 3600 * 1000; // 1 hour
 
+			// messages are stored in segments by the posted time, a segment is erased once all its messages expire.
+			uint32_t m_BucketWidth_s = 1800;
+			std::string m_sPath; // segments directory. If empty - derived from the node DB path
+
 			NodeDB::BbsTotals m_Limit;
 
+			// The messages index is kept in RAM (BbsStore::s_IndexPerMsg per message, ~200 bytes), at m_Limit.m_Count it may take up to ~4GB.
+			// Opt-in: if set - caps the count in addition to m_Limit (i.e. 512MB would allow ~2.5 mln msgs). 0 - no cap
+			uint64_t m_MaxIndexSize = 0;
+
 			Bbs()
 			{
 				// set the following to 0 to disable BBS replication.
@@ -121,8 +151,40 @@ struct Node
 			size_t m_MaxBodyPackSize = 1024 * 1024 * 5;
 			uint32_t m_MaxBodyPackCount = 3000;
 
+			// Ask peers to send block packs compressed. Saves bandwidth during the sync at the expense of some CPU.
+			// Serving compressed packs is always supported.
+			bool m_CompressedBodies = false;
+
+			uint32_t m_CompressionStatsPeriod_ms = 1000 * 60; // log the body compression totals, if there was traffic since the last time. 0: disabled
+
 		} m_BandwidthCtl;
 
+		struct SyncCtl
+		{
+			// Pipelined blocks download. The missing range is split into segments, which are requested from several peers in parallel,
+			// each segment is sized wrt the throughput of the peer. Downloading runs ahead of the cursor up to the window, so that
+			// the validation is never starved.
+			// 0: disabled (a single pack at a time, limited by m_MaxConcurrentBlocksRequest). Off by default, until it's proven on the mainnet.
+			// ~20000 is a reasonable value to enable it
+			Height m_Window = 0;
+
+			uint32_t m_PackTime_ms = 5000; // desired time to deliver a single segment
+			uint32_t m_PackMin = 16; // initial segment size, before the peer throughput is measured
+			uint32_t m_PacksPerPeer = 2; // requests pipelined to the same peer, to hide the latency
+
+			// The window is adjusted wrt the validation backlog (downloaded blocks waiting for the validation), each m_StatsPeriod_ms.
+			// If the backlog exceeds this time of the validation (at its current rate) - the window is halved, down to a single pack.
+			// If the download reaches the window while the validation keeps up - it's doubled, up to m_Window. 0: fixed window
+			uint32_t m_BacklogTime_s = 60;
+
+			// A segment that takes longer than this factor times the expected (wrt the owner throughput) is re-requested from
+			// an idle faster peer. 0: disabled
+			uint32_t m_HedgeFactor = 3;
+
+			uint32_t m_StatsPeriod_ms = 1000 * 10; // log the download/validation rate during the sync. 0: disabled
+
+		} m_SyncCtl;
+
 		struct TestMode {
 			// for testing only!
 			uint32_t m_FakePowSolveTime_ms = 15 * 1000;
@@ -152,6 +214,9 @@ struct Node
 		{
 			std::string m_sPathOutput; // directory with (back)slash and optionally a common prefix
 			uint32_t m_Granularity = 30; // block interval for newer recovery generation
+			uint32_t m_Deltas = 0; // num of deltas between the full recovery files. The full ones are then built in the background. 0 - always full
+			// Retention: with deltas, once a full recovery is merged, the previous full one and its deltas are deleted (only the latest is kept).
+			// Without deltas nothing is deleted, every generated full recovery file stays, as before
 
 		} m_Recovery;
 
@@ -204,7 +269,70 @@ struct Node
 	bool m_UpdatedFromPeers = false;
 	bool m_PostStartSynced = false;
 
+	struct TxValidationStats
+	{
+		uint64_t m_Received = 0; // txs from other nodes, that were queued for validation
+		uint64_t m_Dropped = 0; // queue overflow
+		uint64_t m_Invalid = 0; // failed context-free validation
+		uint64_t m_Done = 0;
+		uint64_t m_ValidatedSync = 0; // context-free validation performed on the node thread
+		uint64_t m_Penalized = 0; // senders rating lowered for invalid txs
+		uint32_t m_LatencyMax_ms = 0; // from queueing till the end of the processing on the node thread
+
+	} m_TxValidationStats;
+
+	struct BodyCompressionStats
+	{
+		struct Direction
+		{
+			uint64_t m_Packs = 0;
+			uint64_t m_BytesRaw = 0;
+			uint64_t m_BytesCompressed = 0;
+
+			uint64_t get_Saved() const { return m_BytesRaw - m_BytesCompressed; }
+			void Add(size_t nRaw, size_t nCompressed);
+		};
+
+		Direction m_Sent;
+		Direction m_Received;
+
+		uint64_t m_PacksLogged = 0; // sent + received, at the last log
+		io::Timer::Ptr m_pTimer;
+
+		void Start();
+		void OnTimer();
+
+		IMPLEMENT_GET_PARENT_OBJ(Node, m_BodyCompressionStats)
+
+	} m_BodyCompressionStats;
+
+	struct SyncStats
+	{
+		uint64_t m_BlocksDownloaded = 0; // received in block packs
+		uint64_t m_BlocksValidated = 0; // cursor progress while downloading
+		uint32_t m_PacksHedged = 0; // re-requested from faster peers
+		Height m_hDownloaded = 0; // highest block received
+		Height m_Window = 0; // current download window, adjusted wrt the validation backlog
+
+		// during the last period
+		uint32_t m_DownloadedPerSec = 0;
+		uint32_t m_ValidatedPerSec = 0;
+
+		io::Timer::Ptr m_pTimer;
+		uint32_t m_Time_ms = 0;
+		uint64_t m_BlocksDownloaded0 = 0;
+		Height m_hCursor0 = 0;
+
+		void Start();
+		void OnTimer();
+		void AdjustWindow(Height hBacklog);
+
+		IMPLEMENT_GET_PARENT_OBJ(Node, m_SyncStats)
+	} m_SyncStats;
+
 	bool GenerateRecoveryInfo(const char*);
+	bool GenerateRecoveryDelta(ByteBuffer&, Height hPrev); // the changes after the specified height, without the header
+	bool GenerateRecoveryDelta(const char* szPath, const Block::SystemState::ID& idPrev); // synchronous. idPrev must be in the current chain
 	void PrintTxos();
 	void PrintRollbackStats();
 
@@ -286,6 +414,8 @@ private:
 		Key m_Key;
 
 		bool m_bNeeded;
+		bool m_bFollowUp; // pipelined segment, not at the bottom of the congestion
+		bool m_bHedged; // requested from another peer as well
 		uint32_t m_nCount;
 		uint32_t m_TimeAssigned_ms;
 		NodeDB::StateID m_sidTrg;
@@ -308,14 +438,20 @@ private:
 	void UpdateSyncStatus();
 	void UpdateSyncStatusRaw();
 
+	Task& CreateTask(const Task::Key&, const NodeDB::StateID& sidTrg);
 	void TryAssignTask(Task&);
 	bool TryAssignTask(Task&, Peer&);
 	void DeleteUnassignedTask(Task&);
+	bool IsPipelined(const Task&) const;
+	void SchedulePipeline(Task&, const NodeDB::StateID& sidTrg);
+	void MaybeHedge(Peer&);
 
 	void InitKeys();
 	void InitIDs();
 	void RefreshOwnedUtxos();
 	void MaybeGenerateRecovery();
+	bool MaybeGenerateRecoveryDelta(const std::string& sPath);
+	template <typename TArchive> void SaveRecoveryNonStd(TArchive&, Height hMin);
 
 	struct Wanted
 	{
@@ -388,6 +524,107 @@ private:
 		IMPLEMENT_GET_PARENT_OBJ(Node, m_TxDeferred)
 	} m_TxDeferred;
 
+	struct TxValidator
+	{
+		struct Element
+		{
+			typedef std::unique_ptr<Element> Ptr;
+
+			Transaction::Ptr m_pTx;
+			const Transaction* m_pValidated = nullptr; // m_pTx is moved out while it's handled on the node thread
+			std::unique_ptr<Merkle::Hash> m_pCtx;
+			PeerID m_Sender;
+			bool m_Fluff;
+			uint32_t m_Time_ms;
+
+			// context-free validation result
+			bool m_bValid;
+			HeightRange m_Height;
+			TxStats m_Stats;
+		};
+
+		std::mutex m_Mutex;
+		std::condition_variable m_NewTask;
+		std::map<PeerID, std::deque<Element::Ptr> > m_mapIn; // per sender
+		std::deque<Element::Ptr> m_queOut;
+		PeerID m_pidNext; // round-robin cursor
+		uint32_t m_nIn = 0;
+		bool m_Run = false;
+
+		uint32_t m_BatchMax;
+		uint32_t m_BatchDelay_ms;
+
+		uint32_t m_Pending = 0; // not handled yet. Accessed from the node thread only
+		const Element* m_pCurrent = nullptr; // being handled on the node thread
+
+		std::vector<MyThread> m_vThreads;
+		io::AsyncEvent::Ptr m_pEvtDone;
+
+		bool IsEnabled() const { return !m_vThreads.empty(); }
+		bool IsSaturated() const;
+		void Initialize();
+		void Stop();
+		bool Push(Element::Ptr&&);
+		void OnDone();
+		void RunThread(const Rules&);
+		void SelectBatch(std::vector<Element::Ptr>&);
+		void OnInvalid(const PeerID&); // lowers the sender rating by PenaltyInvalidTx. The node-thread validation (no validator threads) doesn't penalize
+		static void Validate(Element&);
+		static void ValidateBatch(Element** pp, size_t n);
+
+		~TxValidator() { Stop(); }
+
+		IMPLEMENT_GET_PARENT_OBJ(Node, m_TxValidator)
+	} m_TxValidator;
+
+	// Writes the recovery deltas, and builds the full recovery from the previous full one and the deltas. Works on files only, doesn't access the node data
+	struct RecoveryWriter
+	{
+		struct Task
+		{
+			typedef std::unique_ptr<Task> Ptr;
+
+			Block::ChainWorkProof m_Cwp;
+			Block::SystemState::ID m_Prev;
+			ByteBuffer m_Body; // delta body, prepared by the node
+			std::string m_sPath;
+
+			// if specified - the new full recovery is built, then the base and the deltas are deleted
+			std::string m_sPathFull;
+			std::string m_sBase;
+			std::vector<std::string> m_vDeltas;
+
+			bool m_Ok = false;
+		};
+
+		std::mutex m_Mutex;
+		std::condition_variable m_NewTask;
+		std::deque<Task::Ptr> m_queIn;
+		std::deque<Task::Ptr> m_queOut;
+		bool m_Run = false;
+
+		MyThread m_Thread;
+		io::AsyncEvent::Ptr m_pEvtDone;
+
+		// the current chain: the full recovery, and the deltas over it. Accessed from the node thread only
+		std::string m_sBase;
+		std::vector<std::string> m_vDeltas;
+		Block::SystemState::ID m_Tip;
+
+		void Reset() { m_sBase.clear(); m_vDeltas.clear(); }
+		void Push(Task::Ptr&&);
+		void Stop();
+		void OnDone();
+		void RunThread(const Rules&);
+		static void Execute(Task&);
+
+		~RecoveryWriter() { Stop(); }
+
+		IMPLEMENT_GET_PARENT_OBJ(Node, m_RecoveryWriter)
+	} m_RecoveryWriter;
+
+	bool PrepareRecoveryDelta(RecoveryWriter::Task&, const Block::SystemState::ID& idPrev);
+
 	void OnTransactionDeferred(Transaction::Ptr&&, std::unique_ptr<Merkle::Hash>&&, const PeerID*, bool bFluff);
 	uint8_t OnTransactionStem(Transaction::Ptr&&, std::ostream* pExtraInfo);
 	uint8_t OnTransactionFluff(Transaction::Ptr&&, std::ostream* pExtraInfo, const PeerID*, Dandelion::Element*);
@@ -419,10 +656,14 @@ private:
 		} m_W;
 
 		static void CalcMsgKey(NodeDB::WalkerBbs::Data&);
+		BbsStore m_Store;
+		void Open();
+
 		uint32_t m_LastCleanup_ms = 0;
 		void Cleanup();
 		void MaybeCleanup();
 		bool IsInLimits() const;
+		void get_Limits(NodeDB::BbsTotals&) const;
 
 		struct Subscription
 		{
@@ -448,8 +689,6 @@ private:
 		Subscription::BbsSet m_Subscribed;
 		Timestamp m_HighestPosted_s = 0;
 
-		NodeDB::BbsTotals m_Totals;
-
 		IMPLEMENT_GET_PARENT_OBJ(Node, m_Bbs)
 	} m_Bbs;
 
@@ -540,6 +779,23 @@ private:
 		io::Timer::Ptr m_pTimerRequest;
 		io::Timer::Ptr m_pTimerPeers;
 
+		// per-connection dictionaries for compressed block packs, created on demand
+		std::unique_ptr<LzStream::Encoder> m_pBodyEncoder;
+		std::unique_ptr<LzStream::Decoder> m_pBodyDecoder;
+
+		struct Throughput
+		{
+			uint32_t m_BlocksPerSec = 0; // moving average. 0: not measured yet
+			uint32_t m_Rtt_ms = 0; // moving average of the response latency, excluding the transfer time
+			uint32_t m_LastPack = 0; // num of blocks in the last received pack
+			uint32_t m_LastDone_ms = 0;
+
+			void OnPack(uint32_t nBlocks, uint32_t dt_ms, uint32_t dtTransfer_ms);
+			uint32_t get_PackSize(const Config::SyncCtl&, uint32_t nMax) const;
+			uint32_t get_Expected_ms(uint32_t nBlocks) const;
+
+		} m_Throughput;
+
 		Peer(Node& n) :m_This(n) {}
 
 		void TakeTasks();
@@ -559,7 +815,7 @@ private:
 		void MaybeSendDependent();
 		void OnChocking();
 		void SetTxCursor(TxPool::Fluff::Element*);
-		bool GetBlock(proto::BodyBuffers&, const NodeDB::StateID&, const proto::GetBodyPack&, bool bActive);
+		bool GetBlock(proto::BodyBuffersRef&, const NodeDB::StateID&, const proto::GetBodyPack&, bool bActive);
 
 		bool IsChocking(size_t nExtra = 0);
 		bool ShouldAssignTasks();
@@ -569,7 +825,9 @@ private:
 		void OnFirstTaskDone();
 		void OnFirstTaskDone(NodeProcessor::DataStatus::Enum);
 		void ModifyRatingWrtData(size_t nSize);
+		void ModifyThroughput(uint32_t nBlocks, size_t nSize);
 		void SendHdrs(NodeDB::StateID&, uint32_t nCount);
+		void SendBodyPack(const proto::BodyPackRef&);
 		void SendTx(Transaction::Ptr& ptx, bool bFluff, const Merkle::Hash* pCtx = nullptr);
 
 		struct ISelector {
@@ -607,6 +865,7 @@ private:
 		virtual void OnMsg(proto::GetBodyPack&&) override;
 		virtual void OnMsg(proto::Body&&) override;
 		virtual void OnMsg(proto::BodyPack&&) override;
+		virtual void OnMsg(proto::BodyPackZ&&) override;
 		virtual void OnMsg(proto::NewTransaction&&) override;
 		virtual void OnMsg(proto::HaveTransaction&&) override;
 		virtual void OnMsg(proto::GetTransaction&&) override;
@@ -734,6 +993,20 @@ private:
 		Peer* m_pFinalizer = NULL;
 		Task::Ptr m_pTaskToFinalize;
 
+		NodeProcessor::BlockTemplate m_Template;
+
+		struct TemplateStats
+		{
+			uint64_t m_Full = 0; // selected from the whole pool
+			uint64_t m_Reused = 0; // the newcomers didn't make it
+			uint32_t m_Last_ms = 0;
+			uint32_t m_Max_ms = 0;
+			uint64_t m_Total_ms = 0;
+
+			void OnBuilt(NodeProcessor::BlockTemplate::Build, uint32_t dt_ms);
+
+		} m_TemplateStats;
+
 		std::mutex m_Mutex;
 		Task::Ptr m_pTask; // currently being-mined
 
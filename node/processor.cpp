@@ -22,6 +22,7 @@
 #include "../utility/logger_checkpoints.h"
 #include "../utility/blobmap.h"
 #include <condition_variable>
+#include <chrono>
 #include <cctype>
 
 namespace beam {
@@ -88,9 +89,14 @@ void NodeProcessor::Initialize(const char* szPath)
 
 void NodeProcessor::Initialize(const char* szPath, const StartParams& sp)
 {
-	m_DB.Open(szPath);
+	m_DB.Open(szPath, sp.m_Wal);
 	m_DbTx.Start(m_DB);
 
+	InitializeBlockStore(szPath, sp.m_BlockStore);
+
+	if (sp.m_Wal)
+		m_DbReaders.Open(szPath, m_Blocks.IsOpen() ? &m_Blocks : nullptr); // the snapshots may reference the stored bodies too
+
 	if (sp.m_CheckIntegrity)
 	{
 		LOG_INFO() << "DB integrity check...";
@@ -143,6 +149,7 @@ void NodeProcessor::Initialize(const char* szPath, const StartParams& sp)
 	m_DB.get_Cursor(m_Cursor.m_Sid);
 	m_Mmr.m_States.m_Count = m_Cursor.m_Sid.m_Height - Rules::HeightGenesis;
 	InitCursor(false);
+	InitializeStatesMmr(sp);
 
 	ZeroObject(m_SyncData);
 
@@ -165,6 +172,7 @@ void NodeProcessor::Initialize(const char* szPath, const StartParams& sp)
 	m_Mmr.m_Shielded.m_Count += m_Extra.m_ShieldedOutputs;
 
 	InitializeMapped(szPath);
+	InitializeShieldedPool(szPath);
 	m_Extra.m_Txos = get_TxosBefore(m_Cursor.m_ID.m_Height + 1);
 
 	bool bRebuildNonStd = false;
@@ -351,27 +359,51 @@ int My_strcmpi(const char* sz1, const char* sz2)
 	return 0;
 }
 
-void NodeProcessor::get_MappingPath(std::string& sPath, const char* sz)
+void NodeProcessor::get_MappingPath(std::string& sPath, const char* sz, const char* szSufix)
 {
 	// derive mapping path from db path
 	sPath = sz;
 
-	static const char szSufix[] = ".db";
-	const size_t nSufix = _countof(szSufix) - 1;
+	static const char szDbSufix[] = ".db";
+	const size_t nSufix = _countof(szDbSufix) - 1;
 
-	if ((sPath.size() >= nSufix) && !My_strcmpi(sPath.c_str() + sPath.size() - nSufix, szSufix))
+	if ((sPath.size() >= nSufix) && !My_strcmpi(sPath.c_str() + sPath.size() - nSufix, szDbSufix))
 		sPath.resize(sPath.size() - nSufix);
 
-	sPath += "-utxo-image.bin";
+	sPath += szSufix;
 }
 
-bool NodeProcessor::InitMapping(const char* sz, bool bForceReset)
+void NodeProcessor::InitializeStatesMmr(const StartParams& sp)
 {
-	// derive mapping path from db path
-	std::string sPath;
-	get_MappingPath(sPath, sz);
+	m_Mmr.m_States.m_Lru.SetMax(sp.m_StatesMmrCache);
 
-	Mapped::Stamp us;
+	bool bStored = !!m_DB.ParamIntGetDef(NodeDB::ParamID::StatesHashes);
+	if (sp.m_StatesHashes)
+	{
+		if (bStored)
+			m_Mmr.m_States.m_StoreHashes = true;
+		else
+		{
+			LOG_INFO() << "Building states hashes...";
+			m_Mmr.m_States.BuildHashes();
+			m_DB.ParamIntSet(NodeDB::ParamID::StatesHashes, 1);
+		}
+	}
+	else
+	{
+		m_Mmr.m_States.m_StoreHashes = false;
+
+		if (bStored)
+		{
+			// won't be maintained
+			m_DB.StreamsDelAll(NodeDB::StreamType::StatesHashes, NodeDB::StreamType::StatesHashes);
+			m_DB.ParamDelSafe(NodeDB::ParamID::StatesHashes);
+		}
+	}
+}
+
+void NodeProcessor::get_MappingStamp(Mapped::Stamp& us, bool bForceReset)
+{
 	Blob blob(us);
 
 	// don't use the saved image if no height: we may contain treasury UTXOs, but no way to verify the contents
@@ -380,10 +412,68 @@ bool NodeProcessor::InitMapping(const char* sz, bool bForceReset)
 		us = 1U;
 		us.Negate();
 	}
+}
+
+bool NodeProcessor::InitMapping(const char* sz, bool bForceReset)
+{
+	// derive mapping path from db path
+	std::string sPath;
+	get_MappingPath(sPath, sz);
+
+	Mapped::Stamp us;
+	get_MappingStamp(us, bForceReset);
 
 	return m_Mapped.Open(sPath.c_str(), us);
 }
 
+void NodeProcessor::InitializeBlockStore(const char* sz, bool bAppend)
+{
+	uint64_t nStamp = m_DB.ParamIntGetDef(NodeDB::ParamID::BlocksStamp);
+	if (!nStamp)
+	{
+		if (!bAppend)
+			return; // never used
+
+		ECC::GenRandom(&nStamp, sizeof(nStamp));
+		std::setmax(nStamp, 1U);
+
+		m_DB.ParamIntSet(NodeDB::ParamID::BlocksStamp, nStamp);
+	}
+
+	// once used - must be opened, the DB may reference the bodies stored there
+	std::string sPath;
+	get_MappingPath(sPath, sz, "-blocks");
+
+	m_Blocks.Open(sPath.c_str(), nStamp);
+	m_DB.set_BlockStore(&m_Blocks, bAppend);
+}
+
+void NodeProcessor::InitializeShieldedPool(const char* sz)
+{
+	std::string sPath;
+	get_MappingPath(sPath, sz, "-shielded-pool.bin");
+
+	Mapped::Stamp us;
+	get_MappingStamp(us, false);
+
+	if (m_ShieldedPool.Open(sPath.c_str(), us, m_Extra.m_ShieldedOutputs))
+		return;
+
+	LOG_INFO() << "Rebuilding shielded pool...";
+
+	ECC::Point::Storage pBuf[0x400];
+	for (TxoID id0 = 0; id0 < m_Extra.m_ShieldedOutputs; )
+	{
+		uint32_t n = static_cast<uint32_t>(std::min<TxoID>(_countof(pBuf), m_Extra.m_ShieldedOutputs - id0));
+		m_DB.ShieldedRead(id0, pBuf, n);
+
+		for (uint32_t i = 0; i < n; i++)
+			m_ShieldedPool.Append(pBuf[i]);
+
+		id0 += n;
+	}
+}
+
 void NodeProcessor::LogSyncData()
 {
 	if (!IsFastSync())
@@ -432,7 +522,9 @@ void NodeProcessor::CommitMappingAndDB()
 {
 	Mapped::Stamp us;
 
-	bool bFlushMapping = (m_Mapped.IsOpen() && m_Mapped.get_Hdr().m_Dirty);
+	bool bFlushMapping =
+		(m_Mapped.IsOpen() && m_Mapped.get_Hdr().m_Dirty) ||
+		(m_ShieldedPool.IsOpen() && m_ShieldedPool.get_Hdr().m_Dirty);
 
 	if (bFlushMapping)
 	{
@@ -447,10 +539,22 @@ void NodeProcessor::CommitMappingAndDB()
 		m_DB.ParamSet(NodeDB::ParamID::MappingStamp, nullptr, &blob);
 	}
 
+	if (m_Blocks.IsOpen())
+		m_Blocks.Flush(); // the DB may reference the appended bodies
+
 	m_DbTx.Commit();
 
+	if (m_Blocks.IsOpen())
+		m_Blocks.OnCommitted();
+
 	if (bFlushMapping)
-		m_Mapped.FlushStrict(us);
+	{
+		// both are stamped, even if only one was modified
+		if (m_Mapped.IsOpen())
+			m_Mapped.FlushStrict(us);
+		if (m_ShieldedPool.IsOpen())
+			m_ShieldedPool.FlushStrict(us);
+	}
 }
 
 void NodeProcessor::Vacuum()
@@ -788,7 +892,11 @@ void NodeProcessor::EnumCongestions()
 const uint64_t* NodeProcessor::get_CachedRows(const NodeDB::StateID& sid, Height nCountExtra)
 {
 	EnumCongestionsInternal();
+	return FindCachedRows(sid, nCountExtra);
+}
 
+const uint64_t* NodeProcessor::FindCachedRows(const NodeDB::StateID& sid, Height nCountExtra)
+{
 	CongestionCache::TipCongestion* pVal = m_CongestionCache.Find(sid);
 	if (pVal)
 	{
@@ -1025,17 +1133,47 @@ private:
 
 	Sigma::CmListVec m_Lst;
 
+	// points read directly from the shielded pool, no copy
+	struct CmListPool
+		:public Sigma::CmList
+	{
+		const ECC::Point::Storage* m_p;
+		uint32_t m_Count;
+
+		virtual bool get_At(ECC::Point::Storage& res, uint32_t iIdx) override
+		{
+			if (iIdx >= m_Count)
+				return false;
+
+			res = m_p[iIdx];
+			return true;
+		}
+	} m_LstPool;
+
+	Sigma::CmList* m_pLst = &m_Lst;
+
 	bool IsValid(const TxKernelShieldedInput&, Height hScheme, std::vector<ECC::Scalar::Native>& vBuf, ECC::InnerProduct::BatchContext&);
 
 	virtual Sigma::CmList& get_List() override
 	{
-		return m_Lst;
+		return *m_pLst;
 	}
 
 	virtual void PrepareList(NodeProcessor& np, const Node& n) override
 	{
-		m_Lst.m_vec.resize(s_Chunk); // will allocate if empty
-		np.get_DB().ShieldedRead(n.m_ID.m_Value + n.m_Min, &m_Lst.m_vec.front() + n.m_Min, n.m_Max - n.m_Min);
+		const ShieldedPool& sp = np.m_ShieldedPool;
+		if (sp.IsOpen() && (sp.get_Count() >= n.m_ID.m_Value + n.m_Max))
+		{
+			m_LstPool.m_p = sp.get_At(n.m_ID.m_Value);
+			m_LstPool.m_Count = n.m_Max;
+			m_pLst = &m_LstPool;
+		}
+		else
+		{
+			m_Lst.m_vec.resize(s_Chunk); // will allocate if empty
+			np.get_DB().ShieldedRead(n.m_ID.m_Value + n.m_Min, &m_Lst.m_vec.front() + n.m_Min, n.m_Max - n.m_Min);
+			m_pLst = &m_Lst;
+		}
 	}
 
 	struct Walker
@@ -2172,27 +2310,6 @@ void NodeProcessor::ProofBuilderHard::OnProof(Merkle::Hash& hv, bool bNewOnRight
 	m_Proof.back() = hv;
 }
 
-uint64_t NodeProcessor::ProcessKrnMmr(Merkle::Mmr& mmr, std::vector<TxKernel::Ptr>& vKrn, const Merkle::Hash& idKrn, TxKernel::Ptr* ppRes)
-{
-	uint64_t iRet = uint64_t (-1);
-
-	for (size_t i = 0; i < vKrn.size(); i++)
-	{
-		TxKernel::Ptr& p = vKrn[i];
-		const Merkle::Hash& hv = p->m_Internal.m_ID;
-		mmr.Append(hv);
-
-		if (hv == idKrn)
-		{
-			iRet = i; // found
-			if (ppRes)
-				ppRes->swap(p);
-		}
-	}
-
-	return iRet;
-}
-
 struct NodeProcessor::ProofBuilder_PrevState
 	:public ProofBuilder
 {
@@ -2231,6 +2348,19 @@ struct NodeProcessor::ProofBuilder_PrevState
 };
 
 Height NodeProcessor::get_ProofKernel(Merkle::Proof& proof, TxKernel::Ptr* ppRes, const Merkle::Hash& idKrn)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	m_ProofKernelStats.m_Requests++;
+
+	Height h = get_ProofKernelInternal(proof, ppRes, idKrn);
+
+	auto dt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0);
+	m_ProofKernelStats.AddLatency(dt.count());
+
+	return h;
+}
+
+Height NodeProcessor::get_ProofKernelInternal(Merkle::Proof& proof, TxKernel::Ptr* ppRes, const Merkle::Hash& idKrn)
 {
 	NodeDB::StateID sid;
 	sid.m_Height = m_DB.FindKernel(idKrn);
@@ -2238,17 +2368,32 @@ Height NodeProcessor::get_ProofKernel(Merkle::Proof& proof, TxKernel::Ptr* ppRes
 		return sid.m_Height;
 
 	sid.m_Row = FindActiveAtStrict(sid.m_Height);
-	TxVectors::Eternal txve;
-	ReadKrns(sid.m_Row, txve);
 
-	Merkle::FixedMmr mmr;
-	mmr.Resize(txve.m_vKernels.size());
-	auto iTrg = ProcessKrnMmr(mmr, txve.m_vKernels, idKrn, ppRes);
+	KrnMmrCache::Entry* pE = m_KrnMmrCache.Find(sid.m_Height);
+	if (pE)
+		m_ProofKernelStats.m_CacheHits++;
+
+	if (!pE || ppRes)
+	{
+		TxVectors::Eternal txve;
+		ReadKrns(sid.m_Row, txve);
+
+		if (!pE)
+			pE = &m_KrnMmrCache.Create(sid.m_Height, txve.m_vKernels);
+
+		if (ppRes)
+		{
+			uint32_t i = pE->Find(idKrn);
+			if (i < txve.m_vKernels.size())
+				ppRes->swap(txve.m_vKernels[i]);
+		}
+	}
 
-	if (std::numeric_limits<uint64_t>::max() == iTrg)
+	uint32_t iTrg = pE->Find(idKrn);
+	if (static_cast<uint32_t>(-1) == iTrg)
 		OnCorrupted();
 
-	mmr.get_Proof(proof, iTrg);
+	pE->m_Mmr.get_Proof(proof, iTrg);
 
 	if (sid.m_Height >= Rules::get().pForks[3].m_Height)
 	{
@@ -3119,39 +3264,66 @@ bool NodeProcessor::KrnWalkerRecognize::OnKrn(const TxKernel& krn)
 	return true;
 }
 
-void NodeProcessor::Recognizer::Recognize(const TxKernelShieldedOutput& v, Height h, uint32_t nKrnIdx)
+void NodeProcessor::Recognizer::ShieldedRecovered::Recover(Height h, const ViewerKeys& vk)
 {
-	TxoID nID = m_Extra.m_ShieldedOutputs++;
-
-	ViewerKeys vk;
-	m_Handler.get_ViewerKeys(vk);
+	const TxKernelShieldedOutput& v = *m_pKrn;
+	const ShieldedTxo& txo = v.m_Txo;
 
-	for (Key::Index nIdx = 0; nIdx < vk.m_nSh; nIdx++)
+	for (m_nIdx = 0; m_nIdx < vk.m_nSh; m_nIdx++)
 	{
-		const ShieldedTxo& txo = v.m_Txo;
-
-		ShieldedTxo::Data::Params pars;
-		if (!pars.m_Ticket.Recover(txo.m_Ticket, vk.m_pSh[nIdx]))
+		if (!m_Pars.m_Ticket.Recover(txo.m_Ticket, vk.m_pSh[m_nIdx]))
 			continue;
 
 		ECC::Oracle oracle;
 		oracle << v.m_Msg;
 
-		if (!pars.m_Output.Recover(txo, pars.m_Ticket.m_SharedSecret, h, oracle))
-			continue;
+		if (m_Pars.m_Output.Recover(txo, m_Pars.m_Ticket.m_SharedSecret, h, oracle))
+		{
+			m_Recovered = true;
+			return;
+		}
+	}
 
-		proto::Event::Shielded evt;
-		evt.m_TxoID = nID;
-		pars.ToID(evt.m_CoinID);
-		evt.m_CoinID.m_Key.m_nIdx = nIdx;
-		evt.m_Flags = proto::Event::Flags::Add;
+	m_Recovered = false;
+}
 
-		EventKey::Shielded key = pars.m_Ticket.m_SpendPk;
-		key.m_Y |= EventKey::s_FlagShielded;
+void NodeProcessor::Recognizer::Recognize(const TxKernelShieldedOutput& v, Height h, uint32_t nKrnIdx)
+{
+	TxoID nID = m_Extra.m_ShieldedOutputs++;
 
-		AddEvent(h, EventKey::s_IdxKernel + nKrnIdx, evt, key);
-		break;
+	ShieldedRecovered sr;
+	const ShieldedRecovered* pSr = &sr;
+
+	if (m_pShieldedPre)
+	{
+		assert(m_pShieldedPre->m_iNext < m_pShieldedPre->m_v.size());
+		pSr = &m_pShieldedPre->m_v[m_pShieldedPre->m_iNext++];
+		assert(pSr->m_pKrn == &v);
+	}
+	else
+	{
+		ViewerKeys vk;
+		m_Handler.get_ViewerKeys(vk);
+
+		sr.m_pKrn = &v;
+		sr.Recover(h, vk);
 	}
+
+	if (!pSr->m_Recovered)
+		return;
+
+	const ShieldedTxo::Data::Params& pars = pSr->m_Pars;
+
+	proto::Event::Shielded evt;
+	evt.m_TxoID = nID;
+	pars.ToID(evt.m_CoinID);
+	evt.m_CoinID.m_Key.m_nIdx = pSr->m_nIdx;
+	evt.m_Flags = proto::Event::Flags::Add;
+
+	EventKey::Shielded key = pars.m_Ticket.m_SpendPk;
+	key.m_Y |= EventKey::s_FlagShielded;
+
+	AddEvent(h, EventKey::s_IdxKernel + nKrnIdx, evt, key);
 }
 
 void NodeProcessor::Recognizer::Recognize(const Output& x, Height h, Key::IPKdf& keyViewer)
@@ -3398,64 +3570,158 @@ bool NodeProcessor::ViewerKeys::IsEmpty() const
 
 void NodeProcessor::RescanOwnedTxos()
 {
+	// Both the txos and the shielded outputs are recovered in parallel in batches. Then the events are added on this thread
+	// in the original order, hence the result is the same as for the sequential scan.
 	m_DB.DeleteEventsFrom(Rules::HeightGenesis - 1);
 
 	MyRecognizer rec(*this);
 
+	Executor& ex = get_Executor();
+	uint32_t nThreads = ex.get_Threads();
+
+	ViewerKeys vk;
+	get_ViewerKeys(vk);
+
+	Height h0 = Rules::get().pForks[2].m_Height;
+	bool bShielded = !vk.IsEmpty() && (m_Cursor.m_Sid.m_Height >= h0);
+
+	// progress units: txos, then heights with shielded kernels
+	uint64_t nProgressTxos = get_TxosBefore(m_Cursor.m_ID.m_Height + 1);
+	uint64_t nProgressTotal = nProgressTxos;
+	if (bShielded)
+		nProgressTotal += m_Cursor.m_Sid.m_Height - h0 + 1;
+
 	struct TxoRecover
-		:public ITxoRecover
+		:public ITxoWalker
 	{
+		struct Txo
+		{
+			TxoID m_ID;
+			Height m_hCreate;
+			Height m_hSpend;
+			Output m_Outp;
+			CoinID m_Cid;
+			Output::User m_User;
+			bool m_Recovered;
+		};
+
+		std::vector<Txo> m_vBatch;
+		uint32_t m_nBatchMax;
+
+		NodeProcessor& m_This;
+		Key::IPKdf& m_Key;
 		MyRecognizer& m_Rec;
+		uint64_t m_nProgressTotal;
 		uint32_t m_Total = 0;
 		uint32_t m_Unspent = 0;
 
-		TxoRecover(Key::IPKdf& key, NodeProcessor& x, MyRecognizer& rec)
-			:ITxoRecover(key)
+		TxoRecover(NodeProcessor& x, Key::IPKdf& key, MyRecognizer& rec)
+			:m_This(x)
+			,m_Key(key)
 			,m_Rec(rec)
 		{
 		}
 
-		virtual bool OnTxo(const NodeDB::WalkerTxo& wlk, Height hCreate, Output& outp, const CoinID& cid, const Output::User& user) override
+		virtual bool OnTxo(const NodeDB::WalkerTxo& wlk, Height hCreate) override
 		{
-			if (cid.IsDummy())
-			{
-				m_Rec.m_Handler.m_Proc.OnDummy(cid, hCreate);
+			if (TxoIsNaked(wlk.m_Value))
 				return true;
+
+			Txo& x = m_vBatch.emplace_back();
+			x.m_ID = wlk.m_ID;
+			x.m_hCreate = hCreate;
+			x.m_hSpend = wlk.m_SpendHeight;
+
+			Deserializer der;
+			der.reset(wlk.m_Value.p, wlk.m_Value.n);
+			der & x.m_Outp;
+
+			if (m_vBatch.size() >= m_nBatchMax)
+				Flush();
+
+			return true;
+		}
+
+		struct MyTask
+			:public Executor::TaskSync
+		{
+			TxoRecover* m_pThis;
+
+			virtual void Exec(Executor::Context& ctx) override
+			{
+				std::vector<Txo>& v = m_pThis->m_vBatch;
+
+				uint32_t i0, nCount;
+				ctx.get_Portion(i0, nCount, static_cast<uint32_t>(v.size()));
+
+				for (uint32_t i = i0; i < i0 + nCount; i++)
+				{
+					Txo& x = v[i];
+					x.m_Recovered = x.m_Outp.Recover(x.m_hCreate, m_pThis->m_Key, x.m_Cid, &x.m_User);
+				}
+			}
+		};
+
+		void Flush()
+		{
+			if (m_vBatch.empty())
+				return;
+
+			MyTask t;
+			t.m_pThis = this;
+			m_This.get_Executor().ExecAll(t);
+
+			for (size_t i = 0; i < m_vBatch.size(); i++)
+			{
+				const Txo& x = m_vBatch[i];
+				if (x.m_Recovered)
+					OnRecovered(x);
+			}
+
+			m_This.InitializeUtxosProgress(m_vBatch.back().m_ID + 1, m_nProgressTotal);
+			m_vBatch.clear();
+		}
+
+		void OnRecovered(const Txo& x)
+		{
+			if (x.m_Cid.IsDummy())
+			{
+				m_Rec.m_Handler.m_Proc.OnDummy(x.m_Cid, x.m_hCreate);
+				return;
 			}
 
 			proto::Event::Utxo evt;
 			evt.m_Flags = proto::Event::Flags::Add;
-			evt.m_Cid = cid;
-			evt.m_Commitment = outp.m_Commitment;
-			evt.m_Maturity = outp.get_MinMaturity(hCreate);
-			evt.m_User = user;
+			evt.m_Cid = x.m_Cid;
+			evt.m_Commitment = x.m_Outp.m_Commitment;
+			evt.m_Maturity = x.m_Outp.get_MinMaturity(x.m_hCreate);
+			evt.m_User = x.m_User;
 
-			const EventKey::Utxo& key = outp.m_Commitment;
-			m_Rec.m_Recognizer.AddEvent(hCreate, EventKey::s_IdxOutput, evt, key);
+			const EventKey::Utxo& key = x.m_Outp.m_Commitment;
+			m_Rec.m_Recognizer.AddEvent(x.m_hCreate, EventKey::s_IdxOutput, evt, key);
 
 			m_Total++;
 
-			if (MaxHeight == wlk.m_SpendHeight)
+			if (MaxHeight == x.m_hSpend)
 				m_Unspent++;
 			else
 			{
 				evt.m_Flags = 0;
-				m_Rec.m_Recognizer.AddEvent(wlk.m_SpendHeight, EventKey::s_IdxInput, evt);
+				m_Rec.m_Recognizer.AddEvent(x.m_hSpend, EventKey::s_IdxInput, evt);
 			}
-
-			return true;
 		}
 	};
 
-	ViewerKeys vk;
-	get_ViewerKeys(vk);
-
 	if (vk.m_pMw)
 	{
 		LOG_INFO() << "Rescanning owned Txos...";
 
-		TxoRecover wlk(*vk.m_pMw, *this, rec);
+		TxoRecover wlk(*this, *vk.m_pMw, rec);
+		wlk.m_nBatchMax = nThreads * 256;
+		wlk.m_nProgressTotal = nProgressTotal;
+
 		EnumTxos(wlk);
+		wlk.Flush();
 
 		LOG_INFO() << "Recovered " << wlk.m_Unspent << "/" << wlk.m_Total << " unspent/total Txos";
 	}
@@ -3469,14 +3735,93 @@ void NodeProcessor::RescanOwnedTxos()
 		LOG_INFO() << "Rescanning shielded Txos...";
 
 		// shielded items
-		Height h0 = Rules::get().pForks[2].m_Height;
-		if (m_Cursor.m_Sid.m_Height >= h0)
+		if (bShielded)
 		{
 			TxoID nOuts = m_Extra.m_ShieldedOutputs;
 			m_Extra.m_ShieldedOutputs = 0;
 
+			struct KrnWalkerCollect
+				:public KrnWalkerShielded
+			{
+				Recognizer::ShieldedPreRecovered* m_pPre;
+				std::vector<Height>* m_pHeights;
+
+				virtual bool OnKrnEx(const TxKernelShieldedOutput& krn) override
+				{
+					Recognizer::ShieldedRecovered& x = m_pPre->m_v.emplace_back();
+					x.m_pKrn = &krn;
+					m_pHeights->push_back(m_Height);
+					return true;
+				}
+			};
+
+			struct MyTask
+				:public Executor::TaskSync
+			{
+				Recognizer::ShieldedPreRecovered* m_pPre;
+				const std::vector<Height>* m_pHeights;
+				const ViewerKeys* m_pVk;
+
+				virtual void Exec(Executor::Context& ctx) override
+				{
+					uint32_t i0, nCount;
+					ctx.get_Portion(i0, nCount, static_cast<uint32_t>(m_pPre->m_v.size()));
+
+					for (uint32_t i = i0; i < i0 + nCount; i++)
+						m_pPre->m_v[i].Recover(m_pHeights->at(i), *m_pVk);
+				}
+			};
+
+			const Height nChunk = 512;
+			std::vector<TxVectors::Eternal> vKrns;
+			std::vector<Height> vHeights;
+
+			Recognizer::ShieldedPreRecovered pre;
 			KrnWalkerRecognize wlkKrn(rec.m_Recognizer);
-			EnumKernels(wlkKrn, HeightRange(h0, m_Cursor.m_Sid.m_Height));
+
+			for (Height h = h0; h <= m_Cursor.m_Sid.m_Height; )
+			{
+				Height h1 = std::min(m_Cursor.m_Sid.m_Height, h + nChunk - 1);
+
+				vKrns.resize(h1 - h + 1);
+				pre.m_v.clear();
+				pre.m_iNext = 0;
+				vHeights.clear();
+
+				KrnWalkerCollect wlkCollect;
+				wlkCollect.m_pPre = &pre;
+				wlkCollect.m_pHeights = &vHeights;
+
+				for (size_t i = 0; i < vKrns.size(); i++)
+				{
+					vKrns[i].m_vKernels.clear();
+					ReadKrns(FindActiveAtStrict(h + i), vKrns[i]);
+
+					wlkCollect.m_Height = h + i;
+					wlkCollect.Process(vKrns[i].m_vKernels);
+				}
+
+				MyTask t;
+				t.m_pPre = &pre;
+				t.m_pHeights = &vHeights;
+				t.m_pVk = &vk;
+				ex.ExecAll(t);
+
+				rec.m_Recognizer.m_pShieldedPre = &pre;
+
+				for (size_t i = 0; i < vKrns.size(); i++)
+				{
+					wlkKrn.m_Height = h + i;
+					wlkKrn.m_nKrnIdx = 0;
+					wlkKrn.ProcessHeight(vKrns[i].m_vKernels);
+				}
+
+				rec.m_Recognizer.m_pShieldedPre = nullptr;
+				assert(pre.m_iNext == pre.m_v.size());
+
+				h = h1 + 1;
+				InitializeUtxosProgress(nProgressTxos + (h - h0), nProgressTotal);
+			}
 
 			assert(m_Extra.m_ShieldedOutputs == nOuts);
 			nOuts; // supporess unused var warning in release
@@ -3847,6 +4192,9 @@ bool NodeProcessor::HandleKernelType(const TxKernelShieldedOutput& krn, BlockInt
 			m_DB.ShieldedResize(m_Extra.m_ShieldedOutputs + 1, m_Extra.m_ShieldedOutputs);
 			m_DB.ShieldedWrite(m_Extra.m_ShieldedOutputs, &pt_s, 1);
 
+			assert(m_ShieldedPool.get_Count() == m_Extra.m_ShieldedOutputs);
+			m_ShieldedPool.Append(pt_s);
+
 			// Append state hash
 			ECC::Hash::Value hvState;
 			if (m_Extra.m_ShieldedOutputs)
@@ -3886,6 +4234,7 @@ bool NodeProcessor::HandleKernelType(const TxKernelShieldedOutput& krn, BlockInt
 		{
 			m_DB.ShieldedResize(m_Extra.m_ShieldedOutputs - 1, m_Extra.m_ShieldedOutputs);
 			m_DB.ShieldedStateResize(m_Extra.m_ShieldedOutputs - 1, m_Extra.m_ShieldedOutputs);
+			m_ShieldedPool.ShrinkTo(m_Extra.m_ShieldedOutputs - 1);
 		}
 
 		if (!bic.m_SkipDefinition)
@@ -4647,7 +4996,8 @@ bool NodeProcessor::BlockInterpretCtx::BvmProcessor::Invoke(const bvm2::Contract
 struct NodeProcessor::ProcessorInfoParser
 	:public bvm2::ProcessorManager
 {
-	NodeProcessor& m_Proc;
+	NodeProcessor* m_pProc; // if not set - the headers are read from the DB
+	NodeDB& m_DB;
 
 	Height m_Height;
 	ByteBuffer m_bufParser;
@@ -4660,7 +5010,14 @@ struct NodeProcessor::ProcessorInfoParser
 	{
 		if (s.m_Height > m_Height)
 			return false;
-		return m_Proc.get_HdrAt(s);
+		if (m_pProc)
+			return m_pProc->get_HdrAt(s);
+
+		if (s.m_Height < Rules::HeightGenesis)
+			return false;
+
+		m_DB.get_State(m_DB.FindActiveStateStrict(s.m_Height), s);
+		return true;
 	}
 
 	void VarsEnum(const Blob& kMin, const Blob& kMax, IReadVars::Ptr& pOut) override
@@ -4684,7 +5041,7 @@ struct NodeProcessor::ProcessorInfoParser
 		pOut = std::make_unique<Context>();
 		auto& x = Cast::Up<Context>(*pOut);
 
-		m_Proc.m_DB.ContractDataEnum(x.m_Wlk, kMin, kMax);
+		m_DB.ContractDataEnum(x.m_Wlk, kMin, kMax);
 	}
 
 	void LogsEnum(const Blob& kMin, const Blob& kMax, const HeightPos* pPosMin, const HeightPos* pPosMax, IReadLogs::Ptr& pOut) override
@@ -4723,9 +5080,9 @@ struct NodeProcessor::ProcessorInfoParser
 		}
 
 		if (kMin.n && kMax.n)
-			m_Proc.m_DB.ContractLogEnum(x.m_Wlk, kMin, kMax, *pPosMin, *pPosMax);
+			m_DB.ContractLogEnum(x.m_Wlk, kMin, kMax, *pPosMin, *pPosMax);
 		else
-			m_Proc.m_DB.ContractLogEnum(x.m_Wlk, *pPosMin, *pPosMax);
+			m_DB.ContractLogEnum(x.m_Wlk, *pPosMin, *pPosMax);
 	}
 /*
 	bool VarGetProof(Blob& key, ByteBuffer& val, beam::Merkle::Proof&) override {
@@ -4741,14 +5098,22 @@ struct NodeProcessor::ProcessorInfoParser
 	}
 */
 	ProcessorInfoParser(NodeProcessor& p)
-		:m_Proc(p)
+		:m_pProc(&p)
+		,m_DB(p.m_DB)
 	{
 		m_Height = p.m_Cursor.m_Full.m_Height;
 	}
 
+	ProcessorInfoParser(NodeDB& db, Height h)
+		:m_pProc(nullptr)
+		,m_DB(db)
+		,m_Height(h)
+	{
+	}
+
 	bool Init()
 	{
-		m_Proc.m_DB.ParamGet(NodeDB::ParamID::RichContractParser, nullptr, nullptr, &m_bufParser);
+		m_DB.ParamGet(NodeDB::ParamID::RichContractParser, nullptr, nullptr, &m_bufParser);
 		if (m_bufParser.empty())
 			return false;
 
@@ -4782,6 +5147,26 @@ struct NodeProcessor::ProcessorInfoParser
 		Wasm::Word val = PushArgAlias(arg);
 		m_Stack.Push(val);
 	}
+
+	void get_ContractDescr(const ECC::uintBig& sid, const ECC::uintBig& cid, std::string& res, bool bFullState)
+	{
+		try
+		{
+			if (!Init())
+				return;
+
+			PushArgBoth(sid);
+			PushArgBoth(cid);
+
+			CallMethod(bFullState ? 2 : 1);
+
+			res = Execute();
+		}
+		catch (const std::exception& e)
+		{
+			LOG_WARNING() << "contract parser error: " << e.what();
+		}
+	}
 };
 
 
@@ -4816,23 +5201,14 @@ void NodeProcessor::BlockInterpretCtx::BvmProcessor::ParseExtraInfo(ContractInvo
 
 void NodeProcessor::get_ContractDescr(const ECC::uintBig& sid, const ECC::uintBig& cid, std::string& res, bool bFullState)
 {
-	try
-	{
-		ProcessorInfoParser proc(*this);
-		if (!proc.Init())
-			return;
-
-		proc.PushArgBoth(sid);
-		proc.PushArgBoth(cid);
-
-		proc.CallMethod(bFullState ? 2 : 1);
+	ProcessorInfoParser proc(*this);
+	proc.get_ContractDescr(sid, cid, res, bFullState);
+}
 
-		res = proc.Execute();
-	}
-	catch (const std::exception& e)
-	{
-		LOG_WARNING() << "contract parser error: " << e.what();
-	}
+void NodeProcessor::get_ContractDescr(NodeDB& db, Height h, const ECC::uintBig& sid, const ECC::uintBig& cid, std::string& res, bool bFullState)
+{
+	ProcessorInfoParser proc(db, h);
+	proc.get_ContractDescr(sid, cid, res, bFullState);
 }
 
 BlobMap::Entry& NodeProcessor::BlockInterpretCtx::get_ContractVar(const Blob& key, NodeDB& db)
@@ -5431,6 +5807,7 @@ void NodeProcessor::RollbackTo(Height h)
 
 	m_RecentStates.RollbackTo(h);
 	m_ValCache.OnShLo(m_Extra.m_ShieldedOutputs);
+	m_KrnMmrCache.RollbackTo(h);
 
 	m_Mmr.m_States.ShrinkTo(m_Mmr.m_States.H2I(m_Cursor.m_Sid.m_Height));
 
@@ -5968,9 +6345,76 @@ bool NodeProcessor::ValidateInputs(const ECC::Point& comm, Input::Count nCount /
 	return !m_Mapped.m_Utxo.Traverse(t);
 }
 
-size_t NodeProcessor::GenerateNewBlockInternal(BlockContext& bc, BlockInterpretCtx& bic)
+void NodeProcessor::BlockTemplate::Release(ElementVec& v, TxPool::Fluff& txp)
 {
-	Height h = m_Cursor.m_Sid.m_Height + 1;
+	for (size_t i = 0; i < v.size(); i++)
+		txp.Release(*v[i]);
+	v.clear();
+}
+
+void NodeProcessor::BlockTemplate::Reset()
+{
+	m_Valid = false;
+	if (m_pPool)
+		Release(m_vTxs, *m_pPool);
+	assert(m_vTxs.empty());
+	m_pDependent.reset();
+	m_pPool = nullptr;
+}
+
+NodeProcessor::BlockTemplate::Build NodeProcessor::PrepareTemplate(BlockContext& bc)
+{
+	BlockTemplate& t = *bc.m_pTemplate;
+
+	const Transaction* pDependent = bc.m_pParent ? bc.m_pParent->m_pValue.get() : nullptr;
+
+	if (!t.m_Valid ||
+		(t.m_pPool != &bc.m_TxPool) ||
+		(t.m_Tip != m_Cursor.m_ID) ||
+		(t.m_pDependent.get() != pDependent))
+		return BlockTemplate::Build::Full;
+
+	if (t.m_Mode != bc.m_Mode)
+		return BlockTemplate::Build::Full;
+
+	// the selected txs must still be in the pool. Otherwise the space they free may fit the txs skipped before
+	for (size_t i = 0; i < t.m_vTxs.size(); i++)
+	{
+		const TxPool::Fluff::Element& x = *t.m_vTxs[i];
+		if (!x.m_pValue || x.IsOutdated())
+			return BlockTemplate::Build::Full;
+	}
+
+	// Can any newcomer make it? Either it outranks a selected tx, or fits the remaining space
+	const TxPool::Fluff::Element* pWorst = t.m_vTxs.empty() ? nullptr : t.m_vTxs.back();
+
+	for (auto it = bc.m_TxPool.m_Queue.rbegin(); bc.m_TxPool.m_Queue.rend() != it; it++)
+	{
+		const TxPool::Fluff::Element& x = it->get_ParentObj();
+		if (x.m_Queue.m_Seq <= t.m_Seq)
+			break;
+
+		if (!x.m_pValue || x.IsOutdated())
+			continue;
+
+		if (pWorst && (x.m_Profit < pWorst->m_Profit))
+			return BlockTemplate::Build::Full;
+
+		size_t nSizeNext = t.m_nSize + x.m_Profit.m_nSize;
+		if (!t.m_Last.m_Fees)
+			nSizeNext += m_nSizeUtxoComission;
+
+		if (nSizeNext <= Rules::get().MaxBodySize)
+			return BlockTemplate::Build::Full;
+	}
+
+	t.m_Seq = bc.m_TxPool.m_Seq; // those won't make it as well until the selection changes
+	return BlockTemplate::Build::Reused;
+}
+
+size_t NodeProcessor::GenerateNewBlockInternal(BlockContext& bc, BlockInterpretCtx& bic)
+{
+	Height h = m_Cursor.m_Sid.m_Height + 1;
 
 	// Generate the block up to the allowed size.
 	// All block elements are serialized independently, their binary size can just be added to the size of the "empty" block.
@@ -6120,6 +6564,12 @@ size_t NodeProcessor::GenerateNewBlockInternal(BlockContext& bc, BlockInterpretC
 				ssc.m_Counter.m_Value = nSizeNext;
 				offset += ECC::Scalar::Native(tx.m_Offset);
 				++nTxNum;
+
+				if (bc.m_pTemplate)
+				{
+					x.m_Queue.m_Refs++;
+					bc.m_pTemplate->m_vTxs.push_back(&x);
+				}
 			}
 			else
 			{
@@ -6136,6 +6586,9 @@ size_t NodeProcessor::GenerateNewBlockInternal(BlockContext& bc, BlockInterpretC
 
 	LOG_INFO() << "GenerateNewBlock: size of block = " << ssc.m_Counter.m_Value << "; amount of tx = " << nTxNum;
 
+	if (bc.m_pTemplate)
+		bc.m_pTemplate->m_nSize = ssc.m_Counter.m_Value;
+
 	if (BlockContext::Mode::Assemble != bc.m_Mode)
 	{
 		if (bc.m_Fees)
@@ -6184,18 +6637,24 @@ void NodeProcessor::GenerateNewHdr(BlockContext& bc, BlockInterpretCtx& bic)
 		bc.m_Hdr.m_Kernels = ev.m_hvKernels;
 
 	bc.m_Hdr.m_PoW.m_Difficulty = m_Cursor.m_DifficultyNext;
-	bc.m_Hdr.m_TimeStamp = getTimestamp();
-
 	bc.m_Hdr.m_ChainWork = m_Cursor.m_Full.m_ChainWork + bc.m_Hdr.m_PoW.m_Difficulty;
 
+	SetNewTimestamp(bc.m_Hdr);
+}
+
+void NodeProcessor::SetNewTimestamp(Block::SystemState::Full& s)
+{
+	s.m_TimeStamp = getTimestamp();
+
 	// Adjust the timestamp to be no less than the moving median (otherwise the block'll be invalid)
 	Timestamp tm = get_MovingMedian() + 1;
-	std::setmax(bc.m_Hdr.m_TimeStamp, tm);
+	std::setmax(s.m_TimeStamp, tm);
 }
 
 NodeProcessor::BlockContext::BlockContext(TxPool::Fluff& txp, Key::Index nSubKey, Key::IKdf& coin, Key::IPKdf& tag)
 	:m_TxPool(txp)
 	,m_pParent(nullptr)
+	,m_pTemplate(nullptr)
 	,m_SubIdx(nSubKey)
 	,m_Coin(coin)
 	,m_Tag(tag)
@@ -6204,7 +6663,56 @@ NodeProcessor::BlockContext::BlockContext(TxPool::Fluff& txp, Key::Index nSubKey
 	m_Block.ZeroInit();
 }
 
+void CopyGeneratedBlock(NodeProcessor::GeneratedBlock& trg, const NodeProcessor::GeneratedBlock& src)
+{
+	trg.m_Hdr = src.m_Hdr;
+	trg.m_BodyP = src.m_BodyP;
+	trg.m_BodyE = src.m_BodyE;
+	trg.m_Fees = src.m_Fees;
+
+	trg.m_Block = Block::Body();
+	Cast::Down<Block::BodyBase>(trg.m_Block) = src.m_Block;
+	TxVectors::Writer(trg.m_Block, trg.m_Block).Dump(src.m_Block.get_Reader());
+}
+
 bool NodeProcessor::GenerateNewBlock(BlockContext& bc)
+{
+	if (!bc.m_pTemplate || (BlockContext::Mode::Finalize == bc.m_Mode))
+		return GenerateNewBlockRaw(bc);
+
+	BlockTemplate& t = *bc.m_pTemplate;
+	t.m_Build = PrepareTemplate(bc);
+
+	if (BlockTemplate::Build::Reused == t.m_Build)
+	{
+		CopyGeneratedBlock(bc, t.m_Last);
+		if (BlockContext::Mode::Assemble != bc.m_Mode)
+			SetNewTimestamp(bc.m_Hdr);
+
+		return true;
+	}
+
+	t.Reset();
+	t.m_pPool = &bc.m_TxPool;
+
+	if (!GenerateNewBlockRaw(bc))
+	{
+		t.Reset();
+		return false;
+	}
+
+	t.m_Tip = m_Cursor.m_ID;
+	t.m_pDependent = bc.m_pParent ? bc.m_pParent->m_pValue : nullptr;
+	t.m_Seq = bc.m_TxPool.m_Seq;
+	t.m_Mode = bc.m_Mode;
+	t.m_Valid = true;
+
+	CopyGeneratedBlock(t.m_Last, bc);
+
+	return true;
+}
+
+bool NodeProcessor::GenerateNewBlockRaw(BlockContext& bc)
 {
 	BlockInterpretCtx bic(m_Cursor.m_Sid.m_Height + 1, true);
 	bic.m_Temporary = true;
@@ -6378,12 +6886,12 @@ bool NodeProcessor::ValidateAndSummarize(TxBase::Context& ctx, const TxBase& txb
 
 bool NodeProcessor::ExtractBlockWithExtra(Block::Body& block, std::vector<Output::Ptr>& vOutsIn, const NodeDB::StateID& sid, std::vector<ContractInvokeExtraInfo>& vC)
 {
-	ByteBuffer bbE;
-	if (!GetBlockInternal(sid, &bbE, nullptr, 0, 0, 0, false, &block))
+	io::SharedBuffer bufE;
+	if (!GetBlockInternal(sid, &bufE, nullptr, 0, 0, 0, false, &block))
 		return false;
 
 	Deserializer der;
-	der.reset(bbE);
+	der.reset(bufE.data, bufE.size);
 	der & Cast::Down<TxVectors::Eternal>(block);
 
 	vOutsIn.reserve(block.m_vInputs.size());
@@ -6397,7 +6905,7 @@ bool NodeProcessor::ExtractBlockWithExtra(Block::Body& block, std::vector<Output
 		ToInputWithMaturity(inp, *pOutp, false);
 	}
 
-	bbE.clear();
+	ByteBuffer bbE;
 	if (m_DB.KrnInfoGet(sid.m_Height, bbE))
 	{
 		der.reset(bbE);
@@ -6553,9 +7061,22 @@ bool NodeProcessor::ITxoWalker_Unspent::OnTxo(const NodeDB::WalkerTxo& wlk, Heig
 
 void NodeProcessor::InitializeUtxos()
 {
+	// Bulk load. The unspent txos are read sequentially (the DB connection is single-threaded), their keys are evaluated and sorted in parallel,
+	// then the tree is built bottom-up, independent subtrees in parallel.
 	struct Walker
-		:public ITxoWalker_UnspentNaked
+		:public ITxoWalker
 	{
+		struct Txo
+		{
+			TxoID m_ID;
+			Height m_hCreate;
+			uint64_t m_nOffset;
+			uint32_t m_nSize;
+		};
+
+		std::vector<Txo> m_vTxos;
+		ByteBuffer m_Buf; // naked txos
+
 		TxoID m_TxosTotal = 0;
 		NodeProcessor& m_This;
 		Walker(NodeProcessor& x) :m_This(x) {}
@@ -6563,15 +7084,21 @@ void NodeProcessor::InitializeUtxos()
 		virtual bool OnTxo(const NodeDB::WalkerTxo& wlk, Height hCreate) override
 		{
 			m_This.InitializeUtxosProgress(wlk.m_ID, m_TxosTotal);
-			return ITxoWalker_UnspentNaked::OnTxo(wlk, hCreate);
-		}
 
-		virtual bool OnTxo(const NodeDB::WalkerTxo& wlk, Height hCreate, Output& outp) override
-		{
-			m_This.m_Extra.m_Txos = wlk.m_ID;
-			BlockInterpretCtx bic(hCreate, true);
-			if (!m_This.HandleBlockElement(outp, bic))
-				OnCorrupted();
+			if (wlk.m_SpendHeight != MaxHeight)
+				return true;
+
+			uint8_t pNaked[s_TxoNakedMax];
+			TxoToNaked(pNaked, Cast::NotConst(wlk).m_Value);
+
+			Txo& x = m_vTxos.emplace_back();
+			x.m_ID = wlk.m_ID;
+			x.m_hCreate = hCreate;
+			x.m_nOffset = m_Buf.size();
+			x.m_nSize = wlk.m_Value.n;
+
+			const uint8_t* p = reinterpret_cast<const uint8_t*>(wlk.m_Value.p);
+			m_Buf.insert(m_Buf.end(), p, p + wlk.m_Value.n);
 
 			return true;
 		}
@@ -6580,14 +7107,151 @@ void NodeProcessor::InitializeUtxos()
 	Walker wlk(*this);
 	wlk.m_TxosTotal = get_TxosBefore(m_Cursor.m_ID.m_Height + 1);
 	EnumTxos(wlk);
+
+	if (wlk.m_vTxos.size() > std::numeric_limits<uint32_t>::max())
+		OnCorrupted();
+
+	std::vector<UtxoTree::BulkEntry> vEntries;
+	vEntries.resize(wlk.m_vTxos.size());
+
+	Executor& ex = get_Executor();
+	uint32_t nThreads = ex.get_Threads();
+
+	struct MyTask
+		:public Executor::TaskSync
+	{
+		const Walker* m_pWlk;
+		UtxoTree::BulkEntry* m_pE;
+		uint32_t m_nTotal;
+		std::vector<uint32_t> m_vPos; // sorted portions
+		std::atomic<bool> m_bFail;
+
+		virtual void Exec(Executor::Context& ctx) override
+		{
+			uint32_t i0, nCount;
+			ctx.get_Portion(i0, nCount, m_nTotal);
+			m_vPos[ctx.m_iThread] = i0;
+
+			try
+			{
+				for (uint32_t i = i0; i < i0 + nCount; i++)
+				{
+					const Walker::Txo& x = m_pWlk->m_vTxos[i];
+
+					Deserializer der;
+					der.reset(&m_pWlk->m_Buf.front() + x.m_nOffset, x.m_nSize);
+
+					Output outp;
+					der & outp;
+
+					UtxoTree::Key::Data d;
+					d.m_Commitment = outp.m_Commitment;
+					d.m_Maturity = outp.get_MinMaturity(x.m_hCreate);
+
+					UtxoTree::BulkEntry& e = m_pE[i];
+					e.m_Key = d;
+					e.m_ID = x.m_ID;
+				}
+			}
+			catch (const std::exception&)
+			{
+				m_bFail = true;
+			}
+
+			std::sort(m_pE + i0, m_pE + i0 + nCount);
+		}
+	} t;
+
+	t.m_pWlk = &wlk;
+	t.m_pE = vEntries.empty() ? nullptr : &vEntries.front();
+	t.m_nTotal = static_cast<uint32_t>(vEntries.size());
+	t.m_vPos.resize(nThreads + 1);
+	t.m_vPos[nThreads] = t.m_nTotal;
+	t.m_bFail = false;
+
+	ex.ExecAll(t);
+	if (t.m_bFail)
+		OnCorrupted();
+
+	wlk.m_vTxos.clear();
+	wlk.m_vTxos.shrink_to_fit();
+	wlk.m_Buf.clear();
+	wlk.m_Buf.shrink_to_fit();
+
+	// merge sorted portions, pairwise
+	struct MyTaskMerge
+		:public Executor::TaskSync
+	{
+		const MyTask* m_pT;
+		uint32_t m_nStep;
+
+		virtual void Exec(Executor::Context& ctx) override
+		{
+			const std::vector<uint32_t>& vPos = m_pT->m_vPos;
+			uint32_t nPortions = static_cast<uint32_t>(vPos.size() - 1);
+
+			uint32_t i0 = ctx.m_iThread * m_nStep * 2;
+			uint32_t i1 = i0 + m_nStep;
+			if (i1 >= nPortions)
+				return;
+
+			uint32_t i2 = std::min(i1 + m_nStep, nPortions);
+			std::inplace_merge(m_pT->m_pE + vPos[i0], m_pT->m_pE + vPos[i1], m_pT->m_pE + vPos[i2]);
+		}
+	} tm;
+
+	tm.m_pT = &t;
+	for (tm.m_nStep = 1; tm.m_nStep < nThreads; tm.m_nStep *= 2)
+		ex.ExecAll(tm);
+
+	UtxoTree::BulkLoader bl(m_Mapped.m_Utxo);
+	if (!bl.Init(t.m_pE, vEntries.size()))
+		OnCorrupted();
+
+	m_Mapped.m_Utxo.EnsureReserve(bl); // no remapping during the build
+	bl.Allocate(nThreads * 8);
+
+	struct MyTaskBuild
+		:public Executor::TaskSync
+	{
+		UtxoTree::BulkLoader* m_pBl;
+
+		virtual void Exec(Executor::Context& ctx) override
+		{
+			uint32_t i0, nCount;
+			ctx.get_Portion(i0, nCount, m_pBl->get_Tasks());
+
+			for (uint32_t i = i0; i < i0 + nCount; i++)
+				m_pBl->ExecTask(i);
+		}
+	} tb;
+
+	tb.m_pBl = &bl;
+	ex.ExecAll(tb);
+
+	bl.Finalize();
 }
 
 bool NodeProcessor::GetBlock(const NodeDB::StateID& sid, ByteBuffer* pEthernal, ByteBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive)
+{
+	io::SharedBuffer bufE, bufP;
+	if (!GetBlockInternal(sid, pEthernal ? &bufE : nullptr, pPerishable ? &bufP : nullptr, h0, hLo1, hHi1, bActive, nullptr))
+		return false;
+
+	if (pEthernal)
+		pEthernal->assign(bufE.data, bufE.data + bufE.size);
+	if (pPerishable)
+		pPerishable->assign(bufP.data, bufP.data + bufP.size);
+
+	return true;
+}
+
+bool NodeProcessor::GetBlock(const NodeDB::StateID& sid, io::SharedBuffer* pEthernal, io::SharedBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive)
 {
 	return GetBlockInternal(sid, pEthernal, pPerishable, h0, hLo1, hHi1, bActive, nullptr);
 }
 
-bool NodeProcessor::GetBlockInternal(const NodeDB::StateID& sid, ByteBuffer* pEthernal, ByteBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive, Block::Body* pBody)
+bool NodeProcessor::GetBlockInternal(const NodeDB::StateID& sid, io::SharedBuffer* pEthernal, io::SharedBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive, Block::Body* pBody)
 {
 	// h0 - current peer Height
 	// hLo1 - HorizonLo that peer needs after the sync
@@ -6622,7 +7286,7 @@ bool NodeProcessor::GetBlockInternal(const NodeDB::StateID& sid, ByteBuffer* pEt
 		return false;
 
 	bool bFullBlock = (sid.m_Height >= hHi1) && (sid.m_Height > hLo1) && !pBody;
-	m_DB.GetStateBlock(sid.m_Row, bFullBlock ? pPerishable : nullptr, pEthernal, nullptr);
+	m_DB.GetStateBlock(sid.m_Row, bFullBlock ? pPerishable : nullptr, pEthernal);
 
 	if (!pBody && !(pPerishable && pPerishable->empty()))
 		return true;
@@ -6751,13 +7415,15 @@ bool NodeProcessor::GetBlockInternal(const NodeDB::StateID& sid, ByteBuffer* pEt
 
 	if (!pBody)
 	{
+		ByteBuffer bbP;
 		ser & uintBigFrom(nCount);
-		ser.swap_buf(*pPerishable);
-		pPerishable->insert(pPerishable->end(), bbBlob.begin(), bbBlob.end());
+		ser.swap_buf(bbP);
+		bbP.insert(bbP.end(), bbBlob.begin(), bbBlob.end());
 		
-		ser.swap_buf(*pPerishable);
+		ser.swap_buf(bbP);
 
-		ser.swap_buf(*pPerishable);
+		ser.swap_buf(bbP);
+		pPerishable->assign(std::move(bbP));
 	}
 
 	return true;
@@ -6840,9 +7506,11 @@ void NodeProcessor::RebuildNonStd()
 	m_Mmr.m_Assets.ResizeTo(0);
 	m_Mmr.m_Shielded.ResizeTo(0);
 	m_Extra.m_ShieldedOutputs = 0;
+	m_ShieldedPool.ShrinkTo(0);
 
 	static_assert(NodeDB::StreamType::StatesMmr == 0);
-	m_DB.StreamsDelAll(static_cast<NodeDB::StreamType::Enum>(1), NodeDB::StreamType::count);
+	static_assert(NodeDB::StreamType::ShieldedState + 1 == NodeDB::StreamType::StatesHashes);
+	m_DB.StreamsDelAll(static_cast<NodeDB::StreamType::Enum>(1), NodeDB::StreamType::ShieldedState); // the states streams are kept
 
 	struct KrnWalkerRebuild
 		:public IKrnWalker
@@ -6950,6 +7618,130 @@ int NodeProcessor::get_AssetAt(Asset::Full& ai, Height h)
 	return 1;
 }
 
+void NodeProcessor::KrnMmrCache::Delete(Entry& x)
+{
+	m_Keys.erase(KeySet::s_iterator_to(x.m_Key));
+	m_Mru.erase(MruList::s_iterator_to(x.m_Mru));
+	delete &x;
+}
+
+void NodeProcessor::KrnMmrCache::ShrinkTo(uint32_t n)
+{
+	while (m_Mru.size() > n)
+		Delete(m_Mru.back().get_ParentObj());
+}
+
+void NodeProcessor::KrnMmrCache::RollbackTo(Height h)
+{
+	while (true)
+	{
+		KeySet::reverse_iterator it = m_Keys.rbegin();
+		if (m_Keys.rend() == it)
+			break;
+
+		Entry::Key& x = *it;
+		if (x.m_Value <= h)
+			break;
+
+		Delete(x.get_ParentObj());
+	}
+}
+
+NodeProcessor::KrnMmrCache::Entry* NodeProcessor::KrnMmrCache::Find(Height h)
+{
+	Entry::Key key;
+	key.m_Value = h;
+
+	KeySet::iterator it = m_Keys.find(key);
+	if (m_Keys.end() == it)
+		return nullptr;
+
+	Entry& x = it->get_ParentObj();
+	m_Mru.erase(MruList::s_iterator_to(x.m_Mru));
+	m_Mru.push_front(x.m_Mru);
+
+	return &x;
+}
+
+NodeProcessor::KrnMmrCache::Entry& NodeProcessor::KrnMmrCache::Create(Height h, const std::vector<TxKernel::Ptr>& vKrn)
+{
+	ShrinkTo(s_Max - 1);
+
+	Entry* pE = new Entry;
+	pE->m_Key.m_Value = h;
+
+	pE->m_Mmr.Resize(vKrn.size());
+	pE->m_vIdx.resize(vKrn.size());
+
+	for (uint32_t i = 0; i < vKrn.size(); i++)
+	{
+		const Merkle::Hash& hv = vKrn[i]->m_Internal.m_ID;
+		pE->m_Mmr.Append(hv);
+		pE->m_vIdx[i].first = hv;
+		pE->m_vIdx[i].second = i;
+	}
+
+	std::sort(pE->m_vIdx.begin(), pE->m_vIdx.end());
+
+	m_Keys.insert(pE->m_Key);
+	m_Mru.push_front(pE->m_Mru);
+
+	return *pE;
+}
+
+uint32_t NodeProcessor::KrnMmrCache::Entry::Find(const Merkle::Hash& hv) const
+{
+	auto it = std::lower_bound(m_vIdx.begin(), m_vIdx.end(), hv, [](const std::pair<Merkle::Hash, uint32_t>& x, const Merkle::Hash& hv) { return x.first < hv; });
+	if ((m_vIdx.end() == it) || (it->first != hv))
+		return static_cast<uint32_t>(-1);
+
+	// if the same kernel appears in the block more than once - the last one is selected, as before
+	for (auto itNext = it + 1; (m_vIdx.end() != itNext) && (itNext->first == hv); itNext++)
+		it = itNext;
+
+	return it->second;
+}
+
+void NodeProcessor::ProofKernelStats::AddLatency(uint64_t us)
+{
+	uint32_t i = 0;
+	for (; (us > 1) && (i + 1 < s_Buckets); us >>= 1)
+		i++;
+
+	m_pLatency[i]++;
+}
+
+uint64_t NodeProcessor::ProofKernelStats::get_Percentile_us(uint32_t nPercent) const
+{
+	uint64_t nTotal = 0;
+	for (uint32_t i = 0; i < s_Buckets; i++)
+		nTotal += m_pLatency[i];
+
+	uint64_t nThreshold = (nTotal * nPercent + 99) / 100;
+	uint64_t nSum = 0;
+
+	for (uint32_t i = 0; i < s_Buckets; i++)
+	{
+		nSum += m_pLatency[i];
+		if (nSum >= nThreshold)
+			return static_cast<uint64_t>(2) << i;
+	}
+
+	return 0;
+}
+
+void NodeProcessor::ProofKernelStats::Log()
+{
+	if (m_Requests == m_RequestsLogged)
+		return;
+
+	m_RequestsLogged = m_Requests;
+
+	LOG_INFO()
+		<< "Kernel proofs: requests " << m_Requests << ", cache hits " << m_CacheHits
+		<< ", latency p50 < " << get_Percentile_us(50) << " us, p99 < " << get_Percentile_us(99) << " us";
+}
+
 void NodeProcessor::ValidatedCache::ShrinkTo(uint32_t n)
 {
 	while (m_Mru.size() > n)
@@ -7090,7 +7882,7 @@ NodeProcessor::Mapped::Hdr& NodeProcessor::Mapped::get_Hdr()
 void NodeProcessor::Mapped::FlushStrict(const Stamp& s)
 {
 	Hdr& h = get_Hdr();
-	assert(h.m_Dirty);
+	// may be not dirty, if only the shielded pool was modified
 
 	h.m_Dirty = 0;
 	h.m_RootUtxo = m_Utxo.m_RootOffset;
@@ -7100,6 +7892,102 @@ void NodeProcessor::Mapped::FlushStrict(const Stamp& s)
 	h.m_Stamp = s;
 }
 
+/////////////////////////////
+// ShieldedPool
+static_assert(sizeof(NodeProcessor::ShieldedPool::Hdr) == sizeof(ECC::Point::Storage) * 2);
+
+bool NodeProcessor::ShieldedPool::Open(const char* sz, const Stamp& s, TxoID nCount)
+{
+	// change this when format changes
+	static const uint8_t s_pSig[] = {
+		0x3A, 0x91, 0xE2, 0x0C,
+		0x5D, 0x47, 0xB8, 0x16,
+		0x9E, 0x2F, 0x63, 0xD4,
+		0x08, 0xCB, 0x71, 0xA5
+	};
+	static_assert(sizeof(s_pSig) == sizeof(Hdr::m_pSig));
+
+	m_File.Open(sz);
+
+	if ((m_File.m_nMapping >= sizeof(Hdr)) && (m_File.m_nMapping - sizeof(Hdr)) / sizeof(ECC::Point::Storage) >= nCount)
+	{
+		const Hdr& h = get_Hdr();
+		if (!memcmp(h.m_pSig, s_pSig, sizeof(s_pSig)) && !h.m_Dirty && (h.m_Stamp == s) && (h.m_Count == nCount))
+			return true;
+	}
+
+	// reset
+	m_File.CloseMapping();
+	m_File.Resize(0);
+	m_File.Resize(sizeof(Hdr));
+	m_File.OpenMapping();
+
+	Hdr& h = get_Hdr();
+	memcpy(h.m_pSig, s_pSig, sizeof(s_pSig));
+	h.m_Dirty = 1;
+	h.m_Count = 0;
+
+	return false;
+}
+
+void NodeProcessor::ShieldedPool::Close()
+{
+	m_File.Close();
+}
+
+NodeProcessor::ShieldedPool::Hdr& NodeProcessor::ShieldedPool::get_Hdr() const
+{
+	return m_File.get_At<Hdr>(0);
+}
+
+const ECC::Point::Storage* NodeProcessor::ShieldedPool::get_At(TxoID id) const
+{
+	assert(id <= get_Count());
+	return reinterpret_cast<const ECC::Point::Storage*>(m_File.m_pMapping + sizeof(Hdr)) + id;
+}
+
+void NodeProcessor::ShieldedPool::Reserve(TxoID nCount)
+{
+	const MappedFile::Offset nSize = sizeof(Hdr) + sizeof(ECC::Point::Storage) * nCount;
+	if (m_File.m_nMapping >= nSize)
+		return;
+
+	// grow in big steps, remapping is expensive
+	const TxoID nStep = 0x1000;
+	nCount = (nCount + nStep - 1) / nStep * nStep;
+
+	m_File.CloseMapping();
+	m_File.Resize(sizeof(Hdr) + sizeof(ECC::Point::Storage) * nCount);
+	m_File.OpenMapping();
+}
+
+void NodeProcessor::ShieldedPool::Append(const ECC::Point::Storage& pt)
+{
+	TxoID n = get_Count();
+	Reserve(n + 1);
+
+	Hdr& h = get_Hdr();
+	h.m_Dirty = 1;
+	Cast::NotConst(get_At(n))[0] = pt;
+	h.m_Count = n + 1;
+}
+
+void NodeProcessor::ShieldedPool::ShrinkTo(TxoID nCount)
+{
+	Hdr& h = get_Hdr();
+	assert(nCount <= h.m_Count);
+
+	h.m_Dirty = 1;
+	h.m_Count = nCount; // the file is not truncated, the space would be reused
+}
+
+void NodeProcessor::ShieldedPool::FlushStrict(const Stamp& s)
+{
+	Hdr& h = get_Hdr();
+	h.m_Dirty = 0;
+	h.m_Stamp = s;
+}
+
 void NodeProcessor::Mapped::Utxo::EnsureReserve()
 {
 	try
@@ -7118,6 +8006,23 @@ void NodeProcessor::Mapped::Utxo::EnsureReserve()
 	}
 }
 
+void NodeProcessor::Mapped::Utxo::EnsureReserve(const BulkLoader& bl)
+{
+	try
+	{
+		get_ParentObj().m_Mapping.EnsureReserve(Type::UtxoLeaf, sizeof(MyLeaf), bl.get_Leafs());
+		get_ParentObj().m_Mapping.EnsureReserve(Type::HashJoint, sizeof(MyJoint), bl.get_Joints());
+		get_ParentObj().m_Mapping.EnsureReserve(Type::UtxoQueue, sizeof(MyLeaf::IDQueue), bl.get_Queues());
+		get_ParentObj().m_Mapping.EnsureReserve(Type::UtxoNode, sizeof(MyLeaf::IDNode), bl.get_QueueNodes());
+	}
+	catch (const std::exception& e)
+	{
+		CorruptionException exc;
+		exc.m_sErr = e.what();
+		throw exc;
+	}
+}
+
 void NodeProcessor::Mapped::OnDirty()
 {
 	get_Hdr().m_Dirty = 1;
@@ -18,10 +18,12 @@
 #include "../core/proto.h"
 #include "../core/treasury.h"
 #include "../core/mapped_file.h"
+#include "../core/shielded.h"
 #include "../utility/dvector.h"
 #include "../utility/executor.h"
 #include "../utility/containers.h"
 #include "db.h"
+#include "block_store.h"
 #include "txpool.h"
 
 namespace beam {
@@ -37,6 +39,7 @@ class NodeProcessor
 	} m_DB;
 
 	NodeDB::Transaction m_DbTx;
+	BlockStore m_Blocks;
 
 
 	class Mapped
@@ -75,6 +78,7 @@ class NodeProcessor
 			virtual void OnDirty() override { get_ParentObj().OnDirty(); }
 
 			void EnsureReserve();
+			void EnsureReserve(const BulkLoader&);
 
 			IMPLEMENT_GET_PARENT_OBJ(Mapped, m_Utxo)
 		} m_Utxo;
@@ -184,7 +188,7 @@ class NodeProcessor
 	BeamKernelsAll(THE_MACRO)
 #undef THE_MACRO
 
-	static uint64_t ProcessKrnMmr(Merkle::Mmr&, std::vector<TxKernel::Ptr>&, const Merkle::Hash& idKrn, TxKernel::Ptr* ppRes);
+	Height get_ProofKernelInternal(Merkle::Proof&, TxKernel::Ptr*, const Merkle::Hash& idKrn);
 
 	struct KrnFlyMmr;
 
@@ -194,9 +198,6 @@ class NodeProcessor
 	static void TxoToNaked(uint8_t* pBuf, Blob&);
 	static bool TxoIsNaked(const Blob&);
 
-	void ToInputWithMaturity(Input&, Output&, bool bNake);
-
-	TxoID get_TxosBefore(Height);
 	TxoID FindHeightByTxoID(Height& h, TxoID id0); // returns the Txos at state end
 
 	void ReadOffset(ECC::Scalar&, uint64_t rowid);
@@ -206,7 +207,10 @@ class NodeProcessor
 
 	void InitCursor(bool bMovingUp);
 	bool InitMapping(const char*, bool bForceReset);
+	void get_MappingStamp(Merkle::Hash&, bool bForceReset);
 	void InitializeMapped(const char*);
+	void InitializeShieldedPool(const char*);
+	void InitializeBlockStore(const char*, bool bAppend);
 
 	typedef std::pair<int64_t, std::pair<int64_t, Difficulty::Raw> > THW; // Time-Height-Work. Time and Height are signed
 	Difficulty get_NextDifficulty();
@@ -270,6 +274,10 @@ public:
 		bool m_Vacuum = false;
 		bool m_ResetSelfID = false;
 		bool m_EraseSelfID = false;
+		bool m_Wal = false; // open the DB in WAL mode, enables m_DbReaders
+		bool m_BlockStore = false; // append the new block bodies to the BlockStore segments, rather than the DB
+		bool m_StatesHashes = false; // keep the state hashes in a dedicated stream, the States MMR won't need to look for the active states
+		uint32_t m_StatesMmrCache = 0x10000; // max States MMR elements cached in memory (header proofs for FlyClients)
 
 		struct RichInfo {
 			static const uint8_t Off = 1;
@@ -284,7 +292,8 @@ public:
 	void Initialize(const char* szPath, const StartParams&);
 
     static bool ExtractTreasury(const Blob&, Treasury::Data&);
-	static void get_MappingPath(std::string&, const char*);
+	static void get_MappingPath(std::string&, const char*, const char* szSufix = "-utxo-image.bin");
+	void InitializeStatesMmr(const StartParams&);
 
 	NodeProcessor();
 	virtual ~NodeProcessor();
@@ -429,6 +438,8 @@ public:
 
 	bool ExtractBlockWithExtra(Block::Body&, std::vector<Output::Ptr>& vOutsIn, const NodeDB::StateID&, std::vector<ContractInvokeExtraInfo>&);
 	void get_ContractDescr(const ECC::uintBig& sid, const ECC::uintBig& cid, std::string&, bool bFullState);
+	// same, from the DB state at the specified height (e.g. a read snapshot). Doesn't access the processor, may be called from any thread
+	static void get_ContractDescr(NodeDB&, Height, const ECC::uintBig& sid, const ECC::uintBig& cid, std::string&, bool bFullState);
 
 	int get_AssetAt(Asset::Full&, Height); // Must set ID. Returns -1 if asset is destroyed, 0 if never existed.
 
@@ -451,6 +462,8 @@ public:
 
 	// use only for data retrieval for peers
 	NodeDB& get_DB() { return m_DB; }
+	// read-only snapshots, can be used from other threads. Only available in WAL mode. See the committed state, as of the last CommitDB()
+	NodeDB::ReadPool m_DbReaders;
 	UtxoTree& get_Utxos() { return m_Mapped.m_Utxo; }
 	RadixHashOnlyTree& get_Contracts() { return m_Mapped.m_Contract; }
 
@@ -521,6 +534,7 @@ public:
 
 	void EnumCongestions();
 	const uint64_t* get_CachedRows(const NodeDB::StateID&, Height nCountExtra); // retval valid till next call to this func, or to EnumCongestions()
+	const uint64_t* FindCachedRows(const NodeDB::StateID&, Height nCountExtra); // same, but doesn't refresh the cache. Safe to call during EnumCongestions()
 	void TryGoUp();
 	void TryGoTo(NodeDB::StateID&);
 	void OnFastSyncOver(MultiblockContext&, bool& bContextFail);
@@ -577,6 +591,8 @@ public:
 	void RescanOwnedTxos();
 
 	uint64_t FindActiveAtStrict(Height);
+	TxoID get_TxosBefore(Height);
+	void ToInputWithMaturity(Input&, Output&, bool bNake);
 	Height FindVisibleKernel(const Merkle::Hash&, const BlockInterpretCtx&);
 
 	uint8_t ValidateTxContextEx(const Transaction&, const HeightRange&, bool bShieldedTested, uint32_t& nBvmCharge, TxPool::Dependent::Element* pParent, std::ostream* pExtraInfo, Merkle::Hash* pCtxNew); // assuming context-free validation is already performed, but 
@@ -596,12 +612,14 @@ public:
 		Block::Body m_Block; // in/out
 	};
 
+	struct BlockTemplate;
 
 	struct BlockContext
 		:public GeneratedBlock
 	{
 		TxPool::Fluff& m_TxPool;
 		const TxPool::Dependent::Element* m_pParent;
+		BlockTemplate* m_pTemplate; // optional, to reuse the last block if the pool newcomers don't make it
 
 		Key::Index m_SubIdx;
 		Key::IKdf& m_Coin;
@@ -618,9 +636,42 @@ public:
 		BlockContext(TxPool::Fluff& txp, Key::Index, Key::IKdf& coin, Key::IPKdf& tag);
 	};
 
+	struct BlockTemplate
+	{
+		// The tx selection of the last generated block. While the tip, the dependent context and the selected txs are the same, only the
+		// txs arrived to the pool since then are examined. If none of them can make it into the block (ranks below the selection and doesn't
+		// fit the remaining space) - the last block is reused as-is, only the timestamp is updated. Otherwise the block is built anew.
+		// Note: there's no partial rebuild. The state can't stay applied between the builds (it's shared with the block/tx processing), so
+		// any change to the selection costs the same as the full build.
+		enum struct Build {
+			Full,
+			Reused
+		};
+
+		typedef std::vector<TxPool::Fluff::Element*> ElementVec;
+
+		ElementVec m_vTxs; // selected, in the profit order. Referenced (i.e. alive even if deleted from the pool meanwhile)
+
+		Block::SystemState::ID m_Tip;
+		Transaction::Ptr m_pDependent;
+		TxPool::Fluff* m_pPool = nullptr;
+		uint64_t m_Seq = 0; // pool arrivals up to this one are accounted
+		BlockContext::Mode m_Mode = BlockContext::Mode::SinglePass;
+		size_t m_nSize = 0; // estimated
+		bool m_Valid = false;
+
+		Build m_Build = Build::Full; // how the last block was built
+		GeneratedBlock m_Last;
+
+		~BlockTemplate() { Reset(); }
+		void Reset();
+		static void Release(ElementVec&, TxPool::Fluff&);
+	};
+
 	bool GenerateNewBlock(BlockContext&);
 
 	bool GetBlock(const NodeDB::StateID&, ByteBuffer* pEthernal, ByteBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive);
+	bool GetBlock(const NodeDB::StateID&, io::SharedBuffer* pEthernal, io::SharedBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive); // the parts in the BlockStore are not copied
 
 	struct ITxoWalker
 	{
@@ -752,6 +803,25 @@ public:
 		};
 		Recognizer(IHandler& h, Extra& extra);
 
+		struct ShieldedRecovered
+		{
+			const TxKernelShieldedOutput* m_pKrn;
+			bool m_Recovered;
+			Key::Index m_nIdx;
+			ShieldedTxo::Data::Params m_Pars;
+
+			void Recover(Height, const ViewerKeys&);
+		};
+
+		struct ShieldedPreRecovered
+		{
+			// shielded outputs recovered in advance (in parallel), in the order they're recognized
+			std::vector<ShieldedRecovered> m_v;
+			size_t m_iNext = 0;
+		};
+
+		ShieldedPreRecovered* m_pShieldedPre = nullptr;
+
 		void Recognize(const TxVectors::Full& block, Height height, uint32_t shieldedOuts, bool validateShieldedOuts = true);
 
 		void Recognize(const Input&, Height);
@@ -799,6 +869,111 @@ public:
 		return m_Mmr.m_Shielded.m_Count - m_Extra.m_ShieldedOutputs;
 	}
 
+	// All the shielded outputs (commitment + serial pub, affine form), as a flat array in a mapped file.
+	// Lelantus verification reads the points directly from it, instead of loading them from the DB for every chunk.
+	// The pool is append-only, truncated only on rollback. Validated by the same stamp as the mapped image.
+	class ShieldedPool
+	{
+		MappedFileRaw m_File;
+
+		void Reserve(TxoID);
+
+	public:
+
+		typedef Merkle::Hash Stamp;
+
+#pragma pack(push, 1)
+		struct Hdr
+		{
+			uint8_t m_pSig[16];
+			MappedFile::Offset m_Dirty; // boolean, just aligned
+			Stamp m_Stamp;
+			TxoID m_Count;
+			uint8_t m_pReserved[64]; // pad to 128 bytes, the points are aligned
+		};
+#pragma pack(pop)
+
+		~ShieldedPool() { Close(); }
+
+		bool Open(const char* sz, const Stamp&, TxoID nCount); // resets the pool if the contents don't match
+		bool IsOpen() const { return m_File.m_pMapping != nullptr; }
+		void Close();
+
+		Hdr& get_Hdr() const;
+		TxoID get_Count() const { return get_Hdr().m_Count; }
+		const ECC::Point::Storage* get_At(TxoID) const; // the pointer is invalidated by the next append
+
+		void Append(const ECC::Point::Storage&);
+		void ShrinkTo(TxoID);
+		void FlushStrict(const Stamp&);
+	};
+
+	ShieldedPool m_ShieldedPool;
+
+	// Kernel MMRs of the recently requested blocks, to serve the kernel proofs without re-reading and re-hashing the whole block.
+	// Only active blocks are cached, the entries above the rollback height are discarded.
+	struct KrnMmrCache
+	{
+		struct Entry
+		{
+			struct Key
+				:public boost::intrusive::set_base_hook<>
+			{
+				typedef Height Type;
+				Type m_Value;
+				bool operator < (const Key& x) const { return m_Value < x.m_Value; }
+				IMPLEMENT_GET_PARENT_OBJ(Entry, m_Key)
+			} m_Key;
+
+			struct Mru
+				:public boost::intrusive::list_base_hook<>
+			{
+				IMPLEMENT_GET_PARENT_OBJ(Entry, m_Mru)
+			} m_Mru;
+
+			Merkle::FixedMmr m_Mmr;
+			std::vector<std::pair<Merkle::Hash, uint32_t> > m_vIdx; // kernel ID -> index in block, sorted
+
+			uint32_t Find(const Merkle::Hash&) const; // returns -1 if not found
+		};
+
+		typedef boost::intrusive::set<Entry::Key> KeySet;
+		typedef boost::intrusive::list<Entry::Mru> MruList;
+
+		KeySet m_Keys;
+		MruList m_Mru;
+
+		static const uint32_t s_Max = 256;
+
+		~KrnMmrCache() {
+			ShrinkTo(0);
+		}
+
+		void Delete(Entry&);
+		void ShrinkTo(uint32_t);
+		void RollbackTo(Height);
+
+		Entry* Find(Height); // modifies MRU if found
+		Entry& Create(Height, const std::vector<TxKernel::Ptr>&);
+
+	} m_KrnMmrCache;
+
+	struct ProofKernelStats
+	{
+		uint64_t m_Requests = 0;
+		uint64_t m_CacheHits = 0;
+
+		// latency histogram in microseconds: bucket 0 counts [0, 2), bucket i counts [2^i, 2^(i+1)), the last one is open-ended
+		static const uint32_t s_Buckets = 20;
+		uint64_t m_pLatency[s_Buckets] = { 0 };
+
+		uint64_t m_RequestsLogged = 0; // at the last log
+
+		void AddLatency(uint64_t us);
+		uint64_t get_Percentile_us(uint32_t nPercent) const; // upper bound of the bucket
+		void Log(); // if there were requests since the last time, called with the node sync stats timer
+	} m_ProofKernelStats;
+
 	struct ValidatedCache
 	{
 		struct Entry
@@ -863,10 +1038,13 @@ public:
 	bool ExecInDependentContext(IWorker&, const Merkle::Hash*, const TxPool::Dependent&);
 
 private:
+	bool GenerateNewBlockRaw(BlockContext&);
 	size_t GenerateNewBlockInternal(BlockContext&, BlockInterpretCtx&);
 	void GenerateNewHdr(BlockContext&, BlockInterpretCtx&);
+	void SetNewTimestamp(Block::SystemState::Full&);
+	BlockTemplate::Build PrepareTemplate(BlockContext&);
 	DataStatus::Enum OnStateInternal(const Block::SystemState::Full&, Block::SystemState::ID&, bool bAlreadyChecked);
-	bool GetBlockInternal(const NodeDB::StateID&, ByteBuffer* pEthernal, ByteBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive, Block::Body*);
+	bool GetBlockInternal(const NodeDB::StateID&, io::SharedBuffer* pEthernal, io::SharedBuffer* pPerishable, Height h0, Height hLo1, Height hHi1, bool bActive, Block::Body*);
 };
 
 struct LogSid
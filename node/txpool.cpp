@@ -66,6 +66,7 @@ TxPool::Fluff::Element* TxPool::Fluff::AddValidTx(Transaction::Ptr&& pValue, con
 	InternalInsert(*p);
 
 	p->m_Queue.m_Refs = 1;
+	p->m_Queue.m_Seq = ++m_Seq;
 	m_Queue.push_back(p->m_Queue);
 
 	return p;
@@ -71,6 +71,7 @@ struct TxPool
 				:public boost::intrusive::list_base_hook<>
 			{
 				uint32_t m_Refs = 0;
+				uint64_t m_Seq = 0; // arrival order
 				IMPLEMENT_GET_PARENT_OBJ(Element, m_Queue)
 			} m_Queue;
 
@@ -85,7 +86,8 @@ struct TxPool
 		TxSet m_setTxs;
 		ProfitSet m_setProfit;
 		OutdatedSet m_setOutdated;
-		Queue m_Queue;
+		Queue m_Queue; // in the arrival order
+		uint64_t m_Seq = 0; // of the last arrived
 
 		Element* AddValidTx(Transaction::Ptr&&, const Transaction::Context&, const Transaction::KeyType&, uint32_t nSizeCorrection);
 		void SetOutdated(Element&, Height);
@@ -24,6 +24,7 @@
 #include "../../utility/test_helpers.h"
 #include "../../utility/serialize.h"
 #include "../../utility/blobmap.h"
+#include "../../utility/fsutils.h"
 #include "../../core/unittest/mini_blockchain.h"
 #include "../../bvm/bvm2.h"
 #include "../../bvm/ManagerStd.h"
@@ -812,6 +813,896 @@ namespace beam
 		}
 	}
 
+	bool IsSnapshotConsistent(NodeDB::ReadPool::Snapshot& ss, const std::vector<uint64_t>& vRows)
+	{
+		NodeDB& db = ss.get_DB();
+
+		NodeDB::StateID sid;
+		db.get_Cursor(sid);
+		if ((sid.m_Row != ss.m_Cursor.m_Row) || (sid.m_Height != ss.m_Cursor.m_Height))
+			return false;
+
+		for (uint32_t i = 0; i < vRows.size(); i++)
+		{
+			bool bActive = !!(NodeDB::StateFlags::Active & db.GetStateFlags(vRows[i]));
+			if (bActive != (Rules::HeightGenesis + i <= sid.m_Height))
+				return false;
+		}
+
+		return true;
+	}
+
+	void TestNodeDBSnapshots()
+	{
+		const uint32_t hMax = 40;
+
+		std::vector<Block::SystemState::Full> vStates(hMax);
+		std::vector<uint64_t> vRows(hMax);
+
+		for (uint32_t h = 0; h < hMax; h++)
+		{
+			Block::SystemState::Full& s = vStates[h];
+			ZeroObject(s);
+			s.m_Height = h + Rules::HeightGenesis;
+			s.m_ChainWork = h;
+			s.m_TimeStamp = h;
+			if (h)
+				vStates[h - 1].get_Hash(s.m_Prev);
+		}
+
+		PeerID peer;
+		memset(peer.m_pData, 0x66, peer.nBytes);
+
+		NodeDB db;
+		db.Open(g_sz, true);
+
+		NodeDB::ReadPool pool;
+		pool.Open(g_sz);
+
+		NodeDB::StateID sid;
+		sid.SetNull();
+
+		auto MoveTo = [&](Height h) {
+			while (sid.m_Height < h)
+			{
+				sid.m_Height++;
+				sid.m_Row = vRows[sid.m_Height - Rules::HeightGenesis];
+				db.MoveFwd(sid);
+			}
+			while (sid.m_Height > h)
+				db.MoveBack(sid);
+		};
+
+		{
+			NodeDB::Transaction tr(db);
+			for (uint32_t h = 0; h < hMax; h++)
+				vRows[h] = db.InsertState(vStates[h], peer);
+
+			MoveTo(20);
+			tr.Commit();
+		}
+
+		{
+			NodeDB::ReadPool::Snapshot ss1(pool);
+			verify_test(ss1.m_Cursor.m_Height == 20);
+			verify_test(IsSnapshotConsistent(ss1, vRows));
+
+			{
+				NodeDB::Transaction tr(db);
+				MoveTo(30);
+				tr.Commit();
+			}
+
+			NodeDB::ReadPool::Snapshot ss2(pool);
+			verify_test(ss2.m_Cursor.m_Height == 30);
+			verify_test(IsSnapshotConsistent(ss2, vRows));
+			verify_test(ss1.m_Cursor.m_Height == 20);
+			verify_test(IsSnapshotConsistent(ss1, vRows));
+
+			// uncommitted changes are invisible, then rolled back
+			{
+				NodeDB::Transaction tr(db);
+				MoveTo(10);
+
+				NodeDB::ReadPool::Snapshot ss3(pool);
+				verify_test(ss3.m_Cursor.m_Height == 30);
+				verify_test(IsSnapshotConsistent(ss3, vRows));
+			}
+			sid.m_Height = 30;
+			sid.m_Row = vRows[30 - Rules::HeightGenesis];
+
+			// committed rollback
+			{
+				NodeDB::Transaction tr(db);
+				MoveTo(10);
+				tr.Commit();
+			}
+
+			NodeDB::ReadPool::Snapshot ss4(pool);
+			verify_test(ss4.m_Cursor.m_Height == 10);
+			verify_test(IsSnapshotConsistent(ss4, vRows));
+			verify_test(ss2.m_Cursor.m_Height == 30);
+			verify_test(IsSnapshotConsistent(ss2, vRows));
+			verify_test(IsSnapshotConsistent(ss1, vRows));
+
+			// read-only
+			bool bThrown = false;
+			try {
+				ss4.get_DB().ParamIntSet(NodeDB::ParamID::LastRecoveryHeight, 5);
+			} catch (const std::exception&) {
+				bThrown = true;
+			}
+			verify_test(bThrown);
+			verify_test(IsSnapshotConsistent(ss4, vRows));
+		}
+
+		verify_test(pool.get_Created() == 3);
+
+		{
+			// connections are reused
+			NodeDB::ReadPool::Snapshot ss(pool);
+			verify_test(ss.m_Cursor.m_Height == 10);
+			verify_test(IsSnapshotConsistent(ss, vRows));
+		}
+		verify_test(pool.get_Created() == 3);
+
+		// concurrent readers, while the cursor is moved back and forth
+		std::atomic<uint32_t> nSnapshots(0), nFailed(0);
+		std::atomic<bool> bStop(false);
+
+		std::vector<std::thread> vThreads;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			vThreads.emplace_back([&]() {
+				while (!bStop)
+				{
+					try {
+						NodeDB::ReadPool::Snapshot ss(pool);
+						if (!IsSnapshotConsistent(ss, vRows))
+							nFailed++;
+					} catch (const std::exception&) {
+						nFailed++;
+					}
+					nSnapshots++;
+				}
+			});
+		}
+
+		for (uint32_t i = 0; i < 60; i++)
+		{
+			NodeDB::Transaction tr(db);
+			MoveTo((i * 7) % hMax);
+			tr.Commit();
+		}
+
+		while (nSnapshots < 100)
+			std::this_thread::yield();
+
+		bStop = true;
+		for (auto& t : vThreads)
+			t.join();
+
+		verify_test(!nFailed);
+		verify_test(pool.get_Created() <= 3 + 4);
+
+		pool.Close();
+		db.Close();
+
+		// can be re-opened in normal mode
+		db.Open(g_sz);
+		verify_test(db.get_Cursor(sid) && (sid.m_Height == (59 * 7) % hMax));
+	}
+
+	void TestBbsStore()
+	{
+		std::string sDir;
+		NodeProcessor::get_MappingPath(sDir, g_sz, "-bbs");
+
+		const uint32_t nWidth = 100;
+		const uint32_t nMsgs = 300;
+		const uint32_t nChannels = 7;
+		const uint64_t nStamp = 0x1234;
+
+		char szBody[0x1000]; // large enough for the segments to grow
+		memset(szBody, 'x', sizeof(szBody));
+
+		auto MakeMsg = [&](NodeDB::WalkerBbs::Data& d, uint32_t i) {
+			d.m_Key = i + 1;
+			d.m_Channel = i % nChannels;
+			d.m_TimePosted = 1000 + i * 3; // ~33 msgs per bucket
+			d.m_Nonce = i;
+			d.m_Message.p = szBody;
+			d.m_Message.n = (i * 97) % sizeof(szBody);
+		};
+
+		auto VerifyMsg = [&](const BbsStore& bbs, const BbsStore::Msg& msg) {
+			NodeDB::WalkerBbs::Data d;
+			bbs.get_Data(msg, d);
+
+			uint32_t i = d.m_Nonce;
+			NodeDB::WalkerBbs::Data d0;
+			MakeMsg(d0, i);
+
+			return
+				(d.m_Key == d0.m_Key) &&
+				(d.m_Key == msg.m_Key.m_Value) &&
+				(d.m_Channel == d0.m_Channel) &&
+				(d.m_TimePosted == d0.m_TimePosted) &&
+				(d.m_Message.n == d0.m_Message.n) &&
+				!memcmp(d.m_Message.p, szBody, d.m_Message.n);
+		};
+
+		auto VerifyAll = [&](const BbsStore& bbs, uint32_t i0) {
+			verify_test(bbs.get_Totals().m_Count == nMsgs - i0);
+
+			uint32_t n = 0;
+			for (const BbsStore::Msg* pMsg = bbs.FindNext(0); pMsg; pMsg = bbs.get_Next(*pMsg, false), n++)
+				verify_test(VerifyMsg(bbs, *pMsg));
+			verify_test(n == nMsgs - i0);
+
+			n = 0;
+			for (BbsChannel ch = 0; ch < nChannels; ch++)
+			{
+				uint64_t id = 0;
+				for (const BbsStore::Msg* pMsg = bbs.FindNext(ch, 0); pMsg; pMsg = bbs.get_Next(*pMsg, true), n++)
+				{
+					verify_test(pMsg->m_Channel.m_Value == ch);
+					verify_test(pMsg->m_ID.m_Value > id);
+					id = pMsg->m_ID.m_Value;
+					verify_test(VerifyMsg(bbs, *pMsg));
+				}
+			}
+			verify_test(n == nMsgs - i0);
+
+			for (uint32_t i = 0; i < nMsgs; i++)
+			{
+				NodeDB::WalkerBbs::Data d;
+				MakeMsg(d, i);
+				verify_test(!bbs.Find(d.m_Key) == (i < i0));
+			}
+
+			// the msgs are inserted in order of time
+			for (uint32_t i = i0; i < nMsgs; i += 17)
+			{
+				NodeDB::WalkerBbs::Data d;
+				MakeMsg(d, i);
+
+				const BbsStore::Msg* pMsg = bbs.Find(d.m_Key);
+				verify_test(pMsg && (bbs.FindCursor(d.m_TimePosted) == pMsg->m_ID.m_Value));
+			}
+
+			verify_test(bbs.FindCursor(Timestamp(-1)) == bbs.get_LastID() + 1);
+		};
+
+		BbsStore::Totals lims;
+		lims.m_Count = nMsgs;
+		lims.m_Size = nMsgs * sizeof(szBody);
+
+		{
+			BbsStore bbs;
+			bbs.Open(sDir.c_str(), nStamp, nWidth);
+			verify_test(!bbs.get_Totals().m_Count);
+
+			for (uint32_t i = 0; i < nMsgs; i++)
+			{
+				NodeDB::WalkerBbs::Data d;
+				MakeMsg(d, i);
+				verify_test(!bbs.Find(d.m_Key));
+				verify_test(bbs.Insert(d) == i + 1);
+			}
+
+			VerifyAll(bbs, 0);
+
+			bbs.Cleanup(0, lims);
+			VerifyAll(bbs, 0);
+		}
+
+		{
+			// reopen
+			BbsStore bbs;
+			bbs.Open(sDir.c_str(), nStamp, nWidth);
+			VerifyAll(bbs, 0);
+			verify_test(bbs.get_MaxTime() == 1000 + (nMsgs - 1) * 3);
+
+			// expire whole buckets only
+			bbs.Cleanup(1250, lims);
+			VerifyAll(bbs, 67); // 1200 <= t
+
+			// over the limit - the oldest bucket is dropped
+			lims.m_Count = nMsgs - 67 - 1;
+			bbs.Cleanup(0, lims);
+			VerifyAll(bbs, 100);
+		}
+
+		{
+			// wrong stamp - discarded
+			BbsStore bbs;
+			bbs.Open(sDir.c_str(), nStamp + 1, nWidth);
+			verify_test(!bbs.get_Totals().m_Count && !bbs.get_Buckets());
+		}
+
+		fsutils::remove(sDir);
+	}
+
+	void TestBbsMigrate()
+	{
+		// BBS messages kept in the DB (older versions) must be moved to the store on the first start
+		io::Reactor::Ptr pReactor(io::Reactor::create());
+		io::Reactor::Scope scope(*pReactor);
+
+		const uint32_t nMsgs = 50;
+		const Timestamp ts = getTimestamp();
+
+		auto MakeMsg = [&](NodeDB::WalkerBbs::Data& d, uint32_t i) {
+			d.m_Key = i + 1;
+			d.m_Channel = i % 7;
+			d.m_TimePosted = ts - i * 60;
+			d.m_Nonce = i;
+			d.m_Message.p = "hello";
+			d.m_Message.n = 5;
+		};
+
+		{
+			NodeDB db;
+			db.Open(g_sz);
+			NodeDB::Transaction tr(db);
+
+			NodeDB::WalkerBbs::Data d;
+			for (uint32_t i = 0; i < nMsgs; i++)
+			{
+				MakeMsg(d, i);
+				db.BbsIns(d);
+			}
+
+			MakeMsg(d, nMsgs);
+			d.m_TimePosted = ts - 3600 * 24; // expired, should not be moved
+			db.BbsIns(d);
+
+			tr.Commit();
+		}
+
+		Node::Config::Bbs cfg;
+		uint64_t nStamp;
+		{
+			Node n;
+			n.m_Cfg.m_sPathLocal = g_sz;
+			n.m_Cfg.m_Treasury = g_Treasury;
+
+			ECC::SetRandom(n);
+			n.Initialize();
+
+			nStamp = n.get_Processor().get_DB().ParamIntGetDef(NodeDB::ParamID::BbsStamp);
+			verify_test(nStamp);
+		}
+
+		{
+			NodeDB db;
+			db.Open(g_sz);
+
+			verify_test(db.ParamIntGetDef(NodeDB::ParamID::BbsStamp) == nStamp);
+
+			NodeDB::BbsTotals x;
+			db.get_BbsTotals(x);
+			verify_test(!x.m_Count);
+		}
+
+		std::string sDir;
+		NodeProcessor::get_MappingPath(sDir, g_sz, "-bbs");
+
+		{
+			BbsStore bbs;
+			bbs.Open(sDir.c_str(), nStamp, cfg.m_BucketWidth_s);
+			verify_test(bbs.get_Totals().m_Count == nMsgs);
+
+			for (uint32_t i = 0; i < nMsgs; i++)
+			{
+				NodeDB::WalkerBbs::Data d0, d;
+				MakeMsg(d0, i);
+
+				const BbsStore::Msg* pMsg = bbs.Find(d0.m_Key);
+				verify_test(pMsg);
+
+				bbs.get_Data(*pMsg, d);
+				verify_test((d.m_Channel == d0.m_Channel) && (d.m_TimePosted == d0.m_TimePosted) && (d.m_Nonce == d0.m_Nonce));
+				verify_test((d.m_Message.n == d0.m_Message.n) && !memcmp(d.m_Message.p, d0.m_Message.p, d.m_Message.n));
+			}
+		}
+
+		{
+			BbsStore bbs;
+			bbs.Open(sDir.c_str(), nStamp + 1, cfg.m_BucketWidth_s); // discard the segments
+		}
+
+		fsutils::remove(sDir);
+	}
+
+	void TestBlockStore()
+	{
+		std::string sDir;
+		NodeProcessor::get_MappingPath(sDir, g_sz, "-blocks");
+
+		const uint32_t nRows = 200;
+		const uint64_t nStamp = 0x4321;
+
+		ByteBuffer bufBody(0x3000);
+		for (size_t i = 0; i < bufBody.size(); i++)
+			bufBody[i] = static_cast<uint8_t>(i * 7);
+
+		auto MakeBody = [&](uint32_t i, Merkle::Hash& hv, Blob& bodyP, Blob& bodyE) {
+			hv = Merkle::Hash(i + 1);
+			bodyP = Blob(&bufBody.front() + i, (i * 31) % 0x2000); // the 1st is empty
+			bodyE = Blob(&bufBody.front() + i * 3, 100 + i);
+		};
+
+		auto IsEqual = [](const io::SharedBuffer& buf, const Blob& b) {
+			return (buf.size == b.n) && !memcmp(buf.data, b.p, b.n);
+		};
+
+		auto Verify = [&](const BlockStore& bs, uint32_t i, bool bP, bool bE) {
+			Merkle::Hash hv;
+			Blob bodyP, bodyE;
+			MakeBody(i, hv, bodyP, bodyE);
+
+			if (!bP)
+				bodyP.n = 0;
+			if (!bE)
+				bodyE.n = 0;
+
+			BlockStore::Body body;
+			bool bFound = bs.Find(i + 1, hv, body);
+			if (!bodyP.n && !bodyE.n)
+				return !bFound;
+
+			return bFound && IsEqual(body.m_Perishable, bodyP) && IsEqual(body.m_Eternal, bodyE);
+		};
+
+		auto VerifyAll = [&](const BlockStore& bs, bool bErased) {
+			for (uint32_t i = 0; i < nRows; i++)
+			{
+				bool bE = !(bErased && !(i % 3));
+				bool bP = bE && !(bErased && !(i % 2));
+				verify_test(Verify(bs, i, bP, bE));
+			}
+		};
+
+		auto Erase = [&](BlockStore& bs) {
+			for (uint32_t i = 0; i < nRows; i++)
+			{
+				if (!(i % 2))
+					bs.DelPerishable(i + 1);
+				if (!(i % 3))
+					bs.Delete(i + 1);
+			}
+		};
+
+		BlockStore::Body bodyHeld;
+		uint64_t nUsed0;
+
+		{
+			BlockStore bs;
+			bs.m_SegmentSize = 0x40000;
+			bs.Open(sDir.c_str(), nStamp);
+			verify_test(!bs.get_Totals().m_Records);
+
+			for (uint32_t i = 0; i < nRows; i++)
+			{
+				Merkle::Hash hv;
+				Blob bodyP, bodyE;
+				MakeBody(i, hv, bodyP, bodyE);
+				bs.Insert(i + 1, hv, bodyP, bodyE);
+			}
+
+			bs.Flush();
+			bs.OnCommitted();
+
+			VerifyAll(bs, false);
+			verify_test(bs.get_Segments() > 1);
+			verify_test(bs.get_Totals().m_Records == nRows);
+			nUsed0 = bs.get_Used();
+
+			// different state at this row
+			verify_test(!bs.Find(1, Merkle::Hash(2U), bodyHeld));
+			verify_test(bs.Find(1, Merkle::Hash(1U), bodyHeld));
+
+			// not committed
+			Erase(bs);
+			VerifyAll(bs, true);
+		}
+
+		{
+			// reopen. Uncommitted erasures are lost
+			BlockStore bs;
+			bs.m_SegmentSize = 0x40000;
+			bs.Open(sDir.c_str(), nStamp);
+			VerifyAll(bs, false);
+
+			Erase(bs);
+			bs.Flush();
+			bs.OnCommitted();
+			VerifyAll(bs, true);
+			verify_test(bs.get_Used() < nUsed0); // sparse segments compacted
+		}
+
+		{
+			BlockStore bs;
+			bs.m_SegmentSize = 0x40000;
+			bs.Open(sDir.c_str(), nStamp);
+			VerifyAll(bs, true);
+
+			// supersede
+			Blob bodyP(nullptr, 0), bodyE("new", 3);
+			bs.Insert(2, Merkle::Hash(2U), bodyP, bodyE);
+			bs.Flush();
+			bs.OnCommitted();
+		}
+
+		{
+			BlockStore bs;
+			bs.m_SegmentSize = 0x40000;
+			bs.Open(sDir.c_str(), nStamp);
+
+			BlockStore::Body body;
+			verify_test(bs.Find(2, Merkle::Hash(2U), body));
+			verify_test(!body.m_Perishable.size && (body.m_Eternal.size == 3) && !memcmp(body.m_Eternal.data, "new", 3));
+
+			// erase all, only the tail segment remains
+			for (uint32_t i = 0; i < nRows; i++)
+				bs.Delete(i + 1);
+			bs.Flush();
+			bs.OnCommitted();
+
+			verify_test(!bs.get_Totals().m_Records && !bs.get_Totals().m_Live);
+			verify_test(bs.get_Segments() <= 1);
+		}
+
+		// the held body outlives its segment
+		{
+			Merkle::Hash hv;
+			Blob bodyP, bodyE;
+			MakeBody(0, hv, bodyP, bodyE);
+			verify_test(!bodyHeld.m_Perishable.size && IsEqual(bodyHeld.m_Eternal, bodyE));
+			bodyHeld.m_Eternal.clear();
+		}
+
+		{
+			// wrong stamp - discarded
+			BlockStore bs;
+			bs.Open(sDir.c_str(), nStamp + 1);
+			verify_test(!bs.get_Totals().m_Records && !bs.get_Segments());
+		}
+
+		fsutils::remove(sDir);
+	}
+
+	void TestBlockStoreServing()
+	{
+		// bodies served from the DB blobs vs the block store mapping
+		const uint32_t nBlocks = 300;
+		const uint32_t nSizeP = 0x10000;
+		const uint32_t nSizeE = 0x4000;
+		const uint32_t nPasses = 5;
+
+		std::string sDir;
+		NodeProcessor::get_MappingPath(sDir, g_sz, "-blocks");
+
+		NodeDB db;
+		db.Open(g_sz, true);
+		NodeDB::Transaction tr(db);
+
+		BlockStore bs;
+		bs.Open(sDir.c_str(), 1);
+
+		PeerID peer;
+		memset(peer.m_pData, 0x66, peer.nBytes);
+
+		ByteBuffer bufP(nSizeP + nBlocks), bufE(nSizeE + nBlocks);
+		for (size_t i = 0; i < bufP.size(); i++)
+			bufP[i] = static_cast<uint8_t>(i * 13);
+		for (size_t i = 0; i < bufE.size(); i++)
+			bufE[i] = static_cast<uint8_t>(i * 5);
+
+		// 2 chains: the 1st is kept in the DB, the 2nd in the store
+		std::vector<uint64_t> pRows[2];
+		for (uint32_t iChain = 0; iChain < 2; iChain++)
+		{
+			db.set_BlockStore(&bs, !!iChain);
+
+			Block::SystemState::Full s;
+			ZeroObject(s);
+			s.m_Prev = Merkle::Hash(iChain + 1);
+
+			for (uint32_t h = 0; h < nBlocks; h++)
+			{
+				s.m_Height = h + Rules::HeightGenesis;
+				s.m_ChainWork = h;
+
+				uint64_t row = db.InsertState(s, peer);
+				pRows[iChain].push_back(row);
+
+				db.SetStateBlock(row, Blob(&bufP[h], nSizeP), Blob(&bufE[h], nSizeE), peer);
+				s.get_Hash(s.m_Prev);
+			}
+		}
+
+		bs.Flush();
+		tr.Commit();
+		bs.OnCommitted();
+		tr.Start(db);
+
+		verify_test(bs.get_Totals().m_Records == nBlocks);
+
+		uint32_t pTime_ms[3];
+		for (uint32_t iChain = 0; iChain < 2; iChain++)
+		{
+			uint32_t t_ms = GetTime_ms();
+
+			for (uint32_t iPass = 0; iPass < nPasses; iPass++)
+			{
+				for (uint32_t h = 0; h < nBlocks; h++)
+				{
+					ByteBuffer bbP, bbE;
+					db.GetStateBlock(pRows[iChain][h], &bbP, &bbE, nullptr);
+
+					if (!iPass)
+						verify_test(
+							(bbP.size() == nSizeP) && !memcmp(&bbP.front(), &bufP[h], nSizeP) &&
+							(bbE.size() == nSizeE) && !memcmp(&bbE.front(), &bufE[h], nSizeE));
+				}
+			}
+
+			pTime_ms[iChain] = GetTime_ms() - t_ms;
+		}
+
+		{
+			// from the store, as served now (the buffers reference the mapping)
+			uint32_t t_ms = GetTime_ms();
+
+			for (uint32_t iPass = 0; iPass < nPasses; iPass++)
+			{
+				for (uint32_t h = 0; h < nBlocks; h++)
+				{
+					io::SharedBuffer bP, bE;
+					db.GetStateBlock(pRows[1][h], &bP, &bE);
+
+					if (!iPass)
+						verify_test(
+							(bP.size == nSizeP) && !memcmp(bP.data, &bufP[h], nSizeP) &&
+							(bE.size == nSizeE) && !memcmp(bE.data, &bufE[h], nSizeE));
+				}
+			}
+
+			pTime_ms[2] = GetTime_ms() - t_ms;
+		}
+
+		uint64_t nTotal = uint64_t(nSizeP + nSizeE) * nBlocks * nPasses;
+		printf("Block bodies served, %u MB: from DB: %u ms, from store: %u ms, from store w/o copy: %u ms\n",
+			static_cast<uint32_t>(nTotal >> 20), pTime_ms[0], pTime_ms[1], pTime_ms[2]);
+
+		// served without copy: the buffers reference the mapping. The message is the same as with the copied bodies
+		for (uint32_t iChain = 0; iChain < 2; iChain++)
+		{
+			proto::BodyPack msg;
+			proto::BodyPackRef msgRef;
+
+			for (uint32_t h = 0; h < 3; h++)
+			{
+				uint64_t row = pRows[iChain][h];
+
+				proto::BodyBuffers& bb = msg.m_Bodies.emplace_back();
+				db.GetStateBlock(row, &bb.m_Perishable, &bb.m_Eternal, nullptr);
+
+				proto::BodyBuffersRef& bbRef = msgRef.m_Bodies.emplace_back();
+				db.GetStateBlock(row, &bbRef.m_Perishable, &bbRef.m_Eternal);
+
+				if (iChain)
+				{
+					Merkle::Hash hv;
+					db.get_StateHash(row, hv);
+
+					BlockStore::Body body;
+					verify_test(bs.Find(row, hv, body));
+					verify_test((bbRef.m_Perishable.data == body.m_Perishable.data) && (bbRef.m_Eternal.data == body.m_Eternal.data));
+				}
+			}
+
+			Serializer ser, serRef;
+			ser & msg;
+			serRef & msgRef;
+
+			SerializeBuffer sb = ser.buffer(), sbRef = serRef.buffer();
+			verify_test((sb.second == sbRef.second) && !memcmp(sb.first, sbRef.first, sb.second));
+		}
+
+		// perishable part erased, the eternal is still read from the store
+		uint64_t row = pRows[1][0];
+		db.DelStateBlockPP(row);
+
+		ByteBuffer bbP, bbE;
+		db.GetStateBlock(row, &bbP, &bbE, nullptr);
+		verify_test(bbP.empty() && (bbE.size() == nSizeE));
+
+		db.DelStateBlockAll(row);
+		bbE.clear();
+		db.GetStateBlock(row, &bbP, &bbE, nullptr);
+		verify_test(bbP.empty() && bbE.empty());
+
+		// read snapshots are served from the store as well. The store is modified ahead of the DB commit, hence a snapshot may outlive the record
+		NodeDB::ReadPool pool;
+		pool.Open(g_sz, &bs);
+		{
+			NodeDB::ReadPool::Snapshot ss(pool);
+			row = pRows[1][1];
+
+			io::SharedBuffer bP, bE;
+			ss.get_DB().GetStateBlock(row, &bP, &bE);
+			verify_test((bP.size == nSizeP) && (bE.size == nSizeE));
+
+			db.DelStateBlockAll(row);
+			ss.get_DB().GetStateBlock(row, &bP, &bE); // not available, no error
+			verify_test(!bP.size && !bE.size);
+		}
+		pool.Close();
+
+		bs.Flush();
+		tr.Commit();
+		bs.OnCommitted();
+
+		verify_test(bs.get_Totals().m_Records == nBlocks - 2);
+
+		db.set_BlockStore(nullptr, false);
+		db.Close();
+		bs.Close();
+
+		fsutils::remove_all(sDir);
+	}
+
+	void TestStatesMmrCache()
+	{
+		const uint32_t hMax = 3000;
+		const uint32_t nProofs = 2000;
+
+		std::vector<Block::SystemState::Full> vStates(hMax);
+		std::vector<Merkle::Hash> vHashes(hMax);
+
+		for (uint32_t h = 0; h < hMax; h++)
+		{
+			Block::SystemState::Full& s = vStates[h];
+			ZeroObject(s);
+			s.m_Height = h + Rules::HeightGenesis;
+			s.m_ChainWork = h;
+			s.m_TimeStamp = h;
+			if (h)
+				s.m_Prev = vHashes[h - 1];
+			s.get_Hash(vHashes[h]);
+		}
+
+		PeerID peer;
+		memset(peer.m_pData, 0x66, peer.nBytes);
+
+		NodeDB db;
+		db.Open(g_sz);
+		NodeDB::Transaction tr(db);
+
+		NodeDB::StatesMmr smmr(db);
+		NodeDB::StateID sid;
+
+		for (uint32_t h = 0; h < hMax; h++)
+		{
+			sid.m_Row = db.InsertState(vStates[h], peer);
+			sid.m_Height = h + Rules::HeightGenesis;
+			db.MoveFwd(sid);
+
+			if (h)
+				smmr.Append(vHashes[h - 1]); // the MMR contains all the states below the cursor
+		}
+
+		const uint64_t nCount = smmr.m_Count;
+		Merkle::Hash hvRoot;
+		smmr.get_Hash(hvRoot);
+
+		std::vector<uint64_t> vIdx(nProofs);
+		for (uint32_t i = 0; i < nProofs; i++)
+			vIdx[i] = (i * 7919ULL) % nCount;
+
+		auto RunProofs = [&](NodeDB::StatesMmr& x, uint64_t& nReads) {
+
+			uint64_t nReads0 = x.m_DbReads;
+			uint32_t t_ms = GetTime_ms();
+
+			for (uint32_t i = 0; i < nProofs; i++)
+			{
+				Merkle::ProofBuilderStd bld;
+				x.get_Proof(bld, vIdx[i]);
+
+				Merkle::Hash hv = vHashes[vIdx[i]];
+				Merkle::Interpret(hv, bld.m_Proof);
+				verify_test(hv == hvRoot);
+			}
+
+			nReads = x.m_DbReads - nReads0;
+			return GetTime_ms() - t_ms;
+		};
+
+		// benchmark: header proofs throughput, states hashes fetched from the DB, cached, and stored in a stream
+		uint64_t nReadsDB, nReadsCold, nReadsWarm, nReadsStored;
+		uint32_t dtDB_ms, dtCold_ms, dtWarm_ms, dtStored_ms;
+
+		{
+			NodeDB::StatesMmr x(db);
+			x.m_Count = nCount;
+			dtDB_ms = RunProofs(x, nReadsDB);
+		}
+
+		NodeDB::StatesMmr smmrC(db);
+		smmrC.m_Count = nCount;
+		smmrC.m_Lru.SetMax(0x10000);
+		dtCold_ms = RunProofs(smmrC, nReadsCold);
+		dtWarm_ms = RunProofs(smmrC, nReadsWarm);
+
+		verify_test(nReadsCold && (nReadsCold <= nReadsDB));
+		verify_test(!nReadsWarm); // DB-free
+
+		NodeDB::StatesMmr smmrS(db);
+		smmrS.m_Count = nCount;
+		smmrS.BuildHashes();
+		dtStored_ms = RunProofs(smmrS, nReadsStored);
+
+		printf("States MMR, %u proofs: from DB: %u ms, %u reads. Cached: %u ms, %u reads, then %u ms, %u reads. Stored hashes: %u ms, %u reads\n",
+			nProofs,
+			dtDB_ms, static_cast<uint32_t>(nReadsDB),
+			dtCold_ms, static_cast<uint32_t>(nReadsCold),
+			dtWarm_ms, static_cast<uint32_t>(nReadsWarm),
+			dtStored_ms, static_cast<uint32_t>(nReadsStored));
+
+		// small cache is bounded
+		{
+			NodeDB::StatesMmr x(db);
+			x.m_Count = nCount;
+			x.m_Lru.SetMax(100);
+
+			uint64_t nReads;
+			RunProofs(x, nReads);
+			verify_test(x.m_Lru.get_Count() == 100);
+		}
+
+		// rollback: the cached and stored elements above the new count must not be used
+		const uint64_t nCount2 = nCount - 123;
+
+		for (uint32_t iPass = 0; iPass < 2; iPass++)
+		{
+			NodeDB::StatesMmr& x = iPass ? smmrS : smmrC;
+			x.ShrinkTo(nCount2);
+
+			for (uint64_t i = nCount2; i < nCount; i++)
+			{
+				Merkle::Hash hv = vHashes[i];
+				hv.Inc(); // different branch
+				x.Append(hv);
+			}
+
+			Merkle::Hash hv;
+			x.get_Hash(hv);
+			verify_test(hv != hvRoot);
+
+			x.ShrinkTo(nCount2);
+			for (uint64_t i = nCount2; i < nCount; i++)
+				x.Append(vHashes[i]);
+
+			x.get_Hash(hv);
+			verify_test(hv == hvRoot);
+		}
+
+		{
+			// the stream is consistent
+			NodeDB::StatesMmr x(db);
+			x.m_Count = nCount;
+			x.m_StoreHashes = true;
+
+			uint64_t nReads;
+			RunProofs(x, nReads);
+		}
+	}
+
 	struct MiniWallet
 	{
 		Key::IKdf::Ptr m_pKdf;
@@ -1108,17 +1999,308 @@ namespace beam
 
 			verify_test(vOutsIn.size() == block.m_vInputs.size());
 
-			// inputs must come with maturities!
-			for (size_t i = 0; i < block.m_vInputs.size(); i++)
+			// inputs must come with maturities!
+			for (size_t i = 0; i < block.m_vInputs.size(); i++)
+			{
+				const Input& inp = *block.m_vInputs[i];
+				verify_test(inp.m_Commitment == vOutsIn[i]->m_Commitment);
+				verify_test(inp.m_Internal.m_ID && inp.m_Internal.m_Maturity);
+			}
+		}
+
+	}
+
+
+	void TestBlockTemplate()
+	{
+		// Benchmark: block template latency with a large synthetic pool.
+		// The txs are kernel-only (valid in any context), the fees are assigned to the pool elements directly, to have a variety of profits.
+		MyNodeProcessor1 np;
+		np.Initialize(g_sz);
+		np.OnTreasury(g_Treasury);
+
+		Key::IKdf& kdf = *np.m_Wallet.m_pKdf;
+		uint64_t nIdx = 0;
+
+		auto fnAdd = [&np, &kdf, &nIdx](Amount fee)
+		{
+			Transaction::Ptr pTx = std::make_shared<Transaction>();
+
+			TxKernelStd::Ptr pKrn(new TxKernelStd);
+			ECC::Scalar::Native k;
+			kdf.DeriveKey(k, Key::ID(++nIdx, Key::Type::Kernel));
+			pKrn->Sign(k);
+
+			pTx->m_vKernels.push_back(std::move(pKrn));
+			pTx->m_Offset = -k;
+
+			Transaction::Context::Params pars;
+			Transaction::Context ctx(pars);
+			ctx.m_Height.m_Min = Rules::HeightGenesis;
+			ctx.m_Height.m_Max = MaxHeight;
+			ctx.m_Stats.m_Fee = AmountBig::Type(fee);
+
+			Transaction::KeyType key;
+			pTx->get_Key(key);
+
+			return np.m_TxPool.AddValidTx(std::move(pTx), ctx, key, 0);
+		};
+
+		const uint32_t nPool = 50000;
+		const uint32_t nNew = 100;
+
+		for (uint32_t i = 0; i < nPool; i++)
+			fnAdd(100 + (i * 7919ULL) % 100000);
+
+		NodeProcessor::BlockTemplate tmpl;
+
+		auto fnGenerate = [&np, &tmpl](bool bTemplate, Amount& fees)
+		{
+			NodeProcessor::BlockContext bc(np.m_TxPool, 0, *np.m_Wallet.m_pKdf, *np.m_Wallet.m_pKdf);
+			if (bTemplate)
+				bc.m_pTemplate = &tmpl;
+
+			uint32_t t0_ms = GetTime_ms();
+			verify_test(np.GenerateNewBlock(bc));
+			fees = bc.m_Fees;
+
+			return GetTime_ms() - t0_ms;
+		};
+
+		Amount fees0, fees1;
+
+		uint32_t dtFull_ms = fnGenerate(true, fees0);
+		verify_test(NodeProcessor::BlockTemplate::Build::Full == tmpl.m_Build);
+		size_t nSelected = tmpl.m_vTxs.size();
+		verify_test(nSelected && (nSelected < nPool)); // the block is full
+
+		// low-profit newcomers can't make it
+		for (uint32_t i = 0; i < nNew; i++)
+			fnAdd(1);
+
+		uint32_t dtReused_ms = fnGenerate(true, fees1);
+		verify_test(NodeProcessor::BlockTemplate::Build::Reused == tmpl.m_Build);
+		verify_test(fees1 == fees0);
+
+		// high-profit newcomers replace the worst selected. All the txs are of the same size, so that the count remains
+		for (uint32_t i = 0; i < nNew; i++)
+			fnAdd(1000000);
+
+		fnGenerate(true, fees1);
+		verify_test(NodeProcessor::BlockTemplate::Build::Full == tmpl.m_Build);
+		verify_test(tmpl.m_vTxs.size() == nSelected);
+
+		uint32_t dtNoTemplate_ms = fnGenerate(false, fees0);
+		verify_test(fees1 == fees0);
+
+		// evicted from the pool. The freed space is filled from the rest of the pool
+		np.m_TxPool.Delete(*tmpl.m_vTxs.front());
+
+		fnGenerate(true, fees1);
+		verify_test(NodeProcessor::BlockTemplate::Build::Full == tmpl.m_Build);
+		verify_test(tmpl.m_vTxs.size() == nSelected);
+
+		fnGenerate(false, fees0);
+		verify_test(fees1 == fees0);
+
+		// tip change
+		{
+			TxPool::Fluff txPool; // empty
+			NodeProcessor::BlockContext bc(txPool, 0, *np.m_Wallet.m_pKdf, *np.m_Wallet.m_pKdf);
+			verify_test(np.GenerateNewBlock(bc));
+
+			np.OnState(bc.m_Hdr, PeerID());
+
+			Block::SystemState::ID id;
+			bc.m_Hdr.get_ID(id);
+
+			np.OnBlock(id, bc.m_BodyP, bc.m_BodyE, PeerID());
+			np.TryGoUp();
+			verify_test(np.m_Cursor.m_ID == id);
+		}
+
+		fnGenerate(true, fees1);
+		verify_test(NodeProcessor::BlockTemplate::Build::Full == tmpl.m_Build);
+		verify_test(tmpl.m_vTxs.size() == nSelected);
+
+		printf("Block template, Pool=%u, Selected=%u: Full=%u ms, Reused=%u ms, No template=%u ms\n",
+			nPool,
+			static_cast<uint32_t>(nSelected),
+			dtFull_ms,
+			dtReused_ms,
+			dtNoTemplate_ms);
+	}
+
+	void TestShieldedPool()
+	{
+		// The pool is maintained by the NodeProcessor: appended on block apply, truncated on rollback, validated (or rebuilt) on open.
+		// Each time it must match the shielded outputs in the DB
+		std::string sPath;
+		NodeProcessor::get_MappingPath(sPath, g_sz, "-shielded-pool.bin");
+		DeleteFile(sPath.c_str());
+
+		struct MyProcessor
+			:public MyNodeProcessor1
+		{
+			uint32_t m_nShieldedIdx = 0;
+
+			void VerifyPool()
+			{
+				const ShieldedPool& sp = m_ShieldedPool;
+				verify_test(sp.IsOpen());
+
+				TxoID nCount = m_Extra.m_ShieldedOutputs;
+				verify_test(sp.get_Count() == nCount);
+
+				if (nCount)
+				{
+					std::vector<ECC::Point::Storage> vPts(nCount);
+					get_DB().ShieldedRead(0, &vPts.front(), nCount);
+					verify_test(!memcmp(sp.get_At(0), &vPts.front(), sizeof(ECC::Point::Storage) * nCount));
+				}
+			}
+
+			bool AddShieldedTx(TxPool::Fluff& txPool)
+			{
+				Height h = m_Cursor.m_ID.m_Height;
+
+				Transaction::Ptr pTx;
+				Amount val = m_Wallet.MakeTxInput(pTx, h);
+				if (!val)
+					return false;
+
+				auto& fs = Transaction::FeeSettings::get(h + 1);
+				Amount fee = fs.get_DefaultStd() + fs.m_ShieldedOutputTotal;
+				verify_test(val > fee);
+
+				TxKernelShieldedOutput::Ptr pKrn(new TxKernelShieldedOutput);
+				pKrn->m_Height.m_Min = h + 1;
+				pKrn->m_Fee = fee;
+
+				ShieldedTxo::Viewer viewer;
+				viewer.FromOwner(*m_Wallet.m_pKdf, 0);
+
+				ShieldedTxo::Data::Params sdp;
+				sdp.m_Ticket.Generate(pKrn->m_Txo.m_Ticket, viewer, ++m_nShieldedIdx);
+				sdp.m_Output.m_Value = val - fee;
+				ZeroObject(sdp.m_Output.m_User);
+
+				pKrn->UpdateMsg();
+				ECC::Oracle oracle;
+				oracle << pKrn->m_Msg;
+
+				sdp.GenerateOutp(pKrn->m_Txo, h + 1, oracle);
+				pKrn->MsgToID();
+
+				pTx->m_vKernels.push_back(std::move(pKrn));
+				MiniWallet::UpdateOffset(*pTx, sdp.m_Output.m_k, true);
+				pTx->Normalize();
+
+				Transaction::Context::Params pars;
+				Transaction::Context ctx(pars);
+				ctx.m_Height.m_Min = h + 1;
+				verify_test(pTx->IsValid(ctx));
+
+				Transaction::KeyType key;
+				pTx->get_Key(key);
+
+				txPool.AddValidTx(std::move(pTx), ctx, key, 0);
+				return true;
+			}
+
+			void MineBlock(uint32_t nShielded)
+			{
+				TxPool::Fluff txPool;
+				if (m_Cursor.m_ID.m_Height + 1 >= Rules::get().pForks[2].m_Height)
+				{
+					for (uint32_t i = 0; (i < nShielded) && AddShieldedTx(txPool); i++)
+						;
+				}
+
+				BlockContext bc(txPool, 0, *m_Wallet.m_pKdf, *m_Wallet.m_pKdf);
+				verify_test(GenerateNewBlock(bc));
+
+				OnState(bc.m_Hdr, PeerID());
+
+				Block::SystemState::ID id;
+				bc.m_Hdr.get_ID(id);
+
+				OnBlock(id, bc.m_BodyP, bc.m_BodyE, PeerID());
+				TryGoUp();
+				verify_test(m_Cursor.m_ID == id);
+
+				m_Wallet.AddMyUtxo(CoinID(Rules::get_Emission(id.m_Height), id.m_Height, Key::Type::Coinbase)); // the fees are too small to be spent
+			}
+		};
+
+		const uint32_t nShieldedPerBlock = 1; // the coinbases mature before the fork accumulate, there are spare ones after the rollback
+		std::vector<TxoID> vOutputs; // per height
+
+		{
+			MyProcessor np;
+			np.Initialize(g_sz);
+			np.OnTreasury(g_Treasury);
+			np.VerifyPool();
+
+			vOutputs.push_back(np.m_Extra.m_ShieldedOutputs);
+
+			for (uint32_t i = 0; i < 40; i++)
+			{
+				np.MineBlock(nShieldedPerBlock);
+				vOutputs.push_back(np.m_Extra.m_ShieldedOutputs);
+			}
+
+			np.VerifyPool();
+			verify_test(np.m_Extra.m_ShieldedOutputs);
+
+			// rollback, the outputs of the reverted blocks are removed
+			Height h0 = np.m_Cursor.m_ID.m_Height - 5;
+			np.ManualRollbackTo(h0);
+			verify_test(np.m_Cursor.m_ID.m_Height == h0);
+			verify_test(np.m_Extra.m_ShieldedOutputs == vOutputs[h0]);
+			np.VerifyPool();
+
+			vOutputs.resize(h0 + 1);
+
+			// forget the coins of the reverted blocks
+			for (auto it = np.m_Wallet.m_MyUtxos.begin(); np.m_Wallet.m_MyUtxos.end() != it; )
+			{
+				if (it->second.m_Cid.m_Idx > h0)
+					it = np.m_Wallet.m_MyUtxos.erase(it);
+				else
+					++it;
+			}
+
+			// appended after the rollback
+			for (uint32_t i = 0; i < 3; i++)
 			{
-				const Input& inp = *block.m_vInputs[i];
-				verify_test(inp.m_Commitment == vOutsIn[i]->m_Commitment);
-				verify_test(inp.m_Internal.m_ID && inp.m_Internal.m_Maturity);
+				np.MineBlock(nShieldedPerBlock);
+				vOutputs.push_back(np.m_Extra.m_ShieldedOutputs);
 			}
+
+			verify_test(np.m_Extra.m_ShieldedOutputs > vOutputs[h0]);
+			np.VerifyPool();
 		}
 
-	}
+		{
+			// reopen, the pool is accepted as is
+			MyProcessor np;
+			np.Initialize(g_sz);
+			verify_test(np.m_Extra.m_ShieldedOutputs == vOutputs.back());
+			np.VerifyPool();
+		}
+
+		DeleteFile(sPath.c_str());
+
+		{
+			// missing pool is rebuilt from the DB
+			MyProcessor np;
+			np.Initialize(g_sz);
+			np.VerifyPool();
+		}
 
+		DeleteFile(sPath.c_str());
+	}
 
 	void TestNodeProcessor2(std::vector<BlockPlus::Ptr>& blockChain)
 	{
@@ -1537,162 +2719,569 @@ namespace beam
 			np.OnBlock(id, bbP, bbE, pid);
 		}
 
-		np.TryGoUp();
-		verify_test(!np.IsFastSync());
-		verify_test(np.m_Cursor.m_ID.m_Height == blockChain.size());
-	}
+		np.TryGoUp();
+		verify_test(!np.IsFastSync());
+		verify_test(np.m_Cursor.m_ID.m_Height == blockChain.size());
+	}
+
+	const uint16_t g_Port = 25003; // don't use the default port to prevent collisions with running nodes, beacons and etc.
+
+	void TestNodeConversation()
+	{
+		// Testing configuration: Node0 <-> Node1 <-> Client.
+
+		io::Reactor::Ptr pReactor(io::Reactor::create());
+		io::Reactor::Scope scope(*pReactor);
+
+		Node node, node2;
+		node.m_Cfg.m_sPathLocal = g_sz;
+		node.m_Cfg.m_Listen.port(g_Port);
+		node.m_Cfg.m_Listen.ip(INADDR_ANY);
+		node.m_Cfg.m_Treasury = g_Treasury;
+
+		node.m_Cfg.m_Timeout.m_GetBlock_ms = 1000 * 60;
+		node.m_Cfg.m_Timeout.m_GetState_ms = 1000 * 60;
+
+		node2.m_Cfg.m_sPathLocal = g_sz2;
+		node2.m_Cfg.m_Listen.port(g_Port + 1);
+		node2.m_Cfg.m_Listen.ip(INADDR_ANY);
+		node2.m_Cfg.m_Timeout = node.m_Cfg.m_Timeout;
+		node2.m_Cfg.m_Treasury = g_Treasury;
+
+		node2.m_Cfg.m_BeaconPort = g_Port;
+
+		ECC::SetRandom(node);
+		ECC::SetRandom(node2);
+
+		node.Initialize();
+		node2.Initialize();
+
+		struct MyClient
+			:public proto::NodeConnection
+		{
+			Node* m_ppNode[2];
+			unsigned int m_iNode;
+			unsigned int m_WaitingCycles;
+
+			Height m_HeightMax;
+			const Height m_HeightTrg = 70;
+
+			MyClient()
+			{
+				m_pTimer = io::Timer::create(io::Reactor::get_Current());
+			}
+
+			virtual void OnConnectedSecure() override {
+				OnTimer();
+			}
+
+			virtual void OnDisconnect(const DisconnectReason&) override {
+				fail_test("OnDisconnect");
+			}
+
+			io::Timer::Ptr m_pTimer;
+
+			void OnTimer() {
+
+
+				if (m_HeightMax < m_HeightTrg)
+				{
+					Node& n = *m_ppNode[m_iNode];
+
+					TxPool::Fluff txPool; // empty, no transactions
+					NodeProcessor::BlockContext bc(txPool, 0, *n.m_Keys.m_pMiner, *n.m_Keys.m_pMiner);
+
+					verify_test(n.get_Processor().GenerateNewBlock(bc));
+
+					n.get_Processor().OnState(bc.m_Hdr, PeerID());
+
+					Block::SystemState::ID id;
+					bc.m_Hdr.get_ID(id);
+
+					n.get_Processor().OnBlock(id, bc.m_BodyP, bc.m_BodyE, PeerID());
+					n.get_Processor().TryGoUp();
+
+					std::setmax(m_HeightMax, bc.m_Hdr.m_Height);
+
+					printf("Mined block Height = %u, node = %u \n", (unsigned int) bc.m_Hdr.m_Height, (unsigned int)m_iNode);
+
+					++m_iNode %= _countof(m_ppNode);
+				}
+				else
+					if (m_WaitingCycles++ > 60)
+					{
+						fail_test("Blockchain height didn't reach target");
+						io::Reactor::get_Current().stop();
+					}
+
+				SetTimer(100);
+			}
+
+			virtual void OnMsg(proto::NewTip&& msg) override
+			{
+				printf("Tip Height=%u\n", (unsigned int) msg.m_Description.m_Height);
+				verify_test(msg.m_Description.m_Height <= m_HeightMax);
+				if (msg.m_Description.m_Height == m_HeightTrg)
+					io::Reactor::get_Current().stop();
+			}
+
+			void SetTimer(uint32_t timeout_ms) {
+				m_pTimer->start(timeout_ms, false, [this]() { return (this->OnTimer)(); });
+			}
+		};
+
+		MyClient cl;
+		cl.m_iNode = 0;
+		cl.m_HeightMax = 0;
+		cl.m_WaitingCycles = 0;
+		cl.m_ppNode[0] = &node;
+		cl.m_ppNode[1] = &node2;
+
+		io::Address addr;
+		addr.resolve("127.0.0.1");
+		addr.port(g_Port + 1);
+
+		cl.Connect(addr);
+
+
+		pReactor->run();
+
+		node.GenerateRecoveryInfo(g_sz3);
+
+		struct MyParser :public RecoveryInfo::IParser
+		{
+			Key::IPKdf::Ptr m_pOwner1;
+			Key::IPKdf::Ptr m_pOwner2;
+			uint32_t m_nUnrecognized = 0;
+
+			virtual bool OnUtxo(Height h, const Output& outp) override
+			{
+				CoinID cid;
+				bool b1 = outp.Recover(h, *m_pOwner1, cid);
+				bool b2 = outp.Recover(h, *m_pOwner2, cid);
+				if (!(b1 || b2))
+				{
+					verify_test(!h); // treasury
+					m_nUnrecognized++;
+					verify_test(m_nUnrecognized <= 1);
+				}
+
+				return true;
+			}
+		} parser;
+		parser.m_pOwner1 = node.m_Keys.m_pOwner;
+		parser.m_pOwner2 = node2.m_Keys.m_pOwner;
+
+		verify_test(parser.Proceed(g_sz3));
+
+		DeleteFile(g_sz3);
+	}
+
+	void TestNodeSyncPipelined()
+	{
+		// Node3 syncs from 2 nodes with the same chain. The blocks are requested in small segments, both nodes should serve them.
+		// The 2nd node keeps the bodies in the block store
+		io::Reactor::Ptr pReactor(io::Reactor::create());
+		io::Reactor::Scope scope(*pReactor);
+
+		const Height hTrg = 500;
+
+		Node pNodes[2];
+		for (uint32_t i = 0; i < _countof(pNodes); i++)
+		{
+			Node& n = pNodes[i];
+			n.m_Cfg.m_sPathLocal = i ? g_sz2 : g_sz;
+			n.m_Cfg.m_Listen.port(g_Port + i);
+			n.m_Cfg.m_Listen.ip(INADDR_ANY);
+			n.m_Cfg.m_Treasury = g_Treasury;
+			n.m_Cfg.m_BeaconPeriod_ms = 0;
+			n.m_Cfg.m_ProcessorParams.m_BlockStore = (1 == i);
+
+			ECC::SetRandom(n);
+			n.Initialize();
+		}
+
+		for (Height h = Rules::HeightGenesis; h <= hTrg; h++)
+		{
+			Node& n = pNodes[0];
+
+			TxPool::Fluff txPool; // empty, no transactions
+			NodeProcessor::BlockContext bc(txPool, 0, *n.m_Keys.m_pMiner, *n.m_Keys.m_pMiner);
+			verify_test(n.get_Processor().GenerateNewBlock(bc));
+
+			Block::SystemState::ID id;
+			bc.m_Hdr.get_ID(id);
+
+			for (uint32_t i = 0; i < _countof(pNodes); i++)
+			{
+				NodeProcessor& np = pNodes[i].get_Processor();
+				np.OnState(bc.m_Hdr, PeerID());
+				np.OnBlock(id, bc.m_BodyP, bc.m_BodyE, PeerID());
+				np.TryGoUp();
+			}
+		}
+
+		Node node3;
+		node3.m_Cfg.m_sPathLocal = g_sz3;
+		node3.m_Cfg.m_Treasury = g_Treasury;
+		node3.m_Cfg.m_BeaconPeriod_ms = 0;
+		node3.m_Cfg.m_BandwidthCtl.m_CompressedBodies = true; // to count the packs served by each node
+		node3.m_Cfg.m_SyncCtl.m_Window = 20000; // off by default
+		node3.m_Cfg.m_SyncCtl.m_PackMin = 10;
+		node3.m_Cfg.m_SyncCtl.m_PackTime_ms = 1; // segments won't grow
+
+		node3.m_Cfg.m_Connect.resize(_countof(pNodes));
+		for (uint32_t i = 0; i < _countof(pNodes); i++)
+		{
+			node3.m_Cfg.m_Connect[i].resolve("127.0.0.1");
+			node3.m_Cfg.m_Connect[i].port(g_Port + i);
+		}
+
+		ECC::SetRandom(node3);
+		node3.Initialize();
+
+		uint32_t nCycles = 0;
+		io::Timer::Ptr pTimer = io::Timer::create(*pReactor);
+		pTimer->start(100, true, [&]() {
+
+			if (node3.get_Processor().m_Cursor.m_ID.m_Height >= hTrg)
+				pReactor->stop();
+			else
+			{
+				if (++nCycles > 600)
+				{
+					fail_test("Pipelined sync didn't complete");
+					pReactor->stop();
+				}
+			}
+		});
+
+		pReactor->run();
+
+		verify_test(node3.get_Processor().m_Cursor.m_ID.m_Height == hTrg);
+
+		const Node::SyncStats& ss = node3.m_SyncStats;
+		verify_test(ss.m_BlocksDownloaded >= hTrg - Rules::HeightGenesis + 1);
+		verify_test(ss.m_hDownloaded == hTrg);
+
+		uint64_t nPacks = 0;
+		for (uint32_t i = 0; i < _countof(pNodes); i++)
+		{
+			const Node::BodyCompressionStats::Direction& bcs = pNodes[i].m_BodyCompressionStats.m_Sent;
+			verify_test(bcs.m_Packs); // both peers were used
+			nPacks += bcs.m_Packs;
+		}
+
+		verify_test(nPacks == node3.m_BodyCompressionStats.m_Received.m_Packs);
+		printf("Pipelined sync: %u blocks, %u + %u packs, %u re-requested\n",
+			static_cast<uint32_t>(ss.m_BlocksDownloaded),
+			static_cast<uint32_t>(pNodes[0].m_BodyCompressionStats.m_Sent.m_Packs),
+			static_cast<uint32_t>(pNodes[1].m_BodyCompressionStats.m_Sent.m_Packs),
+			ss.m_PacksHedged);
+
+		// window feedback. The validation does 100 blocks/sec, the backlog limit is 6000 blocks
+		Node::SyncStats& ss2 = node3.m_SyncStats;
+		verify_test(ss2.m_Window == 20000);
+		ss2.m_ValidatedPerSec = 100;
+
+		ss2.AdjustWindow(6000);
+		verify_test(ss2.m_Window == 20000); // within the limit
+
+		ss2.AdjustWindow(10000);
+		verify_test(ss2.m_Window == 10000); // throttled
+		ss2.AdjustWindow(10000);
+		verify_test(ss2.m_Window == 5000);
+		ss2.AdjustWindow(10000);
+		verify_test(ss2.m_Window == node3.m_Cfg.m_BandwidthCtl.m_MaxBodyPackCount); // not below a single pack
+
+		ss2.AdjustWindow(2000);
+		verify_test(ss2.m_Window == 3000); // the window isn't exhausted yet
+		ss2.AdjustWindow(2900);
+		verify_test(ss2.m_Window == 6000); // extended
+		ss2.AdjustWindow(5000);
+		verify_test(ss2.m_Window == 12000);
+		ss2.AdjustWindow(5000);
+		verify_test(ss2.m_Window == 12000); // not exhausted
+		ss2.m_ValidatedPerSec = 1000;
+		ss2.AdjustWindow(10000);
+		verify_test(ss2.m_Window == 20000); // not above the config
+
+		ss2.m_ValidatedPerSec = 0;
+		ss2.AdjustWindow(100000);
+		verify_test(ss2.m_Window == 20000); // the validation is stalled, no feedback
+	}
+
+	void TestNodeSyncServing()
+	{
+		// Benchmark: a node syncs from genesis from a single peer, that serves the bodies from the DB vs the block store
+		io::Reactor::Ptr pReactor(io::Reactor::create());
+		io::Reactor::Scope scope(*pReactor);
+
+		const Height hTrg = 500;
+
+		Node pNodes[2];
+		for (uint32_t i = 0; i < _countof(pNodes); i++)
+		{
+			Node& n = pNodes[i];
+			n.m_Cfg.m_sPathLocal = i ? g_sz2 : g_sz;
+			n.m_Cfg.m_Listen.port(g_Port + i);
+			n.m_Cfg.m_Listen.ip(INADDR_ANY);
+			n.m_Cfg.m_Treasury = g_Treasury;
+			n.m_Cfg.m_BeaconPeriod_ms = 0;
+			n.m_Cfg.m_ProcessorParams.m_BlockStore = (1 == i);
+
+			ECC::SetRandom(n);
+			n.Initialize();
+		}
+
+		for (Height h = Rules::HeightGenesis; h <= hTrg; h++)
+		{
+			Node& n = pNodes[0];
+
+			TxPool::Fluff txPool; // empty, no transactions
+			NodeProcessor::BlockContext bc(txPool, 0, *n.m_Keys.m_pMiner, *n.m_Keys.m_pMiner);
+			verify_test(n.get_Processor().GenerateNewBlock(bc));
+
+			Block::SystemState::ID id;
+			bc.m_Hdr.get_ID(id);
+
+			for (uint32_t i = 0; i < _countof(pNodes); i++)
+			{
+				NodeProcessor& np = pNodes[i].get_Processor();
+				np.OnState(bc.m_Hdr, PeerID());
+				np.OnBlock(id, bc.m_BodyP, bc.m_BodyE, PeerID());
+				np.TryGoUp();
+			}
+		}
+
+		uint32_t pTime_ms[_countof(pNodes)];
+		uint64_t pSent[_countof(pNodes)];
+
+		const Block::SystemState::ID& idTrg = pNodes[0].get_Processor().m_Cursor.m_ID;
+
+		for (uint32_t i = 0; i < _countof(pNodes); i++)
+		{
+			DeleteFile(g_sz3);
+
+			Node node3;
+			node3.m_Cfg.m_sPathLocal = g_sz3;
+			node3.m_Cfg.m_Treasury = g_Treasury;
+			node3.m_Cfg.m_BeaconPeriod_ms = 0;
+			node3.m_Cfg.m_BandwidthCtl.m_CompressedBodies = true; // to count the served bytes
+
+			node3.m_Cfg.m_Connect.resize(1);
+			node3.m_Cfg.m_Connect[0].resolve("127.0.0.1");
+			node3.m_Cfg.m_Connect[0].port(g_Port + i);
+
+			ECC::SetRandom(node3);
+			node3.Initialize();
+
+			// measure from the moment the headers are received, the connection setup time varies
+			uint32_t t_ms = 0;
+			uint32_t nCycles = 0;
+			io::Timer::Ptr pTimer = io::Timer::create(*pReactor);
+			pTimer->start(1, true, [&]() {
+
+				if (!t_ms && node3.get_Processor().get_DB().StateFindSafe(idTrg))
+					t_ms = GetTime_ms();
+
+				if (node3.get_Processor().m_Cursor.m_ID.m_Height >= hTrg)
+					pReactor->stop();
+				else
+				{
+					if (++nCycles > 60000)
+					{
+						fail_test("Sync didn't complete");
+						pReactor->stop();
+					}
+				}
+			});
+
+			pReactor->run();
+
+			pTime_ms[i] = GetTime_ms() - t_ms;
+			pSent[i] = pNodes[i].m_BodyCompressionStats.m_Sent.m_BytesRaw;
+
+			verify_test(node3.get_Processor().m_Cursor.m_ID.m_Height == hTrg);
+			verify_test(pSent[i]);
+		}
+
+		printf("Sync from a peer, %u blocks, %u KB: from DB: %u ms, from store: %u ms\n",
+			static_cast<uint32_t>(hTrg),
+			static_cast<uint32_t>(pSent[0] >> 10),
+			pTime_ms[0],
+			pTime_ms[1]);
+	}
+
+	void MakeFloodTx(Transaction::Ptr& pTx, Key::IKdf& kdf, uint64_t nIdx)
+	{
+		// context-free valid tx. The input is fictive, so that it'd fail on the context-dependent validation
+		pTx = std::make_shared<Transaction>();
+		Transaction& tx = *pTx;
+
+		const Amount fee = 1000000;
+		ECC::Scalar::Native k, kOffset;
+
+		CoinID cid(Rules::Coin, nIdx, Key::Type::Regular);
+
+		tx.m_vInputs.emplace_back(new Input);
+		CoinID::Worker(cid).Create(k, tx.m_vInputs.back()->m_Commitment, kdf);
+		kOffset = k;
+
+		cid.m_Value -= fee;
+		cid.set_Subkey(1);
+
+		tx.m_vOutputs.emplace_back(new Output);
+		tx.m_vOutputs.back()->Create(Rules::HeightGenesis, k, kdf, cid, kdf);
+		kOffset += -k;
 
-	const uint16_t g_Port = 25003; // don't use the default port to prevent collisions with running nodes, beacons and etc.
+		TxKernelStd::Ptr pKrn(new TxKernelStd);
+		pKrn->m_Fee = fee;
+		kdf.DeriveKey(k, Key::ID(nIdx, Key::Type::Kernel));
+		pKrn->Sign(k);
+		kOffset += -k;
 
-	void TestNodeConversation()
+		tx.m_vKernels.push_back(std::move(pKrn));
+		tx.m_Offset = kOffset;
+		tx.Normalize();
+	}
+
+	void TestTxFlood(const std::vector<Transaction::Ptr>& vTxs, uint32_t nThreads, uint32_t nBatchMax, uint32_t nInvalid)
 	{
-		// Testing configuration: Node0 <-> Node1 <-> Client.
+		// Benchmark: node thread latency while it's flooded by txs from another node
 
 		io::Reactor::Ptr pReactor(io::Reactor::create());
 		io::Reactor::Scope scope(*pReactor);
 
-		Node node, node2;
+		Node node;
 		node.m_Cfg.m_sPathLocal = g_sz;
 		node.m_Cfg.m_Listen.port(g_Port);
 		node.m_Cfg.m_Listen.ip(INADDR_ANY);
+		node.m_Cfg.m_BeaconPeriod_ms = 0;
 		node.m_Cfg.m_Treasury = g_Treasury;
-
-		node.m_Cfg.m_Timeout.m_GetBlock_ms = 1000 * 60;
-		node.m_Cfg.m_Timeout.m_GetState_ms = 1000 * 60;
-
-		node2.m_Cfg.m_sPathLocal = g_sz2;
-		node2.m_Cfg.m_Listen.port(g_Port + 1);
-		node2.m_Cfg.m_Listen.ip(INADDR_ANY);
-		node2.m_Cfg.m_Timeout = node.m_Cfg.m_Timeout;
-		node2.m_Cfg.m_Treasury = g_Treasury;
-
-		node2.m_Cfg.m_BeaconPort = g_Port;
+		node.m_Cfg.m_TxValidation.m_Threads = nThreads;
+		node.m_Cfg.m_TxValidation.m_MaxPending = static_cast<uint32_t>(vTxs.size());
+		node.m_Cfg.m_TxValidation.m_MaxPendingPerPeer = static_cast<uint32_t>(vTxs.size());
+		node.m_Cfg.m_TxValidation.m_BatchMax = nBatchMax;
 
 		ECC::SetRandom(node);
-		ECC::SetRandom(node2);
-
 		node.Initialize();
-		node2.Initialize();
 
 		struct MyClient
 			:public proto::NodeConnection
 		{
-			Node* m_ppNode[2];
-			unsigned int m_iNode;
-			unsigned int m_WaitingCycles;
-
-			Height m_HeightMax;
-			const Height m_HeightTrg = 70;
-
-			MyClient()
-			{
-				m_pTimer = io::Timer::create(io::Reactor::get_Current());
-			}
-
-			virtual void OnConnectedSecure() override {
-				OnTimer();
-			}
-
-			virtual void OnDisconnect(const DisconnectReason&) override {
-				fail_test("OnDisconnect");
-			}
+			const std::vector<Transaction::Ptr>* m_pTxs;
+			Node* m_pNode;
 
 			io::Timer::Ptr m_pTimer;
+			uint32_t m_Start_ms = 0;
+			uint32_t m_Last_ms = 0;
+			uint32_t m_StallMax_ms = 0;
 
-			void OnTimer() {
+			virtual void OnConnectedSecure() override
+			{
+				// identify as a node, txs are validated without replying
+				ECC::Scalar::Native sk;
+				sk.GenRandomNnz();
+				ProveID(sk, proto::IDType::Node);
 
+				proto::NewTransaction msg;
+				msg.m_Fluff = true;
 
-				if (m_HeightMax < m_HeightTrg)
+				for (size_t i = 0; i < m_pTxs->size(); i++)
 				{
-					Node& n = *m_ppNode[m_iNode];
-
-					TxPool::Fluff txPool; // empty, no transactions
-					NodeProcessor::BlockContext bc(txPool, 0, *n.m_Keys.m_pMiner, *n.m_Keys.m_pMiner);
-
-					verify_test(n.get_Processor().GenerateNewBlock(bc));
-
-					n.get_Processor().OnState(bc.m_Hdr, PeerID());
-
-					Block::SystemState::ID id;
-					bc.m_Hdr.get_ID(id);
-
-					n.get_Processor().OnBlock(id, bc.m_BodyP, bc.m_BodyE, PeerID());
-					n.get_Processor().TryGoUp();
-
-					std::setmax(m_HeightMax, bc.m_Hdr.m_Height);
-
-					printf("Mined block Height = %u, node = %u \n", (unsigned int) bc.m_Hdr.m_Height, (unsigned int)m_iNode);
-
-					++m_iNode %= _countof(m_ppNode);
+					msg.m_Transaction = (*m_pTxs)[i];
+					Send(msg);
 				}
-				else
-					if (m_WaitingCycles++ > 60)
-					{
-						fail_test("Blockchain height didn't reach target");
-						io::Reactor::get_Current().stop();
-					}
 
-				SetTimer(100);
+				m_Start_ms = m_Last_ms = GetTime_ms();
+
+				m_pTimer = io::Timer::create(io::Reactor::get_Current());
+				m_pTimer->start(1, true, [this]() { OnTimer(); });
 			}
 
-			virtual void OnMsg(proto::NewTip&& msg) override
+			void OnTimer()
 			{
-				printf("Tip Height=%u\n", (unsigned int) msg.m_Description.m_Height);
-				verify_test(msg.m_Description.m_Height <= m_HeightMax);
-				if (msg.m_Description.m_Height == m_HeightTrg)
+				uint32_t t_ms = GetTime_ms();
+				std::setmax(m_StallMax_ms, t_ms - m_Last_ms);
+				m_Last_ms = t_ms;
+
+				if (m_pNode->m_TxValidationStats.m_Done >= m_pTxs->size())
 					io::Reactor::get_Current().stop();
 			}
 
-			void SetTimer(uint32_t timeout_ms) {
-				m_pTimer->start(timeout_ms, false, [this]() { return (this->OnTimer)(); });
+			virtual void OnDisconnect(const DisconnectReason&) override {
+				fail_test("OnDisconnect");
+				io::Reactor::get_Current().stop();
 			}
 		};
 
 		MyClient cl;
-		cl.m_iNode = 0;
-		cl.m_HeightMax = 0;
-		cl.m_WaitingCycles = 0;
-		cl.m_ppNode[0] = &node;
-		cl.m_ppNode[1] = &node2;
+		cl.m_pTxs = &vTxs;
+		cl.m_pNode = &node;
 
 		io::Address addr;
 		addr.resolve("127.0.0.1");
-		addr.port(g_Port + 1);
+		addr.port(g_Port);
 
 		cl.Connect(addr);
 
-
 		pReactor->run();
 
-		node.GenerateRecoveryInfo(g_sz3);
+		const Node::TxValidationStats& st = node.m_TxValidationStats;
+		verify_test(st.m_Done == vTxs.size());
+		verify_test(!st.m_Dropped);
+		if (nThreads)
+		{
+			verify_test(st.m_Invalid == nInvalid);
+			verify_test(!st.m_ValidatedSync); // the async results must be used, no re-validation on the node thread
+		}
+		else
+			verify_test(st.m_ValidatedSync == vTxs.size());
 
-		struct MyParser :public RecoveryInfo::IParser
+		// with the validator threads the sender of invalid txs is penalized
+		verify_test(st.m_Penalized == (nThreads ? nInvalid : 0));
+
+		uint32_t dt_ms = GetTime_ms() - cl.m_Start_ms;
+
+		printf("Tx flood, threads=%u, batch=%u, Txs=%u, Total=%u ms, Txs/sec=%u, Max node thread stall=%u ms, Max latency=%u ms\n",
+			nThreads,
+			nBatchMax,
+			static_cast<uint32_t>(vTxs.size()),
+			dt_ms,
+			static_cast<uint32_t>(vTxs.size() * 1000ULL / std::max(dt_ms, 1U)),
+			cl.m_StallMax_ms,
+			st.m_LatencyMax_ms);
+	}
+
+	void TestTxFlood()
+	{
+		Key::IKdf::Ptr pKdf;
+		ECC::SetRandom(pKdf);
+
+		std::vector<Transaction::Ptr> vTxs;
+		vTxs.resize(200);
+		for (size_t i = 0; i < vTxs.size(); i++)
+			MakeFloodTx(vTxs[i], *pKdf, i + 1);
+
+		// spoil several rangeproofs. They pass the individual checks, and fail only in the batch, so that bisection is needed to find them
+		const uint32_t nInvalid = 3;
+		for (uint32_t i = 0; i < nInvalid; i++)
 		{
-			Key::IPKdf::Ptr m_pOwner1;
-			Key::IPKdf::Ptr m_pOwner2;
-			uint32_t m_nUnrecognized = 0;
+			ECC::RangeProof::Confidential& bp = *vTxs[i * 67 + 5]->m_vOutputs.front()->m_pConfidential;
+			ECC::Scalar::Native x = bp.m_tDot;
+			x += 1U;
+			bp.m_tDot = x;
+		}
 
-			virtual bool OnUtxo(Height h, const Output& outp) override
-			{
-				CoinID cid;
-				bool b1 = outp.Recover(h, *m_pOwner1, cid);
-				bool b2 = outp.Recover(h, *m_pOwner2, cid);
-				if (!(b1 || b2))
-				{
-					verify_test(!h); // treasury
-					m_nUnrecognized++;
-					verify_test(m_nUnrecognized <= 1);
-				}
-
-				return true;
-			}
-		} parser;
-		parser.m_pOwner1 = node.m_Keys.m_pOwner;
-		parser.m_pOwner2 = node2.m_Keys.m_pOwner;
+		TestTxFlood(vTxs, 0, 1, nInvalid);
+		DeleteFile(g_sz);
 
-		verify_test(parser.Proceed(g_sz3));
+		TestTxFlood(vTxs, 2, 1, nInvalid);
+		DeleteFile(g_sz);
 
-		DeleteFile(g_sz3);
+		TestTxFlood(vTxs, 2, 32, nInvalid);
+		DeleteFile(g_sz);
 	}
 
 	namespace bvm2
@@ -1713,6 +3302,27 @@ namespace beam
 
 
 
+	void CollectEvents(NodeDB& db, std::vector<ByteBuffer>& v)
+	{
+		NodeDB::WalkerEvent wlk;
+		for (db.EnumEvents(wlk, Rules::HeightGenesis - 1); wlk.MoveNext(); )
+		{
+			Serializer ser;
+			ser
+				& wlk.m_Height
+				& wlk.m_Index;
+
+			ByteBuffer& buf = v.emplace_back();
+			ser.swap_buf(buf);
+
+			const uint8_t* p = reinterpret_cast<const uint8_t*>(wlk.m_Body.p);
+			buf.insert(buf.end(), p, p + wlk.m_Body.n);
+
+			p = reinterpret_cast<const uint8_t*>(wlk.m_Key.p);
+			buf.insert(buf.end(), p, p + wlk.m_Key.n);
+		}
+	}
+
 	void TestNodeClientProto()
 	{
 		// Testing configuration: Node <-> Client. Node is a miner
@@ -1747,6 +3357,7 @@ namespace beam
 
 			MiniWallet m_Wallet;
 			NodeProcessor* m_pProc = nullptr;
+			Node* m_pNode = nullptr;
 
 			std::vector<Block::SystemState::Full> m_vStates;
 
@@ -1785,6 +3396,24 @@ namespace beam
 			Height m_hEvts = 0;
 			bool m_bEvtsPending = false;
 
+			// recovery: the full one, and the deltas over it
+			std::vector<std::string> m_vRecovery;
+			Block::SystemState::ID m_idRecovery;
+
+			void OnRecoveryCheckpoint()
+			{
+				std::string sPath = std::string(g_sz3) + "_" + std::to_string(m_vRecovery.size());
+				Block::SystemState::ID id = m_pProc->m_Cursor.m_ID;
+
+				if (m_vRecovery.empty())
+					verify_test(m_pNode->GenerateRecoveryInfo(sPath.c_str()));
+				else
+					verify_test(m_pNode->GenerateRecoveryDelta(sPath.c_str(), m_idRecovery));
+
+				m_vRecovery.push_back(std::move(sPath));
+				m_idRecovery = id;
+			}
+
 			MyClient(const Key::IKdf::Ptr& pKdf)
 			{
 				m_Wallet.m_pKdf = pKdf;
@@ -2160,6 +3789,9 @@ namespace beam
 
 				m_vStates.push_back(msg.m_Description);
 
+				if (!(msg.m_Description.m_Height % 25))
+					OnRecoveryCheckpoint();
+
 				if (IsHeightReached())
 				{
 					if (TestAllDone(false))
@@ -2980,6 +4612,7 @@ namespace beam
 
 		MyClient cl(node.m_Keys.m_pMiner);
 		cl.m_pProc = &node.get_Processor();
+		cl.m_pNode = &node;
 
 		io::Address addr;
 		addr.resolve("127.0.0.1");
@@ -3065,6 +4698,7 @@ namespace beam
 
 		node2.m_Cfg.m_Horizon = node.m_Cfg.m_Horizon;
 		node2.m_Cfg.m_Horizon.m_Local = node2.m_Cfg.m_Horizon.m_Sync;
+		node2.m_Cfg.m_BandwidthCtl.m_CompressedBodies = true;
 
 		ECC::SetRandom(node2);
 		node2.Initialize();
@@ -3074,6 +4708,27 @@ namespace beam
 
 		cl.TestAllDone(true);
 
+		// node2 should have synced via compressed block packs
+		const Node::BodyCompressionStats::Direction& bcs = node.m_BodyCompressionStats.m_Sent;
+		verify_test(bcs.m_Packs && (bcs.m_BytesCompressed < bcs.m_BytesRaw));
+		verify_test(!memcmp(&bcs, &node2.m_BodyCompressionStats.m_Received, sizeof(bcs)));
+		printf("Compressed body packs: %u, %u -> %u bytes\n", (uint32_t) bcs.m_Packs, (uint32_t) bcs.m_BytesRaw, (uint32_t) bcs.m_BytesCompressed);
+
+		const NodeProcessor::ProofKernelStats& pks = node.get_Processor().m_ProofKernelStats;
+		verify_test(pks.m_Requests && pks.m_CacheHits && (pks.m_CacheHits < pks.m_Requests));
+		verify_test(pks.get_Percentile_us(50) <= pks.get_Percentile_us(99));
+		printf("Kernel proofs: %u requests, %u cached, latency p50 < %u us, p99 < %u us\n", (uint32_t) pks.m_Requests, (uint32_t) pks.m_CacheHits, (uint32_t) pks.get_Percentile_us(50), (uint32_t) pks.get_Percentile_us(99));
+
+		{
+			// bucket 0 also takes the sub-microsecond requests
+			NodeProcessor::ProofKernelStats pks2;
+			pks2.AddLatency(0);
+			pks2.AddLatency(1);
+			pks2.AddLatency(3);
+			verify_test((pks2.m_pLatency[0] == 2) && (pks2.m_pLatency[1] == 1));
+			verify_test((pks2.get_Percentile_us(50) == 2) && (pks2.get_Percentile_us(99) == 4));
+		}
+
 		struct TxoRecover
 			:public NodeProcessor::ITxoRecover
 		{
@@ -3091,7 +4746,25 @@ namespace beam
 		TxoRecover wlk(*node.m_Keys.m_pOwner);
 		node2.get_Processor().EnumTxos(wlk);
 
-		node.get_Processor().RescanOwnedTxos();
+		// the parallel rescan must produce the same events as the sequential (single-thread) one
+		{
+			std::vector<ByteBuffer> vEventsSeq, vEventsMT;
+
+			ExecutorMT& ex = static_cast<ExecutorMT&>(node.get_Processor().get_Executor());
+			uint32_t nThreads = ex.get_Threads();
+
+			ex.set_Threads(1);
+			node.get_Processor().RescanOwnedTxos();
+			CollectEvents(node.get_Processor().get_DB(), vEventsSeq);
+
+			ex.set_Threads(4);
+			node.get_Processor().RescanOwnedTxos();
+			CollectEvents(node.get_Processor().get_DB(), vEventsMT);
+
+			ex.set_Threads(nThreads);
+
+			verify_test(!vEventsSeq.empty() && (vEventsSeq == vEventsMT));
+		}
 
 		verify_test(wlk.m_Recovered);
 
@@ -3126,10 +4799,10 @@ namespace beam
 				return true;
 			}
 
-			virtual bool OnShieldedIn(const ShieldedTxo::DescriptionInp& din) override
+			virtual bool OnShieldedInRecognized(const ShieldedTxo::DescriptionInp& din, const ShieldedTxo::BaseKey&) override
 			{
-				if (m_SpendKeys.end() != m_SpendKeys.find(din.m_SpendPk))
-					m_ShieldedIns++;
+				verify_test(m_SpendKeys.end() != m_SpendKeys.find(din.m_SpendPk));
+				m_ShieldedIns++;
 				return true;
 			}
 
@@ -3147,6 +4820,38 @@ namespace beam
 
 		verify_test((p.m_SpendKeys.size() == 1) && p.m_Utxos && p.m_UtxosCA && p.m_Assets && p.m_ShieldedOuts && p.m_ShieldedIns);
 
+		// the full recovery from the earlier one and the deltas must be recognized the same way
+		verify_test(!cl.m_vRecovery.empty());
+		if (cl.m_idRecovery.m_Height < node.get_Processor().m_Cursor.m_ID.m_Height)
+			cl.OnRecoveryCheckpoint();
+
+		{
+			std::vector<std::string> vDeltas(cl.m_vRecovery.begin() + 1, cl.m_vRecovery.end());
+
+			ExecutorMT_R ex;
+			ex.set_Threads(2);
+
+			MyParser p2;
+			p2.Init(cl.m_Wallet.m_pKdf);
+			p2.m_pExecutor = &ex; // parallel recognition
+			verify_test(p2.Proceed(cl.m_vRecovery.front().c_str(), vDeltas));
+
+			verify_test((p2.m_Utxos == p.m_Utxos) && (p2.m_UtxosCA == p.m_UtxosCA) && (p2.m_Assets == p.m_Assets));
+			verify_test((p2.m_ShieldedOuts == p.m_ShieldedOuts) && (p2.m_ShieldedIns == p.m_ShieldedIns) && (p2.m_SpendKeys == p.m_SpendKeys));
+
+			std::string sMerged = std::string(beam::g_sz3) + "_merged";
+			RecoveryInfo::Merge(sMerged.c_str(), cl.m_vRecovery.front().c_str(), vDeltas);
+
+			MyParser p3;
+			p3.Init(cl.m_Wallet.m_pKdf);
+			verify_test(p3.Proceed(sMerged.c_str()));
+			verify_test((p3.m_Utxos == p.m_Utxos) && (p3.m_Assets == p.m_Assets) && (p3.m_ShieldedOuts == p.m_ShieldedOuts) && (p3.m_SpendKeys == p.m_SpendKeys));
+
+			DeleteFile(sMerged.c_str());
+			for (const auto& sPath : cl.m_vRecovery)
+				DeleteFile(sPath.c_str());
+		}
+
 		auto logger = beam::Logger::create(LOG_LEVEL_DEBUG, LOG_LEVEL_DEBUG);
 		node.PrintTxos();
 
@@ -3205,6 +4910,124 @@ namespace beam
 		}
 	}
 
+	void TestRecoveryParallel()
+	{
+		// Recovery with many UTXOs, part of them is ours. The parallel recognition must give the same results, in the same order
+		Key::IKdf::Ptr pKdf, pKdfOther;
+		ECC::SetRandom(pKdf);
+		ECC::SetRandom(pKdfOther);
+
+		const uint32_t nOutputs = 200; // distinct outputs, each is placed at all the heights
+		const Height hMax = 15; // below Fork1, all use the same scheme
+		verify_test(hMax < Rules::get().pForks[1].m_Height);
+
+		printf("Preparing recovery ...\n");
+
+		std::vector<Output> vOutputs(nOutputs);
+		for (uint32_t i = 0; i < nOutputs; i++)
+		{
+			CoinID cid(Rules::Coin * (i + 1), i, Key::Type::Regular);
+			Key::IKdf& kdf = (i % 4) ? *pKdfOther : *pKdf;
+
+			ECC::Scalar::Native sk;
+			vOutputs[i].Create(Rules::HeightGenesis, sk, kdf, cid, kdf);
+		}
+
+		struct Utxo
+		{
+			UtxoTree::Key m_Key;
+			Height m_Height;
+			uint32_t m_iOutput;
+		};
+
+		std::vector<Utxo> vUtxos;
+		for (Height h = Rules::HeightGenesis; h <= hMax; h++)
+		{
+			for (uint32_t i = 0; i < nOutputs; i++)
+			{
+				UtxoTree::Key::Data d;
+				d.m_Commitment = vOutputs[i].m_Commitment;
+				d.m_Maturity = vOutputs[i].get_MinMaturity(h);
+
+				Utxo& u = vUtxos.emplace_back();
+				u.m_Key = d;
+				u.m_Height = h;
+				u.m_iOutput = i;
+			}
+		}
+
+		std::sort(vUtxos.begin(), vUtxos.end(), [](const Utxo& a, const Utxo& b) { return a.m_Key.V.cmp(b.m_Key.V) < 0; });
+
+		UtxoTree::Compact t;
+		for (const auto& u : vUtxos)
+			verify_test(t.Add(u.m_Key));
+
+		MiniBlockChain cc;
+		t.Flush(cc.m_hvLive);
+		cc.Generate(hMax + 5); // below Fork2, no shielded and assets
+
+		{
+			Block::ChainWorkProof cwp;
+			cwp.m_hvRootLive = cc.m_hvLive;
+			cwp.Create(cc.m_Source, cc.m_vStates.back().m_Hdr);
+
+			RecoveryInfo::Writer w;
+			w.Open(g_sz3, cwp);
+
+			yas::binary_oarchive<std::FStream, SERIALIZE_OPTIONS> ser(w.m_Stream);
+			for (const auto& u : vUtxos)
+			{
+				ser & u.m_Height;
+				yas::detail::saveRecovery(ser, vOutputs[u.m_iOutput], u.m_Height);
+			}
+		}
+
+		struct MyParser
+			:public RecoveryInfo::IRecognizer
+		{
+			uint32_t m_Recognized = 0;
+			ECC::Hash::Processor m_hp; // the sequence of the recognized UTXOs
+
+			virtual bool OnUtxoRecognized(Height h, const Output& outp, CoinID& cid, const Output::User&) override
+			{
+				m_Recognized++;
+				m_hp << h << outp.m_Commitment << cid.m_Idx;
+				return true;
+			}
+		};
+
+		ECC::Hash::Value hv0;
+
+		for (uint32_t nThreads = 0; nThreads <= 4; nThreads = nThreads ? (nThreads << 1) : 1)
+		{
+			ExecutorMT_R ex;
+			ex.set_Threads(nThreads);
+
+			MyParser p;
+			p.Init(pKdf);
+			if (nThreads)
+				p.m_pExecutor = &ex;
+
+			uint32_t t_ms = GetTime_ms();
+			verify_test(p.Proceed(g_sz3));
+			t_ms = GetTime_ms() - t_ms;
+
+			verify_test(p.m_Recognized == (nOutputs / 4) * hMax);
+
+			ECC::Hash::Value hv;
+			p.m_hp >> hv;
+
+			if (nThreads)
+				verify_test(hv == hv0);
+			else
+				hv0 = hv;
+
+			printf("Recovery: UTXOs = %u, Threads = %u, Time = %u ms\n", (uint32_t) vUtxos.size(), nThreads, t_ms);
+		}
+
+		DeleteFile(g_sz3);
+	}
+
 	void RaiseHeightTo(Node& node, Height h)
 	{
 		while (node.get_Processor().m_Cursor.m_ID.m_Height < h)
@@ -3823,6 +5646,7 @@ void TestAll()
 	{
 		beam::TestHalving();
 		beam::TestChainworkProof();
+		beam::TestRecoveryParallel();
 	}
 
 	// Make sure this test doesn't run in parallel. We have the following potential collisions for Nodes:
@@ -3841,6 +5665,20 @@ void TestAll()
 		beam::TestNodeDB();
 		beam::DeleteFile(beam::g_sz);
 
+		beam::TestNodeDBSnapshots();
+		beam::DeleteFile(beam::g_sz);
+
+		beam::TestBbsStore();
+		beam::TestBbsMigrate();
+		beam::DeleteFile(beam::g_sz);
+
+		beam::TestBlockStore();
+		beam::TestBlockStoreServing();
+		beam::DeleteFile(beam::g_sz);
+
+		beam::TestStatesMmrCache();
+		beam::DeleteFile(beam::g_sz);
+
 		{
 			printf("NodeProcessor test1...\n");
 			fflush(stdout);
@@ -3865,12 +5703,51 @@ void TestAll()
 			beam::DeleteFile(beam::g_sz2);
 		}
 
+		printf("Block template test...\n");
+		fflush(stdout);
+
+		beam::TestBlockTemplate();
+		beam::DeleteFile(beam::g_sz);
+
 		printf("NodeX2 concurrent test...\n");
 		fflush(stdout);
 
 		beam::TestNodeConversation();
 		beam::DeleteFile(beam::g_sz);
 		beam::DeleteFile(beam::g_sz2);
+
+		printf("Pipelined sync test...\n");
+		fflush(stdout);
+
+		beam::TestNodeSyncPipelined();
+		beam::DeleteFile(beam::g_sz);
+		beam::DeleteFile(beam::g_sz2);
+		beam::DeleteFile(beam::g_sz3);
+
+		{
+			std::string sDir;
+			beam::NodeProcessor::get_MappingPath(sDir, beam::g_sz2, "-blocks");
+			beam::fsutils::remove_all(sDir);
+		}
+
+		printf("Sync serving test...\n");
+		fflush(stdout);
+
+		beam::TestNodeSyncServing();
+		beam::DeleteFile(beam::g_sz);
+		beam::DeleteFile(beam::g_sz2);
+		beam::DeleteFile(beam::g_sz3);
+
+		{
+			std::string sDir;
+			beam::NodeProcessor::get_MappingPath(sDir, beam::g_sz2, "-blocks");
+			beam::fsutils::remove_all(sDir);
+		}
+
+		printf("Tx flood test...\n");
+		fflush(stdout);
+
+		beam::TestTxFlood();
 	}
 
 	beam::Rules::get().MaxRollback = 100;
@@ -3883,6 +5760,12 @@ void TestAll()
 	beam::Rules::get().Shielded.m_ProofMin = { 4, 5 }; // 1K
 	beam::Rules::get().UpdateChecksum();
 
+	printf("Shielded pool test...\n");
+	fflush(stdout);
+
+	beam::TestShieldedPool();
+	beam::DeleteFile(beam::g_sz);
+
 	printf("Node <---> Client test (with proofs)...\n");
 	fflush(stdout);
 
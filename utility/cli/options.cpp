@@ -144,6 +144,11 @@ namespace beam
         const char* MINING_THREADS = "mining_threads";
         const char* POW_SOLVE_TIME = "pow_solve_time";
         const char* VERIFICATION_THREADS = "verification_threads";
+        const char* VERIFICATION_WORK_STEALING = "verification_work_stealing";
+        const char* TX_VALIDATION_THREADS = "tx_validation_threads";
+        const char* TX_VALIDATION_BATCH = "tx_validation_batch";
+        const char* COMPRESSED_BODIES = "compressed_bodies";
+        const char* SYNC_WINDOW = "sync_window";
         const char* NONCEPREFIX_DIGITS = "nonceprefix_digits";
         const char* NODE_PEER = "peer";
         const char* NODE_PEERS_PERSISTENT = "peers_persistent";
@@ -181,6 +186,9 @@ namespace beam
         const char* CONTRACT_RICH_PARSER = "contract_rich_parser";
         const char* CHECKDB = "check_db";
         const char* VACUUM = "vacuum";
+        const char* DB_WAL = "db_wal";
+        const char* STATES_HASHES = "states_hashes";
+        const char* BLOCK_STORE = "block_store";
         const char* CRASH = "crash";
         const char* INIT = "init";
         const char* RESTORE = "restore";
@@ -192,6 +200,7 @@ namespace beam
         const char* KEY_MINE = "key_mine"; // deprecated
         const char* MINER_KEY = "miner_key";
         const char* BBS_ENABLE = "bbs_enable";
+        const char* BBS_MAX_INDEX = "bbs_max_index";
         const char* NEW_ADDRESS = "new_addr";
         const char* GET_ADDRESS = "get_address";
         const char* SET_CONFIRMATIONS_COUNT = "set_confirmations_count";
@@ -223,6 +232,7 @@ namespace beam
         const char* LOG_DEBUG = "debug";
         const char* LOG_VERBOSE = "verbose";
         const char* LOG_CLEANUP_DAYS = "log_cleanup_days";
+        const char* LOG_ASYNC = "log_async";
         const char* LOG_UTXOS = "log_utxos";
         const char* VERSION = "version";
         const char* VERSION_FULL = "version,v";
@@ -240,6 +250,7 @@ namespace beam
         const char* GENERATE_RECOVERY_PATH = "generate_recovery";
         const char* RECOVERY_AUTO_PATH = "recovery_auto_path";
         const char* RECOVERY_AUTO_PERIOD = "recovery_auto_period";
+        const char* RECOVERY_AUTO_DELTAS = "recovery_auto_deltas";
         const char* SWAP_INIT = "swap_init";
         const char* SWAP_ACCEPT = "swap_accept";
         const char* SWAP_TOKEN = "swap_token";
@@ -399,6 +410,12 @@ namespace beam
             (cli::POW_SOLVE_TIME, po::value<uint32_t>()->default_value(15 * 1000), "pow solve time. It works if FakePoW is enabled")
 
             (cli::VERIFICATION_THREADS, po::value<int>()->default_value(-1), "number of threads for cryptographic verifications (0 = single thread, -1 = auto)")
+            (cli::VERIFICATION_WORK_STEALING, po::value<bool>()->default_value(false), "use work-stealing scheduler for verification threads")
+            (cli::TX_VALIDATION_THREADS, po::value<uint32_t>()->default_value(0), "number of threads for asynchronous validation of relayed transactions (0 = on the node thread)")
+            (cli::TX_VALIDATION_BATCH, po::value<uint32_t>()->default_value(32), "max number of relayed transactions verified in a single batch (1 = no batching)")
+            (cli::COMPRESSED_BODIES, po::value<bool>()->default_value(false), "ask peers to send block bodies compressed during the sync (saves bandwidth)")
+            (cli::SYNC_WINDOW, po::value<uint32_t>()->default_value(0), "max number of blocks downloaded in parallel ahead of the validation during the sync, e.g. 20000 (0 = off, one block pack at a time)")
+            (cli::LOG_ASYNC, po::value<uint32_t>()->default_value(0), "write the log from a dedicated thread (0 = off, 1 = drop messages if a thread's queue is full, 2 = wait if full)")
             (cli::NONCEPREFIX_DIGITS, po::value<unsigned>()->default_value(0), "number of hex digits for nonce prefix for stratum client (0..6)")
             (cli::NODE_PEER, po::value<vector<string>>()->multitoken(), "nodes to connect to")
             (cli::NODE_PEERS_PERSISTENT, po::value<bool>()->default_value(false), "Keep persistent connection to the specified peers, regardless to ratings")
@@ -419,7 +436,11 @@ namespace beam
             (cli::MANUAL_SELECT, po::value<std::string>(), "Explicit correct block selection at the specified height. Auto-rollback below this height if current branch is different")
             (cli::CHECKDB, po::value<bool>()->default_value(false), "DB integrity check")
             (cli::VACUUM, po::value<bool>()->default_value(false), "DB vacuum (compact)")
+            (cli::DB_WAL, po::value<bool>()->default_value(false), "Open DB in WAL mode, allows concurrent read-only access")
+            (cli::STATES_HASHES, po::value<bool>()->default_value(false), "Keep the block header hashes in a separate stream, speeds-up header proofs")
+            (cli::BLOCK_STORE, po::value<bool>()->default_value(false), "Keep new block bodies in append-only segment files next to the DB, served to the peers directly from the mapping")
             (cli::BBS_ENABLE, po::value<bool>()->default_value(true), "Enable SBBS messaging")
+            (cli::BBS_MAX_INDEX, po::value<uint32_t>()->default_value(0), "max RAM taken by the SBBS messages index, in MB. Limits the messages count accordingly, ~5K msgs per MB (0 = no limit)")
             (cli::CRASH, po::value<int>()->default_value(0), "Induce crash (test proper handling)")
             (cli::OWNER_KEY, po::value<string>(), "Owner viewer key")
             (cli::KEY_OWNER, po::value<string>(), "Owner viewer key (deprecated)")
@@ -431,6 +452,7 @@ namespace beam
             (cli::GENERATE_RECOVERY_PATH, po::value<string>(), "Recovery file to generate immediately after start")
             (cli::RECOVERY_AUTO_PATH, po::value<string>(), "path and file prefix for recovery auto-generation")
             (cli::RECOVERY_AUTO_PERIOD, po::value<uint32_t>()->default_value(30), "period (in blocks) for recovery auto-generation")
+            (cli::RECOVERY_AUTO_DELTAS, po::value<uint32_t>()->default_value(0), "num of recovery deltas between the full recovery files, the full ones are built in the background (0 - always full)")
             (cli::CONTRACT_RICH_INFO, po::value<bool>(), "Set to save rich contract invocation info")
             (cli::CONTRACT_RICH_PARSER, po::value<std::string>(), "Optional shader to parse contract invocation info")
             ;
@@ -43,6 +43,11 @@ namespace beam
         extern const char* MINING_THREADS;
         extern const char* POW_SOLVE_TIME;
         extern const char* VERIFICATION_THREADS;
+        extern const char* VERIFICATION_WORK_STEALING;
+        extern const char* TX_VALIDATION_THREADS;
+        extern const char* TX_VALIDATION_BATCH;
+        extern const char* COMPRESSED_BODIES;
+        extern const char* SYNC_WINDOW;
         extern const char* NONCEPREFIX_DIGITS;
         extern const char* NODE_PEER;
         extern const char* NODE_PEERS_PERSISTENT;
@@ -82,6 +87,9 @@ namespace beam
         extern const char* CONTRACT_RICH_PARSER;
         extern const char* CHECKDB;
         extern const char* VACUUM;
+        extern const char* DB_WAL;
+        extern const char* STATES_HASHES;
+        extern const char* BLOCK_STORE;
         extern const char* CRASH;
         extern const char* INIT;
         extern const char* RESTORE;
@@ -93,6 +101,7 @@ namespace beam
         extern const char* KEY_MINE;  // deprecated
         extern const char* MINER_KEY;
         extern const char* BBS_ENABLE;
+        extern const char* BBS_MAX_INDEX;
         extern const char* NEW_ADDRESS;
         extern const char* GET_ADDRESS;
         extern const char* SET_CONFIRMATIONS_COUNT;
@@ -124,6 +133,7 @@ namespace beam
         extern const char* LOG_DEBUG;
         extern const char* LOG_VERBOSE;
         extern const char* LOG_CLEANUP_DAYS;
+        extern const char* LOG_ASYNC;
         extern const char* LOG_UTXOS;
         extern const char* VERSION;
         extern const char* VERSION_FULL;
@@ -143,6 +153,7 @@ namespace beam
         extern const char* GENERATE_RECOVERY_PATH;
         extern const char* RECOVERY_AUTO_PATH;
         extern const char* RECOVERY_AUTO_PERIOD;
+        extern const char* RECOVERY_AUTO_DELTAS;
         extern const char* SWAP_INIT;
         extern const char* SWAP_ACCEPT;
         extern const char* SWAP_TOKEN;
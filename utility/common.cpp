@@ -159,6 +159,12 @@ namespace beam
 		m_Threads = nThreads;
 	}
 
+	void ExecutorMT::set_WorkStealing(bool b)
+	{
+		Stop();
+		m_bWorkStealing = b;
+	}
+
 	uint32_t ExecutorMT::get_Threads()
 	{
 		return m_Threads;
@@ -175,6 +181,27 @@ namespace beam
 		m_FlushTarget = static_cast<uint32_t>(-1);
 
 		uint32_t nThreads = get_Threads();
+
+		if (m_bWorkStealing)
+		{
+			if (m_WS.m_nDeques != nThreads)
+			{
+				m_WS.m_pDeques.reset(new WorkStealing::Deque[nThreads]);
+				m_WS.m_nDeques = nThreads;
+			}
+
+			for (uint32_t i = 0; i < nThreads; i++)
+				m_WS.m_pDeques[i].Reset();
+
+			m_WS.m_InProgress = 0;
+			m_WS.m_Queued = 0;
+			m_WS.m_Injected = 0;
+			m_WS.m_Sleeping = 0;
+			m_WS.m_FlushTarget = static_cast<uint32_t>(-1);
+			m_WS.m_CtlGen = 0;
+			m_WS.m_Stop = false;
+		}
+
 		m_vThreads.resize(nThreads);
 
 		for (uint32_t i = 0; i < nThreads; i++)
@@ -186,6 +213,12 @@ namespace beam
 		assert(pTask);
 		InitSafe();
 
+		if (m_bWorkStealing)
+		{
+			PushWS(*pTask.release());
+			return;
+		}
+
 		std::unique_lock<std::mutex> scope(m_Mutex);
 
 		m_queTasks.push_back(*pTask.release());
@@ -198,6 +231,9 @@ namespace beam
 	{
 		InitSafe();
 
+		if (m_bWorkStealing)
+			return FlushWS(nMaxTasks);
+
 		std::unique_lock<std::mutex> scope(m_Mutex);
 		FlushLocked(scope, nMaxTasks);
 
@@ -218,6 +254,12 @@ namespace beam
 	{
 		InitSafe();
 
+		if (m_bWorkStealing)
+		{
+			ExecAllWS(t);
+			return;
+		}
+
 		std::unique_lock<std::mutex> scope(m_Mutex);
 		FlushLocked(scope, 0);
 
@@ -239,6 +281,7 @@ namespace beam
 		{
 			std::unique_lock<std::mutex> scope(m_Mutex);
 			m_Run = false;
+			m_WS.m_Stop = true;
 			m_NewTask.notify_all();
 		}
 
@@ -253,12 +296,31 @@ namespace beam
 			TaskAsync::Ptr pGuard(&m_queTasks.front());
 			m_queTasks.pop_front();
 		}
+
+		if (m_bWorkStealing)
+		{
+			for (uint32_t i = 0; i < m_WS.m_nDeques; i++)
+			{
+				while (true)
+				{
+					TaskAsync::Ptr pGuard(m_WS.m_pDeques[i].Steal());
+					if (!pGuard)
+						break;
+				}
+			}
+		}
 	}
 
 	void ExecutorMT::RunThreadCtx(Context& ctx)
 	{
 		ctx.m_pThis = this;
 
+		if (m_bWorkStealing)
+		{
+			RunThreadWS(ctx);
+			return;
+		}
+
 		while (true)
 		{
 			TaskAsync::Ptr pGuard;
@@ -318,6 +380,245 @@ namespace beam
 		}
 	}
 
+	void ExecutorMT::WorkStealing::Deque::Reset()
+	{
+		m_Top = 0;
+		m_Bottom = 0;
+	}
+
+	bool ExecutorMT::WorkStealing::Deque::Push(TaskAsync& t)
+	{
+		uint64_t nBottom = m_Bottom.load(std::memory_order_relaxed);
+
+		// acquire: slots released by Steal() are safe to overwrite
+		if (nBottom - m_Top.load(std::memory_order_acquire) >= s_Size)
+			return false;
+
+		m_pSlot[nBottom & (s_Size - 1)].store(&t, std::memory_order_relaxed);
+		m_Bottom.store(nBottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	Executor::TaskAsync* ExecutorMT::WorkStealing::Deque::Pop()
+	{
+		uint64_t nBottom = m_Bottom.load(std::memory_order_relaxed);
+		if (m_Top.load(std::memory_order_relaxed) >= nBottom)
+			return nullptr; // top never passes the bottom, so it's empty
+
+		nBottom--;
+		m_Bottom.store(nBottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with Steal(): either we see its top, or it sees our bottom
+
+		uint64_t nTop = m_Top.load(std::memory_order_relaxed);
+		if (nTop > nBottom)
+		{
+			// the last one was stolen
+			m_Bottom.store(nBottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		TaskAsync* pRet = m_pSlot[nBottom & (s_Size - 1)].load(std::memory_order_relaxed);
+		if (nTop == nBottom)
+		{
+			// the last one, race with the thieves
+			if (!m_Top.compare_exchange_strong(nTop, nTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				pRet = nullptr;
+
+			m_Bottom.store(nBottom + 1, std::memory_order_relaxed);
+		}
+
+		return pRet;
+	}
+
+	Executor::TaskAsync* ExecutorMT::WorkStealing::Deque::Steal()
+	{
+		while (true)
+		{
+			uint64_t nTop = m_Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (nTop >= m_Bottom.load(std::memory_order_acquire))
+				return nullptr;
+
+			TaskAsync* pRet = m_pSlot[nTop & (s_Size - 1)].load(std::memory_order_relaxed);
+			if (m_Top.compare_exchange_strong(nTop, nTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return pRet;
+		}
+	}
+
+	thread_local const ExecutorMT* ExecutorMT::WorkStealing::s_pOwner = nullptr;
+	thread_local uint32_t ExecutorMT::WorkStealing::s_iOwn = 0;
+
+	void ExecutorMT::PushWS(TaskAsync& t)
+	{
+		m_WS.m_InProgress++;
+		m_WS.m_Queued++; // before the task becomes visible, so that it never underflows
+
+		// worker threads push to their own deques, no locking
+		if ((WorkStealing::s_pOwner != this) || !m_WS.m_pDeques[WorkStealing::s_iOwn].Push(t))
+		{
+			// pushed from outside, or the own deque is full
+			std::unique_lock<std::mutex> scope(m_Mutex);
+			m_queTasks.push_back(t);
+			m_WS.m_Injected++;
+		}
+
+		if (m_WS.m_Sleeping)
+		{
+			std::unique_lock<std::mutex> scope(m_Mutex);
+			m_NewTask.notify_one();
+		}
+	}
+
+	uint32_t ExecutorMT::FlushWS(uint32_t nMaxTasks)
+	{
+		if (m_WS.m_InProgress > nMaxTasks)
+		{
+			std::unique_lock<std::mutex> scope(m_Mutex);
+			m_WS.m_FlushTarget = nMaxTasks;
+
+			while (m_WS.m_InProgress > nMaxTasks)
+				m_Flushed.wait(scope);
+
+			m_WS.m_FlushTarget = static_cast<uint32_t>(-1);
+		}
+
+		return m_WS.m_InProgress;
+	}
+
+	void ExecutorMT::ExecAllWS(TaskSync& t)
+	{
+		FlushWS(0);
+
+		assert(!m_pCtl && !m_WS.m_InProgress);
+		m_pCtl = &t;
+		m_WS.m_InProgress = get_Threads();
+		m_WS.m_CtlGen++; // each thread executes the control task once per generation
+
+		{
+			std::unique_lock<std::mutex> scope(m_Mutex);
+			m_NewTask.notify_all();
+		}
+
+		FlushWS(0);
+		m_pCtl = nullptr;
+	}
+
+	Executor::TaskAsync* ExecutorMT::TakeWS(uint32_t iThread)
+	{
+		if (!m_WS.m_Queued)
+			return nullptr;
+
+		// own deque first (most recent), then the injection queue, then steal from the others (oldest)
+		TaskAsync* pTask = m_WS.m_pDeques[iThread].Pop();
+		if (!pTask && m_WS.m_Injected)
+			pTask = TakeInjectedWS(iThread);
+
+		for (uint32_t i = 1; !pTask && (i < m_WS.m_nDeques); i++)
+		{
+			uint32_t iDeque = iThread + i;
+			if (iDeque >= m_WS.m_nDeques)
+				iDeque -= m_WS.m_nDeques;
+
+			pTask = m_WS.m_pDeques[iDeque].Steal();
+		}
+
+		if (pTask)
+			m_WS.m_Queued--;
+
+		return pTask;
+	}
+
+	Executor::TaskAsync* ExecutorMT::TakeInjectedWS(uint32_t iThread)
+	{
+		std::unique_lock<std::mutex> scope(m_Mutex);
+		if (m_queTasks.empty())
+			return nullptr;
+
+		TaskAsync* pRet = &m_queTasks.front();
+		m_queTasks.pop_front();
+
+		// move a fair share of the rest to the own deque, where it's visible to the thieves. Leave the rest for the others.
+		uint32_t nMove = static_cast<uint32_t>(m_queTasks.size()) / m_WS.m_nDeques;
+		std::setmin(nMove, WorkStealing::s_Batch - 1);
+
+		uint32_t nTaken = 1;
+		for (; nTaken <= nMove; nTaken++)
+		{
+			TaskAsync& t = m_queTasks.front();
+			if (!m_WS.m_pDeques[iThread].Push(t))
+				break;
+			m_queTasks.pop_front();
+		}
+
+		m_WS.m_Injected -= nTaken;
+		return pRet;
+	}
+
+	void ExecutorMT::RunThreadWS(Context& ctx)
+	{
+		WorkStealing::s_pOwner = this;
+		WorkStealing::s_iOwn = ctx.m_iThread;
+
+		uint32_t nCtlGen = 0;
+
+		while (true)
+		{
+			TaskSync* pCtl = nullptr;
+			TaskAsync* pTask = nullptr;
+
+			for (uint32_t nSpin = 0; ; )
+			{
+				if (m_WS.m_Stop)
+					return;
+
+				if (m_WS.m_CtlGen != nCtlGen)
+				{
+					nCtlGen++;
+					pCtl = m_pCtl;
+					break;
+				}
+
+				pTask = TakeWS(ctx.m_iThread);
+				if (pTask)
+					break;
+
+				if (nSpin < WorkStealing::s_Spin)
+				{
+					nSpin++;
+					std::this_thread::yield();
+					continue;
+				}
+
+				std::unique_lock<std::mutex> scope(m_Mutex);
+				m_WS.m_Sleeping++; // must be visible before the re-check, pairs with PushWS
+
+				while (m_Run && !m_WS.m_Queued && (m_WS.m_CtlGen == nCtlGen))
+					m_NewTask.wait(scope);
+
+				m_WS.m_Sleeping--;
+				nSpin = 0;
+			}
+
+			if (pCtl)
+				pCtl->Exec(ctx);
+			else
+			{
+				TaskAsync::Ptr pGuard(pTask);
+				pTask->Exec(ctx);
+			}
+
+			uint32_t nInProgress = --m_WS.m_InProgress;
+
+			uint32_t nTarget = m_WS.m_FlushTarget;
+			if ((nTarget != static_cast<uint32_t>(-1)) && (nInProgress <= nTarget))
+			{
+				std::unique_lock<std::mutex> scope(m_Mutex);
+				m_Flushed.notify_all();
+			}
+		}
+	}
+
 	///////////////////////
 	// BlobMap
 	BlobMap::Entry* BlobMap::Set::Find(const Blob& key)
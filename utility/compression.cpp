@@ -0,0 +1,284 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "compression.h"
+
+namespace beam
+{
+	namespace
+	{
+		const uint32_t s_nMaxLenShort = 15;
+
+		void WriteLen(ByteBuffer& res, uint32_t n)
+		{
+			for (; n >= 0xff; n -= 0xff)
+				res.push_back(0xff);
+			res.push_back(static_cast<uint8_t>(n));
+		}
+
+		bool ReadLen(const uint8_t*& p, const uint8_t* pEnd, uint32_t& n, uint32_t nMax)
+		{
+			while (true)
+			{
+				if (p == pEnd)
+					return false;
+
+				uint8_t x = *p++;
+				n += x;
+				if (n > nMax)
+					return false;
+
+				if (0xff != x)
+					return true;
+			}
+		}
+
+		void WriteVarInt(ByteBuffer& res, uint32_t n)
+		{
+			for (; n >= 0x80; n >>= 7)
+				res.push_back(static_cast<uint8_t>(n | 0x80));
+			res.push_back(static_cast<uint8_t>(n));
+		}
+
+		bool ReadVarInt(const uint8_t*& p, const uint8_t* pEnd, uint32_t& n)
+		{
+			n = 0;
+			for (uint32_t nShift = 0; nShift < 32; nShift += 7)
+			{
+				if (p == pEnd)
+					return false;
+
+				uint8_t x = *p++;
+				n |= static_cast<uint32_t>(x & 0x7f) << nShift;
+
+				if (!(x & 0x80))
+					return true;
+			}
+
+			return false;
+		}
+
+		void WriteSequence(ByteBuffer& res, const uint8_t* pLit, uint32_t nLit, uint32_t nDist, uint32_t nLen)
+		{
+			// nLen is the extra match length (above the minimum), or unused if nDist is 0 (last sequence)
+			uint8_t nToken = static_cast<uint8_t>(std::min(nLit, s_nMaxLenShort) << 4);
+			if (nDist)
+				nToken |= static_cast<uint8_t>(std::min(nLen, s_nMaxLenShort));
+
+			res.push_back(nToken);
+			if (nLit >= s_nMaxLenShort)
+				WriteLen(res, nLit - s_nMaxLenShort);
+
+			res.insert(res.end(), pLit, pLit + nLit);
+
+			if (nDist)
+			{
+				WriteVarInt(res, nDist);
+				if (nLen >= s_nMaxLenShort)
+					WriteLen(res, nLen - s_nMaxLenShort);
+			}
+		}
+
+		uint32_t Read32(const uint8_t* p)
+		{
+			uint32_t x;
+			memcpy(&x, p, sizeof(x));
+			return x;
+		}
+	}
+
+	/////////////////////////////////////
+	// Encoder
+	bool LzStream::Encoder::Write(ByteBuffer& res, const void* p, uint32_t nSize)
+	{
+		uint32_t nHist = static_cast<uint32_t>(m_Buf.size());
+
+		const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(p);
+		m_Buf.insert(m_Buf.end(), pSrc, pSrc + nSize);
+
+		res.clear();
+		res.reserve(nSize);
+		Compress(res, nHist);
+
+		bool bCompressed = (res.size() < nSize);
+		if (!bCompressed)
+			res.assign(pSrc, pSrc + nSize); // store as-is. The data is still added to the history
+
+		Trim();
+		return bCompressed;
+	}
+
+	void LzStream::Encoder::Compress(ByteBuffer& res, uint32_t nHist)
+	{
+		if (m_Buf.size() == nHist)
+			return;
+
+		if (m_vHash.empty())
+			m_vHash.resize(1U << s_HashBits);
+
+		const uint8_t* pBase = &m_Buf.front();
+		uint32_t nEnd = static_cast<uint32_t>(m_Buf.size());
+
+		uint32_t nPos = nHist;
+		uint32_t nAnchor = nHist;
+		uint32_t nMisses = 0;
+
+		while (nPos + s_MinMatch <= nEnd)
+		{
+			uint32_t iHash = (Read32(pBase + nPos) * 2654435761U) >> (32 - s_HashBits);
+			uint32_t nRef = m_vHash[iHash];
+			m_vHash[iHash] = nPos + 1;
+
+			if (nRef)
+			{
+				nRef--;
+
+				if ((nPos - nRef <= s_Window) && (Read32(pBase + nRef) == Read32(pBase + nPos)))
+				{
+					uint32_t nLen = s_MinMatch;
+					while ((nPos + nLen < nEnd) && (pBase[nRef + nLen] == pBase[nPos + nLen]))
+						nLen++;
+
+					WriteSequence(res, pBase + nAnchor, nPos - nAnchor, nPos - nRef, nLen - s_MinMatch);
+
+					// index the end of the match, improves the ratio for adjacent repetitions
+					uint32_t nLast = nPos + nLen - 2;
+					if (nLast + s_MinMatch <= nEnd)
+						m_vHash[(Read32(pBase + nLast) * 2654435761U) >> (32 - s_HashBits)] = nLast + 1;
+
+					nPos += nLen;
+					nAnchor = nPos;
+					nMisses = 0;
+
+					if (res.size() >= nEnd - nHist)
+						return; // no gain anyway
+					continue;
+				}
+			}
+
+			// skip faster through the incompressible data
+			nPos += 1 + (nMisses++ >> 5);
+		}
+
+		if (nAnchor < nEnd)
+			WriteSequence(res, pBase + nAnchor, nEnd - nAnchor, 0, 0);
+	}
+
+	void LzStream::Encoder::Trim()
+	{
+		if (m_Buf.size() <= s_Window)
+			return;
+
+		uint32_t nShift = static_cast<uint32_t>(m_Buf.size()) - s_Window;
+		m_Buf.erase(m_Buf.begin(), m_Buf.begin() + nShift);
+
+		for (size_t i = 0; i < m_vHash.size(); i++)
+		{
+			uint32_t& x = m_vHash[i];
+			x = (x > nShift) ? (x - nShift) : 0;
+		}
+	}
+
+	/////////////////////////////////////
+	// Decoder
+	bool LzStream::Decoder::Read(ByteBuffer& res, const void* p, uint32_t nSize, uint32_t nSizeRaw)
+	{
+		if (nSize > nSizeRaw)
+			return false;
+
+		uint32_t nHist = static_cast<uint32_t>(m_Buf.size());
+		const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(p);
+
+		if (nSize == nSizeRaw)
+			m_Buf.insert(m_Buf.end(), pSrc, pSrc + nSize); // stored
+		else
+		{
+			m_Buf.resize(nHist + nSizeRaw);
+			if (!Decompress(pSrc, nSize, nHist))
+			{
+				m_Buf.clear();
+				return false;
+			}
+		}
+
+		res.assign(m_Buf.begin() + nHist, m_Buf.end());
+		Trim();
+		return true;
+	}
+
+	bool LzStream::Decoder::Decompress(const uint8_t* pSrc, uint32_t nSize, uint32_t nHist)
+	{
+		const uint8_t* pSrcEnd = pSrc + nSize;
+
+		uint8_t* pBase = &m_Buf.front();
+		uint32_t nEnd = static_cast<uint32_t>(m_Buf.size());
+		uint32_t nPos = nHist;
+
+		while (nPos < nEnd)
+		{
+			if (pSrc == pSrcEnd)
+				return false;
+
+			uint8_t nToken = *pSrc++;
+
+			uint32_t nLit = nToken >> 4;
+			if ((s_nMaxLenShort == nLit) && !ReadLen(pSrc, pSrcEnd, nLit, nEnd - nPos))
+				return false;
+
+			if ((nLit > nEnd - nPos) || (nLit > static_cast<uint32_t>(pSrcEnd - pSrc)))
+				return false;
+
+			memcpy(pBase + nPos, pSrc, nLit);
+			pSrc += nLit;
+			nPos += nLit;
+
+			if (nPos == nEnd)
+				break;
+
+			uint32_t nDist;
+			if (!ReadVarInt(pSrc, pSrcEnd, nDist) || !nDist || (nDist > nPos) || (nDist > s_Window))
+				return false;
+
+			uint32_t nLen = nToken & 0xf;
+			if ((s_nMaxLenShort == nLen) && !ReadLen(pSrc, pSrcEnd, nLen, nEnd - nPos))
+				return false;
+
+			nLen += s_MinMatch;
+			if (nLen > nEnd - nPos)
+				return false;
+
+			const uint8_t* pRef = pBase + nPos - nDist;
+			uint8_t* pDst = pBase + nPos;
+
+			if (nDist >= nLen)
+				memcpy(pDst, pRef, nLen);
+			else
+			{
+				// overlapping
+				for (uint32_t i = 0; i < nLen; i++)
+					pDst[i] = pRef[i];
+			}
+
+			nPos += nLen;
+		}
+
+		return (pSrc == pSrcEnd);
+	}
+
+	void LzStream::Decoder::Trim()
+	{
+		if (m_Buf.size() > s_Window)
+			m_Buf.erase(m_Buf.begin(), m_Buf.end() - s_Window);
+	}
+}
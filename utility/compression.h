@@ -0,0 +1,64 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "common.h"
+
+namespace beam
+{
+	// Fast LZ77 compression (greedy parsing, byte-aligned format), suitable for streaming.
+	// Both sides keep the recent history (the dictionary), so that each message may refer to the data of the previous ones.
+	// Hence messages must be decoded exactly in the same order they were encoded, and none may be skipped.
+	//
+	// Sequence format:
+	//	token: 4 bits literals count, 4 bits match length (minus s_MinMatch). Value of 15 means extended length follows (bytes of 255 + remainder)
+	//	literals
+	//	match distance (varint). Omitted in the last sequence (the one that reaches the message size)
+	//	extended match length
+	//
+	// Incompressible messages are stored as-is (encoded size equals to the original size).
+	struct LzStream
+	{
+		static const uint32_t s_MinMatch = 4;
+		static const uint32_t s_Window = 1U << 20; // part of the format, must be the same on both sides
+
+		struct Encoder
+		{
+			// returns true if compressed, otherwise res is just a copy of the data.
+			bool Write(ByteBuffer& res, const void* p, uint32_t nSize);
+
+		private:
+			static const uint32_t s_HashBits = 16;
+
+			ByteBuffer m_Buf; // history, followed by the current data
+			std::vector<uint32_t> m_vHash; // position + 1, 0 means none
+
+			void Compress(ByteBuffer& res, uint32_t nHist);
+			void Trim();
+		};
+
+		struct Decoder
+		{
+			// returns false if the data is malformed. In this case the stream is unusable.
+			bool Read(ByteBuffer& res, const void* p, uint32_t nSize, uint32_t nSizeRaw);
+
+		private:
+			ByteBuffer m_Buf; // history, followed by the current data
+
+			bool Decompress(const uint8_t* pSrc, uint32_t nSize, uint32_t nHist);
+			void Trim();
+		};
+	};
+}
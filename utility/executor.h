@@ -16,6 +16,7 @@
 
 #include "common.h"
 #include <condition_variable>
+#include <atomic>
 #include <thread>
 #include <boost/intrusive/list.hpp>
 #include "thread.h"
@@ -85,6 +86,12 @@ namespace beam
 
 		void set_Threads(uint32_t);
 
+		// Alternative scheduler: each thread owns a lock-free deque. Tasks pushed by a worker thread go to its own deque
+		// (and are taken LIFO by it), tasks pushed from outside go to the shared injection queue, from which workers take them in batches.
+		// Idle threads steal from the others. Stops the threads if they're already running.
+		void set_WorkStealing(bool);
+		bool get_WorkStealing() const { return m_bWorkStealing; }
+
 	protected:
 
 		uint32_t m_Threads; // set at c'tor to num of cores.
@@ -107,8 +114,54 @@ namespace beam
 
 		std::vector<MyThread> m_vThreads;
 
+		bool m_bWorkStealing = false;
+
+		struct WorkStealing
+		{
+			// Chase-Lev deque, bounded. The owner thread pushes and pops at the bottom, thieves steal from the top.
+			struct Deque
+			{
+				static const uint32_t s_Size = 1024; // must be a power of 2
+
+				alignas(64) std::atomic<uint64_t> m_Top;
+				alignas(64) std::atomic<uint64_t> m_Bottom;
+				std::atomic<TaskAsync*> m_pSlot[s_Size];
+
+				void Reset();
+				bool Push(TaskAsync&); // owner only
+				TaskAsync* Pop(); // owner only
+				TaskAsync* Steal();
+			};
+
+			std::unique_ptr<Deque[]> m_pDeques;
+			uint32_t m_nDeques = 0;
+
+			// set for the worker threads
+			static thread_local const ExecutorMT* s_pOwner;
+			static thread_local uint32_t s_iOwn;
+
+			std::atomic<uint32_t> m_InProgress;
+			std::atomic<uint32_t> m_Queued; // in deques and injection queue
+			std::atomic<uint32_t> m_Injected; // in m_queTasks: pushed from outside, or the own deque was full
+			std::atomic<uint32_t> m_Sleeping;
+			std::atomic<uint32_t> m_FlushTarget;
+			std::atomic<uint32_t> m_CtlGen;
+			std::atomic<bool> m_Stop;
+
+			static const uint32_t s_Spin = 64; // yields before going to sleep
+			static const uint32_t s_Batch = 32; // max tasks moved from the injection queue at once
+
+		} m_WS;
+
 		void InitSafe();
 		void FlushLocked(std::unique_lock<std::mutex>&, uint32_t nMaxTasks);
 		void RunThreadInternal(uint32_t);
+
+		void PushWS(TaskAsync&);
+		uint32_t FlushWS(uint32_t nMaxTasks);
+		void ExecAllWS(TaskSync&);
+		void RunThreadWS(Context&);
+		TaskAsync* TakeWS(uint32_t iThread);
+		TaskAsync* TakeInjectedWS(uint32_t iThread);
 	};
 }
@@ -53,6 +53,12 @@ struct HeapAllocatedMemory : AllocatedMemory {
     void* data;
 };
 
+struct VectorMemory : AllocatedMemory {
+    explicit VectorMemory(std::vector<uint8_t>&& v) : vec(std::move(v)) {}
+
+    std::vector<uint8_t> vec;
+};
+
 #ifdef WIN32
 
 struct ReadOnlyMappedFileWin32 : AllocatedMemory {
@@ -144,6 +150,14 @@ std::pair<uint8_t*, SharedMem> alloc_heap(size_t size) {
     return p;
 }
 
+void SharedBuffer::assign(std::vector<uint8_t>&& v) {
+    clear();
+    if (!v.empty()) {
+        VectorMemory* mem = new VectorMemory(std::move(v));
+        assign(mem->vec.data(), mem->vec.size(), SharedMem(mem));
+    }
+}
+
 SharedBuffer map_file_read_only(const char* fileName) {
 #ifdef WIN32
     ReadOnlyMappedFileWin32* mem = new ReadOnlyMappedFileWin32(fileName);
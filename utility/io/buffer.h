@@ -128,6 +128,9 @@ struct SharedBuffer : IOVec {
         guard = std::move(_guard);
     }
 
+    /// Takes over the vector contents, no copy
+    void assign(std::vector<uint8_t>&& v);
+
     void unique() {
         if (empty()) return;
         auto p = alloc_heap(size);
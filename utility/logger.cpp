@@ -40,16 +40,202 @@ namespace fs = std::filesystem;
 #include <iostream>
 #include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 #include <algorithm>
 
+#ifndef WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#endif
+
 namespace beam {
 
 using namespace std;
 
 Logger* Logger::g_logger = 0;
 
+namespace {
+
+struct LogRecord {
+    int level;
+    const char* data; // header and body
+    size_t size;
+};
+
+// Queue of formatted messages of a single thread. Single producer (the logging thread), single consumer (the writer thread), lock-free.
+// Records are 8-byte aligned: [uint32_t size][int32_t level][header][body]. A record is never split, the space left at the end is skipped.
+class LogRing {
+    static constexpr uint32_t WRAP = static_cast<uint32_t>(-1);
+    static constexpr size_t RECORD_HDR = 8;
+
+    std::unique_ptr<char[]> _buf;
+    size_t _capacity;
+    alignas(64) std::atomic<size_t> _head{0}; // written by the producer
+    alignas(64) std::atomic<size_t> _tail{0}; // written by the consumer
+
+    static size_t get_record_size(size_t size) {
+        return (RECORD_HDR + size + 7) & ~size_t(7);
+    }
+
+public:
+    explicit LogRing(size_t size) {
+        for (_capacity = 0x1000; _capacity < size; _capacity <<= 1)
+            ;
+        _buf.reset(new char[_capacity]);
+    }
+
+    bool fits(size_t size) const {
+        return get_record_size(size) <= _capacity / 2;
+    }
+
+    bool empty() const {
+        return _head.load(memory_order_acquire) == _tail.load(memory_order_acquire);
+    }
+
+    bool is_half_full() const {
+        return _head.load(memory_order_relaxed) - _tail.load(memory_order_relaxed) >= _capacity / 2;
+    }
+
+    // producer
+    bool try_push(int level, const char* header, size_t headerSize, const char* msg, size_t size) {
+        size_t nRecord = get_record_size(headerSize + size);
+        size_t head = _head.load(memory_order_relaxed);
+        size_t tail = _tail.load(memory_order_acquire);
+
+        size_t offset = head & (_capacity - 1);
+        size_t nSkip = (_capacity - offset < nRecord) ? (_capacity - offset) : 0;
+        if (head + nSkip + nRecord - tail > _capacity)
+            return false;
+
+        if (nSkip) {
+            memcpy(_buf.get() + offset, &WRAP, sizeof(WRAP));
+            head += nSkip;
+            offset = 0;
+        }
+
+        char* p = _buf.get() + offset;
+        uint32_t n = static_cast<uint32_t>(headerSize + size);
+        int32_t lvl = level;
+        memcpy(p, &n, sizeof(n));
+        memcpy(p + sizeof(n), &lvl, sizeof(lvl));
+        memcpy(p + RECORD_HDR, header, headerSize);
+        memcpy(p + RECORD_HDR + headerSize, msg, size);
+
+        _head.store(head + nRecord, memory_order_release);
+        return true;
+    }
+
+    // consumer. Appends the pending records, they remain valid until release(). Returns the position to release
+    size_t peek(vector<LogRecord>& out) const {
+        size_t pos = _tail.load(memory_order_relaxed);
+        size_t head = _head.load(memory_order_acquire);
+
+        while (pos != head) {
+            size_t offset = pos & (_capacity - 1);
+            const char* p = _buf.get() + offset;
+
+            uint32_t n;
+            memcpy(&n, p, sizeof(n));
+            if (WRAP == n) {
+                pos += _capacity - offset;
+                continue;
+            }
+
+            int32_t lvl;
+            memcpy(&lvl, p + sizeof(n), sizeof(lvl));
+            out.push_back({ lvl, p + RECORD_HDR, n });
+            pos += get_record_size(n);
+        }
+
+        return pos;
+    }
+
+    void release(size_t pos) {
+        _tail.store(pos, memory_order_release);
+    }
+};
+
+std::atomic<uint64_t> g_asyncWriterID{0};
+
+} // namespace
+
+class LoggerImpl;
+
+// Drains the per-thread queues by a dedicated thread, writes them in batches
+class AsyncLogWriter {
+    LoggerImpl& _owner;
+    const uint64_t _id;
+    const Logger::AsyncParams _params;
+    const int _flushLevel;
+
+    mutex _mutex; // protects _rings, used for wake-up
+    condition_variable _cv;
+    mutex _mutexDrained; // block mode: the producers wait for the writer to release the space
+    condition_variable _cvDrained;
+    vector<shared_ptr<LogRing>> _rings;
+    atomic<bool> _stop{false};
+    uint64_t _droppedReported = 0;
+    std::string _dropReport;
+    thread _thread;
+
+    LogRing& get_ring() {
+        struct ThreadRing {
+            uint64_t ownerID = 0;
+            shared_ptr<LogRing> ring;
+        };
+        static thread_local ThreadRing t;
+
+        if (t.ownerID != _id) {
+            // the ring is released when the thread exits, the writer drops it once it's drained
+            t.ring = make_shared<LogRing>(_params.bufferSize);
+            t.ownerID = _id;
+
+            lock_guard<mutex> lock(_mutex);
+            _rings.push_back(t.ring);
+        }
+        return *t.ring;
+    }
+
+    // block mode: sleeps until the writer releases the space, pred is re-checked on each wake-up
+    template <typename TPred>
+    void wait_drain(const TPred& pred) {
+        unique_lock<mutex> lock(_mutexDrained);
+        while (!pred()) {
+            _cv.notify_one(); // the writer may be idle
+            _cvDrained.wait_for(lock, chrono::milliseconds(10)); // the timeout is just a safety net
+        }
+    }
+
+    void run();
+
+public:
+    AsyncLogWriter(LoggerImpl& owner, const Logger::AsyncParams& params, int flushLevel) :
+        _owner(owner),
+        _id(++g_asyncWriterID),
+        _params(params),
+        _flushLevel(flushLevel)
+    {
+        _thread = thread(&AsyncLogWriter::run, this);
+    }
+
+    ~AsyncLogWriter() {
+        _stop = true;
+        _cv.notify_one();
+        _thread.join();
+    }
+
+    // Returns false if the message should be written synchronously
+    bool push(int level, const char* header, size_t headerSize, const char* msg, size_t size);
+};
+
 class LoggerImpl : public Logger {
 protected:
+    friend class AsyncLogWriter;
+
     mutex _mutex;
     static const size_t MAX_HEADER_SIZE = 256;
     static const size_t MAX_TIMESTAMP_SIZE = 80;
@@ -61,6 +247,10 @@ protected:
     std::string _timeFormat;
     bool _printMilliseconds;
 
+    std::unique_ptr<AsyncLogWriter> _async;
+    atomic<uint64_t> _asyncWritten{0};
+    atomic<uint64_t> _asyncDropped{0};
+
     LoggerImpl(FILE* sink, int minLevel, int flushLevel) :
         _sink(sink),
         _minLevel(minLevel),
@@ -73,6 +263,7 @@ protected:
     }
 
     virtual ~LoggerImpl() {
+        stop_async();
         if (this == g_logger) {
             g_logger = 0;
         }
@@ -92,16 +283,26 @@ protected:
         }
     }
 
-    void write_message(const LogMessageHeader& header, const char* buf, size_t size) override {
+    size_t format_header(char* headerFormatted, const LogMessageHeader& header) {
         char timestampFormatted[MAX_TIMESTAMP_SIZE];
-        char headerFormatted[MAX_HEADER_SIZE];
         if (!_timeFormat.empty()) {
             format_timestamp(timestampFormatted, MAX_TIMESTAMP_SIZE, _timeFormat.c_str(), header.timestamp, _printMilliseconds);
         } else {
             timestampFormatted[0] = 0;
         }
         size_t headerSize = _headerFormatter(headerFormatted, MAX_HEADER_SIZE, timestampFormatted, header);
-        write_impl(header.level, headerFormatted, headerSize, buf, size);
+        return std::min(headerSize, MAX_HEADER_SIZE - 1); // snprintf returns the untruncated size
+    }
+
+    void write_message(const LogMessageHeader& header, const char* buf, size_t size) override {
+        char headerFormatted[MAX_HEADER_SIZE];
+        size_t headerSize = format_header(headerFormatted, header);
+        if (_async && _async->push(header.level, headerFormatted, headerSize, buf, size)) return;
+        write_formatted(header.level, headerFormatted, headerSize, buf, size);
+    }
+
+    virtual void write_formatted(int level, const char* header, size_t headerSize, const char* msg, size_t size) {
+        write_impl(level, header, headerSize, msg, size);
     }
 
     const FileNameType& get_current_file_name() override {
@@ -109,6 +310,42 @@ protected:
         return emptyName;
     }
 
+    void start_async(const AsyncParams& params) override {
+        stop_async();
+        _async = std::make_unique<AsyncLogWriter>(*this, params, _flushLevel);
+    }
+
+    void stop_async() override {
+        _async.reset();
+    }
+
+    AsyncStats get_async_stats() override {
+        AsyncStats res;
+        res.written = _asyncWritten;
+        res.dropped = _asyncDropped;
+        return res;
+    }
+
+#ifndef WIN32
+    static void write_iov(int fd, iovec* iov, int count) {
+        while (count) {
+            ssize_t n = writev(fd, iov, count);
+            if (n < 0) {
+                if (EINTR == errno) continue;
+                return;
+            }
+            // partial write
+            for (; count && (size_t(n) >= iov->iov_len); iov++, count--) {
+                n -= iov->iov_len;
+            }
+            if (count) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+    }
+#endif
+
 public:
     bool level_accepted(int level) override {
         return level >= _minLevel;
@@ -122,14 +359,131 @@ public:
         fwrite(msg, 1, size, _sink);
         if (level >= _flushLevel) fflush(_sink);
     }
+
+    // called from the writer thread
+    virtual void write_batch(const LogRecord* records, size_t count) {
+        lock_guard<mutex> lock(_mutex);
+        if (!_sink) return;
+        fflush(_sink); // whatever was written synchronously
+
+#ifdef WIN32
+        for (size_t i = 0; i < count; i++) {
+            if (level_accepted(records[i].level)) fwrite(records[i].data, 1, records[i].size, _sink);
+        }
+        fflush(_sink);
+#else
+        const int nMaxIov = std::min(IOV_MAX, 1024);
+        iovec iov[1024];
+        int n = 0;
+        int fd = fileno(_sink);
+
+        for (size_t i = 0; i < count; i++) {
+            if (!level_accepted(records[i].level)) continue;
+            iov[n].iov_base = const_cast<char*>(records[i].data);
+            iov[n].iov_len = records[i].size;
+            if (++n == nMaxIov) {
+                write_iov(fd, iov, n);
+                n = 0;
+            }
+        }
+        if (n) write_iov(fd, iov, n);
+#endif
+    }
 };
 
+bool AsyncLogWriter::push(int level, const char* header, size_t headerSize, const char* msg, size_t size) {
+    LogRing& ring = get_ring();
+
+    if (!ring.fits(headerSize + size)) {
+        if (!_params.block) {
+            _owner._asyncDropped++;
+            return true;
+        }
+        // too large for the queue: write it directly, but after the preceding messages of this thread
+        wait_drain([&ring]() { return ring.empty(); });
+        return false;
+    }
+
+    if (!ring.try_push(level, header, headerSize, msg, size)) {
+        if (!_params.block) {
+            _owner._asyncDropped++;
+            return true;
+        }
+        wait_drain([&]() { return ring.try_push(level, header, headerSize, msg, size); });
+    }
+
+    if ((level >= _flushLevel) || ring.is_half_full()) _cv.notify_one();
+    return true;
+}
+
+void AsyncLogWriter::run() {
+    vector<shared_ptr<LogRing>> rings;
+    vector<size_t> tails;
+    vector<LogRecord> records;
+
+    while (true) {
+        bool stop = _stop;
+        rings.clear();
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            // drop the rings of the exited threads
+            _rings.erase(remove_if(_rings.begin(), _rings.end(), [](const shared_ptr<LogRing>& p) {
+                return (p.use_count() == 1) && p->empty();
+            }), _rings.end());
+            rings = _rings;
+        }
+
+        records.clear();
+        tails.clear();
+        for (const auto& p : rings) {
+            tails.push_back(p->peek(records));
+        }
+        size_t nMessages = records.size();
+
+        uint64_t nDropped = _owner._asyncDropped;
+        if (nDropped != _droppedReported) {
+            char headerFormatted[LoggerImpl::MAX_HEADER_SIZE];
+            LogMessageHeader header(LOG_LEVEL_WARNING, nullptr, 0, nullptr);
+            _dropReport.assign(headerFormatted, _owner.format_header(headerFormatted, header));
+            _dropReport += std::to_string(nDropped - _droppedReported) + " log messages dropped\n";
+            _droppedReported = nDropped;
+            records.push_back({ LOG_LEVEL_WARNING, _dropReport.data(), _dropReport.size() });
+        }
+
+        if (records.empty()) {
+            if (stop) break;
+            unique_lock<mutex> lock(_mutex);
+            _cv.wait_for(lock, chrono::milliseconds(10));
+            continue;
+        }
+
+        _owner.write_batch(records.data(), records.size());
+        _owner._asyncWritten += nMessages;
+
+        for (size_t i = 0; i < rings.size(); i++) {
+            rings[i]->release(tails[i]);
+        }
+
+        if (_params.block) {
+            {
+                lock_guard<mutex> lock(_mutexDrained); // a producer is either waiting, or will see the released space
+            }
+            _cvDrained.notify_all();
+        }
+    }
+}
+
 class ConsoleLogger : public LoggerImpl {
 public:
     ConsoleLogger(int flushLevel, int consoleLevel) :
         LoggerImpl(stdout, consoleLevel, flushLevel)
     {}
 
+    ~ConsoleLogger() {
+        stop_async();
+    }
+
     // does nothing for console
     void rotate() override {}
 };
@@ -153,6 +507,7 @@ public:
     }
 
     ~FileLogger() {
+        stop_async(); // before the file is closed
         fclose(_sink);
     }
 
@@ -231,23 +586,24 @@ public:
         _consoleSink(flushLevel, consoleLevel)
     {}
 
-    void write_message(const LogMessageHeader& header, const char* buf, size_t size) override {
-        char timestampFormatted[MAX_TIMESTAMP_SIZE];
-        char headerFormatted[MAX_HEADER_SIZE];
-        if (!_timeFormat.empty()) {
-            format_timestamp(timestampFormatted, MAX_TIMESTAMP_SIZE, _timeFormat.c_str(), header.timestamp, _printMilliseconds);
-        } else {
-            timestampFormatted[0] = 0;
-        }
-        size_t headerSize = _headerFormatter(headerFormatted, MAX_HEADER_SIZE, timestampFormatted, header);
-        if (_consoleSink.level_accepted(header.level)) {
-            _consoleSink.write_impl(header.level, headerFormatted, headerSize, buf, size);
+    ~CombinedLogger() {
+        stop_async(); // before the sinks are destroyed
+    }
+
+    void write_formatted(int level, const char* header, size_t headerSize, const char* msg, size_t size) override {
+        if (_consoleSink.level_accepted(level)) {
+            _consoleSink.write_impl(level, header, headerSize, msg, size);
         }
-        if (_fileSink.level_accepted(header.level)) {
-            _fileSink.write_impl(header.level, headerFormatted, headerSize, buf, size);
+        if (_fileSink.level_accepted(level)) {
+            _fileSink.write_impl(level, header, headerSize, msg, size);
         }
     }
 
+    void write_batch(const LogRecord* records, size_t count) override {
+        _consoleSink.write_batch(records, count);
+        _fileSink.write_batch(records, count);
+    }
+
     const FileNameType& get_current_file_name() override {
         return _fileSink.get_current_file_name();
     }
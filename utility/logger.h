@@ -167,6 +167,26 @@ public:
     /// Rotates file name, called externally
     virtual void rotate() = 0;
 
+    /// Asynchronous mode: messages are queued in per-thread lock-free ring buffers and written by a dedicated thread, in batches
+    struct AsyncParams {
+        // per thread, bytes. Rounded up to a power of 2
+        size_t bufferSize = 256 * 1024;
+
+        // if the buffer is full: wait for the writer thread, or drop the message (drops are counted and reported in the log)
+        bool block = false;
+    };
+
+    struct AsyncStats {
+        uint64_t written = 0;
+        uint64_t dropped = 0;
+    };
+
+    /// Starts/stops the asynchronous mode. On stop all the queued messages are written.
+    /// Must not be called concurrently with logging from other threads (i.e. call on startup and shutdown)
+    virtual void start_async(const AsyncParams& params) = 0;
+    virtual void stop_async() = 0;
+    virtual AsyncStats get_async_stats() = 0;
+
     static bool will_log(int level) {
         return g_logger && g_logger->level_accepted(level);
     }
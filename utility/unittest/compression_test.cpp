@@ -0,0 +1,196 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utility/compression.h"
+#include <random>
+#include <chrono>
+#include <stdio.h>
+
+using namespace beam;
+
+static int g_TestsFailed = 0;
+
+#define verify_test(x) \
+do { \
+    if (!(x)) { \
+        printf("Test failed! Line=%u, Expression: %s\n", __LINE__, #x); \
+        g_TestsFailed++; \
+    } \
+} while (false)
+
+std::mt19937 g_Rnd(12345);
+
+void FillRandom(ByteBuffer& buf, size_t nSize)
+{
+    buf.resize(nSize);
+    for (size_t i = 0; i < nSize; i++)
+        buf[i] = static_cast<uint8_t>(g_Rnd());
+}
+
+// random records with repeated fields, similar to serialized txs
+void FillStructured(ByteBuffer& buf, size_t nSize)
+{
+    ByteBuffer vCommon;
+    FillRandom(vCommon, 100);
+
+    buf.clear();
+    while (buf.size() < nSize)
+    {
+        uint32_t nRecord = g_Rnd() % 3;
+        buf.push_back(static_cast<uint8_t>(nRecord));
+
+        ByteBuffer v;
+        FillRandom(v, 33 + g_Rnd() % 40); // unique part
+        buf.insert(buf.end(), v.begin(), v.end());
+
+        uint32_t nCommon = 10 + g_Rnd() % 60;
+        buf.insert(buf.end(), vCommon.begin(), vCommon.begin() + nCommon);
+
+        buf.insert(buf.end(), 8 + g_Rnd() % 20, 0); // zeroes
+    }
+
+    buf.resize(nSize);
+}
+
+bool RoundTrip(LzStream::Encoder& enc, LzStream::Decoder& dec, const ByteBuffer& buf, size_t& nCompressed)
+{
+    ByteBuffer vZ, vRes;
+    bool bCompressed = enc.Write(vZ, buf.empty() ? nullptr : &buf.front(), static_cast<uint32_t>(buf.size()));
+    verify_test(bCompressed == (vZ.size() < buf.size()));
+
+    nCompressed = vZ.size();
+
+    if (!dec.Read(vRes, vZ.empty() ? nullptr : &vZ.front(), static_cast<uint32_t>(vZ.size()), static_cast<uint32_t>(buf.size())))
+        return false;
+
+    return vRes == buf;
+}
+
+void TestRoundTrip()
+{
+    LzStream::Encoder enc;
+    LzStream::Decoder dec;
+    size_t nCompressed;
+
+    ByteBuffer buf;
+    verify_test(RoundTrip(enc, dec, buf, nCompressed)); // empty
+
+    buf.assign(3, 7); // shorter than min match
+    verify_test(RoundTrip(enc, dec, buf, nCompressed));
+
+    buf.assign(100000, 0); // long overlapping match
+    verify_test(RoundTrip(enc, dec, buf, nCompressed));
+    verify_test(nCompressed < 500);
+
+    FillRandom(buf, 50000); // incompressible, must be stored
+    verify_test(RoundTrip(enc, dec, buf, nCompressed));
+    verify_test(nCompressed == buf.size());
+
+    // the same data again, now it's in the dictionary
+    verify_test(RoundTrip(enc, dec, buf, nCompressed));
+    verify_test(nCompressed < 1000);
+
+    FillStructured(buf, 300000);
+    verify_test(RoundTrip(enc, dec, buf, nCompressed));
+    verify_test(nCompressed < buf.size());
+    printf("Structured: %u -> %u\n", (uint32_t) buf.size(), (uint32_t) nCompressed);
+
+    // larger than the window, the history is trimmed on both sides
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        FillStructured(buf, LzStream::s_Window + 12345 * i);
+        verify_test(RoundTrip(enc, dec, buf, nCompressed));
+    }
+
+    // small messages, referring to the previous ones
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        FillStructured(buf, 1 + g_Rnd() % 2000);
+        verify_test(RoundTrip(enc, dec, buf, nCompressed));
+    }
+}
+
+void TestCorrupted()
+{
+    ByteBuffer buf;
+    FillStructured(buf, 20000);
+
+    LzStream::Encoder enc;
+    ByteBuffer vZ;
+    verify_test(enc.Write(vZ, &buf.front(), static_cast<uint32_t>(buf.size())));
+
+    uint32_t nRejected = 0;
+
+    for (uint32_t i = 0; i < 2000; i++)
+    {
+        ByteBuffer vZ2 = vZ;
+
+        switch (i % 3)
+        {
+        case 0:
+            vZ2[g_Rnd() % vZ2.size()] ^= static_cast<uint8_t>(1 + g_Rnd() % 255);
+            break;
+        case 1:
+            vZ2.resize(g_Rnd() % vZ2.size());
+            break;
+        default:
+            FillRandom(vZ2, vZ2.size());
+        }
+
+        // must never crash or read/write out of bounds
+        LzStream::Decoder dec;
+        ByteBuffer vRes;
+        if (dec.Read(vRes, vZ2.empty() ? nullptr : &vZ2.front(), static_cast<uint32_t>(vZ2.size()), static_cast<uint32_t>(buf.size())))
+            verify_test(vRes.size() == buf.size());
+        else
+            nRejected++;
+    }
+
+    verify_test(nRejected);
+
+    // encoded size larger than declared original
+    LzStream::Decoder dec;
+    ByteBuffer vRes;
+    verify_test(!dec.Read(vRes, &vZ.front(), static_cast<uint32_t>(vZ.size()), static_cast<uint32_t>(vZ.size() - 1)));
+}
+
+void TestSpeed()
+{
+    ByteBuffer buf;
+    FillStructured(buf, 5 * 1024 * 1024);
+
+    LzStream::Encoder enc;
+    LzStream::Decoder dec;
+    ByteBuffer vZ, vRes;
+
+    auto t0 = std::chrono::steady_clock::now();
+    enc.Write(vZ, &buf.front(), static_cast<uint32_t>(buf.size()));
+    auto t1 = std::chrono::steady_clock::now();
+    verify_test(dec.Read(vRes, &vZ.front(), static_cast<uint32_t>(vZ.size()), static_cast<uint32_t>(buf.size())));
+    auto t2 = std::chrono::steady_clock::now();
+    verify_test(vRes == buf);
+
+    printf("5MB: compressed to %u, encode %u ms, decode %u ms\n", (uint32_t) vZ.size(),
+        (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count(),
+        (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count());
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestCorrupted();
+    TestSpeed();
+
+    return g_TestsFailed ? -1 : 0;
+}
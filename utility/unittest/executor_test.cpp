@@ -0,0 +1,245 @@
+// Copyright 2018 The Beam Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utility/executor.h"
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <assert.h>
+
+using namespace beam;
+
+static int g_TestsFailed = 0;
+
+#define verify_test(x) \
+do { \
+    if (!(x)) { \
+        printf("Test failed! Line=%u, Expression: %s\n", __LINE__, #x); \
+        g_TestsFailed++; \
+    } \
+} while (false)
+
+struct MyExecutor
+    :public ExecutorMT
+{
+    void StartThread(MyThread& t, uint32_t iThread) override
+    {
+        t = MyThread(&MyExecutor::RunThread, this, iThread);
+    }
+
+    void RunThread(uint32_t iThread)
+    {
+        Context ctx;
+        ctx.m_iThread = iThread;
+        RunThreadCtx(ctx);
+    }
+};
+
+struct TaskCount
+    :public Executor::TaskAsync
+{
+    std::atomic<uint32_t>& m_Counter;
+    uint32_t m_nWork;
+
+    TaskCount(std::atomic<uint32_t>& x, uint32_t nWork) :m_Counter(x), m_nWork(nWork) {}
+
+    void Exec(Executor::Context&) override
+    {
+        // some dummy work, the compiler must not optimize it out
+        volatile uint32_t n = 0;
+        for (uint32_t i = 0; i < m_nWork; i++)
+            n = n + i;
+
+        m_Counter++;
+    }
+};
+
+// spawns a binary tree of tasks from the worker threads
+struct TaskSpawn
+    :public Executor::TaskAsync
+{
+    std::atomic<uint32_t>& m_Counter;
+    uint32_t m_nDepth;
+
+    TaskSpawn(std::atomic<uint32_t>& x, uint32_t nDepth) :m_Counter(x), m_nDepth(nDepth) {}
+
+    void Exec(Executor::Context& ctx) override
+    {
+        if (m_nDepth)
+            for (uint32_t i = 0; i < 2; i++)
+                ctx.m_pThis->Push(std::make_unique<TaskSpawn>(m_Counter, m_nDepth - 1));
+
+        m_Counter++;
+    }
+};
+
+struct TaskPortion
+    :public Executor::TaskSync
+{
+    std::vector<uint32_t> m_vHits;
+    std::vector<uint32_t> m_vThreadHits;
+
+    void Exec(Executor::Context& ctx) override
+    {
+        m_vThreadHits[ctx.m_iThread]++;
+
+        uint32_t i0, nCount;
+        ctx.get_Portion(i0, nCount, static_cast<uint32_t>(m_vHits.size()));
+
+        for (uint32_t i = 0; i < nCount; i++)
+            m_vHits[i0 + i]++; // portions don't overlap
+    }
+};
+
+static uint64_t get_Time_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TestExecutor(bool bWorkStealing, uint32_t nThreads)
+{
+    MyExecutor ex;
+    ex.set_Threads(nThreads);
+    ex.set_WorkStealing(bWorkStealing);
+    verify_test(ex.get_WorkStealing() == bWorkStealing);
+
+    std::atomic<uint32_t> nDone(0);
+
+    // pushed from outside, via the injection queue
+    const uint32_t nTasks = 5000;
+    for (uint32_t i = 0; i < nTasks; i++)
+        ex.Push(std::make_unique<TaskCount>(nDone, 100));
+
+    verify_test(!ex.Flush(0));
+    verify_test(nTasks == nDone);
+
+    // partial flush
+    nDone = 0;
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        ex.Push(std::make_unique<TaskCount>(nDone, 1000));
+        verify_test(ex.Flush(4) <= 4);
+    }
+
+    ex.Flush(0);
+    verify_test(200 == nDone);
+
+    // tasks pushed by the workers, more than a deque can hold
+    nDone = 0;
+    ex.Push(std::make_unique<TaskSpawn>(nDone, 12));
+    verify_test(!ex.Flush(0));
+    verify_test((1u << 13) - 1 == nDone);
+
+    for (uint32_t iCycle = 0; iCycle < 50; iCycle++)
+    {
+        TaskPortion t;
+        t.m_vHits.resize(1000 + iCycle);
+        t.m_vThreadHits.resize(nThreads);
+
+        ex.ExecAll(t);
+
+        for (uint32_t i = 0; i < t.m_vHits.size(); i++)
+            verify_test(1 == t.m_vHits[i]);
+        for (uint32_t i = 0; i < nThreads; i++)
+            verify_test(1 == t.m_vThreadHits[i]);
+    }
+
+    // Tasks interleaved with ExecAll
+    nDone = 0;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        ex.Push(std::make_unique<TaskCount>(nDone, 10));
+
+        TaskPortion t;
+        t.m_vHits.resize(10);
+        t.m_vThreadHits.resize(nThreads);
+        ex.ExecAll(t);
+
+        verify_test(i + 1 == nDone);
+    }
+
+    // stop with pending tasks, they should be discarded without leaks
+    for (uint32_t i = 0; i < 100; i++)
+        ex.Push(std::make_unique<TaskCount>(nDone, 10000));
+    ex.Stop();
+
+    // restart
+    nDone = 0;
+    ex.Push(std::make_unique<TaskCount>(nDone, 1));
+    ex.Flush(0);
+    verify_test(1 == nDone);
+}
+
+void BenchmarkExecutor(bool bWorkStealing, uint32_t nThreads)
+{
+    MyExecutor ex;
+    ex.set_Threads(nThreads);
+    ex.set_WorkStealing(bWorkStealing);
+
+    std::atomic<uint32_t> nDone(0);
+    ex.Flush(0); // start threads
+
+    const uint32_t pWork[] = { 0, 1000, 20000 };
+    const uint32_t pTasks[] = { 200000, 50000, 5000 };
+
+    for (uint32_t iWork = 0; iWork < _countof(pWork); iWork++)
+    {
+        uint64_t t0 = get_Time_us();
+
+        for (uint32_t i = 0; i < pTasks[iWork]; i++)
+        {
+            ex.Push(std::make_unique<TaskCount>(nDone, pWork[iWork]));
+
+            if (!(i & 0xfff))
+                ex.Flush(nThreads * 64); // don't let the queue grow unbounded
+        }
+        ex.Flush(0);
+
+        uint64_t dt = get_Time_us() - t0;
+        printf("    Push/Flush, work=%-6u: %.3f us/task\n", pWork[iWork], double(dt) / pTasks[iWork]);
+    }
+
+    const uint32_t nExecAll = 20000;
+    uint64_t t0 = get_Time_us();
+
+    TaskPortion t;
+    t.m_vHits.resize(64);
+    t.m_vThreadHits.resize(nThreads);
+
+    for (uint32_t i = 0; i < nExecAll; i++)
+        ex.ExecAll(t);
+
+    uint64_t dt = get_Time_us() - t0;
+    printf("    ExecAll            : %.3f us/call\n", double(dt) / nExecAll);
+}
+
+int main()
+{
+    const uint32_t pThreads[] = { 1, 2, 4, 8 };
+
+    for (uint32_t iMode = 0; iMode < 2; iMode++)
+        for (uint32_t iThreads = 0; iThreads < _countof(pThreads); iThreads++)
+            TestExecutor(!!iMode, pThreads[iThreads]);
+
+    for (uint32_t iThreads = 0; iThreads < _countof(pThreads); iThreads++)
+    {
+        for (uint32_t iMode = 0; iMode < 2; iMode++)
+        {
+            printf("%s, Threads=%u\n", iMode ? "Work-stealing" : "Shared queue", pThreads[iThreads]);
+            BenchmarkExecutor(!!iMode, pThreads[iThreads]);
+        }
+    }
+
+    return g_TestsFailed ? -1 : 0;
+}
@@ -14,7 +14,12 @@
 
 #include "utility/logger_checkpoints.h"
 #include "utility/helpers.h"
+#include "utility/test_helpers.h"
 #include <thread>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <iterator>
 
 using namespace beam;
 
@@ -79,7 +84,71 @@ void test_ndc_2(bool exc)
     }
 }
 
+size_t count_lines(const Logger::FileNameType& path) {
+    std::ifstream f(path);
+    return std::count(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>(), '\n');
+}
+
+// mode: 0 - sync, 1 - async, wait if the buffer is full, 2 - async, drop if full
+void test_throughput(int mode, unsigned nThreads) {
+    const unsigned nMessages = 20000; // per thread
+    Logger::FileNameType path;
+    Logger::AsyncStats stats;
+    uint64_t ms = 0;
+
+    {
+        auto logger = Logger::create(LOG_LEVEL_ERROR, LOG_SINK_DISABLED, LOG_LEVEL_INFO, "bench_");
+        path = logger->get_current_file_name();
+
+        if (mode) {
+            Logger::AsyncParams params;
+            params.block = (1 == mode);
+            params.bufferSize = 0x10000;
+            logger->start_async(params);
+        }
+
+        helpers::StopWatch sw;
+        sw.start();
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < nThreads; i++) {
+            threads.emplace_back([i]() {
+                for (unsigned j = 0; j < nMessages; j++) {
+                    LOG_INFO() << "Thread " << i << ", message " << j << ", some payload to make it look like a real log line " << 0x12345678;
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        logger->stop_async(); // drain
+        sw.stop();
+        ms = sw.milliseconds();
+        stats = logger->get_async_stats();
+    }
+
+    size_t nLines = count_lines(path);
+    std::remove(std::string(path.begin(), path.end()).c_str());
+
+    const uint64_t nTotal = uint64_t(nThreads) * nMessages;
+    static const char* szModes[] = { "sync", "async, block", "async, drop" };
+    std::cout << szModes[mode] << ", " << nThreads << " threads: " << nTotal * 1000 / std::max<uint64_t>(ms, 1) << " msg/sec, written " << nLines << ", dropped " << stats.dropped << std::endl;
+
+    if (2 == mode) {
+        // the drops are reported in the log
+        if (stats.written + stats.dropped != nTotal || nLines < stats.written) throw std::runtime_error("async log: lost messages");
+    }
+    else if (nLines != nTotal) {
+        throw std::runtime_error("log: lost messages");
+    }
+}
+
 int main() {
+    for (int mode = 0; mode < 3; mode++) {
+        for (unsigned nThreads : { 1U, 4U, 16U }) {
+            test_throughput(mode, nThreads);
+        }
+    }
+
     test_logger_1();
     test_ndc_1();
     test_ndc_2(false);
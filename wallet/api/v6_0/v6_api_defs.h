@@ -322,6 +322,7 @@ namespace beam::wallet
 
         uint32_t count = 0;
         uint32_t skip = 0;
+        boost::optional<TxID> after; // keyset pagination: list the txs after this one (normally the last one of the previous page)
 
         struct Response
         {
@@ -752,6 +752,18 @@ namespace beam::wallet
                 filter.m_AssetConfirmedHeight = data.filter.height;
             }
             filter.m_KernelProofHeight = data.filter.height;
+
+            if (data.after)
+            {
+                auto tx = walletDB->getTx(*data.after);
+                if (!tx)
+                {
+                    throw jsonrpc_exception(ApiError::InvalidParamsJsonRpc, kUnknownTxID);
+                }
+                checkTxAccessRights(*tx, ApiError::InvalidParamsJsonRpc, kUnknownTxID);
+                filter.m_AfterTxID = data.after;
+            }
+
             walletDB->visitTx([&](const TxDescription& tx)
             {
                 if (!allowedTx(tx))
@@ -766,7 +778,7 @@ namespace beam::wallet
                 }
                 Status::Response& item = res.resultList.emplace_back();
                 item.tx = tx;
-                item.txProofHeight = storage::DeduceTxProofHeight(*walletDB, tx);
+                item.txProofHeight = storage::DeduceTxProofHeight(tx);
                 item.systemHeight = stateID.m_Height;
 
                 ++counter;
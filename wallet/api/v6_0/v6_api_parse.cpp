@@ -744,6 +744,8 @@ namespace beam::wallet
             txList.skip = *skip;
         }
 
+        txList.after = getOptionalParam<ValidTxID>(params, "after");
+
         return std::make_pair(txList, MethodInfo());
     }
 
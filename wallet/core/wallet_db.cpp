@@ -560,6 +560,189 @@ namespace beam::wallet
         }
     }
 
+    struct WalletDB::StatementCache
+    {
+        typedef std::pair<sqlite3*, std::string> Key;
+
+        struct Entry
+        {
+            Key m_Key;
+            sqlite3_stmt* m_pStm;
+        };
+
+        // A statement is removed while in use, so that nested statements with the same SQL text are prepared independently
+        std::list<Entry> m_Lru; // front - most recently released
+        std::multimap<Key, std::list<Entry>::iterator> m_Map;
+        size_t m_Max = 256;
+        CacheStats m_Stats;
+
+        ~StatementCache() { Clear(); }
+
+        sqlite3_stmt* Take(sqlite3* db, const std::string& sql)
+        {
+            auto it = m_Map.find(Key(db, sql));
+            if (m_Map.end() == it)
+            {
+                m_Stats.m_Misses++;
+                return nullptr;
+            }
+
+            m_Stats.m_Hits++;
+            sqlite3_stmt* pStm = it->second->m_pStm;
+            m_Lru.erase(it->second);
+            m_Map.erase(it);
+            return pStm;
+        }
+
+        void Put(sqlite3* db, std::string&& sql, sqlite3_stmt* pStm) // must be reset
+        {
+            m_Lru.push_front(Entry{ Key(db, std::move(sql)), pStm });
+            m_Map.emplace(m_Lru.front().m_Key, m_Lru.begin());
+
+            while (m_Lru.size() > m_Max)
+                DeleteLast();
+        }
+
+        void DeleteLast()
+        {
+            auto itL = std::prev(m_Lru.end());
+            for (auto it = m_Map.lower_bound(itL->m_Key); ; ++it)
+            {
+                assert(m_Map.end() != it);
+                if (it->second == itL)
+                {
+                    m_Map.erase(it);
+                    break;
+                }
+            }
+
+            sqlite3_finalize(itL->m_pStm);
+            m_Lru.erase(itL);
+        }
+
+        void Clear()
+        {
+            while (!m_Lru.empty())
+                DeleteLast();
+        }
+    };
+
+    struct WalletDB::ParameterCache
+    {
+        typedef std::pair<SubTxID, TxParameterID> Key;
+
+        struct Tx
+        {
+            std::map<Key, boost::optional<ByteBuffer>> m_Params;
+            std::list<TxID>::iterator m_itMru;
+            bool m_Complete = false; // all the tx parameters are cached, the missing ones don't exist
+        };
+
+        std::map<TxID, Tx> m_Txs;
+        std::list<TxID> m_Mru; // front - most recently used
+        size_t m_Count = 0;
+        size_t m_Max = 100000;
+        CacheStats m_Stats;
+
+        Tx* FindTx(const TxID& txID)
+        {
+            auto it = m_Txs.find(txID);
+            if (m_Txs.end() == it)
+                return nullptr;
+
+            m_Mru.splice(m_Mru.begin(), m_Mru, it->second.m_itMru);
+            return &it->second;
+        }
+
+        // returns false if not cached. pBlob is set to null if the parameter is known to be missing
+        bool Find(const TxID& txID, SubTxID subTxID, TxParameterID paramID, const ByteBuffer*& pBlob)
+        {
+            Tx* pTx = FindTx(txID);
+            if (pTx)
+            {
+                auto it = pTx->m_Params.find(Key(subTxID, paramID));
+                if (pTx->m_Params.end() != it)
+                {
+                    m_Stats.m_Hits++;
+                    pBlob = it->second ? &*it->second : nullptr;
+                    return true;
+                }
+
+                if (pTx->m_Complete)
+                {
+                    m_Stats.m_Hits++;
+                    pBlob = nullptr;
+                    return true;
+                }
+            }
+
+            m_Stats.m_Misses++;
+            return false;
+        }
+
+        Tx& InsertTx(const TxID& txID)
+        {
+            Tx* pTx = FindTx(txID);
+            if (pTx)
+                return *pTx;
+
+            Tx& tx = m_Txs[txID];
+            m_Mru.push_front(txID);
+            tx.m_itMru = m_Mru.begin();
+            return tx;
+        }
+
+        void Insert(Tx& tx, SubTxID subTxID, TxParameterID paramID, const boost::optional<ByteBuffer>& blob)
+        {
+            auto res = tx.m_Params.emplace(Key(subTxID, paramID), blob);
+            if (res.second)
+                m_Count++;
+            else
+                res.first->second = blob;
+        }
+
+        void Insert(const TxID& txID, SubTxID subTxID, TxParameterID paramID, const boost::optional<ByteBuffer>& blob)
+        {
+            Insert(InsertTx(txID), subTxID, paramID, blob);
+            Shrink();
+        }
+
+        void Shrink()
+        {
+            // evict whole txs, except the most recent one
+            while ((m_Count > m_Max) && (m_Mru.size() > 1))
+            {
+                TxID txID = m_Mru.back();
+                Erase(txID);
+            }
+        }
+
+        void Erase(const TxID& txID, SubTxID subTxID, TxParameterID paramID)
+        {
+            auto it = m_Txs.find(txID);
+            if ((m_Txs.end() != it) && it->second.m_Params.erase(Key(subTxID, paramID)))
+                m_Count--;
+        }
+
+        void Erase(const TxID& txID)
+        {
+            auto it = m_Txs.find(txID);
+            if (m_Txs.end() == it)
+                return;
+
+            m_Count -= it->second.m_Params.size();
+            m_Mru.erase(it->second.m_itMru);
+            m_Txs.erase(it);
+        }
+
+        void Clear()
+        {
+            m_Txs.clear();
+            m_Mru.clear();
+            m_Count = 0;
+        }
+    };
+
     namespace sqlite
     {
         struct Statement
@@ -568,22 +751,22 @@ namespace beam::wallet
                 : _walletDB(nullptr)
                 , _db(privateDB ? db->m_PrivateDB : db->_db)
                 , _stm(nullptr)
+                , _cache(db->m_pStatements.get())
             {
-                int ret = sqlite3_prepare_v2(_db, sql, -1, &_stm, nullptr);
-                throwIfError(ret, _db);
+                prepare(sql);
             }
 
             Statement(WalletDB* db, const char* sql, bool privateDB = false)
                 : _walletDB(db)
                 , _db(privateDB ? db->m_PrivateDB : db->_db)
                 , _stm(nullptr)
+                , _cache(db->m_pStatements.get())
             {
                 if (_walletDB)
                 {
                     _walletDB->onPrepareToModify();
                 }
-                int ret = sqlite3_prepare_v2(_db, sql, -1, &_stm, nullptr);
-                throwIfError(ret, _db);
+                prepare(sql);
             }
 
             void Reset()
@@ -926,12 +1109,37 @@ namespace beam::wallet
 
             ~Statement()
             {
-                sqlite3_finalize(_stm);
+                if (_cache && _stm)
+                {
+                    sqlite3_reset(_stm);
+                    sqlite3_clear_bindings(_stm);
+                    _cache->Put(_db, std::move(_sql), _stm);
+                }
+                else
+                {
+                    sqlite3_finalize(_stm);
+                }
             }
         private:
+            void prepare(const char* sql)
+            {
+                if (_cache)
+                {
+                    _sql = sql;
+                    _stm = _cache->Take(_db, _sql);
+                    if (_stm)
+                        return;
+                }
+
+                int ret = sqlite3_prepare_v2(_db, sql, -1, &_stm, nullptr);
+                throwIfError(ret, _db);
+            }
+
             WalletDB* _walletDB;
             sqlite3 * _db;
             sqlite3_stmt* _stm;
+            WalletDB::StatementCache* _cache;
+            std::string _sql;
             std::vector<ByteBuffer> _buffers;
         };
 
@@ -1262,6 +1470,17 @@ namespace beam::wallet
             throwIfError(ret, db);
         }
 
+        void CreateTxSummaryListIndexes(sqlite3* db)
+        {
+            // for the keyset pagination of the tx list, ordered by CreateTime. The primary key (TxID) is implicitly included
+            const char* req =
+                "CREATE INDEX IF NOT EXISTS TxSummaryListIndex ON " TX_SUMMARY_NAME " (CreateTime,Status,AssetID);"
+                "CREATE INDEX IF NOT EXISTS TxSummaryStatusListIndex ON " TX_SUMMARY_NAME " (Status,CreateTime);"
+                "CREATE INDEX IF NOT EXISTS TxSummaryAssetListIndex ON " TX_SUMMARY_NAME " (AssetID,CreateTime);";
+            int ret = sqlite3_exec(db, req, nullptr, nullptr, nullptr);
+            throwIfError(ret, db);
+        }
+
         void CreateTxParamsTable(sqlite3* db)
         {
             const char* req = "CREATE TABLE " TX_PARAMS_NAME " (" ENUM_TX_PARAMS_FIELDS(LIST_WITH_TYPES, COMMA, ) ", PRIMARY KEY (txID, subTxID, paramID)) WITHOUT ROWID;";
@@ -1325,6 +1544,7 @@ namespace beam::wallet
                 ;
             const auto ret = sqlite3_exec(db, req, nullptr, nullptr, nullptr);
             throwIfError(ret, db);
+            CreateTxSummaryListIndexes(db);
         }
 
         void MigrateAssetsFrom20(sqlite3* db)
@@ -2370,6 +2590,7 @@ namespace beam::wallet
 
                 case DbVersion:
                     CreateTxParamsIndex(walletDB->_db);
+                    CreateTxSummaryListIndexes(walletDB->_db);
                     // drop private variables from public database for cold wallet
                     if (separateDBForPrivateData && !DropPrivateVariablesFromPublicDatabase(*walletDB))
                     {
@@ -2509,6 +2730,371 @@ namespace beam::wallet
         }
     }
 
+    // The coin status depends on the current height and the state of the transactions, not only on the coin itself.
+    // The maturing coins are kept ordered by the maturity, and moved to the available on the new tip in memory.
+    // The coins whose status depends on a tx (incoming, outgoing) are re-read when the status of that tx changes.
+    // The rest are only updated on the coin change.
+    struct WalletDB::TotalsCache
+    {
+        struct ShieldedKeyCmp
+        {
+            bool operator()(const ShieldedTxo::BaseKey& a, const ShieldedTxo::BaseKey& b) const
+            {
+                if (a.m_nIdx != b.m_nIdx)
+                    return a.m_nIdx < b.m_nIdx;
+                if (a.m_IsCreatedByViewer != b.m_IsCreatedByViewer)
+                    return a.m_IsCreatedByViewer < b.m_IsCreatedByViewer;
+                return a.m_kSerG.m_Value < b.m_kSerG.m_Value;
+            }
+        };
+
+        struct CoinState
+        {
+            Coin::Status m_Status;
+            Height m_ConfirmHeight;
+            Height m_hMature; // for the maturing coins: the height from which it can be spent
+            boost::optional<TxID> m_TxID; // the status depends on this tx
+        };
+
+        struct ShieldedState
+        {
+            Asset::ID m_AssetID;
+            Amount m_Value;
+            ShieldedCoin::Status m_Status;
+            Height m_ConfirmHeight;
+            boost::optional<TxID> m_TxID; // the status depends on this tx
+        };
+
+        struct PerAsset
+        {
+            storage::Totals::AssetTotals m_Totals;
+            uint32_t m_Coins = 0;
+            uint32_t m_ShieldedCoins = 0;
+            bool m_MinHeightDirty = false;
+            bool m_MinHeightShieldedDirty = false;
+        };
+
+        std::map<Asset::ID, PerAsset> m_Assets;
+        std::map<Coin::ID, CoinState> m_Coins;
+        std::map<ShieldedTxo::BaseKey, ShieldedState, ShieldedKeyCmp> m_ShieldedCoins;
+
+        std::multimap<Height, Coin::ID> m_CoinsMaturing; // by the maturity height
+        std::map<ShieldedTxo::BaseKey, ShieldedCoin, ShieldedKeyCmp> m_ShieldedMaturing; // depend on the shielded outputs count as well, re-evaluated on each tip
+        std::multimap<TxID, Coin::ID> m_CoinsByTx;
+        std::multimap<TxID, ShieldedTxo::BaseKey> m_ShieldedByTx;
+
+        // the statuses of all the coins depend on them
+        Height m_hTip = 0;
+        uint8_t m_MaxPrivacyLockTimeLimitHours = 0;
+
+        PerAsset& get_Asset(Asset::ID aid)
+        {
+            PerAsset& x = m_Assets[aid];
+            x.m_Totals.AssetId = aid;
+            return x;
+        }
+
+        static void UpdateMinHeight(Height& hMin, Height h)
+        {
+            hMin = hMin ? std::min(hMin, h) : h;
+        }
+
+        static const boost::optional<TxID>& get_StatusTx(Height hConfirm, Height hSpent, const boost::optional<TxID>& createTxId, const boost::optional<TxID>& spentTxId)
+        {
+            static const boost::optional<TxID> s_None;
+            if (MaxHeight != hSpent)
+                return s_None;
+            return (MaxHeight == hConfirm) ? createTxId : spentTxId;
+        }
+
+        template <typename TMap, typename TVal, typename TCmp>
+        static void EraseValue(TMap& m, const typename TMap::key_type& key, const TVal& val, TCmp cmp)
+        {
+            for (auto its = m.equal_range(key); its.first != its.second; ++its.first)
+            {
+                if (!cmp(its.first->second, val) && !cmp(val, its.first->second))
+                {
+                    m.erase(its.first);
+                    break;
+                }
+            }
+        }
+
+        void OnCoin(const Coin& c)
+        {
+            OnCoinRemoved(c.m_ID);
+
+            PerAsset& x = get_Asset(c.m_ID.m_AssetID);
+            x.m_Coins++;
+            x.m_Totals.AddCoin(c.m_ID, c.m_status);
+            if (!x.m_MinHeightDirty)
+                UpdateMinHeight(x.m_Totals.MinCoinHeightMW, c.m_confirmHeight);
+
+            CoinState& cs = m_Coins[c.m_ID];
+            cs.m_Status = c.m_status;
+            cs.m_ConfirmHeight = c.m_confirmHeight;
+            cs.m_TxID = get_StatusTx(c.m_confirmHeight, c.m_spentHeight, c.m_createTxId, c.m_spentTxId);
+
+            if (Coin::Status::Maturing == c.m_status)
+            {
+                cs.m_hMature = c.get_Maturity(); // the coin status is deduced, with the confirmations offset
+                m_CoinsMaturing.emplace(cs.m_hMature, c.m_ID);
+            }
+
+            if (cs.m_TxID)
+                m_CoinsByTx.emplace(*cs.m_TxID, c.m_ID);
+        }
+
+        void OnCoinRemoved(const Coin::ID& cid)
+        {
+            auto it = m_Coins.find(cid);
+            if (m_Coins.end() == it)
+                return;
+
+            const CoinState& cs = it->second;
+
+            PerAsset& x = get_Asset(cid.m_AssetID);
+            x.m_Coins--;
+            x.m_Totals.AddCoin(cid, cs.m_Status, false);
+            if (cs.m_ConfirmHeight == x.m_Totals.MinCoinHeightMW)
+                x.m_MinHeightDirty = true;
+
+            if (Coin::Status::Maturing == cs.m_Status)
+                EraseValue(m_CoinsMaturing, cs.m_hMature, cid, std::less<Coin::ID>());
+            if (cs.m_TxID)
+                EraseValue(m_CoinsByTx, *cs.m_TxID, cid, std::less<Coin::ID>());
+
+            m_Coins.erase(it);
+        }
+
+        void OnShieldedCoin(const ShieldedCoin& c)
+        {
+            const ShieldedTxo::BaseKey& key = c.m_CoinID.m_Key;
+            OnShieldedCoinRemoved(key);
+
+            PerAsset& x = get_Asset(c.m_CoinID.m_AssetID);
+            x.m_ShieldedCoins++;
+            x.m_Totals.AddShieldedCoin(c.m_CoinID.m_Value, c.m_Status);
+            if (!x.m_MinHeightShieldedDirty)
+                UpdateMinHeight(x.m_Totals.MinCoinHeightShielded, c.m_confirmHeight);
+
+            ShieldedState& cs = m_ShieldedCoins[key];
+            cs.m_AssetID = c.m_CoinID.m_AssetID;
+            cs.m_Value = c.m_CoinID.m_Value;
+            cs.m_Status = c.m_Status;
+            cs.m_ConfirmHeight = c.m_confirmHeight;
+            cs.m_TxID = get_StatusTx(c.m_confirmHeight, c.m_spentHeight, c.m_createTxId, c.m_spentTxId);
+
+            if (ShieldedCoin::Status::Maturing == c.m_Status)
+                m_ShieldedMaturing[key] = c;
+
+            if (cs.m_TxID)
+                m_ShieldedByTx.emplace(*cs.m_TxID, key);
+        }
+
+        void OnShieldedCoinRemoved(const ShieldedTxo::BaseKey& key)
+        {
+            auto it = m_ShieldedCoins.find(key);
+            if (m_ShieldedCoins.end() == it)
+                return;
+
+            const ShieldedState& cs = it->second;
+
+            PerAsset& x = get_Asset(cs.m_AssetID);
+            x.m_ShieldedCoins--;
+            x.m_Totals.AddShieldedCoin(cs.m_Value, cs.m_Status, false);
+            if (cs.m_ConfirmHeight == x.m_Totals.MinCoinHeightShielded)
+                x.m_MinHeightShieldedDirty = true;
+
+            if (ShieldedCoin::Status::Maturing == cs.m_Status)
+                m_ShieldedMaturing.erase(key);
+            if (cs.m_TxID)
+                EraseValue(m_ShieldedByTx, *cs.m_TxID, key, ShieldedKeyCmp());
+
+            m_ShieldedCoins.erase(it);
+        }
+
+        // the tip only goes up here, the maturing coins may only become available (or outgoing)
+        void OnNewTip(const IWalletDB& db, Height h)
+        {
+            assert(h >= m_hTip);
+            m_hTip = h;
+
+            while (!m_CoinsMaturing.empty())
+            {
+                auto it = m_CoinsMaturing.begin();
+                if (it->first > h)
+                    break;
+
+                Coin::ID cid = it->second;
+                m_CoinsMaturing.erase(it);
+
+                CoinState& cs = m_Coins[cid];
+                assert(Coin::Status::Maturing == cs.m_Status);
+
+                PerAsset& x = get_Asset(cid.m_AssetID);
+                x.m_Totals.AddCoin(cid, cs.m_Status, false);
+                cs.m_Status = storage::IsOngoingTx(db, cs.m_TxID) ? Coin::Status::Outgoing : Coin::Status::Available;
+                x.m_Totals.AddCoin(cid, cs.m_Status);
+            }
+
+            if (m_ShieldedMaturing.empty())
+                return;
+
+            TxoID nShieldedOuts = db.get_ShieldedOuts();
+
+            for (auto it = m_ShieldedMaturing.begin(); m_ShieldedMaturing.end() != it; )
+            {
+                const ShieldedCoin& c = it->second;
+                if ((h < c.m_confirmHeight) || storage::IsMaxPrivacyLocked(c, h, m_MaxPrivacyLockTimeLimitHours, nShieldedOuts))
+                {
+                    ++it;
+                    continue;
+                }
+
+                ShieldedState& cs = m_ShieldedCoins[it->first];
+                assert(ShieldedCoin::Status::Maturing == cs.m_Status);
+
+                PerAsset& x = get_Asset(cs.m_AssetID);
+                x.m_Totals.AddShieldedCoin(cs.m_Value, cs.m_Status, false);
+                cs.m_Status = storage::IsOngoingTx(db, cs.m_TxID) ? ShieldedCoin::Status::Outgoing : ShieldedCoin::Status::Available;
+                x.m_Totals.AddShieldedCoin(cs.m_Value, cs.m_Status);
+
+                it = m_ShieldedMaturing.erase(it);
+            }
+        }
+
+        void RecalculateMinHeights()
+        {
+            bool bDirty = false, bDirtyShielded = false;
+            for (auto& v : m_Assets)
+            {
+                PerAsset& x = v.second;
+                if (x.m_MinHeightDirty)
+                {
+                    x.m_Totals.MinCoinHeightMW = 0;
+                    bDirty = true;
+                }
+                if (x.m_MinHeightShieldedDirty)
+                {
+                    x.m_Totals.MinCoinHeightShielded = 0;
+                    bDirtyShielded = true;
+                }
+            }
+
+            // rare, only when the oldest coin is removed or changed
+            if (bDirty)
+            {
+                for (const auto& v : m_Coins)
+                {
+                    PerAsset& x = m_Assets[v.first.m_AssetID];
+                    if (x.m_MinHeightDirty)
+                        UpdateMinHeight(x.m_Totals.MinCoinHeightMW, v.second.m_ConfirmHeight);
+                }
+            }
+
+            if (bDirtyShielded)
+            {
+                for (const auto& v : m_ShieldedCoins)
+                {
+                    PerAsset& x = m_Assets[v.second.m_AssetID];
+                    if (x.m_MinHeightShieldedDirty)
+                        UpdateMinHeight(x.m_Totals.MinCoinHeightShielded, v.second.m_ConfirmHeight);
+                }
+            }
+
+            for (auto& v : m_Assets)
+                v.second.m_MinHeightDirty = v.second.m_MinHeightShieldedDirty = false;
+        }
+    };
+
+    // The unspent coins, in the order they're considered by the coin selection. The status is not stored, it's deduced on selection
+    struct WalletDB::CoinIndex
+    {
+        struct CoinCmp
+        {
+            bool operator()(const Coin* a, const Coin* b) const
+            {
+                if (a->m_ID.m_Value != b->m_ID.m_Value)
+                    return a->m_ID.m_Value < b->m_ID.m_Value;
+                if (a->m_maturity != b->m_maturity)
+                    return a->m_maturity < b->m_maturity;
+                return a->m_ID < b->m_ID;
+            }
+        };
+
+        typedef std::set<const Coin*, CoinCmp> CoinSet;
+        typedef std::map<ShieldedTxo::BaseKey, ShieldedCoin, TotalsCache::ShieldedKeyCmp> ShieldedMap;
+
+        std::map<Coin::ID, Coin> m_Coins;
+        std::map<Asset::ID, CoinSet> m_Assets;
+        std::map<Asset::ID, ShieldedMap> m_Shielded;
+
+        static bool IsIndexed(const Coin& c)
+        {
+            // same as the selection criteria in the DB: confirmed and not spent
+            return (MaxHeight != c.m_maturity) && (MaxHeight == c.m_spentHeight);
+        }
+
+        void OnCoin(const Coin& c)
+        {
+            OnCoinRemoved(c.m_ID);
+            if (!IsIndexed(c))
+                return;
+
+            auto it = m_Coins.emplace(c.m_ID, c).first;
+            m_Assets[c.m_ID.m_AssetID].insert(&it->second);
+        }
+
+        void OnCoinRemoved(const Coin::ID& cid)
+        {
+            auto it = m_Coins.find(cid);
+            if (m_Coins.end() == it)
+                return;
+
+            auto itA = m_Assets.find(cid.m_AssetID);
+            assert(m_Assets.end() != itA);
+            itA->second.erase(&it->second);
+            if (itA->second.empty())
+                m_Assets.erase(itA);
+
+            m_Coins.erase(it);
+        }
+
+        void OnShieldedCoin(const ShieldedCoin& c)
+        {
+            OnShieldedCoinRemoved(c.m_CoinID.m_Key);
+            if (MaxHeight == c.m_spentHeight)
+                m_Shielded[c.m_CoinID.m_AssetID][c.m_CoinID.m_Key] = c;
+        }
+
+        void OnShieldedCoinRemoved(const ShieldedTxo::BaseKey& key)
+        {
+            // the asset of the removed coin is not always known, there are very few of them anyway
+            for (auto it = m_Shielded.begin(); m_Shielded.end() != it; ++it)
+            {
+                if (it->second.erase(key))
+                {
+                    if (it->second.empty())
+                        m_Shielded.erase(it);
+                    break;
+                }
+            }
+        }
+
+        const CoinSet* FindCoins(Asset::ID aid) const
+        {
+            auto it = m_Assets.find(aid);
+            return (m_Assets.end() == it) ? nullptr : &it->second;
+        }
+
+        const ShieldedMap* FindShielded(Asset::ID aid) const
+        {
+            auto it = m_Shielded.find(aid);
+            return (m_Shielded.end() == it) ? nullptr : &it->second;
+        }
+    };
+
     WalletDB::WalletDB(sqlite3* db)
         : WalletDB(db, db)
     {
@@ -2519,9 +3105,11 @@ namespace beam::wallet
         : _db(db)
         , m_PrivateDB(sdb)
         , m_IsFlushPending(false)
+        , m_pStatements(std::make_unique<StatementCache>())
         , m_mandatoryTxParams{
             TxParameterID::TransactionType,
             TxParameterID::CreateTime}
+        , m_pTxParameters(std::make_unique<ParameterCache>())
     {
 
     }
@@ -2542,6 +3130,7 @@ namespace beam::wallet
                 }
                 m_DbTransaction.reset();
             }
+            m_pStatements.reset(); // all must be finalized before close
             BEAM_VERIFY(SQLITE_OK == sqlite3_close(_db));
             if (m_PrivateDB && _db != m_PrivateDB)
             {
@@ -2748,9 +3337,6 @@ namespace beam::wallet
                 return true;
             }
 
-            typedef std::map<ECC::Point, ShieldedTxo::BaseKey> ShieldedSpendKeyMap;
-            ShieldedSpendKeyMap m_mapShielded;
-
             virtual bool OnAssetRecognized(Asset::Full&) override
             {
                 // TODO
@@ -2771,28 +3357,20 @@ namespace beam::wallet
 
                 LOG_INFO() << "Shielded output, ID: " << dout.m_ID << " Confirmed, Height=" << dout.m_Height;
 
-                m_mapShielded[pars.m_Ticket.m_SpendPk] = sc.m_CoinID.m_Key;
-
                 storage::restoreTransactionFromShieldedCoin(m_This, sc, m_Gateway);
 
                 return true;
             }
 
-            virtual bool OnShieldedIn(const ShieldedTxo::DescriptionInp& dinp) override
+            virtual bool OnShieldedInRecognized(const ShieldedTxo::DescriptionInp& dinp, const ShieldedTxo::BaseKey& key) override
             {
-                ShieldedSpendKeyMap::iterator it = m_mapShielded.find(dinp.m_SpendPk);
-                if (m_mapShielded.end() != it)
+                auto shieldedCoin = m_This.getShieldedCoin(key);
+                if (shieldedCoin)
                 {
-                    auto shieldedCoin = m_This.getShieldedCoin(it->second);
-                    if (shieldedCoin)
-                    {
-                        shieldedCoin->m_spentHeight = dinp.m_Height;
-                        m_This.saveShieldedCoin(*shieldedCoin);
-
-                        LOG_INFO() << "Shielded input, TxoID: " << shieldedCoin->m_TxoID << " Spent, Height=" << dinp.m_Height;
-                    }
+                    shieldedCoin->m_spentHeight = dinp.m_Height;
+                    m_This.saveShieldedCoin(*shieldedCoin);
 
-                    m_mapShielded.erase(it);
+                    LOG_INFO() << "Shielded input, TxoID: " << shieldedCoin->m_TxoID << " Spent, Height=" << dinp.m_Height;
                 }
 
                 return true;
@@ -2808,8 +3386,11 @@ namespace beam::wallet
         };
 
         get_History().DeleteFrom(Rules::HeightGenesis); // clear all the history
+
+        ExecutorMT_R ex; // recognition threads, must outlive the parser
         MyParser p(*this, gateway, prog);
         p.Init(get_OwnerKdf());
+        p.m_pExecutor = &ex;
 
         if (p.Proceed(path.c_str()))
         {
@@ -2920,22 +3501,23 @@ namespace beam::wallet
         auto& fs = Transaction::FeeSettings::get(h);
         Amount feeShielded = fs.m_ShieldedInputTotal;
 
-        if (nMaxShielded)
-        {
-            visitShieldedCoinsUnspent(
-                [&vShielded, aid, feeShielded](const ShieldedCoin& coin) -> bool
-                {
-                    if ((ShieldedCoin::Status::Available == coin.m_Status) && (coin.m_CoinID.m_AssetID == aid))
-                    {
-                        // skip dust
-                        bool bDust = !aid && (coin.m_CoinID.m_Value <= feeShielded);
-                        if (!bDust)
-                            vShielded.emplace_back().first = coin;
-                    }
-                    return true;
-                }
-            );
-
+        const CoinIndex::ShieldedMap* pShielded = nMaxShielded ? get_CoinIndex().FindShielded(aid) : nullptr;
+        if (pShielded)
+        {
+            Height hTip = getCurrentHeight();
+            for (const auto& v : *pShielded)
+            {
+                // skip dust
+                bool bDust = !aid && (v.second.m_CoinID.m_Value <= feeShielded);
+                if (bDust)
+                    continue;
+
+                ShieldedCoin coin = v.second;
+                storage::DeduceStatus(*this, coin, hTip);
+                if (ShieldedCoin::Status::Available == coin.m_Status)
+                    vShielded.emplace_back().first = std::move(coin);
+            }
+
             if (!vShielded.empty())
             {
                 TxoID nOuts = get_ShieldedOuts();
@@ -3016,29 +3598,56 @@ namespace beam::wallet
         return nSelStd;
     }
 
+    WalletDB::CoinIndex& WalletDB::get_CoinIndex()
+    {
+        if (!m_pCoinIndex)
+        {
+            m_pCoinIndex = std::make_unique<CoinIndex>();
+
+            {
+                sqlite::Statement stm(this, "SELECT " STORAGE_FIELDS " FROM " STORAGE_NAME " WHERE maturity>=0 AND spentHeight<0;");
+                while (stm.step())
+                {
+                    Coin coin;
+                    int colIdx = 0;
+                    ENUM_ALL_STORAGE_FIELDS(STM_GET_LIST, NOSEP, coin);
+                    m_pCoinIndex->OnCoin(coin);
+                }
+            }
+
+            {
+                sqlite::Statement stm(this, "SELECT " SHIELDED_COIN_FIELDS " FROM " SHIELDED_COINS_NAME " WHERE spentHeight<0;");
+                while (stm.step())
+                {
+                    ShieldedCoin coin;
+                    int colIdx = 0;
+                    ENUM_SHIELDED_COIN_FIELDS(STM_GET_LIST, NOSEP, coin);
+                    m_pCoinIndex->OnShieldedCoin(coin);
+                }
+            }
+        }
+
+        return *m_pCoinIndex;
+    }
+
     vector<Coin> WalletDB::selectCoinsEx(Amount amount, Asset::ID assetId, bool bCanReturnLess)
     {
         vector<Coin> coins, coinsSel;
         Block::SystemState::ID stateID = {};
         getSystemStateID(stateID);
 
+        const CoinIndex::CoinSet* pCoins = get_CoinIndex().FindCoins(assetId);
+        if (pCoins)
         {
-            const char* query = "SELECT " STORAGE_FIELDS " FROM " STORAGE_NAME " WHERE maturity>=0 AND maturity<=?1 AND spentHeight<0 ORDER BY amount ASC";
-
-            sqlite::Statement stm(this, query);
-            stm.bind(1, stateID.m_Height);
-
-            while (stm.step())
+            for (const Coin* pCoin : *pCoins)
             {
-                auto& coin = coins.emplace_back();
-                int colIdx = 0;
-                ENUM_ALL_STORAGE_FIELDS(STM_GET_LIST, NOSEP, coin);
+                if (pCoin->m_maturity > stateID.m_Height)
+                    continue;
 
+                auto& coin = coins.emplace_back(*pCoin);
                 storage::DeduceStatus(*this, coin, stateID.m_Height);
                 if (Coin::Status::Available != coin.m_status)
                     coins.pop_back();
-                else if (coin.m_ID.m_AssetID != assetId)
-                    coins.pop_back();
                 else
                 {
                     if (coin.m_ID.m_Value >= amount)
@@ -3813,15 +4422,35 @@ namespace beam::wallet
                        .append(")");
         }
 
+        Timestamp afterTime = 0;
+        if (filter.m_AfterTxID)
+        {
+            sqlite::Statement stm(this, "SELECT CreateTime FROM " TX_SUMMARY_NAME " WHERE TxID=?1;");
+            stm.bind(1, *filter.m_AfterTxID);
+            if (!stm.step())
+                return;
+            stm.get(0, afterTime);
+
+            if (!whereParams.empty())
+                whereParams.append(" AND ");
+            whereParams.append("(CreateTime,TxID)<(?1,?2)");
+        }
+
         if (!whereParams.empty())
         {
             query.append(" WHERE ");
             query.append(whereParams);
         }
         
-        query.append(" ORDER BY CreateTime DESC");
+        query.append(" ORDER BY CreateTime DESC, TxID DESC");
 
         sqlite::Statement stm(this, query.c_str());
+        if (filter.m_AfterTxID)
+        {
+            stm.bind(1, afterTime);
+            stm.bind(2, *filter.m_AfterTxID);
+        }
+
         sqlite::Statement stm2(this, "SELECT * FROM " TX_PARAMS_NAME " WHERE txID=?1;");
         TxID txID;
         while (stm.step())
@@ -3928,6 +4557,9 @@ namespace beam::wallet
             container_type::const_iterator end() const noexcept { return c.end(); }
         } gottenParams;
 
+        // all the tx parameters are read, keep them in the cache (for the subsequent getTxParameter calls, like on tx resume)
+        auto& txCached = m_pTxParameters->InsertTx(txId);
+
         while (stm.step())
         {
             TxParameter parameter = {};
@@ -3935,6 +4567,7 @@ namespace beam::wallet
             ENUM_TX_PARAMS_FIELDS(STM_GET_LIST, NOSEP, parameter);
             auto parameterID = static_cast<TxParameterID>(parameter.m_paramID);
 
+            m_pTxParameters->Insert(txCached, static_cast<SubTxID>(parameter.m_subTxID), parameterID, parameter.m_value);
             txDescription.SetParameter(parameterID, std::move(parameter.m_value), static_cast<SubTxID>(parameter.m_subTxID));
 
             if (parameter.m_subTxID == kDefaultSubTxID)
@@ -3943,6 +4576,9 @@ namespace beam::wallet
             }
         }
 
+        txCached.m_Complete = true;
+        m_pTxParameters->Shrink();
+
         txDescription.fillFromTxParameters(txDescription);
 
         if (std::includes(gottenParams.begin(), gottenParams.end(), m_mandatoryTxParams.begin(), m_mandatoryTxParams.end()))
@@ -3993,6 +4629,7 @@ namespace beam::wallet
 
             stm.step();
             deleteParametersFromCache(txId);
+            OnTxStatusChanged(txId);
             notifyTransactionChanged(ChangeAction::Removed, { *tx });
         }
 
@@ -4097,6 +4734,12 @@ namespace beam::wallet
         sqlite::Statement stm(this, req);
         stm.bind(1, key);
         stm.step();
+
+        if (m_pTotals)
+            m_pTotals->OnShieldedCoinRemoved(key);
+
+        if (m_pCoinIndex)
+            m_pCoinIndex->OnShieldedCoinRemoved(key);
     }
 
     void WalletDB::deleteShieldedCoinsCreatedByTx(const TxID& txId)
@@ -4980,18 +5623,10 @@ namespace beam::wallet
 
     bool WalletDB::setTxParameter(const TxID& txID, SubTxID subTxID, TxParameterID paramID, const ByteBuffer& blob, bool shouldNotifyAboutChanges, bool allowModify /* = true */)
     {
-        if (auto txIter = m_TxParametersCache.find(txID); txIter != m_TxParametersCache.end())
+        const ByteBuffer* pCached = nullptr;
+        if (m_pTxParameters->Find(txID, subTxID, paramID, pCached) && pCached && (blob == *pCached))
         {
-            if (auto subTxIter = txIter->second.find(subTxID); subTxIter != txIter->second.end())
-            {
-                if (auto pit = subTxIter->second.find(paramID); pit != subTxIter->second.end())
-                {
-                    if (pit->second && blob == *(pit->second))
-                    {
-                        return false;
-                    }
-                }
-            }
+            return false;
         }
 
         bool hasTx = hasTransaction(txID);
@@ -5026,6 +5661,8 @@ namespace beam::wallet
 
                 insertParameterToCache(txID, subTxID, paramID, blob);
                 OnTxSummaryParam(txID, subTxID, paramID, &blob);
+                if ((TxParameterID::Status == paramID) && (kDefaultSubTxID == subTxID))
+                    OnTxStatusChanged(txID);
                 return true;
             }
         }
@@ -5050,6 +5687,8 @@ namespace beam::wallet
 
         insertParameterToCache(txID, subTxID, paramID, blob);
         OnTxSummaryParam(txID, subTxID, paramID, &blob);
+        if ((TxParameterID::Status == paramID) && (kDefaultSubTxID == subTxID))
+            OnTxStatusChanged(txID);
         return true;
     }
 
@@ -5142,16 +5781,7 @@ namespace beam::wallet
 
     bool WalletDB::delTxParameter(const TxID& txID, SubTxID subTxID, TxParameterID paramID)
     {
-        if (auto txIter = m_TxParametersCache.find(txID); txIter != m_TxParametersCache.end())
-        {
-            if (auto subTxIter = txIter->second.find(subTxID); subTxIter != txIter->second.end())
-            {
-                if (auto pit = subTxIter->second.find(paramID); pit != subTxIter->second.end())
-                {
-                    subTxIter->second.erase(pit);
-                }
-            }
-        }
+        m_pTxParameters->Erase(txID, subTxID, paramID);
 
         sqlite::Statement stm(this, "DELETE FROM " TX_PARAMS_NAME " WHERE txID=?1 AND subTxID=?2 AND paramID=?3;");
 
@@ -5162,26 +5792,22 @@ namespace beam::wallet
         stm.step();
 
         OnTxSummaryParam(txID, subTxID, paramID, nullptr);
+        if ((TxParameterID::Status == paramID) && (kDefaultSubTxID == subTxID))
+            OnTxStatusChanged(txID);
 
         return true;
     }
 
     bool WalletDB::getTxParameter(const TxID& txID, SubTxID subTxID, TxParameterID paramID, ByteBuffer& blob) const
     {
-        if (auto txIter = m_TxParametersCache.find(txID); txIter != m_TxParametersCache.end())
+        const ByteBuffer* pCached = nullptr;
+        if (m_pTxParameters->Find(txID, subTxID, paramID, pCached))
         {
-            if (auto subTxIter = txIter->second.find(subTxID); subTxIter != txIter->second.end())
-            {
-                if (auto pit = subTxIter->second.find(paramID); pit != subTxIter->second.end())
-                {
-                    if (pit->second)
-                    {
-                        blob = *(pit->second);
-                        return true;
-                    }
-                    return false;
-                }
-            }
+            if (!pCached)
+                return false;
+
+            blob = *pCached;
+            return true;
         }
 
         sqlite::Statement stm(this, "SELECT value FROM " TX_PARAMS_NAME " WHERE txID=?1 AND subTxID=?2 AND paramID=?3;");
@@ -5225,12 +5851,32 @@ namespace beam::wallet
 
     void WalletDB::insertParameterToCache(const TxID& txID, SubTxID subTxID, TxParameterID paramID, const boost::optional<ByteBuffer>& blob) const
     {
-        m_TxParametersCache[txID][subTxID][paramID] = blob;
+        m_pTxParameters->Insert(txID, subTxID, paramID, blob);
     }
 
     void WalletDB::deleteParametersFromCache(const TxID& txID)
     {
-        m_TxParametersCache.erase(txID);
+        m_pTxParameters->Erase(txID);
+    }
+
+    WalletDB::CacheStats WalletDB::get_StatementCacheStats() const
+    {
+        CacheStats res = m_pStatements->m_Stats;
+        res.m_Count = m_pStatements->m_Lru.size();
+        return res;
+    }
+
+    WalletDB::CacheStats WalletDB::get_ParameterCacheStats() const
+    {
+        CacheStats res = m_pTxParameters->m_Stats;
+        res.m_Count = m_pTxParameters->m_Count;
+        return res;
+    }
+
+    void WalletDB::set_ParameterCacheMax(size_t n)
+    {
+        m_pTxParameters->m_Max = n;
+        m_pTxParameters->Shrink();
     }
 
     bool WalletDB::hasTransaction(const TxID& txID) const
@@ -5270,6 +5916,11 @@ namespace beam::wallet
             m_DbTransaction->rollback();
             m_DbTransaction.reset();
         }
+
+        // may be inconsistent with the DB now
+        m_pTotals.reset();
+        m_pCoinIndex.reset();
+        m_pTxParameters->Clear();
     }
 
     void WalletDB::onModified()
@@ -5316,8 +5967,131 @@ namespace beam::wallet
         }
     }
 
+    bool WalletDB::fillTotals(storage::Totals& totals)
+    {
+        Height h = getCurrentHeight();
+        uint8_t nLockLimit = get_MaxPrivacyLockTimeLimitHours();
+
+        // After the rollback the coins may become immature again
+        if (m_pTotals && ((h < m_pTotals->m_hTip) || (nLockLimit != m_pTotals->m_MaxPrivacyLockTimeLimitHours)))
+            m_pTotals.reset();
+
+        if (!m_pTotals)
+        {
+            m_pTotals = std::make_unique<TotalsCache>();
+            m_pTotals->m_hTip = h;
+            m_pTotals->m_MaxPrivacyLockTimeLimitHours = nLockLimit;
+
+            visitCoins([this](const Coin& c) -> bool
+            {
+                m_pTotals->OnCoin(c);
+                return true;
+            });
+
+            visitShieldedCoins([this](const ShieldedCoin& c) -> bool
+            {
+                m_pTotals->OnShieldedCoin(c);
+                return true;
+            });
+        }
+        else
+        {
+            if (h > m_pTotals->m_hTip)
+                m_pTotals->OnNewTip(*this, h);
+        }
+
+        m_pTotals->RecalculateMinHeights();
+
+        for (const auto& v : m_pTotals->m_Assets)
+        {
+            const TotalsCache::PerAsset& x = v.second;
+            if (x.m_Coins || x.m_ShieldedCoins)
+                totals.GetTotalsRef(v.first) = x.m_Totals;
+        }
+
+        return true;
+    }
+
+    void WalletDB::OnTxStatusChanged(const TxID& txID)
+    {
+        if (!m_pTotals)
+            return;
+
+        // re-read the coins whose status depends on this tx
+        std::vector<Coin::ID> vCoins;
+        for (auto its = m_pTotals->m_CoinsByTx.equal_range(txID); its.first != its.second; ++its.first)
+            vCoins.push_back(its.first->second);
+
+        for (const auto& cid : vCoins)
+        {
+            Coin c;
+            c.m_ID = cid;
+            if (findCoin(c))
+                m_pTotals->OnCoin(c);
+            else
+                m_pTotals->OnCoinRemoved(cid);
+        }
+
+        std::vector<ShieldedTxo::BaseKey> vShielded;
+        for (auto its = m_pTotals->m_ShieldedByTx.equal_range(txID); its.first != its.second; ++its.first)
+            vShielded.push_back(its.first->second);
+
+        for (const auto& key : vShielded)
+        {
+            auto c = getShieldedCoin(key);
+            if (c)
+                m_pTotals->OnShieldedCoin(*c);
+            else
+                m_pTotals->OnShieldedCoinRemoved(key);
+        }
+    }
+
     void WalletDB::notifyCoinsChanged(ChangeAction action, const vector<Coin>& items)
     {
+        if (m_pTotals)
+        {
+            switch (action)
+            {
+            case ChangeAction::Added:
+            case ChangeAction::Updated:
+                for (const auto& c : items)
+                {
+                    Coin c2 = c; // the status (and the confirmations offset) may be not deduced or outdated
+                    storage::DeduceStatus(*this, c2, m_pTotals->m_hTip);
+                    m_pTotals->OnCoin(c2);
+                }
+                break;
+
+            case ChangeAction::Removed:
+                for (const auto& c : items)
+                    m_pTotals->OnCoinRemoved(c.m_ID);
+                break;
+
+            default:
+                m_pTotals.reset();
+            }
+        }
+
+        if (m_pCoinIndex)
+        {
+            switch (action)
+            {
+            case ChangeAction::Added:
+            case ChangeAction::Updated:
+                for (const auto& c : items)
+                    m_pCoinIndex->OnCoin(c);
+                break;
+
+            case ChangeAction::Removed:
+                for (const auto& c : items)
+                    m_pCoinIndex->OnCoinRemoved(c.m_ID);
+                break;
+
+            default:
+                m_pCoinIndex.reset();
+            }
+        }
+
         if (items.empty() && action != ChangeAction::Reset)
             return;
 
@@ -5361,6 +6135,46 @@ namespace beam::wallet
 
     void WalletDB::notifyShieldedCoinsChanged(ChangeAction action, const std::vector<ShieldedCoin>& items)
     {
+        if (m_pTotals)
+        {
+            switch (action)
+            {
+            case ChangeAction::Added:
+            case ChangeAction::Updated:
+                for (const auto& c : items)
+                    m_pTotals->OnShieldedCoin(c);
+                break;
+
+            case ChangeAction::Removed:
+                for (const auto& c : items)
+                    m_pTotals->OnShieldedCoinRemoved(c.m_CoinID.m_Key);
+                break;
+
+            default:
+                m_pTotals.reset();
+            }
+        }
+
+        if (m_pCoinIndex)
+        {
+            switch (action)
+            {
+            case ChangeAction::Added:
+            case ChangeAction::Updated:
+                for (const auto& c : items)
+                    m_pCoinIndex->OnShieldedCoin(c);
+                break;
+
+            case ChangeAction::Removed:
+                for (const auto& c : items)
+                    m_pCoinIndex->OnShieldedCoinRemoved(c.m_CoinID.m_Key);
+                break;
+
+            default:
+                m_pCoinIndex.reset();
+            }
+        }
+
         if (items.empty() && action != ChangeAction::Reset)
             return;
 
@@ -5614,119 +6428,145 @@ namespace beam::wallet
             Init(db, nzOnly);
         }
 
-        void Totals::Init(IWalletDB& walletDB, bool nzOnly)
+        void Totals::AssetTotals::AddCoin(const Coin::ID& cid, Coin::Status status, bool bAdd)
         {
-            auto getTotalsRef = [this](Asset::ID assetId) -> AssetTotals& {
-                if (allTotals.find(assetId) == allTotals.end()) {
-                    allTotals[assetId] = AssetTotals();
-                    allTotals[assetId].AssetId = assetId;
-                }
-                return allTotals[assetId];
-            };
+            AmountBig::Type value = cid.m_Value;
+            if (!bAdd)
+                value.Negate();
 
-            walletDB.visitCoins([getTotalsRef] (const Coin& c) -> bool
+            switch (status)
             {
-                auto& totals = getTotalsRef(c.m_ID.m_AssetID);
-                totals.MinCoinHeightMW = totals.MinCoinHeightMW == 0 ? c.m_confirmHeight :
-                                         std::min(c.m_confirmHeight, totals.MinCoinHeightMW);
-
-                const AmountBig::Type value = c.m_ID.m_Value;
-                switch (c.m_status)
+            case Coin::Status::Available:
+                Avail   += value;
+                Unspent += value;
+                switch (cid.m_Type)
                 {
-                case Coin::Status::Available:
-                    totals.Avail   += value;
-                    totals.Unspent += value;
-                    switch (c.m_ID.m_Type)
-                    {
-                    case Key::Type::Coinbase:
-                        assert(!c.isAsset());
-                        totals.AvailCoinbase += value;
-                        break;
-                    case Key::Type::Comission:
-                        assert(!c.isAsset());
-                        totals.AvailFee += value;
-                        break;
-                    default: // suppress warning
-                        break;
-                    }
-                    break;
-
-                case Coin::Status::Maturing:
-                    totals.Maturing += value;
-                    totals.Unspent += value;
-                    break;
-
-                case Coin::Status::Incoming:
-                    totals.Incoming += value;
-                    if (c.m_ID.m_Type == Key::Type::Change)
-                    {
-                        totals.ReceivingChange += value;
-                    }
-                    else
-                    {
-                        totals.ReceivingIncoming += value;
-                    }
-                    break;
-
-                case Coin::Status::Outgoing:
-                    totals.Outgoing += value;
+                case Key::Type::Coinbase:
+                    assert(!cid.m_AssetID);
+                    AvailCoinbase += value;
                     break;
-
-                case Coin::Status::Unavailable:
-                    totals.Unavail += value;
+                case Key::Type::Comission:
+                    assert(!cid.m_AssetID);
+                    AvailFee += value;
                     break;
-
                 default: // suppress warning
                     break;
                 }
+                break;
+
+            case Coin::Status::Maturing:
+                Maturing += value;
+                Unspent += value;
+                break;
 
-                switch (c.m_ID.m_Type)
+            case Coin::Status::Incoming:
+                Incoming += value;
+                if (cid.m_Type == Key::Type::Change)
                 {
-                case Key::Type::Coinbase:
-                    assert(!c.isAsset());
-                    totals.Coinbase += value;
+                    ReceivingChange += value;
+                }
+                else
+                {
+                    ReceivingIncoming += value;
+                }
+                break;
+
+            case Coin::Status::Outgoing:
+                Outgoing += value;
+                break;
+
+            case Coin::Status::Unavailable:
+                Unavail += value;
+                break;
+
+            default: // suppress warning
+                break;
+            }
+
+            switch (cid.m_Type)
+            {
+            case Key::Type::Coinbase:
+                assert(!cid.m_AssetID);
+                Coinbase += value;
+                break;
+            case Key::Type::Comission:
+                assert(!cid.m_AssetID);
+                Fee += value;
+                break;
+            default: // suppress warning
+                break;
+            }
+        }
+
+        void Totals::AssetTotals::AddShieldedCoin(Amount val, ShieldedCoin::Status status, bool bAdd)
+        {
+            AmountBig::Type value = val;
+            if (!bAdd)
+                value.Negate();
+
+            switch(status) {
+                case ShieldedCoin::Status::Available:
+                    AvailShielded += value;
+                    UnspentShielded += value;
                     break;
-                case Key::Type::Comission:
-                    assert(!c.isAsset());
-                    totals.Fee += value;
+                case ShieldedCoin::Status::Maturing:
+                    MaturingShielded += value;
+                    UnspentShielded += value;
                     break;
-                default: // suppress warning
+                case ShieldedCoin::Status::Unavailable:
+                    UnavailShielded += value;
                     break;
-                }
+                case ShieldedCoin::Status::Outgoing:
+                    OutgoingShielded += value;
+                    break;
+                case ShieldedCoin::Status::Incoming:
+                    IncomingShielded += value;
+                    break;
+                case ShieldedCoin::Status::Spent:
+                case ShieldedCoin::Status::Consumed:
+                    break; // this is not necessary
+                default:
+                    assert(false); // should never happen
+            }
+        }
+
+        Totals::AssetTotals& Totals::GetTotalsRef(Asset::ID assetId)
+        {
+            auto it = allTotals.find(assetId);
+            if (allTotals.end() != it)
+                return it->second;
+
+            AssetTotals& totals = allTotals[assetId];
+            totals.AssetId = assetId;
+            return totals;
+        }
+
+        void Totals::Scan(IWalletDB& walletDB)
+        {
+            walletDB.visitCoins([this] (const Coin& c) -> bool
+            {
+                auto& totals = GetTotalsRef(c.m_ID.m_AssetID);
+                totals.MinCoinHeightMW = totals.MinCoinHeightMW == 0 ? c.m_confirmHeight :
+                                         std::min(c.m_confirmHeight, totals.MinCoinHeightMW);
+
+                totals.AddCoin(c.m_ID, c.m_status);
                 return true;
             });
 
-            walletDB.visitShieldedCoins([getTotalsRef](const ShieldedCoin& c) -> bool {
-                auto& totals = getTotalsRef(c.m_CoinID.m_AssetID);
+            walletDB.visitShieldedCoins([this](const ShieldedCoin& c) -> bool {
+                auto& totals = GetTotalsRef(c.m_CoinID.m_AssetID);
                 totals.MinCoinHeightShielded = totals.MinCoinHeightShielded == 0 ? c.m_confirmHeight :
                                                std::min(c.m_confirmHeight, totals.MinCoinHeightShielded);
 
-                const AmountBig::Type value = c.m_CoinID.m_Value;
-                switch(c.m_Status) {
-                    case ShieldedCoin::Status::Available:
-                        totals.AvailShielded += value;
-                        totals.UnspentShielded += value;
-                        break;
-                    case ShieldedCoin::Status::Maturing:
-                        totals.MaturingShielded += value;
-                        totals.UnspentShielded += value;
-                        break;
-                    case ShieldedCoin::Status::Unavailable:
-                        totals.UnavailShielded += value;
-                        break;
-                    case ShieldedCoin::Status::Outgoing:
-                        totals.OutgoingShielded += value;
-                        break;
-                    case ShieldedCoin::Status::Incoming:
-                        totals.IncomingShielded += value;
-                        break;
-                    case ShieldedCoin::Status::Spent:
-                        break; // this is not necessary
-                    default:
-                        assert(false); // should never happen
-                }
+                totals.AddShieldedCoin(c.m_CoinID.m_Value, c.m_Status);
                 return true;
             });
+        }
+
+        void Totals::Init(IWalletDB& walletDB, bool nzOnly)
+        {
+            if (!walletDB.fillTotals(*this))
+                Scan(walletDB);
 
              walletDB.visitAssets([this](const WalletAsset& asset) -> bool {
                 // we also add owned assets to totals even if there are no coins for owned assets
@@ -5889,21 +6729,11 @@ namespace beam::wallet
             if (c.m_confirmHeight != MaxHeight)
             {
                 const auto* packedMessage = ShieldedTxo::User::ToPackedMessage(c.m_CoinID.m_User);
-                uint32_t mpAnonymitySet = packedMessage->m_MaxPrivacyMinAnonymitySet;
-                if (mpAnonymitySet)
+                if (packedMessage->m_MaxPrivacyMinAnonymitySet &&
+                    IsMaxPrivacyLocked(c, hTop, walletDB.get_MaxPrivacyLockTimeLimitHours(), walletDB.get_ShieldedOuts()))
                 {
-                    Height timeLimit = walletDB.get_MaxPrivacyLockTimeLimitHours();
-
-                    if (!timeLimit || c.m_confirmHeight + timeLimit * 60 > hTop)
-                    {
-                        ShieldedCoin::UnlinkStatus unlinkStatus;
-                        unlinkStatus.Init(c, walletDB.get_ShieldedOuts());
-                        if (unlinkStatus.m_Progress < 100 * mpAnonymitySet / beam::MaxPrivacyAnonimitySetFractionsCount)
-                        {
-                            c.m_Status = ShieldedCoin::Status::Maturing;
-                            return;
-                        }
-                    }
+                    c.m_Status = ShieldedCoin::Status::Maturing;
+                    return;
                 }
 
                 if (hTop < c.m_confirmHeight)
@@ -5931,11 +6761,33 @@ namespace beam::wallet
             c.m_Status = ShieldedCoin::Status::Unavailable;
         }
 
+        bool IsMaxPrivacyLocked(const ShieldedCoin& c, Height hTop, uint8_t nLockLimitHours, TxoID nShieldedOuts)
+        {
+            const auto* packedMessage = ShieldedTxo::User::ToPackedMessage(c.m_CoinID.m_User);
+            uint32_t mpAnonymitySet = packedMessage->m_MaxPrivacyMinAnonymitySet;
+            if (!mpAnonymitySet)
+                return false;
+
+            Height timeLimit = nLockLimitHours;
+            if (timeLimit && (c.m_confirmHeight + timeLimit * 60 <= hTop))
+                return false;
+
+            ShieldedCoin::UnlinkStatus unlinkStatus;
+            unlinkStatus.Init(c, nShieldedOuts);
+            return (unlinkStatus.m_Progress < 100 * mpAnonymitySet / beam::MaxPrivacyAnonimitySetFractionsCount);
+        }
+
         Height DeduceTxProofHeight(const IWalletDB& walletDB, const TxDescription &tx)
         {
             return DeduceTxProofHeightImpl(walletDB, tx.m_txId, tx.m_txType);
         }
 
+        Height DeduceTxProofHeight(const TxDescription &tx)
+        {
+            auto paramID = (tx.m_txType == TxType::AssetInfo) ? TxParameterID::AssetConfirmedHeight : TxParameterID::KernelProofHeight;
+            return tx.GetParameter<Height>(paramID).value_or(0);
+        }
+
         Height DeduceTxDisplayHeight(const IWalletDB& walletDB, const TxDescription &tx)
         {
             auto height = DeduceTxProofHeight(walletDB, tx);
@@ -251,6 +251,10 @@ namespace beam::wallet
 #define MACRO(id, type) boost::optional<type> m_##id;
         BEAM_TX_LIST_FILTER_MAP(MACRO)
 #undef MACRO
+
+        // Keyset pagination: only the txs listed after this one (the txs are listed by CreateTime, then TxID, descending).
+        // If the tx doesn't exist - nothing is listed
+        boost::optional<TxID> m_AfterTxID;
     };
 
     struct IWalletDB;
@@ -416,6 +420,11 @@ namespace beam::wallet
         virtual void onAssetChanged(ChangeAction action, Asset::ID assetID) {}
     };
 
+    namespace storage
+    {
+        struct Totals;
+    }
+
     struct IWalletDB : IVariablesDB
     {
         using Ptr = std::shared_ptr<IWalletDB>;
@@ -501,6 +510,9 @@ namespace beam::wallet
         // Returns currently known blockchain height
         virtual Height getCurrentHeight() const = 0;
 
+        // Coin totals per asset. Returns false if not supported, then the totals are calculated by visiting all the coins
+        virtual bool fillTotals(storage::Totals&) { return false; }
+
         // Rollback UTXO set to known height (used in rollback scenario)
         virtual void rollbackConfirmedUtxo(Height minHeight) = 0;
         virtual void rollbackAssets(Height minHeight) = 0;
@@ -658,6 +670,7 @@ namespace beam::wallet
         void saveCoins(const std::vector<Coin>& coins) override;
         void removeCoins(const std::vector<Coin::ID>&) override;
         bool findCoin(Coin& coin) override;
+        bool fillTotals(storage::Totals&) override;
         void clearCoins() override;
         void setCoinConfirmationsOffset(uint32_t offset) override;
         uint32_t getCoinConfirmationsOffset() const override;
@@ -767,6 +780,17 @@ namespace beam::wallet
         void visitEvents(Height min, const Blob& key, std::function<bool(Height, ByteBuffer&&)>&& func) const override;
         void visitEvents(Height min, std::function<bool(Height, ByteBuffer&&)>&& func) const override;
 
+        struct CacheStats
+        {
+            uint64_t m_Hits = 0;
+            uint64_t m_Misses = 0;
+            size_t m_Count = 0; // currently cached items (statements or tx parameters)
+        };
+
+        CacheStats get_StatementCacheStats() const;
+        CacheStats get_ParameterCacheStats() const;
+        void set_ParameterCacheMax(size_t); // max number of cached tx parameters, whole txs are evicted (least recently used first)
+
     private:
         static std::shared_ptr<WalletDB> initBase(const std::string& path, const SecString& password, bool separateDBForPrivateData);
 
@@ -796,11 +820,11 @@ namespace beam::wallet
         void saveShieldedCoinRaw(const ShieldedCoin& coin);
 
         Amount selectCoinsStd(Amount nTrg, Amount nSel, Asset::ID, std::vector<Coin>&);
+        struct CoinIndex;
+        CoinIndex& get_CoinIndex();
 
         // ////////////////////////////////////////
         // Cache for optimized access for database fields
-        using ParameterCache = std::map<TxID, std::map<SubTxID, std::map<TxParameterID, boost::optional<ByteBuffer>>>>;
-
         void insertParameterToCache(const TxID& txID, SubTxID subTxID, TxParameterID paramID, const boost::optional<ByteBuffer>& blob) const;
         void deleteParametersFromCache(const TxID& txID);
         bool hasTransaction(const TxID& txID) const;
@@ -842,6 +866,18 @@ namespace beam::wallet
         io::Timer::Ptr m_FlushTimer;
         bool m_IsFlushPending;
         std::unique_ptr<sqlite::Transaction> m_DbTransaction;
+
+        // Prepared statements, reused by the SQL text (per connection). Bounded, least recently used are finalized
+        struct StatementCache;
+        std::unique_ptr<StatementCache> m_pStatements;
+
+        // Coin totals, maintained incrementally. Built on the first request, reset if can't be updated
+        struct TotalsCache;
+        std::unique_ptr<TotalsCache> m_pTotals;
+        void OnTxStatusChanged(const TxID&);
+
+        // Unspent coins of each asset, ordered for the coin selection. Built on the first request, reset if can't be updated
+        std::unique_ptr<CoinIndex> m_pCoinIndex;
         std::vector<IWalletDbObserver*> m_subscribers;
         const std::set<TxParameterID> m_mandatoryTxParams;
 
@@ -857,7 +893,9 @@ namespace beam::wallet
             IMPLEMENT_GET_PARENT_OBJ(WalletDB, m_History)
         } m_History;
         
-        mutable ParameterCache m_TxParametersCache;
+        // Tx parameters (including missing ones), bounded, grouped by tx
+        struct ParameterCache;
+        std::unique_ptr<ParameterCache> m_pTxParameters;
 
         struct LocalKeyKeeper;
         LocalKeyKeeper* m_pLocalKeyKeeper = nullptr;
@@ -947,12 +985,15 @@ namespace beam::wallet
         bool setTxParameter(IWalletDB& db, const TxID& txID, TxParameterID paramID, const ByteBuffer& value, bool shouldNotifyAboutChanges);
 
         Height DeduceTxProofHeight(const IWalletDB& walletDB, const TxDescription &tx);
+        Height DeduceTxProofHeight(const TxDescription &tx); // from the parameters loaded with the tx (as by visitTx), no DB lookups
         Height DeduceTxDisplayHeight(const IWalletDB& walletDB, const TxDescription &tx);
 
         bool changeAddressExpiration(IWalletDB& walletDB, const WalletID& walletID, WalletAddress::ExpirationStatus status);
 
         void DeduceStatus(const IWalletDB&, Coin&, Height hTop);
         void DeduceStatus(const IWalletDB&, ShieldedCoin&, Height hTop);
+        bool IsOngoingTx(const IWalletDB&, const boost::optional<TxID>&);
+        bool IsMaxPrivacyLocked(const ShieldedCoin&, Height hTop, uint8_t nLockLimitHours, TxoID nShieldedOuts); // not unlinked enough to be spent
 
         bool isTreasuryHandled(const IWalletDB&);
         void setTreasuryHandled(IWalletDB&, bool value);
@@ -988,14 +1029,20 @@ namespace beam::wallet
                 Height MinCoinHeightMW = 0;
                 Height MinCoinHeightShielded = 0;
                 bool IsNZ() const;
+
+                // add or subtract the coin value, according to its status and type
+                void AddCoin(const Coin::ID&, Coin::Status, bool bAdd = true);
+                void AddShieldedCoin(Amount, ShieldedCoin::Status, bool bAdd = true);
             };
 
             Totals();
             Totals(IWalletDB& db, bool nzOnly);
             void Init(IWalletDB&, bool nzOnly);
+            void Scan(IWalletDB&); // visits all the coins
 
             bool HasTotals(Asset::ID) const;
             AssetTotals GetTotals(Asset::ID) const;
+            AssetTotals& GetTotalsRef(Asset::ID); // creates if not exists
 
             const std::set<Asset::ID>& GetAssetsNZ() const;
             const std::map<Asset::ID, AssetTotals>& GetAllTotals() const;
@@ -754,6 +754,34 @@ namespace
 
                 WALLET_CHECK(data.skip == 10);
                 WALLET_CHECK(data.count == 10);
+                WALLET_CHECK(!data.after);
+            }
+
+            ApiTest(): WalletApiTest(NoFork, ApiInitData()) {}
+        };
+
+        ApiTest api;
+        WALLET_CHECK(ApiSyncMode::DoneSync == api.executeAPIRequest(msg.data(), msg.size()));
+    }
+
+    void testTxListKeysetJsonRpc(const std::string& msg)
+    {
+        class ApiTest : public WalletApiTest
+        {
+        public:
+            void onAPIError(const json& msg) override
+            {
+                WALLET_CHECK(!"invalid list api json!!!");
+                cout << msg["error"] << endl;
+            }
+
+            void onHandleTxList(const JsonRpcId& id, const TxList& data) override
+            {
+                WALLET_CHECK(id > 0);
+
+                WALLET_CHECK(data.count == 10);
+                WALLET_CHECK(data.skip == 0);
+                WALLET_CHECK(data.after && to_hex(data.after->data(), data.after->size()) == "10c4b760c842433cb58339a0fafef3db");
             }
 
             ApiTest(): WalletApiTest(NoFork, ApiInitData()) {}
@@ -2089,6 +2117,18 @@ int main()
         }
     }));
 
+    testTxListKeysetJsonRpc(JSON_CODE(
+    {
+        "jsonrpc": "2.0",
+        "id" : 12345,
+        "method" : "tx_list",
+        "params" :
+        {
+            "after" : "10c4b760c842433cb58339a0fafef3db",
+            "count" : 10
+        }
+    }));
+
     testValidateAddressJsonRpc(JSON_CODE(
     {
         "jsonrpc": "2.0",
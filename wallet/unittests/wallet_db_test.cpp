@@ -1684,6 +1684,563 @@ void TestShieldedStatus2()
 
 }
 
+bool IsSameTotals(const storage::Totals& t0, const storage::Totals& t1)
+{
+    const auto& m0 = t0.GetAllTotals();
+    const auto& m1 = t1.GetAllTotals();
+    if (m0.size() != m1.size())
+        return false;
+
+    for (auto it0 = m0.begin(), it1 = m1.begin(); it0 != m0.end(); ++it0, ++it1)
+    {
+        const auto& a = it0->second;
+        const auto& b = it1->second;
+        if ((it0->first != it1->first) ||
+            (a.AssetId != b.AssetId) ||
+            (a.Avail != b.Avail) ||
+            (a.Maturing != b.Maturing) ||
+            (a.Incoming != b.Incoming) ||
+            (a.ReceivingIncoming != b.ReceivingIncoming) ||
+            (a.ReceivingChange != b.ReceivingChange) ||
+            (a.Unavail != b.Unavail) ||
+            (a.Outgoing != b.Outgoing) ||
+            (a.AvailCoinbase != b.AvailCoinbase) ||
+            (a.Coinbase != b.Coinbase) ||
+            (a.AvailFee != b.AvailFee) ||
+            (a.Fee != b.Fee) ||
+            (a.Unspent != b.Unspent) ||
+            (a.AvailShielded != b.AvailShielded) ||
+            (a.UnspentShielded != b.UnspentShielded) ||
+            (a.MaturingShielded != b.MaturingShielded) ||
+            (a.UnavailShielded != b.UnavailShielded) ||
+            (a.OutgoingShielded != b.OutgoingShielded) ||
+            (a.IncomingShielded != b.IncomingShielded) ||
+            (a.MinCoinHeightMW != b.MinCoinHeightMW) ||
+            (a.MinCoinHeightShielded != b.MinCoinHeightShielded))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CheckTotals(IWalletDB& db)
+{
+    storage::Totals t0, t1;
+    t0.Scan(db);
+    WALLET_CHECK(db.fillTotals(t1));
+    WALLET_CHECK(IsSameTotals(t0, t1));
+}
+
+void TestTotals()
+{
+    cout << "\nWallet database totals test\n";
+    auto db = createSqliteWalletDB();
+    CheckTotals(*db);
+
+    Block::SystemState::ID id = {};
+    id.m_Height = 134;
+
+    vector<Coin> coins = {
+        CreateAvailCoin(5),
+        CreateCoin(7, 140, 130), // maturing
+        CreateCoin(3), // unavailable
+        CreateCoin(11, 20, 15, 100), // spent
+        CreateAvailCoin(23, 12),
+    };
+    {
+        Coin c(13, Key::Type::Regular, 5);
+        c.m_maturity = c.m_confirmHeight = 10;
+        coins.push_back(c);
+    }
+    {
+        Coin c(17, Key::Type::Coinbase);
+        c.m_maturity = 200;
+        c.m_confirmHeight = 100;
+        coins.push_back(c);
+    }
+
+    db->storeCoins(coins);
+    CheckTotals(*db);
+
+    // spent and created by an ongoing tx
+    TxID txID = { {4, 2} };
+    storage::setTxParameter(*db, txID, TxParameterID::Status, TxStatus::InProgress, false);
+
+    coins[0].m_spentTxId = txID;
+    db->saveCoin(coins[0]);
+    CheckTotals(*db);
+
+    Coin cIn = CreateCoin(19);
+    cIn.m_ID.m_Type = Key::Type::Change;
+    cIn.m_createTxId = txID;
+    db->storeCoin(cIn);
+    CheckTotals(*db);
+
+    // the tx status changes, the coins are not updated
+    storage::setTxParameter(*db, txID, TxParameterID::Status, TxStatus::Failed, false);
+    CheckTotals(*db);
+
+    storage::setTxParameter(*db, txID, TxParameterID::Status, TxStatus::Registering, false);
+    CheckTotals(*db);
+
+    storage::setTxParameter(*db, txID, TxParameterID::Status, TxStatus::Failed, false);
+    CheckTotals(*db);
+
+    // maturing coins become available
+    id.m_Height = 250;
+    db->setSystemStateID(id);
+    CheckTotals(*db);
+
+    db->rollbackConfirmedUtxo(120);
+    CheckTotals(*db);
+
+    id.m_Height = 120;
+    db->setSystemStateID(id);
+    CheckTotals(*db);
+
+    // the oldest coin is removed
+    db->removeCoins({ coins[4].m_ID });
+    CheckTotals(*db);
+
+    // all the coins of the asset are removed
+    db->removeCoins({ coins[5].m_ID });
+    CheckTotals(*db);
+    {
+        storage::Totals t;
+        WALLET_CHECK(db->fillTotals(t));
+        WALLET_CHECK(!t.HasTotals(5));
+    }
+
+    // shielded
+    ShieldedTxo::DataParams params;
+    params.m_Output.m_Value = 340;
+    params.m_Output.m_AssetID = 0;
+
+    ShieldedCoin sc;
+    sc.m_TxoID = 2;
+    sc.m_CoinID.m_Key.m_nIdx = 0;
+    sc.m_confirmHeight = 2;
+    params.ToID(sc.m_CoinID);
+    db->saveShieldedCoin(sc);
+    CheckTotals(*db);
+
+    sc.m_spentTxId = txID;
+    db->saveShieldedCoin(sc);
+    CheckTotals(*db);
+
+    db->DeleteShieldedCoin(sc.m_CoinID.m_Key);
+    CheckTotals(*db);
+
+    db->clearCoins();
+    CheckTotals(*db);
+}
+
+void TestTotalsPerf()
+{
+    cout << "\nWallet database totals performance test\n";
+    auto db = createSqliteWalletDB();
+
+    const uint32_t nCoins = 500000;
+
+    helpers::StopWatch sw;
+    sw.start();
+    {
+        vector<Coin> coins;
+        coins.reserve(nCoins);
+        for (uint32_t i = 0; i < nCoins; i++)
+        {
+            Coin c = (i % 100) ?
+                CreateAvailCoin(1000 + i, 10 + i % 100) :
+                CreateCoin(1000 + i, 300 + i % 1000, 130); // maturing
+            coins.push_back(c);
+        }
+        db->storeCoins(coins);
+    }
+    sw.stop();
+    cout << "Stored " << nCoins << " coins: " << sw.milliseconds() << " ms\n";
+
+    storage::Totals t0;
+    sw.start();
+    t0.Scan(*db);
+    sw.stop();
+    cout << "Totals, full scan: " << sw.milliseconds() << " ms\n";
+
+    storage::Totals t1;
+    sw.start();
+    WALLET_CHECK(db->fillTotals(t1));
+    sw.stop();
+    cout << "Totals, initial: " << sw.milliseconds() << " ms\n";
+    WALLET_CHECK(IsSameTotals(t0, t1));
+
+    // new tip
+    Block::SystemState::ID id = {};
+    id.m_Height = 700;
+    db->setSystemStateID(id);
+
+    storage::Totals t2;
+    sw.start();
+    WALLET_CHECK(db->fillTotals(t2));
+    sw.stop();
+    cout << "Totals, incremental: " << sw.milliseconds() << " ms\n";
+
+    storage::Totals t3;
+    t3.Scan(*db);
+    WALLET_CHECK(IsSameTotals(t2, t3));
+    WALLET_CHECK(t2.GetBeamTotals().Maturing != t1.GetBeamTotals().Maturing);
+}
+
+vector<Coin> SelectCoinsQuiet(IWalletDB& db, Amount amount, Asset::ID aid = 0)
+{
+    vector<Coin> coins;
+    vector<ShieldedCoin> shieldedCoins;
+    db.selectCoins2(0, amount, aid, coins, shieldedCoins, 0, false);
+    return coins;
+}
+
+void TestCoinIndex()
+{
+    cout << "\nWallet database coin selection index test\n";
+    auto db = createSqliteWalletDB();
+
+    vector<Coin> coins = {
+        CreateAvailCoin(5),
+        CreateAvailCoin(7),
+        CreateCoin(9, 140, 130), // maturing
+        CreateAvailCoin(12, 20),
+    };
+    db->storeCoins(coins);
+
+    auto sel = SelectCoinsQuiet(*db, 9); // builds the index
+    WALLET_CHECK(sel.size() == 1 && sel[0].m_ID.m_Value == 12);
+
+    // spent
+    coins[3].m_spentHeight = 120;
+    db->saveCoin(coins[3]);
+    sel = SelectCoinsQuiet(*db, 9);
+    WALLET_CHECK(sel.size() == 2);
+
+    // new coin
+    Coin c = CreateAvailCoin(10, 30);
+    db->storeCoin(c);
+    sel = SelectCoinsQuiet(*db, 9);
+    WALLET_CHECK(sel.size() == 1 && sel[0].m_ID.m_Value == 10);
+
+    // another asset
+    Coin cAsset = CreateAvailCoin(9);
+    cAsset.m_ID.m_AssetID = 3;
+    db->storeCoin(cAsset);
+    sel = SelectCoinsQuiet(*db, 9);
+    WALLET_CHECK(sel.size() == 1 && sel[0].m_ID.m_Value == 10);
+    sel = SelectCoinsQuiet(*db, 9, 3);
+    WALLET_CHECK(sel.size() == 1 && sel[0].m_ID == cAsset.m_ID);
+
+    db->removeCoins({ c.m_ID });
+    sel = SelectCoinsQuiet(*db, 9);
+    WALLET_CHECK(sel.size() == 2);
+
+    // the maturing coin becomes available
+    Block::SystemState::ID id = {};
+    id.m_Height = 150;
+    db->setSystemStateID(id);
+    sel = SelectCoinsQuiet(*db, 9);
+    WALLET_CHECK(sel.size() == 1 && sel[0].m_ID == coins[2].m_ID);
+
+    // rollback: the spent coin is back, the maturing coin is unconfirmed now
+    db->rollbackConfirmedUtxo(100);
+    sel = SelectCoinsQuiet(*db, 9);
+    WALLET_CHECK(sel.size() == 1 && sel[0].m_ID == coins[3].m_ID);
+    sel = SelectCoinsQuiet(*db, 25);
+    WALLET_CHECK(sel.empty());
+
+    db->clearCoins();
+    sel = SelectCoinsQuiet(*db, 1);
+    WALLET_CHECK(sel.empty());
+
+    // shielded
+    ShieldedTxo::DataParams params;
+    params.m_Output.m_Value = 50000000;
+    params.m_Output.m_AssetID = 0;
+
+    ShieldedCoin sc;
+    sc.m_TxoID = 2;
+    sc.m_CoinID.m_Key.m_nIdx = 0;
+    sc.m_confirmHeight = 2;
+    params.ToID(sc.m_CoinID);
+    db->saveShieldedCoin(sc);
+
+    vector<ShieldedCoin> shieldedCoins;
+    db->selectCoins2(0, 100, Zero, coins, shieldedCoins, 1, false);
+    WALLET_CHECK(shieldedCoins.size() == 1);
+
+    sc.m_spentHeight = 140;
+    db->saveShieldedCoin(sc);
+    shieldedCoins.clear();
+    db->selectCoins2(0, 100, Zero, coins, shieldedCoins, 1, true);
+    WALLET_CHECK(shieldedCoins.empty());
+}
+
+void TestSelectPerf()
+{
+    cout << "\nWallet database coin selection performance test\n";
+
+    for (uint32_t nCoins = 1000; nCoins <= 100000; nCoins *= 10)
+    {
+        auto db = createSqliteWalletDB();
+
+        vector<Coin> coins;
+        coins.reserve(nCoins);
+        for (uint32_t i = 0; i < nCoins; i++)
+            coins.push_back(CreateAvailCoin(1 + rand() % 1000000));
+        db->storeCoins(coins);
+
+        const Amount amount = 300000;
+
+        helpers::StopWatch sw;
+        sw.start();
+        auto sel = SelectCoinsQuiet(*db, amount);
+        sw.stop();
+        WALLET_CHECK(!sel.empty());
+        uint64_t nFirst_us = sw.microseconds();
+
+        const uint32_t nIterations = 100;
+        sw.start();
+        for (uint32_t i = 0; i < nIterations; i++)
+        {
+            auto sel2 = SelectCoinsQuiet(*db, amount + i);
+            WALLET_CHECK(!sel2.empty());
+        }
+        sw.stop();
+
+        cout << nCoins << " coins, first selection: " << nFirst_us << " us, next: " << sw.microseconds() / nIterations << " us\n";
+    }
+}
+
+TxDescription CreateTestTx(uint32_t i)
+{
+    TxID txID = { };
+    memcpy(txID.data(), &i, sizeof(i));
+
+    TxDescription tx(txID);
+    tx.m_txType = TxType::Simple;
+    tx.m_amount = 100 + i;
+    tx.m_fee = 10;
+    tx.m_peerId.m_Pk = i;
+    tx.m_myId.m_Pk = i + 1;
+    tx.m_createTime = 1000 + i;
+    tx.m_minHeight = 134;
+    tx.m_sender = true;
+    tx.m_status = TxStatus::InProgress;
+    return tx;
+}
+
+void TestTxParameterCache()
+{
+    cout << "\nWallet database tx parameter cache test\n";
+    auto db = std::dynamic_pointer_cast<WalletDB>(createSqliteWalletDB());
+
+    const uint32_t nTxs = 20;
+    for (uint32_t i = 0; i < nTxs; i++)
+        db->saveTx(CreateTestTx(i));
+
+    // whole txs are evicted
+    db->set_ParameterCacheMax(50);
+    WALLET_CHECK(db->get_ParameterCacheStats().m_Count <= 50);
+
+    // the values don't depend on the eviction
+    for (uint32_t i = 0; i < nTxs; i++)
+    {
+        auto tx = CreateTestTx(i);
+        Amount amount = 0;
+        WALLET_CHECK(storage::getTxParameter(*db, tx.m_txId, TxParameterID::Amount, amount));
+        WALLET_CHECK(amount == tx.m_amount);
+    }
+
+    auto s0 = db->get_ParameterCacheStats();
+    auto tx = CreateTestTx(nTxs - 1);
+    Amount amount = 0;
+    WALLET_CHECK(storage::getTxParameter(*db, tx.m_txId, TxParameterID::Amount, amount));
+    auto s1 = db->get_ParameterCacheStats();
+    WALLET_CHECK(s1.m_Hits == s0.m_Hits + 1);
+
+    // the tx was read as a whole, the missing parameter is answered from the cache
+    db->set_ParameterCacheMax(100000);
+    WALLET_CHECK(db->getTx(tx.m_txId));
+    s0 = db->get_ParameterCacheStats();
+    Height h = 0;
+    WALLET_CHECK(!storage::getTxParameter(*db, tx.m_txId, TxParameterID::KernelProofHeight, h));
+    s1 = db->get_ParameterCacheStats();
+    WALLET_CHECK((s1.m_Hits == s0.m_Hits + 1) && (s1.m_Misses == s0.m_Misses));
+
+    WALLET_CHECK(storage::setTxParameter(*db, tx.m_txId, TxParameterID::KernelProofHeight, Height(120), true));
+    WALLET_CHECK(storage::getTxParameter(*db, tx.m_txId, TxParameterID::KernelProofHeight, h) && (h == 120));
+    db->delTxParameter(tx.m_txId, kDefaultSubTxID, TxParameterID::KernelProofHeight);
+    WALLET_CHECK(!storage::getTxParameter(*db, tx.m_txId, TxParameterID::KernelProofHeight, h));
+
+    db->deleteTx(tx.m_txId);
+    WALLET_CHECK(!db->getTx(tx.m_txId));
+    WALLET_CHECK(!storage::getTxParameter(*db, tx.m_txId, TxParameterID::Amount, amount));
+
+    // statements are reused
+    auto ss = db->get_StatementCacheStats();
+    WALLET_CHECK(ss.m_Hits > ss.m_Misses);
+    WALLET_CHECK(ss.m_Count > 0);
+}
+
+void TestTxCachePerf()
+{
+    cout << "\nWallet database tx cache performance test\n";
+
+    const uint32_t nTxs = 10000;
+    {
+        auto db = createSqliteWalletDB();
+        for (uint32_t i = 0; i < nTxs; i++)
+            db->saveTx(CreateTestTx(i));
+    }
+
+    auto db = std::dynamic_pointer_cast<WalletDB>(WalletDB::open("wallet.db", string("pass123")));
+
+    // similar to Wallet::ResumeAllTransactions: visit all the txs, then each tx reads its parameters on resume
+    auto fnResume = [&db]()
+    {
+        uint32_t nVisited = 0;
+        db->visitTx([&db, &nVisited](const TxDescription& tx)
+        {
+            TxStatus status = TxStatus::Pending;
+            storage::getTxParameter(*db, tx.m_txId, TxParameterID::Status, status);
+            Amount amount = 0;
+            storage::getTxParameter(*db, tx.m_txId, TxParameterID::Amount, amount);
+            Height h = 0;
+            storage::getTxParameter(*db, tx.m_txId, TxParameterID::KernelProofHeight, h); // missing
+            storage::getTxParameter(*db, tx.m_txId, TxParameterID::MaxHeight, h); // missing
+            nVisited++;
+            return true;
+        }, TxListFilter());
+        return nVisited;
+    };
+
+    for (int iPass = 0; iPass < 2; iPass++)
+    {
+        helpers::StopWatch sw;
+        sw.start();
+        uint32_t nVisited = fnResume();
+        sw.stop();
+        WALLET_CHECK(nVisited == nTxs);
+
+        auto ss = db->get_StatementCacheStats();
+        auto ps = db->get_ParameterCacheStats();
+        cout << nTxs << " txs, resume pass " << iPass << ": " << sw.milliseconds() << " ms. Statements: "
+            << ss.m_Hits << " hits, " << ss.m_Misses << " misses. Parameters: " << ps.m_Hits << " hits, " << ps.m_Misses << " misses, " << ps.m_Count << " cached\n";
+    }
+
+    // the cache is too small for all the txs
+    db->set_ParameterCacheMax(nTxs);
+    helpers::StopWatch sw;
+    sw.start();
+    fnResume();
+    sw.stop();
+    cout << nTxs << " txs, resume with a small parameter cache: " << sw.milliseconds() << " ms\n";
+}
+
+vector<TxID> ListTxIDs(const IWalletDB& db, TxListFilter filter, uint32_t nCount, uint32_t nSkip = 0)
+{
+    vector<TxID> res;
+    db.visitTx([&](const TxDescription& tx)
+    {
+        if (nSkip)
+            nSkip--;
+        else
+            res.push_back(tx.m_txId);
+        return !nCount || (res.size() < nCount);
+    }, filter);
+    return res;
+}
+
+void TestTxListKeyset()
+{
+    cout << "\nWallet database tx list keyset pagination test\n";
+    auto db = createSqliteWalletDB();
+
+    const uint32_t nTxs = 50;
+    for (uint32_t i = 0; i < nTxs; i++)
+    {
+        auto tx = CreateTestTx(i);
+        tx.m_createTime = 1000 + i / 3; // some txs are created at the same time
+        tx.m_status = (i & 1) ? TxStatus::Completed : TxStatus::InProgress;
+        db->saveTx(tx);
+        storage::setTxParameter(*db, tx.m_txId, TxParameterID::KernelProofHeight, Height(200 + i), false);
+    }
+
+    for (int iFilter = 0; iFilter < 2; iFilter++)
+    {
+        TxListFilter filter;
+        if (iFilter)
+            filter.m_Status = TxStatus::Completed;
+
+        auto vAll = ListTxIDs(*db, filter, 0);
+        WALLET_CHECK(vAll.size() == (iFilter ? nTxs / 2 : nTxs));
+
+        vector<TxID> vPaged;
+        while (true)
+        {
+            auto vPage = ListTxIDs(*db, filter, 7);
+            if (vPage.empty())
+                break;
+
+            WALLET_CHECK(vPage.size() <= 7);
+            vPaged.insert(vPaged.end(), vPage.begin(), vPage.end());
+            filter.m_AfterTxID = vPage.back();
+        }
+        WALLET_CHECK(vPaged == vAll);
+    }
+
+    // proof heights are loaded with the txs
+    db->visitTx([&](const TxDescription& tx)
+    {
+        WALLET_CHECK(storage::DeduceTxProofHeight(tx) == storage::DeduceTxProofHeight(*db, tx));
+        WALLET_CHECK(storage::DeduceTxProofHeight(tx) >= 200);
+        return true;
+    }, TxListFilter());
+
+    // unknown tx
+    TxListFilter filter;
+    filter.m_AfterTxID = CreateTestTx(nTxs).m_txId;
+    WALLET_CHECK(ListTxIDs(*db, filter, 0).empty());
+}
+
+void TestTxListPagingPerf()
+{
+    cout << "\nWallet database tx list paging performance test\n";
+    auto db = createSqliteWalletDB();
+
+    const uint32_t nTxs = 10000;
+    const uint32_t nPage = 100;
+    for (uint32_t i = 0; i < nTxs; i++)
+        db->saveTx(CreateTestTx(i));
+
+    TxListFilter filter;
+    auto vAll = ListTxIDs(*db, filter, 0);
+    WALLET_CHECK(vAll.size() == nTxs);
+
+    for (uint32_t nOffset : { nPage, nTxs / 10, nTxs / 2, nTxs - nPage })
+    {
+        helpers::StopWatch sw;
+        sw.start();
+        auto v1 = ListTxIDs(*db, filter, nPage, nOffset);
+        sw.stop();
+        uint64_t nSkip_us = sw.microseconds();
+
+        filter.m_AfterTxID = vAll[nOffset - 1];
+        sw.start();
+        auto v2 = ListTxIDs(*db, filter, nPage);
+        sw.stop();
+        filter.m_AfterTxID.reset();
+
+        WALLET_CHECK(v1 == v2);
+        cout << "Page at " << nOffset << ": skip " << nSkip_us << " us, keyset " << sw.microseconds() << " us\n";
+    }
+}
+
 int main() 
 {
     int logLevel = LOG_LEVEL_DEBUG;
@@ -1718,6 +2275,14 @@ int main()
     TestVouchers();
     TestShieldedStatus();
     TestShieldedStatus2();
+    TestTotals();
+    TestTotalsPerf();
+    TestCoinIndex();
+    TestSelectPerf();
+    TestTxParameterCache();
+    TestTxCachePerf();
+    TestTxListKeyset();
+    TestTxListPagingPerf();
 
     return WALLET_CHECK_RESULT;
 }